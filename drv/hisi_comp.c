@@ -104,21 +104,41 @@ struct hisi_zip_sqe {
 	__u32 checksum;
 };
 
+enum hw_buf_type {
+	HZ_PBUFFER,
+	HZ_SGL,
+};
+
 struct hisi_zip_sqe_ops {
 	const char *alg_name;
 	void (*fill_buf)(struct hisi_zip_sqe *sqe, struct wd_comp_msg *msg);
+	int (*fill_buf_sgl)(handle_t h_qp, struct hisi_zip_sqe *sqe,
+			    struct wd_comp_msg *msg);
 	void (*fill_sqe_type)(struct hisi_zip_sqe *sqe);
 	void (*fill_alg)(struct hisi_zip_sqe *sqe);
 	void (*fill_tag)(struct hisi_zip_sqe *sqe, __u32 tag);
 	void (*get_data_size)(struct hisi_zip_sqe *sqe, int op_type,
 			      struct wd_comp_msg *recv_msg);
 	int (*get_tag)(struct hisi_zip_sqe *sqe);
+	void (*fill_win_size)(struct hisi_zip_sqe *sqe,
+			      struct wd_comp_msg *msg);
 };
 
+extern struct hisi_zip_sqe_ops ops[];
+
 #define BLOCK_SIZE	(1 << 19)
 
-#define ZLIB_HEADER	"\x78\x9c"
 #define ZLIB_HEADER_SZ	2
+#define ZLIB_CM_DEFLATE	0x08
+#define ZLIB_CINFO_SHIFT	4
+#define ZLIB_MIN_WBITS	8
+/* FLEVEL 2, hardware always works at the default level */
+#define ZLIB_FLG_LEVEL	0x80
+#define ZLIB_FCHECK_MOD	31
+
+#define HZ_WIN_SIZE_SHIFT	12
+#define HZ_MAX_WBITS		15
+#define HZ_4K_WBITS		12
 
 /*
  * We use a extra field for gzip block length. So the fourth byte is \x04.
@@ -171,6 +191,10 @@ struct hisi_zip_sqe_ops {
 #define HZ_REQ_TYPE_MASK 0xff
 #define HZ_STREAM_POS_MASK 0x08000000
 
+#define HZ_BUF_TYPE_MASK	0xf00
+#define HZ_BUF_TYPE_SHIFT	8
+#define HZ_SGE_OFFSET_MASK	0xffffff
+
 #define HZ_HADDR_SHIFT		32
 #define HZ_SQE_TYPE_V1		0x0
 #define HZ_SQE_TYPE_V3		0x30000000
@@ -221,6 +245,42 @@ static void fill_buf_deflate(struct hisi_zip_sqe *sqe, struct wd_comp_msg *msg)
 	fill_buf_addr_deflate(sqe, req->src, req->dst, ctx_buf);
 }
 
+/* window size field of dw9, 0 keeps the default 32KB window */
+static const __u8 hz_win_size[] = {
+	[WD_COMP_WS_DEF]	= 0x0,
+	[WD_COMP_WS_4K]		= 0x1,
+	[WD_COMP_WS_8K]		= 0x2,
+	[WD_COMP_WS_16K]	= 0x3,
+	[WD_COMP_WS_32K]	= 0x0,
+};
+
+static void fill_win_size_v3(struct hisi_zip_sqe *sqe, struct wd_comp_msg *msg)
+{
+	/* decompression handles any window */
+	if (msg->req.op_type != WD_DIR_COMPRESS || msg->win_sz > WD_COMP_WS_32K)
+		return;
+
+	sqe->dw9 |= hz_win_size[msg->win_sz] << HZ_WIN_SIZE_SHIFT;
+}
+
+/* CINFO of zlib head tells the window which is really used */
+static void get_zlib_head(struct wd_comp_msg *msg, char *head)
+{
+	__u8 wbits = HZ_MAX_WBITS;
+	__u8 cmf, flg;
+
+	if (ops[WD_ZLIB].fill_win_size && msg->win_sz >= WD_COMP_WS_4K &&
+	    msg->win_sz < WD_COMP_WS_32K)
+		wbits = HZ_4K_WBITS + msg->win_sz - WD_COMP_WS_4K;
+
+	cmf = ((wbits - ZLIB_MIN_WBITS) << ZLIB_CINFO_SHIFT) | ZLIB_CM_DEFLATE;
+	flg = ZLIB_FLG_LEVEL;
+	flg += (ZLIB_FCHECK_MOD - ((cmf << 8) | flg) % ZLIB_FCHECK_MOD) %
+	       ZLIB_FCHECK_MOD;
+	head[0] = cmf;
+	head[1] = flg;
+}
+
 static void fill_buf_zlib(struct hisi_zip_sqe *sqe, struct wd_comp_msg *msg)
 {
 	__u32 in_size = msg->req.src_len;
@@ -231,7 +291,7 @@ static void fill_buf_zlib(struct hisi_zip_sqe *sqe, struct wd_comp_msg *msg)
 
 	if (msg->stream_pos == WD_COMP_STREAM_NEW) {
 		if (msg->req.op_type == WD_DIR_COMPRESS) {
-			memcpy(dst, ZLIB_HEADER, ZLIB_HEADER_SZ);
+			get_zlib_head(msg, dst);
 			dst += ZLIB_HEADER_SZ;
 			out_size -= ZLIB_HEADER_SZ;
 		} else {
@@ -279,6 +339,142 @@ static void fill_buf_gzip(struct hisi_zip_sqe *sqe, struct wd_comp_msg *msg)
 	fill_buf_addr_deflate(sqe, src, dst, ctx_buf);
 }
 
+/* the header of zlib/gzip is always in the first sge of dst */
+static int fill_head_to_sgl(struct wd_datalist *list, const char *head,
+			    __u32 head_sz)
+{
+	while (list && (!list->data || !list->len))
+		list = list->next;
+
+	if (!list || list->len < head_sz) {
+		WD_ERR("invalid: first sge is too small for %u bytes head!\n",
+		       head_sz);
+		return -WD_EINVAL;
+	}
+
+	memcpy(list->data, head, head_sz);
+
+	return 0;
+}
+
+static int fill_buf_sgl_common(handle_t h_qp, struct hisi_zip_sqe *sqe,
+			       struct wd_comp_msg *msg, const char *head,
+			       __u32 head_sz)
+{
+	struct wd_comp_req *req = &msg->req;
+	__u32 in_size = req->src_len;
+	__u32 out_size = msg->avail_out;
+	__u32 in_offset = 0;
+	__u32 out_offset = 0;
+	handle_t h_sgl_pool;
+	void *hw_sgl_in;
+	void *hw_sgl_out;
+	void *ctx_buf;
+	int ret;
+
+	if (head_sz && msg->stream_pos == WD_COMP_STREAM_NEW) {
+		if (req->op_type == WD_DIR_COMPRESS) {
+			if (out_size < head_sz) {
+				WD_ERR("invalid: avail_out(%u) is too small!\n",
+				       out_size);
+				return -WD_EINVAL;
+			}
+			ret = fill_head_to_sgl(req->list_dst, head, head_sz);
+			if (ret)
+				return ret;
+			out_offset = head_sz;
+			out_size -= head_sz;
+		} else {
+			if (in_size < head_sz) {
+				WD_ERR("invalid: in_len(%u) is too small!\n",
+				       in_size);
+				return -WD_EINVAL;
+			}
+			in_offset = head_sz;
+			in_size -= head_sz;
+		}
+	}
+
+	h_sgl_pool = hisi_qm_get_sglpool(h_qp);
+	if (!h_sgl_pool) {
+		WD_ERR("failed to get sglpool!\n");
+		return -WD_EINVAL;
+	}
+
+	hw_sgl_in = hisi_qm_get_hw_sgl(h_sgl_pool, req->list_src);
+	if (!hw_sgl_in) {
+		WD_ERR("failed to get hw sgl in!\n");
+		return -WD_ENOMEM;
+	}
+
+	hw_sgl_out = hisi_qm_get_hw_sgl(h_sgl_pool, req->list_dst);
+	if (!hw_sgl_out) {
+		WD_ERR("failed to get hw sgl out!\n");
+		hisi_qm_put_hw_sgl(h_sgl_pool, hw_sgl_in);
+		return -WD_ENOMEM;
+	}
+
+	fill_buf_size_deflate(sqe, in_size, out_size);
+
+	if (msg->ctx_buf)
+		ctx_buf = msg->ctx_buf + RSV_OFFSET;
+	else
+		ctx_buf = NULL;
+
+	fill_buf_addr_deflate(sqe, hw_sgl_in, hw_sgl_out, ctx_buf);
+
+	sqe->dw7 |= in_offset & HZ_SGE_OFFSET_MASK;
+	sqe->dw8 |= out_offset & HZ_SGE_OFFSET_MASK;
+	sqe->dw9 |= HZ_SGL << HZ_BUF_TYPE_SHIFT;
+
+	return 0;
+}
+
+static int fill_buf_sgl_deflate(handle_t h_qp, struct hisi_zip_sqe *sqe,
+				struct wd_comp_msg *msg)
+{
+	return fill_buf_sgl_common(h_qp, sqe, msg, NULL, 0);
+}
+
+static int fill_buf_sgl_zlib(handle_t h_qp, struct hisi_zip_sqe *sqe,
+			     struct wd_comp_msg *msg)
+{
+	char head[ZLIB_HEADER_SZ];
+
+	get_zlib_head(msg, head);
+
+	return fill_buf_sgl_common(h_qp, sqe, msg, head, ZLIB_HEADER_SZ);
+}
+
+static int fill_buf_sgl_gzip(handle_t h_qp, struct hisi_zip_sqe *sqe,
+			     struct wd_comp_msg *msg)
+{
+	return fill_buf_sgl_common(h_qp, sqe, msg, GZIP_HEADER,
+				   GZIP_HEADER_SZ);
+}
+
+static void put_sgl_from_sqe(handle_t h_qp, struct hisi_zip_sqe *sqe)
+{
+	__u32 buf_type = (sqe->dw9 & HZ_BUF_TYPE_MASK) >> HZ_BUF_TYPE_SHIFT;
+	handle_t h_sgl_pool;
+	void *hw_sgl_in;
+	void *hw_sgl_out;
+
+	if (buf_type != HZ_SGL)
+		return;
+
+	h_sgl_pool = hisi_qm_get_sglpool(h_qp);
+	if (!h_sgl_pool)
+		return;
+
+	hw_sgl_in = (void *)((__u64)sqe->source_addr_h << HZ_HADDR_SHIFT |
+			     sqe->source_addr_l);
+	hw_sgl_out = (void *)((__u64)sqe->dest_addr_h << HZ_HADDR_SHIFT |
+			      sqe->dest_addr_l);
+	hisi_qm_put_hw_sgl(h_sgl_pool, hw_sgl_in);
+	hisi_qm_put_hw_sgl(h_sgl_pool, hw_sgl_out);
+}
+
 static void fill_sqe_type_v1(struct hisi_zip_sqe *sqe)
 {
 	__u32 val;
@@ -381,19 +577,23 @@ static int get_tag_v3(struct hisi_zip_sqe *sqe)
 struct hisi_zip_sqe_ops ops[] = { {
 		.alg_name = "deflate",
 		.fill_buf = fill_buf_deflate,
+		.fill_buf_sgl = fill_buf_sgl_deflate,
 		.fill_sqe_type = fill_sqe_type_v3,
 		.fill_alg = fill_alg_deflate,
 		.fill_tag = fill_tag_v3,
 		.get_data_size = get_data_size_deflate,
 		.get_tag = get_tag_v3,
+		.fill_win_size = fill_win_size_v3,
 	}, {
 		.alg_name = "zlib",
 		.fill_buf = fill_buf_zlib,
+		.fill_buf_sgl = fill_buf_sgl_zlib,
 		.fill_alg = fill_alg_zlib,
 		.get_data_size = get_data_size_zlib,
 	}, {
 		.alg_name = "gzip",
 		.fill_buf = fill_buf_gzip,
+		.fill_buf_sgl = fill_buf_sgl_gzip,
 		.fill_alg = fill_alg_gzip,
 		.get_data_size = get_data_size_gzip,
 	},
@@ -410,6 +610,8 @@ static void hisi_zip_sqe_ops_adapt(handle_t h_qp)
 		ops[WD_GZIP].fill_sqe_type = fill_sqe_type_v1;
 		ops[WD_GZIP].fill_tag = fill_tag_v1;
 		ops[WD_GZIP].get_tag = get_tag_v1;
+		ops[WD_ZLIB].fill_win_size = NULL;
+		ops[WD_GZIP].fill_win_size = NULL;
 	} else if (qp->q_info.hw_type >= HISI_QM_API_VER3_BASE) {
 		ops[WD_ZLIB].fill_sqe_type = fill_sqe_type_v3;
 		ops[WD_ZLIB].fill_tag = fill_tag_v3;
@@ -417,6 +619,8 @@ static void hisi_zip_sqe_ops_adapt(handle_t h_qp)
 		ops[WD_GZIP].fill_sqe_type = fill_sqe_type_v3;
 		ops[WD_GZIP].fill_tag = fill_tag_v3;
 		ops[WD_GZIP].get_tag = get_tag_v3;
+		ops[WD_ZLIB].fill_win_size = fill_win_size_v3;
+		ops[WD_GZIP].fill_win_size = fill_win_size_v3;
 	}
 }
 
@@ -469,13 +673,20 @@ static int fill_zip_comp_sqe(struct hisi_qp *qp, struct wd_comp_msg *msg,
 	__u8 flush_type;
 	__u8 stream_pos;
 	__u8 state;
+	int ret;
 
 	if (alg_type >= WD_COMP_ALG_MAX) {
 		WD_ERR("invalid algorithm type(%d)\n", alg_type);
 		return -WD_EINVAL;
 	}
 
-	ops[alg_type].fill_buf(sqe, msg);
+	if (msg->data_fmt == WD_SGL_BUF) {
+		ret = ops[alg_type].fill_buf_sgl((handle_t)qp, sqe, msg);
+		if (ret)
+			return ret;
+	} else {
+		ops[alg_type].fill_buf(sqe, msg);
+	}
 
 	ops[alg_type].fill_sqe_type(sqe);
 
@@ -483,6 +694,9 @@ static int fill_zip_comp_sqe(struct hisi_qp *qp, struct wd_comp_msg *msg,
 
 	ops[alg_type].fill_tag(sqe, msg->tag);
 
+	if (ops[alg_type].fill_win_size)
+		ops[alg_type].fill_win_size(sqe, msg);
+
 	state = (msg->stream_mode == WD_COMP_STATEFUL) ? HZ_STATEFUL :
 		HZ_STATELESS;
 	stream_pos = (msg->stream_pos == WD_COMP_STREAM_NEW) ? HZ_STREAM_NEW :
@@ -507,7 +721,7 @@ static int hisi_zip_comp_send(handle_t ctx, struct wd_comp_msg *msg, void *priv)
 {
 	struct hisi_qp *qp = wd_ctx_get_priv(ctx);
 	handle_t h_qp = (handle_t)qp;
-	struct hisi_zip_sqe sqe = {0};
+	struct hisi_zip_sqe *sqe;
 	__u16 count = 0;
 	int ret;
 
@@ -521,16 +735,23 @@ static int hisi_zip_comp_send(handle_t ctx, struct wd_comp_msg *msg, void *priv)
 		msg->avail_out = HZ_MAX_SIZE;
 	}
 
-	ret = fill_zip_comp_sqe(qp, msg, &sqe);
+	ret = hisi_qm_reserve_sqe(h_qp, 1, &count, (void **)&sqe);
+	if (ret < 0) {
+		WD_ERR("qm send is err(%d)!\n", ret);
+		return ret;
+	}
+
+	/* the slot in the ring holds an old sqe */
+	memset(sqe, 0, sizeof(struct hisi_zip_sqe));
+	ret = fill_zip_comp_sqe(qp, msg, sqe);
 	if (ret < 0) {
 		WD_ERR("failed to fill zip sqe(%d)!\n", ret);
+		hisi_qm_commit_sqe(h_qp, 0);
 		return ret;
 	}
-	ret = hisi_qm_send(h_qp, &sqe, 1, &count);
-	if (ret < 0)
-		WD_ERR("qm send is err(%d)!\n", ret);
+	hisi_qm_commit_sqe(h_qp, 1);
 
-	return ret;
+	return 0;
 }
 
 static int parse_zip_sqe(struct hisi_qp *qp, struct hisi_zip_sqe *sqe, 
@@ -594,15 +815,19 @@ static int hisi_zip_comp_recv(handle_t ctx, struct wd_comp_msg *recv_msg,
 {
 	struct hisi_qp *qp = wd_ctx_get_priv(ctx);
 	handle_t h_qp = (handle_t)qp;
-	struct hisi_zip_sqe sqe = {0};
-	__u16 count = 0;
+	struct hisi_zip_sqe *sqe;
 	int ret;
 
-	ret = hisi_qm_recv(h_qp, &sqe, 1, &count);
+	ret = hisi_qm_peek_resp(h_qp, (void **)&sqe);
 	if (ret < 0)
 		return ret;
 
-	return parse_zip_sqe(qp, &sqe, recv_msg);
+	put_sgl_from_sqe(h_qp, sqe);
+
+	ret = parse_zip_sqe(qp, sqe, recv_msg);
+	hisi_qm_release_resp(h_qp);
+
+	return ret;
 }
 
 struct wd_comp_driver hisi_zip = {
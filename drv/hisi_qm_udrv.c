@@ -2,6 +2,7 @@
 #include <limits.h>
 #include <stdlib.h>
 #include <string.h>
+#include <numa.h>
 #include <sys/mman.h>
 
 #include "hisi_qm_udrv.h"
@@ -24,12 +25,22 @@
 /* the max sge num in on BD, QM user it be the sgl pool size */
 #define HISI_SGL_NUM_IN_BD 256
 
+/* the max sgl num of one pool, set by wd_ctx_set_sgl_num() */
+#define HISI_SGL_NUM_MAX 65536
+
 /* sgl address must be 64 bytes aligned */
 #define HISI_SGL_ALIGE 64
 
 #define HISI_MAX_SIZE_IN_SGE (1024 * 1024 * 8)
 
-#define ADDR_ALIGN_64(addr) ((((__u64)(addr) >> 6) + 1) << 6)
+#define SIZE_ALIGN_64(size) (((size) + HISI_SGL_ALIGE - 1) & \
+			     ~(HISI_SGL_ALIGE - 1))
+
+/* free list head of sgl pool: a tag against ABA, and the top sgl index */
+#define SGL_NIL			0xffffffff
+#define SGL_HEAD(tag, idx)	(((__u64)(tag) << 32) | (idx))
+#define SGL_HEAD_TAG(head)	((__u32)((head) >> 32))
+#define SGL_HEAD_IDX(head)	((__u32)(head))
 
 struct hisi_qm_type {
 	__u16	qm_ver;
@@ -80,16 +91,18 @@ struct hisi_sgl {
 };
 
 struct hisi_sgl_pool {
-	/* the addr64 align offset base sgl */
-	void **sgl_align;
-	/* the sgl src address array*/
-	void **sgl;
-	/* the sgl pool stack depth */
-	__u32 depth;
-	__u32 top;
+	/* all the sgls in one 64 bytes aligned slab on the device's node */
+	void *slab;
+	size_t slab_size;
+	/* the size of one sgl in the slab */
+	__u32 sgl_size;
+	/* the index of the next free sgl of each one */
+	__u32 *next;
+	/* updated by CAS, see SGL_HEAD() */
+	__u64 head;
 	__u32 sge_num;
 	__u32 sgl_num;
-	pthread_spinlock_t lock;
+	bool numa;
 };
 
 static int hacc_db_v1(struct hisi_qm_queue_info *q, __u8 cmd,
@@ -335,6 +348,7 @@ int hisi_qm_get_free_sqe_num(handle_t h_qp)
 handle_t hisi_qm_alloc_qp(struct hisi_qm_priv *config, handle_t ctx)
 {
 	struct hisi_qp *qp;
+	__u32 sgl_num;
 	int ret;
 
 	if (!config)
@@ -355,7 +369,12 @@ handle_t hisi_qm_alloc_qp(struct hisi_qm_priv *config, handle_t ctx)
 	if (ret)
 		goto out_qp;
 
-	qp->h_sgl_pool = hisi_qm_create_sglpool(HISI_SGL_NUM_IN_BD, HISI_SGE_NUM_IN_SGL);
+	sgl_num = wd_ctx_get_sgl_num(ctx);
+	if (!sgl_num)
+		sgl_num = HISI_SGL_NUM_IN_BD;
+
+	qp->h_sgl_pool = hisi_qm_create_sglpool(sgl_num, HISI_SGE_NUM_IN_SGL,
+						wd_get_numa_id(ctx));
 	if (!qp->h_sgl_pool)
 		goto out_qp;
 
@@ -407,6 +426,7 @@ int hisi_qm_send(handle_t h_qp, void *req, __u16 expect, __u16 *count)
 	pthread_spin_lock(&q_info->lock);
 
 	if (wd_ioread32(q_info->ds_tx_base) == 1) {
+		pthread_spin_unlock(&q_info->lock);
 		WD_ERR("wd queue hw error happened before qm send!\n");
 		return -WD_HW_EACCESS;
 	}
@@ -432,27 +452,86 @@ int hisi_qm_send(handle_t h_qp, void *req, __u16 expect, __u16 *count)
 	return 0;
 }
 
-static int hisi_qm_recv_single(struct hisi_qm_queue_info *q_info, void *resp)
+int hisi_qm_reserve_sqe(handle_t h_qp, __u16 expect, __u16 *count,
+			void **sqe)
 {
-	struct cqe *cqe;
-	__u16 i, j;
+	struct hisi_qp *qp = (struct hisi_qp *)h_qp;
+	struct hisi_qm_queue_info *q_info;
+	__u16 free_num, num, tail, i;
 
-	i = q_info->cq_head_index;
-	cqe = q_info->cq_base + i * sizeof(struct cqe);
+	if (!qp || !expect || !count || !sqe)
+		return -WD_EINVAL;
 
-	if (q_info->cqc_phase == CQE_PHASE(cqe)) {
-		j = CQE_SQ_HEAD_INDEX(cqe);
-		if (j >= QM_Q_DEPTH) {
-			WD_ERR("CQE_SQ_HEAD_INDEX(%d) error\n", j);
-			errno = -WD_EIO;
-			return -WD_EIO;
-		}
-		memcpy(resp, (void *)((uintptr_t)q_info->sq_base +
-			j * q_info->sqe_size), q_info->sqe_size);
-	} else {
+	q_info = &qp->q_info;
+
+	pthread_spin_lock(&q_info->lock);
+
+	if (wd_ioread32(q_info->ds_tx_base) == 1) {
+		pthread_spin_unlock(&q_info->lock);
+		WD_ERR("wd queue hw error happened before qm send!\n");
+		return -WD_HW_EACCESS;
+	}
+
+	free_num = get_free_num(q_info);
+	if (!free_num) {
+		pthread_spin_unlock(&q_info->lock);
+		return -WD_EBUSY;
+	}
+
+	num = expect > free_num ? free_num : expect;
+	tail = q_info->sq_tail_index;
+	for (i = 0; i < num; i++) {
+		sqe[i] = (void *)((uintptr_t)q_info->sq_base +
+			 tail * q_info->sqe_size);
+		tail = (tail + 1) % QM_Q_DEPTH;
+	}
+	*count = num;
+
+	/* the lock is held until hisi_qm_commit_sqe() */
+	return 0;
+}
+
+void hisi_qm_commit_sqe(handle_t h_qp, __u16 num)
+{
+	struct hisi_qp *qp = (struct hisi_qp *)h_qp;
+	struct hisi_qm_queue_info *q_info = &qp->q_info;
+	__u16 tail;
+
+	if (num) {
+		tail = (q_info->sq_tail_index + num) % QM_Q_DEPTH;
+		q_info->db(q_info, DOORBELL_CMD_SQ, tail, 0);
+		q_info->sq_tail_index = tail;
+		q_info->used_num += num;
+	}
+
+	pthread_spin_unlock(&q_info->lock);
+}
+
+static int hisi_qm_peek_single(struct hisi_qm_queue_info *q_info, void **resp)
+{
+	struct cqe *cqe;
+	__u16 j;
+
+	cqe = q_info->cq_base + q_info->cq_head_index * sizeof(struct cqe);
+	if (q_info->cqc_phase != CQE_PHASE(cqe))
 		return -WD_EAGAIN;
+
+	j = CQE_SQ_HEAD_INDEX(cqe);
+	if (j >= QM_Q_DEPTH) {
+		WD_ERR("CQE_SQ_HEAD_INDEX(%d) error\n", j);
+		errno = -WD_EIO;
+		return -WD_EIO;
 	}
 
+	*resp = (void *)((uintptr_t)q_info->sq_base + j * q_info->sqe_size);
+
+	return 0;
+}
+
+static void hisi_qm_release_single(struct hisi_qm_queue_info *q_info)
+{
+	__u16 i = q_info->cq_head_index;
+
 	if (i == QM_Q_DEPTH - 1) {
 		q_info->cqc_phase = !(q_info->cqc_phase);
 		i = 0;
@@ -469,10 +548,47 @@ static int hisi_qm_recv_single(struct hisi_qm_queue_info *q_info, void *resp)
 	pthread_spin_lock(&q_info->lock);
 	q_info->used_num--;
 	pthread_spin_unlock(&q_info->lock);
+}
+
+static int hisi_qm_recv_single(struct hisi_qm_queue_info *q_info, void *resp)
+{
+	void *sqe;
+	int ret;
+
+	ret = hisi_qm_peek_single(q_info, &sqe);
+	if (ret)
+		return ret;
+
+	memcpy(resp, sqe, q_info->sqe_size);
+	hisi_qm_release_single(q_info);
 
 	return 0;
 }
 
+int hisi_qm_peek_resp(handle_t h_qp, void **resp)
+{
+	struct hisi_qp *qp = (struct hisi_qp *)h_qp;
+	struct hisi_qm_queue_info *q_info;
+
+	if (!qp || !resp)
+		return -WD_EINVAL;
+
+	q_info = &qp->q_info;
+	if (wd_ioread32(q_info->ds_rx_base) == 1) {
+		WD_ERR("wd queue hw error happened before qm receive!\n");
+		return -WD_HW_EACCESS;
+	}
+
+	return hisi_qm_peek_single(q_info, resp);
+}
+
+void hisi_qm_release_resp(handle_t h_qp)
+{
+	struct hisi_qp *qp = (struct hisi_qp *)h_qp;
+
+	hisi_qm_release_single(&qp->q_info);
+}
+
 int hisi_qm_recv(handle_t h_qp, void *resp, __u16 expect, __u16 *count)
 {
 	struct hisi_qp *qp = (struct hisi_qp *)h_qp;
@@ -509,40 +625,51 @@ int hisi_qm_recv(handle_t h_qp, void *resp, __u16 expect, __u16 *count)
 	return ret;
 }
 
-static void *hisi_qm_create_sgl(__u32 sge_num)
+static void *hisi_qm_alloc_slab(struct hisi_sgl_pool *pool, int numa_id)
 {
-	void *sgl;
-	int size;
+	void *slab;
+
+	if (numa_id >= 0 && numa_available() >= 0) {
+		slab = numa_alloc_onnode(pool->slab_size, numa_id);
+		if (slab) {
+			pool->numa = true;
+			return slab;
+		}
+	}
 
-	size = sizeof(struct hisi_sgl) +
-			sge_num * (sizeof(struct hisi_sge)) + HISI_SGL_ALIGE;
-	sgl = calloc(1, size);
-	if (!sgl)
+	if (posix_memalign(&slab, HISI_SGL_ALIGE, pool->slab_size))
 		return NULL;
 
-	return sgl;
+	pool->numa = false;
+	return slab;
 }
 
-static struct hisi_sgl *hisi_qm_align_sgl(void *sgl, __u32 sge_num)
+static inline struct hisi_sgl *hisi_qm_sgl_at(struct hisi_sgl_pool *pool,
+					      __u32 idx)
 {
-	struct hisi_sgl *sgl_align;
+	return (struct hisi_sgl *)((uintptr_t)pool->slab +
+				   (size_t)idx * pool->sgl_size);
+}
 
-	/* Hardware require the address must be 64 bytes aligned */
-	sgl_align = (struct hisi_sgl *)ADDR_ALIGN_64(sgl);
-	sgl_align->entry_sum_in_chain = sge_num;
-	sgl_align->entry_sum_in_sgl = 0;
-	sgl_align->entry_length_in_sgl = sge_num;
-	sgl_align->next_dma = 0;
+static __u32 hisi_qm_sgl_idx(struct hisi_sgl_pool *pool, struct hisi_sgl *sgl)
+{
+	uintptr_t offs = (uintptr_t)sgl - (uintptr_t)pool->slab;
+
+	if ((uintptr_t)sgl < (uintptr_t)pool->slab ||
+	    offs >= pool->slab_size || offs % pool->sgl_size)
+		return SGL_NIL;
 
-	return sgl_align;
+	return offs / pool->sgl_size;
 }
 
-handle_t hisi_qm_create_sglpool(__u32 sgl_num, __u32 sge_num)
+handle_t hisi_qm_create_sglpool(__u32 sgl_num, __u32 sge_num, int numa_id)
 {
 	struct hisi_sgl_pool *sgl_pool;
-	int i;
+	struct hisi_sgl *sgl;
+	__u32 i;
 
-	if (!sgl_num || !sge_num || sge_num > HISI_SGE_NUM_IN_SGL) {
+	if (!sgl_num || sgl_num > HISI_SGL_NUM_MAX ||
+	    !sge_num || sge_num > HISI_SGE_NUM_IN_SGL) {
 		WD_ERR("create sgl_pool failed, sgl_num=%u, sge_num=%u\n",
 			sgl_num, sge_num);
 		return 0;
@@ -554,34 +681,35 @@ handle_t hisi_qm_create_sglpool(__u32 sgl_num, __u32 sge_num)
 		return 0;
 	}
 
-	sgl_pool->sgl = calloc(sgl_num, sizeof(void *));
-	if (!sgl_pool->sgl) {
-		WD_ERR("sgl array alloc memory failed.\n");
+	sgl_pool->next = calloc(sgl_num, sizeof(__u32));
+	if (!sgl_pool->next) {
+		WD_ERR("sgl index array alloc memory failed.\n");
 		goto err_out;
 	}
 
-	sgl_pool->sgl_align = calloc(sgl_num, sizeof(void *));
-	if (!sgl_pool->sgl_align) {
-		WD_ERR("sgl align array alloc memory failed.\n");
+	/* Hardware require the address must be 64 bytes aligned */
+	sgl_pool->sgl_size = SIZE_ALIGN_64(sizeof(struct hisi_sgl) +
+					   sge_num * sizeof(struct hisi_sge));
+	sgl_pool->slab_size = (size_t)sgl_num * sgl_pool->sgl_size;
+	sgl_pool->slab = hisi_qm_alloc_slab(sgl_pool, numa_id);
+	if (!sgl_pool->slab) {
+		WD_ERR("sgl slab alloc memory failed.\n");
 		goto err_out;
 	}
+	sgl_pool->sgl_num = sgl_num;
+	sgl_pool->sge_num = sge_num;
 
-	/* base the sgl_num create the sgl chain */
+	/*
+	 * The sge entries are filled when the sgl is got, the length is fixed,
+	 * other fields of the head are reset by hisi_qm_get_hw_sgl().
+	 */
 	for (i = 0; i < sgl_num; i++) {
-		sgl_pool->sgl[i] = hisi_qm_create_sgl(sge_num);
-		if (!sgl_pool->sgl[i]) {
-			WD_ERR("sgl create failed.\n");
-			goto err_out;
-		}
-
-		sgl_pool->sgl_align[i] = hisi_qm_align_sgl(sgl_pool->sgl[i], sge_num);
+		sgl = hisi_qm_sgl_at(sgl_pool, i);
+		memset(sgl, 0, sizeof(struct hisi_sgl));
+		sgl->entry_length_in_sgl = sge_num;
+		sgl_pool->next[i] = i + 1 < sgl_num ? i + 1 : SGL_NIL;
 	}
-
-	sgl_pool->sgl_num = sgl_num;
-	sgl_pool->sge_num = sge_num;
-	sgl_pool->depth = sgl_num;
-	sgl_pool->top = sgl_num;
-	pthread_spin_init(&sgl_pool->lock, PTHREAD_PROCESS_SHARED);
+	sgl_pool->head = SGL_HEAD(0, 0);
 
 	return (handle_t)sgl_pool;
 
@@ -593,104 +721,123 @@ err_out:
 void hisi_qm_destroy_sglpool(handle_t sgl_pool)
 {
 	struct hisi_sgl_pool *pool = (struct hisi_sgl_pool *)sgl_pool;
-	int i;
 
 	if (!pool) {
 		WD_ERR("sgl_pool is NULL\n");
 		return;
 	}
-	if (pool->sgl) {
-		for (i = 0; i < pool->sgl_num; i++)
-			if (pool->sgl[i])
-				free(pool->sgl[i]);
 
-		free(pool->sgl);
+	if (pool->slab) {
+		if (pool->numa)
+			numa_free(pool->slab, pool->slab_size);
+		else
+			free(pool->slab);
 	}
 
-	if (pool->sgl_align)
-		free(pool->sgl_align);
+	free(pool->next);
 	free(pool);
 }
 
+/*
+ * The free sgls are a lock-free stack linked by pool->next, the tag of the
+ * head is bumped by each pop and push, so a CAS fails if the head has been
+ * popped and pushed back by others since it was read.
+ */
 static struct hisi_sgl *hisi_qm_sgl_pop(struct hisi_sgl_pool *pool)
 {
 	struct hisi_sgl *hw_sgl;
-
-	pthread_spin_lock(&pool->lock);
-
-	if (pool->top == 0) {
-		WD_ERR("The sgl pool is empty\n");
-		pthread_spin_unlock(&pool->lock);
-		return NULL;
-	}
-
-	pool->top--;
-	hw_sgl = pool->sgl_align[pool->top];
-	pthread_spin_unlock(&pool->lock);
-	return hw_sgl;
-}
-
-static int hisi_qm_sgl_push(struct hisi_sgl_pool *pool, struct hisi_sgl *hw_sgl)
-{
-	pthread_spin_lock(&pool->lock);
-	if (pool->top >= pool->depth) {
-		WD_ERR("The sgl pool is full\n");
-		pthread_spin_unlock(&pool->lock);
-		return -WD_EINVAL;
-	}
-
+	__u64 old, new;
+	__u32 idx;
+
+	old = __atomic_load_n(&pool->head, __ATOMIC_ACQUIRE);
+	do {
+		idx = SGL_HEAD_IDX(old);
+		/* it's refilled by put, the caller may try again */
+		if (idx == SGL_NIL)
+			return NULL;
+
+		new = SGL_HEAD(SGL_HEAD_TAG(old) + 1,
+			       __atomic_load_n(pool->next + idx,
+					       __ATOMIC_RELAXED));
+	} while (!__atomic_compare_exchange_n(&pool->head, &old, new, true,
+					      __ATOMIC_ACQUIRE,
+					      __ATOMIC_ACQUIRE));
+
+	hw_sgl = hisi_qm_sgl_at(pool, idx);
 	hw_sgl->next_dma = 0;
-	hw_sgl->entry_sum_in_sgl = 0;
 	hw_sgl->entry_sum_in_chain = pool->sge_num;
-	hw_sgl->entry_length_in_sgl = pool->sge_num;
+	hw_sgl->entry_sum_in_sgl = 0;
 	hw_sgl->entry_size_in_sgl = 0;
 
-	pool->sgl_align[pool->top] = hw_sgl;
-	pool->top++;
-	pthread_spin_unlock(&pool->lock);
+	return hw_sgl;
+}
 
-	return 0;
+/* push the sgls from first to last, which are linked by pool->next already */
+static void hisi_qm_sgl_push(struct hisi_sgl_pool *pool, __u32 first,
+			     __u32 last)
+{
+	__u64 old, new;
+
+	old = __atomic_load_n(&pool->head, __ATOMIC_RELAXED);
+	do {
+		__atomic_store_n(pool->next + last, SGL_HEAD_IDX(old),
+				 __ATOMIC_RELAXED);
+		new = SGL_HEAD(SGL_HEAD_TAG(old) + 1, first);
+	} while (!__atomic_compare_exchange_n(&pool->head, &old, new, true,
+					      __ATOMIC_RELEASE,
+					      __ATOMIC_RELAXED));
 }
 
 void hisi_qm_put_hw_sgl(handle_t sgl_pool, void *hw_sgl)
 {
 	struct hisi_sgl_pool *pool = (struct hisi_sgl_pool *)sgl_pool;
 	struct hisi_sgl *cur = (struct hisi_sgl *)hw_sgl;
-	struct hisi_sgl *next = (struct hisi_sgl *)hw_sgl;
-	int ret;
+	__u32 first = SGL_NIL;
+	__u32 last = SGL_NIL;
+	__u32 idx;
 
 	if (!pool)
 		return;
 
+	/* the whole chain goes back by one push, the heads aren't touched */
 	while (cur) {
-		next = (struct hisi_sgl *)cur->next_dma;
-		ret = hisi_qm_sgl_push(pool, cur);
-		if (ret)
+		idx = hisi_qm_sgl_idx(pool, cur);
+		if (idx == SGL_NIL) {
+			WD_ERR("The sgl isn't from the pool\n");
 			break;
+		}
 
-		cur = next;
+		if (last == SGL_NIL)
+			first = idx;
+		else
+			pool->next[last] = idx;
+		last = idx;
+
+		cur = (struct hisi_sgl *)cur->next_dma;
 	}
 
-	return;
+	if (first != SGL_NIL)
+		hisi_qm_sgl_push(pool, first, last);
 }
 
-void *hisi_qm_get_hw_sgl(handle_t sgl_pool, struct wd_datalist *sgl)
+int hisi_qm_try_get_hw_sgl(handle_t sgl_pool, struct wd_datalist *sgl,
+			   void **hw_sgl)
 {
 	struct hisi_sgl_pool *pool = (struct hisi_sgl_pool *)sgl_pool;
 	struct wd_datalist *tmp = sgl;
 	struct hisi_sgl *head;
 	struct hisi_sgl *next;
 	struct hisi_sgl *cur;
-	int i = 0;
+	int ret, i = 0;
 
-	if (!pool || !sgl) {
+	if (!pool || !sgl || !hw_sgl) {
 		WD_ERR("get hw sgl pool or sgl is NULL\n");
-		return NULL;
+		return -WD_EINVAL;
 	}
 
 	head = hisi_qm_sgl_pop(pool);
 	if (!head)
-		return NULL;
+		return -WD_EBUSY;
 
 	cur = head;
 	tmp = sgl;
@@ -703,6 +850,7 @@ void *hisi_qm_get_hw_sgl(handle_t sgl_pool, struct wd_datalist *sgl)
 
 		if (tmp->len > HISI_MAX_SIZE_IN_SGE) {
 			WD_ERR("the data len is invalid: %u\n", tmp->len);
+			ret = -WD_EINVAL;
 			goto err_out;
 		}
 
@@ -721,7 +869,7 @@ void *hisi_qm_get_hw_sgl(handle_t sgl_pool, struct wd_datalist *sgl)
 		if (i == pool->sge_num && tmp->next) {
 			next = hisi_qm_sgl_pop(pool);
 			if (!next) {
-				WD_ERR("the sgl pool is not enough");
+				ret = -WD_EBUSY;
 				goto err_out;
 			}
 			cur->next_dma = (uintptr_t)next;
@@ -735,13 +883,29 @@ void *hisi_qm_get_hw_sgl(handle_t sgl_pool, struct wd_datalist *sgl)
 	}
 
 	/* There is no data, recycle the hardware sgl head to pool */
-	if (!head->entry_sum_in_chain)
+	if (!head->entry_sum_in_chain) {
+		ret = -WD_EINVAL;
 		goto err_out;
+	}
 
-	return head;
+	*hw_sgl = head;
+
+	return 0;
 err_out:
 	hisi_qm_put_hw_sgl(sgl_pool, head);
-	return NULL;
+	return ret;
+}
+
+void *hisi_qm_get_hw_sgl(handle_t sgl_pool, struct wd_datalist *sgl)
+{
+	void *hw_sgl = NULL;
+	int ret;
+
+	ret = hisi_qm_try_get_hw_sgl(sgl_pool, sgl, &hw_sgl);
+	if (ret == -WD_EBUSY)
+		WD_ERR("the sgl pool is not enough\n");
+
+	return ret ? NULL : hw_sgl;
 }
 
 handle_t hisi_qm_get_sglpool(handle_t h_qp)
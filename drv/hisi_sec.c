@@ -4,6 +4,7 @@
 #include "../include/drv/wd_cipher_drv.h"
 #include "../include/drv/wd_digest_drv.h"
 #include "../include/drv/wd_aead_drv.h"
+#include "../include/drv/wd_crypto_drv.h"
 #include "hisi_qm_udrv.h"
 #include "wd_cipher.h"
 #include "wd_digest.h"
@@ -741,12 +742,38 @@ static void hisi_sec_put_sgl(handle_t h_qp, __u8 data_fmt, __u8 alg_type,
 		hisi_qm_put_hw_sgl(h_sgl_pool, out);
 }
 
+/* buffers of a received BD are known by itself, not by the msg of caller */
+static void hisi_sec_put_bd2_sgl(handle_t h_qp, __u8 alg_type,
+				 struct hisi_sec_sqe *sqe)
+{
+	__u8 data_fmt;
+
+	data_fmt = sqe->sds_sa_type & SEC_SGL_SDS_MASK ? WD_SGL_BUF : WD_FLAT_BUF;
+	hisi_sec_put_sgl(h_qp, data_fmt, alg_type,
+		(void *)(uintptr_t)sqe->type2.data_src_addr,
+		(void *)(uintptr_t)sqe->type2.data_dst_addr);
+}
+
+static void hisi_sec_put_bd3_sgl(handle_t h_qp, __u8 alg_type,
+				 struct hisi_sec_sqe3 *sqe)
+{
+	__u8 data_fmt;
+
+	/* the src sgl bit is set for all families */
+	data_fmt = sqe->bd_param & SEC_PBUFF_MODE_MASK_V3 ?
+		   WD_SGL_BUF : WD_FLAT_BUF;
+	hisi_sec_put_sgl(h_qp, data_fmt, alg_type,
+		(void *)(uintptr_t)sqe->data_src_addr,
+		(void *)(uintptr_t)sqe->data_dst_addr);
+}
+
 static int hisi_sec_fill_sgl(handle_t h_qp, __u8 data_fmt, __u8 **in,
 	__u8 **out, struct hisi_sec_sqe *sqe)
 {
 	handle_t h_sgl_pool;
 	void *hw_sgl_in;
 	void *hw_sgl_out;
+	int ret;
 
 	if (data_fmt != WD_SGL_BUF)
 		return 0;
@@ -755,16 +782,23 @@ static int hisi_sec_fill_sgl(handle_t h_qp, __u8 data_fmt, __u8 **in,
 	if (!h_sgl_pool)
 		return -WD_ENOMEM;
 
-	hw_sgl_in = hisi_qm_get_hw_sgl(h_sgl_pool, (struct wd_datalist*)(*in));
-	if (!hw_sgl_in) {
+	/* -WD_EBUSY means the pool is used up, it's sent again after polling */
+	ret = hisi_qm_try_get_hw_sgl(h_sgl_pool, (struct wd_datalist *)(*in),
+				     &hw_sgl_in);
+	if (ret) {
+		if (ret == -WD_EBUSY)
+			return ret;
 		WD_ERR("failed to get hw sgl in!\n");
 		return -WD_ENOMEM;
 	}
 
-	hw_sgl_out = hisi_qm_get_hw_sgl(h_sgl_pool, (struct wd_datalist*)(*out));
-	if (!hw_sgl_out) {
-		WD_ERR("failed to get hw sgl out!\n");
+	ret = hisi_qm_try_get_hw_sgl(h_sgl_pool, (struct wd_datalist *)(*out),
+				     &hw_sgl_out);
+	if (ret) {
 		hisi_qm_put_hw_sgl(h_sgl_pool, hw_sgl_in);
+		if (ret == -WD_EBUSY)
+			return ret;
+		WD_ERR("failed to get hw sgl out!\n");
 		return -WD_ENOMEM;
 	}
 
@@ -788,6 +822,7 @@ static int hisi_sec_fill_sgl_v3(handle_t h_qp, __u8 data_fmt, __u8 **in,
 	handle_t h_sgl_pool;
 	void *hw_sgl_in;
 	void *hw_sgl_out;
+	int ret;
 
 	if (data_fmt != WD_SGL_BUF)
 		return 0;
@@ -796,8 +831,11 @@ static int hisi_sec_fill_sgl_v3(handle_t h_qp, __u8 data_fmt, __u8 **in,
 	if (!h_sgl_pool)
 		return -WD_EINVAL;
 
-	hw_sgl_in = hisi_qm_get_hw_sgl(h_sgl_pool, (struct wd_datalist*)(*in));
-	if (!hw_sgl_in) {
+	ret = hisi_qm_try_get_hw_sgl(h_sgl_pool, (struct wd_datalist *)(*in),
+				     &hw_sgl_in);
+	if (ret) {
+		if (ret == -WD_EBUSY)
+			return ret;
 		WD_ERR("failed to get hw sgl in!\n");
 		return -WD_EINVAL;
 	}
@@ -806,10 +844,14 @@ static int hisi_sec_fill_sgl_v3(handle_t h_qp, __u8 data_fmt, __u8 **in,
 		hw_sgl_out = *out;
 		sqe->bd_param |= SEC_PBUFF_MODE_MASK_V3;
 	} else {
-		hw_sgl_out = hisi_qm_get_hw_sgl(h_sgl_pool, (struct wd_datalist*)(*out));
-		if (!hw_sgl_out) {
-			WD_ERR("failed to get hw sgl out!\n");
+		ret = hisi_qm_try_get_hw_sgl(h_sgl_pool,
+					     (struct wd_datalist *)(*out),
+					     &hw_sgl_out);
+		if (ret) {
 			hisi_qm_put_hw_sgl(h_sgl_pool, hw_sgl_in);
+			if (ret == -WD_EBUSY)
+				return ret;
+			WD_ERR("failed to get hw sgl out!\n");
 			return -WD_EINVAL;
 		}
 
@@ -826,12 +868,49 @@ static int hisi_sec_fill_sgl_v3(handle_t h_qp, __u8 data_fmt, __u8 **in,
 	return 0;
 }
 
+/* fields decided by the session, it's the template of BDs of the session */
+static int fill_cipher_bd2_tpl(struct wd_cipher_msg *msg,
+			       struct hisi_sec_sqe *sqe)
+{
+	__u8 scene, de;
+	int ret;
+
+	memset(sqe, 0, sizeof(struct hisi_sec_sqe));
+	/* config BD type */
+	sqe->type_auth_cipher = BD_TYPE2;
+	/* config scence */
+	scene = SEC_IPSEC_SCENE << SEC_SCENE_OFFSET;
+	de = DATA_DST_ADDR_ENABLE << SEC_DE_OFFSET;
+	sqe->sds_sa_type = (__u8)(de | scene);
+
+	ret = fill_cipher_bd2_alg(msg, sqe);
+	if (ret) {
+		WD_ERR("failed to fill bd alg!\n");
+		return ret;
+	}
+
+	ret = fill_cipher_bd2_mode(msg, sqe);
+	if (ret) {
+		WD_ERR("failed to fill bd mode!\n");
+		return ret;
+	}
+
+	sqe->type2.c_key_addr = (__u64)msg->key;
+
+	return 0;
+}
+
+int hisi_sec_cipher_build_tpl(struct wd_cipher_msg *msg, void *tpl)
+{
+	return fill_cipher_bd2_tpl(msg, tpl);
+}
+
 int hisi_sec_cipher_send(handle_t ctx, struct wd_cipher_msg *msg)
 {
 	handle_t h_qp = (handle_t)wd_ctx_get_priv(ctx);
-	struct hisi_sec_sqe sqe;
-	__u8 scene, cipher, de;
+	struct hisi_sec_sqe *sqe;
 	__u16 count = 0;
+	__u8 cipher;
 	int ret;
 
 	if (!msg) {
@@ -839,21 +918,6 @@ int hisi_sec_cipher_send(handle_t ctx, struct wd_cipher_msg *msg)
 		return -WD_EINVAL;
 	}
 
-	memset(&sqe, 0, sizeof(struct hisi_sec_sqe));
-	/* config BD type */
-	sqe.type_auth_cipher = BD_TYPE2;
-	/* config scence */
-	scene = SEC_IPSEC_SCENE << SEC_SCENE_OFFSET;
-	de = DATA_DST_ADDR_ENABLE << SEC_DE_OFFSET;
-	sqe.sds_sa_type = (__u8)(de | scene);
-
-	if (msg->op_type == WD_CIPHER_ENCRYPTION)
-		cipher = SEC_CIPHER_ENC << SEC_CIPHER_OFFSET;
-	else
-		cipher = SEC_CIPHER_DEC << SEC_CIPHER_OFFSET;
-
-	sqe.type_auth_cipher |= cipher;
-
 	ret = cipher_len_check(msg);
 	if (ret)
 		return ret;
@@ -863,30 +927,37 @@ int hisi_sec_cipher_send(handle_t ctx, struct wd_cipher_msg *msg)
 			return ret;
 	}
 
-	ret = fill_cipher_bd2_alg(msg, &sqe);
-	if (ret) {
-		WD_ERR("failed to fill bd alg!\n");
+	ret = hisi_qm_reserve_sqe(h_qp, 1, &count, (void **)&sqe);
+	if (ret < 0)
 		return ret;
-	}
 
-	ret = fill_cipher_bd2_mode(msg, &sqe);
-	if (ret) {
-		WD_ERR("failed to fill bd mode!\n");
-		return ret;
+	if (msg->bd_tpl) {
+		memcpy(sqe, msg->bd_tpl, sizeof(struct hisi_sec_sqe));
+	} else {
+		ret = fill_cipher_bd2_tpl(msg, sqe);
+		if (ret)
+			goto out;
 	}
 
-	ret = hisi_sec_fill_sgl(h_qp, msg->data_fmt, &msg->in, &msg->out, &sqe);
+	if (msg->op_type == WD_CIPHER_ENCRYPTION)
+		cipher = SEC_CIPHER_ENC << SEC_CIPHER_OFFSET;
+	else
+		cipher = SEC_CIPHER_DEC << SEC_CIPHER_OFFSET;
+
+	sqe->type_auth_cipher |= cipher;
+
+	ret = hisi_sec_fill_sgl(h_qp, msg->data_fmt, &msg->in, &msg->out, sqe);
 	if (ret) {
-		WD_ERR("failed to get sgl!\n");
-		return ret;
+		if (ret != -WD_EBUSY)
+			WD_ERR("failed to get sgl!\n");
+		goto out;
 	}
 
-	sqe.type2.clen_ivhlen |= (__u32)msg->in_bytes;
-	sqe.type2.data_src_addr = (__u64)msg->in;
-	sqe.type2.data_dst_addr = (__u64)msg->out;
-	sqe.type2.c_ivin_addr = (__u64)msg->iv;
-	sqe.type2.c_key_addr = (__u64)msg->key;
-	sqe.type2.tag = (__u16)msg->tag;
+	sqe->type2.clen_ivhlen |= (__u32)msg->in_bytes;
+	sqe->type2.data_src_addr = (__u64)msg->in;
+	sqe->type2.data_dst_addr = (__u64)msg->out;
+	sqe->type2.c_ivin_addr = (__u64)msg->iv;
+	sqe->type2.tag = (__u16)msg->tag;
 
 	/*
 	 * Because some special algorithms need to update IV
@@ -898,35 +969,35 @@ int hisi_sec_cipher_send(handle_t ctx, struct wd_cipher_msg *msg)
 	 * field values of the send BD when returning, so we use
 	 * mac_addr to carry the message pointer here.
 	 */
-	sqe.type2.mac_addr = (__u64)msg;
+	sqe->type2.mac_addr = (__u64)msg;
 
-	ret = hisi_qm_send(h_qp, &sqe, 1, &count);
-	if (ret < 0) {
-		hisi_sec_put_sgl(h_qp, msg->data_fmt, msg->alg_type,
-			msg->in, msg->out);
-		return ret;
-	}
+	hisi_qm_commit_sqe(h_qp, 1);
 
+	return 0;
+
+out:
+	hisi_qm_commit_sqe(h_qp, 0);
 	return ret;
 }
 
 int hisi_sec_cipher_recv(handle_t ctx, struct wd_cipher_msg *recv_msg)
 {
-	struct hisi_sec_sqe sqe;
+	struct hisi_sec_sqe *sqe;
 	handle_t h_qp = (handle_t)wd_ctx_get_priv(ctx);
-	__u16 count = 0;
 	int ret;
 
-	ret = hisi_qm_recv(h_qp, &sqe, 1, &count);
+	ret = hisi_qm_peek_resp(h_qp, (void **)&sqe);
 	if (ret < 0)
 		return ret;
 
-	parse_cipher_bd2(&sqe, recv_msg);
-	recv_msg->tag = sqe.type2.tag;
+	parse_cipher_bd2(sqe, recv_msg);
+	recv_msg->tag = sqe->type2.tag;
 
 	hisi_sec_put_sgl(h_qp, recv_msg->data_fmt, recv_msg->alg_type,
 		recv_msg->in, recv_msg->out);
 
+	hisi_qm_release_resp(h_qp);
+
 	return 0;
 }
 
@@ -1005,11 +1076,47 @@ static int fill_cipher_bd3_mode(struct wd_cipher_msg *msg,
 	return 0;
 }
 
+/* fields decided by the session, it's the template of BDs of the session */
+static int fill_cipher_bd3_tpl(struct wd_cipher_msg *msg,
+			       struct hisi_sec_sqe3 *sqe)
+{
+	__u16 scene, de;
+	int ret;
+
+	memset(sqe, 0, sizeof(struct hisi_sec_sqe3));
+	/* config BD type */
+	sqe->bd_param = BD_TYPE3;
+	/* config scence */
+	scene = SEC_IPSEC_SCENE << SEC_SCENE_OFFSET_V3;
+	de = DATA_DST_ADDR_ENABLE << SEC_DE_OFFSET_V3;
+	sqe->bd_param |= (__u16)(de | scene);
+
+	ret = fill_cipher_bd3_alg(msg, sqe);
+	if (ret) {
+		WD_ERR("failed to fill bd alg!\n");
+		return ret;
+	}
+
+	ret = fill_cipher_bd3_mode(msg, sqe);
+	if (ret) {
+		WD_ERR("failed to fill bd mode!\n");
+		return ret;
+	}
+
+	sqe->c_key_addr = (__u64)msg->key;
+
+	return 0;
+}
+
+int hisi_sec_cipher_build_tpl_v3(struct wd_cipher_msg *msg, void *tpl)
+{
+	return fill_cipher_bd3_tpl(msg, tpl);
+}
+
 int hisi_sec_cipher_send_v3(handle_t ctx, struct wd_cipher_msg *msg)
 {
 	handle_t h_qp = (handle_t)wd_ctx_get_priv(ctx);
-	struct hisi_sec_sqe3 sqe;
-	__u16 scene, de;
+	struct hisi_sec_sqe3 *sqe;
 	__u16 count = 0;
 	int ret;
 
@@ -1018,19 +1125,6 @@ int hisi_sec_cipher_send_v3(handle_t ctx, struct wd_cipher_msg *msg)
 		return -WD_EINVAL;
 	}
 
-	memset(&sqe, 0, sizeof(struct hisi_sec_sqe3));
-	/* config BD type */
-	sqe.bd_param = BD_TYPE3;
-	/* config scence */
-	scene = SEC_IPSEC_SCENE << SEC_SCENE_OFFSET_V3;
-	de = DATA_DST_ADDR_ENABLE << SEC_DE_OFFSET_V3;
-	sqe.bd_param |= (__u16)(de | scene);
-
-	if (msg->op_type == WD_CIPHER_ENCRYPTION)
-		sqe.c_icv_key = SEC_CIPHER_ENC;
-	else
-		sqe.c_icv_key = SEC_CIPHER_DEC;
-
 	ret = cipher_len_check(msg);
 	if (ret)
 		return ret;
@@ -1040,31 +1134,36 @@ int hisi_sec_cipher_send_v3(handle_t ctx, struct wd_cipher_msg *msg)
 			return ret;
 	}
 
-	ret = fill_cipher_bd3_alg(msg, &sqe);
-	if (ret) {
-		WD_ERR("failed to fill bd alg!\n");
+	ret = hisi_qm_reserve_sqe(h_qp, 1, &count, (void **)&sqe);
+	if (ret < 0)
 		return ret;
-	}
 
-	ret = fill_cipher_bd3_mode(msg, &sqe);
-	if (ret) {
-		WD_ERR("failed to fill bd mode!\n");
-		return ret;
+	if (msg->bd_tpl) {
+		memcpy(sqe, msg->bd_tpl, sizeof(struct hisi_sec_sqe3));
+	} else {
+		ret = fill_cipher_bd3_tpl(msg, sqe);
+		if (ret)
+			goto out;
 	}
 
+	if (msg->op_type == WD_CIPHER_ENCRYPTION)
+		sqe->c_icv_key |= SEC_CIPHER_ENC;
+	else
+		sqe->c_icv_key |= SEC_CIPHER_DEC;
+
 	ret = hisi_sec_fill_sgl_v3(h_qp, msg->data_fmt, &msg->in, &msg->out,
-		&sqe, msg->alg_type);
+		sqe, msg->alg_type);
 	if (ret) {
-		WD_ERR("failed to get sgl!\n");
-		return ret;
+		if (ret != -WD_EBUSY)
+			WD_ERR("failed to get sgl!\n");
+		goto out;
 	}
 
-	sqe.c_len_ivin = (__u32)msg->in_bytes;
-	sqe.data_src_addr = (__u64)msg->in;
-	sqe.data_dst_addr = (__u64)msg->out;
-	sqe.no_scene.c_ivin_addr = (__u64)msg->iv;
-	sqe.c_key_addr = (__u64)msg->key;
-	sqe.tag = (__u64)msg->tag;
+	sqe->c_len_ivin = (__u32)msg->in_bytes;
+	sqe->data_src_addr = (__u64)msg->in;
+	sqe->data_dst_addr = (__u64)msg->out;
+	sqe->no_scene.c_ivin_addr = (__u64)msg->iv;
+	sqe->tag = (__u64)msg->tag;
 
 	/*
 	 * Because some special algorithms need to update IV
@@ -1076,13 +1175,14 @@ int hisi_sec_cipher_send_v3(handle_t ctx, struct wd_cipher_msg *msg)
 	 * field values of the send BD when returning, so we use
 	 * mac_addr to carry the message pointer here.
 	 */
-	sqe.mac_addr = (__u64)msg;
+	sqe->mac_addr = (__u64)msg;
 
-	ret = hisi_qm_send(h_qp, &sqe, 1, &count);
-	if (ret < 0) {
-		return ret;
-	}
+	hisi_qm_commit_sqe(h_qp, 1);
+
+	return 0;
 
+out:
+	hisi_qm_commit_sqe(h_qp, 0);
 	return ret;
 }
 
@@ -1109,21 +1209,22 @@ static void parse_cipher_bd3(struct hisi_sec_sqe3 *sqe, struct wd_cipher_msg *re
 
 int hisi_sec_cipher_recv_v3(handle_t ctx, struct wd_cipher_msg *recv_msg)
 {
-	struct hisi_sec_sqe3 sqe;
+	struct hisi_sec_sqe3 *sqe;
 	handle_t h_qp = (handle_t)wd_ctx_get_priv(ctx);
-	__u16 count = 0;
 	int ret;
 
-	ret = hisi_qm_recv(h_qp, &sqe, 1, &count);
+	ret = hisi_qm_peek_resp(h_qp, (void **)&sqe);
 	if (ret < 0)
 		return ret;
 
-	parse_cipher_bd3(&sqe, recv_msg);
-	recv_msg->tag = sqe.tag;
+	parse_cipher_bd3(sqe, recv_msg);
+	recv_msg->tag = sqe->tag;
 
 	hisi_sec_put_sgl(h_qp, recv_msg->data_fmt, recv_msg->alg_type,
 		recv_msg->in, recv_msg->out);
 
+	hisi_qm_release_resp(h_qp);
+
 	return 0;
 }
 
@@ -1166,7 +1267,6 @@ static int fill_digest_bd2_alg(struct wd_digest_msg *msg,
 static void qm_fill_digest_long_bd(struct wd_digest_msg *msg,
 		struct hisi_sec_sqe *sqe)
 {
-	struct wd_digest_tag *digest_tag = (void *)(uintptr_t)msg->usr_data;
 	__u64 total_bits;
 
 	if (msg->has_next && (msg->iv_bytes == 0)) {
@@ -1185,7 +1285,7 @@ static void qm_fill_digest_long_bd(struct wd_digest_msg *msg,
 		sqe->ai_apd_cs = AI_GEN_IVIN_ADDR;
 		sqe->ai_apd_cs |= AUTHPAD_PAD << AUTHPAD_OFFSET;
 		sqe->type2.a_ivin_addr = sqe->type2.mac_addr;
-		total_bits = digest_tag->long_data_len * BYTE_BITS;
+		total_bits = msg->long_data_len * BYTE_BITS;
 		sqe->type2.long_a_data_len = total_bits;
 		msg->iv_bytes = 0;
 	} else {
@@ -1215,23 +1315,17 @@ static void parse_digest_bd2(struct hisi_sec_sqe *sqe, struct wd_digest_msg *rec
 #endif
 }
 
-int hisi_sec_digest_send(handle_t ctx, struct wd_digest_msg *msg)
+static int fill_digest_bd2(handle_t h_qp, struct wd_digest_msg *msg,
+			   struct hisi_sec_sqe *sqe)
 {
-	handle_t h_qp = (handle_t)wd_ctx_get_priv(ctx);
-	struct hisi_sec_sqe sqe;
-	__u16 count = 0;
 	__u8 scene;
 	__u8 de;
 	int ret;
 
-	if (!msg) {
-		WD_ERR("input digest msg is NULL!\n");
-		return -WD_EINVAL;
-	}
-	memset(&sqe, 0, sizeof(struct hisi_sec_sqe));
+	memset(sqe, 0, sizeof(struct hisi_sec_sqe));
 	/* config BD type */
-	sqe.type_auth_cipher = BD_TYPE2;
-	sqe.type_auth_cipher |= AUTH_HMAC_CALCULATE << AUTHTYPE_OFFSET;
+	sqe->type_auth_cipher = BD_TYPE2;
+	sqe->type_auth_cipher |= AUTH_HMAC_CALCULATE << AUTHTYPE_OFFSET;
 
 	/* config scence */
 	scene = SEC_IPSEC_SCENE << SEC_SCENE_OFFSET;
@@ -1243,59 +1337,155 @@ int hisi_sec_digest_send(handle_t ctx, struct wd_digest_msg *msg)
 		return -WD_EINVAL;
 	}
 
-	ret = hisi_sec_fill_sgl(h_qp, msg->data_fmt, &msg->in, &msg->out, &sqe);
+	ret = hisi_sec_fill_sgl(h_qp, msg->data_fmt, &msg->in, &msg->out, sqe);
 	if (ret) {
-		WD_ERR("failed to get sgl!\n");
+		if (ret != -WD_EBUSY)
+			WD_ERR("failed to get sgl!\n");
 		return ret;
 	}
 
-	sqe.sds_sa_type = (__u8)(de | scene);
-	sqe.type2.alen_ivllen |= (__u32)msg->in_bytes;
-	sqe.type2.data_src_addr = (__u64)msg->in;
-	sqe.type2.mac_addr = (__u64)msg->out;
+	/* the sgl bit may be set by hisi_sec_fill_sgl() */
+	sqe->sds_sa_type |= (__u8)(de | scene);
+	sqe->type2.alen_ivllen |= (__u32)msg->in_bytes;
+	sqe->type2.data_src_addr = (__u64)msg->in;
+	sqe->type2.mac_addr = (__u64)msg->out;
 
-	ret = fill_digest_bd2_alg(msg, &sqe);
+	ret = fill_digest_bd2_alg(msg, sqe);
 	if (ret) {
 		WD_ERR("failed to fill digest bd alg!\n");
+		hisi_sec_put_sgl(h_qp, msg->data_fmt, msg->alg_type,
+			msg->in, msg->out);
 		return ret;
 	}
 
-	qm_fill_digest_long_bd(msg, &sqe);
+	qm_fill_digest_long_bd(msg, sqe);
 
 #ifdef DEBUG
 	WD_ERR("Dump digest send sqe-->!\n");
-	sec_dump_bd((unsigned char *)&sqe, SQE_BYTES_NUMS);
+	sec_dump_bd((unsigned char *)sqe, SQE_BYTES_NUMS);
 #endif
 
-	sqe.type2.tag = msg->tag;
-	ret = hisi_qm_send(h_qp, &sqe, 1, &count);
+	sqe->type2.tag = msg->tag;
+
+	return 0;
+}
+
+int hisi_sec_digest_send(handle_t ctx, struct wd_digest_msg *msg)
+{
+	handle_t h_qp = (handle_t)wd_ctx_get_priv(ctx);
+	struct hisi_sec_sqe *sqe;
+	__u16 count = 0;
+	int ret;
+
+	if (!msg) {
+		WD_ERR("input digest msg is NULL!\n");
+		return -WD_EINVAL;
+	}
+
+	ret = hisi_qm_reserve_sqe(h_qp, 1, &count, (void **)&sqe);
 	if (ret < 0) {
 		WD_ERR("hisi qm send is err(%d)!\n", ret);
 		return ret;
 	}
 
-	return ret;
+	ret = fill_digest_bd2(h_qp, msg, sqe);
+	if (ret) {
+		hisi_qm_commit_sqe(h_qp, 0);
+		return ret;
+	}
+
+	hisi_qm_commit_sqe(h_qp, 1);
+
+	return 0;
 }
 
 int hisi_sec_digest_recv(handle_t ctx, struct wd_digest_msg *recv_msg)
 {
 	handle_t h_qp = (handle_t)wd_ctx_get_priv(ctx);
-	struct hisi_sec_sqe sqe;
-	__u16 count = 0;
+	struct hisi_sec_sqe *sqe;
 	int ret;
 
-	ret = hisi_qm_recv(h_qp, &sqe, 1, &count);
+	ret = hisi_qm_peek_resp(h_qp, (void **)&sqe);
 	if (ret < 0)
 		return ret;
 
-	parse_digest_bd2(&sqe, recv_msg);
+	parse_digest_bd2(sqe, recv_msg);
 
 	hisi_sec_put_sgl(h_qp, recv_msg->data_fmt, recv_msg->alg_type,
 		recv_msg->in, recv_msg->out);
 
+	hisi_qm_release_resp(h_qp);
+
 	return 0;
 }
 
+int hisi_sec_digest_send_batch(handle_t ctx, struct wd_digest_msg *msgs,
+			       __u32 num)
+{
+	handle_t h_qp = (handle_t)wd_ctx_get_priv(ctx);
+	struct hisi_sec_sqe *sqes[WD_DIGEST_BATCH_MAX];
+	__u16 count = 0;
+	__u32 i;
+	int ret;
+
+	if (!msgs || !num || num > WD_DIGEST_BATCH_MAX) {
+		WD_ERR("invalid: digest batch msgs or num %u!\n", num);
+		return -WD_EINVAL;
+	}
+
+	ret = hisi_qm_reserve_sqe(h_qp, num, &count, (void **)sqes);
+	if (ret < 0) {
+		WD_ERR("hisi qm send is err(%d)!\n", ret);
+		return ret;
+	}
+
+	/* the queue may take part of them, the rest aren't filled */
+	for (i = 0; i < count; i++) {
+		ret = fill_digest_bd2(h_qp, msgs + i, sqes[i]);
+		if (ret)
+			goto put_sgl;
+	}
+
+	/* all BDs by one doorbell */
+	hisi_qm_commit_sqe(h_qp, count);
+
+	return count;
+
+put_sgl:
+	hisi_qm_commit_sqe(h_qp, 0);
+	while (i--)
+		hisi_sec_put_sgl(h_qp, msgs[i].data_fmt, msgs[i].alg_type,
+			msgs[i].in, msgs[i].out);
+	return ret;
+}
+
+int hisi_sec_digest_recv_batch(handle_t ctx, struct wd_digest_msg *msgs,
+			       __u32 num)
+{
+	handle_t h_qp = (handle_t)wd_ctx_get_priv(ctx);
+	struct hisi_sec_sqe *sqe;
+	__u32 i;
+	int ret = 0;
+
+	if (num > WD_DIGEST_BATCH_MAX)
+		num = WD_DIGEST_BATCH_MAX;
+
+	for (i = 0; i < num; i++) {
+		ret = hisi_qm_peek_resp(h_qp, (void **)&sqe);
+		if (ret < 0)
+			break;
+
+		parse_digest_bd2(sqe, msgs + i);
+		hisi_sec_put_bd2_sgl(h_qp, WD_DIGEST, sqe);
+		hisi_qm_release_resp(h_qp);
+	}
+
+	if (!i && ret < 0 && ret != -WD_EAGAIN)
+		return ret;
+
+	return i;
+}
+
 static struct wd_digest_driver hisi_digest_driver = {
 		.drv_name	= "hisi_sec2",
 		.alg_name	= "digest",
@@ -1344,7 +1534,6 @@ static int fill_digest_bd3_alg(struct wd_digest_msg *msg,
 static void qm_fill_digest_long_bd3(struct wd_digest_msg *msg,
 		struct hisi_sec_sqe3 *sqe)
 {
-	struct wd_digest_tag *digest_tag = (void *)(uintptr_t)msg->usr_data;
 	__u64 total_bits;
 
 	if (msg->has_next && (msg->iv_bytes == 0)) {
@@ -1363,7 +1552,7 @@ static void qm_fill_digest_long_bd3(struct wd_digest_msg *msg,
 		sqe->auth_mac_key |= AI_GEN_IVIN_ADDR << SEC_AI_GEN_OFFSET_V3;
 		sqe->stream_scene.stream_auth_pad = AUTHPAD_PAD;
 		sqe->auth_ivin.a_ivin_addr = sqe->mac_addr;
-		total_bits = digest_tag->long_data_len * BYTE_BITS;
+		total_bits = msg->long_data_len * BYTE_BITS;
 		sqe->stream_scene.long_a_data_len = total_bits;
 		msg->iv_bytes = 0;
 	} else {
@@ -1372,23 +1561,17 @@ static void qm_fill_digest_long_bd3(struct wd_digest_msg *msg,
 	}
 }
 
-int hisi_sec_digest_send_v3(handle_t ctx, struct wd_digest_msg *msg)
+static int fill_digest_bd3(handle_t h_qp, struct wd_digest_msg *msg,
+			   struct hisi_sec_sqe3 *sqe)
 {
-	handle_t h_qp = (handle_t)wd_ctx_get_priv(ctx);
-	struct hisi_sec_sqe3 sqe;
-	__u16 count = 0;
 	__u16 scene;
 	__u16 de;
 	int ret;
 
-	if (!msg) {
-		WD_ERR("input digest msg is NULL!\n");
-		return -WD_EINVAL;
-	}
-	memset(&sqe, 0, sizeof(struct hisi_sec_sqe3));
+	memset(sqe, 0, sizeof(struct hisi_sec_sqe3));
 	/* config BD type */
-	sqe.bd_param = BD_TYPE3;
-	sqe.auth_mac_key = AUTH_HMAC_CALCULATE;
+	sqe->bd_param = BD_TYPE3;
+	sqe->auth_mac_key = AUTH_HMAC_CALCULATE;
 
 	/* config scence */
 	scene = SEC_STREAM_SCENE << SEC_SCENE_OFFSET_V3;
@@ -1401,49 +1584,115 @@ int hisi_sec_digest_send_v3(handle_t ctx, struct wd_digest_msg *msg)
 	}
 
 	ret = hisi_sec_fill_sgl_v3(h_qp, msg->data_fmt, &msg->in, &msg->out,
-		&sqe, msg->alg_type);
+		sqe, msg->alg_type);
 	if (ret) {
-		WD_ERR("failed to get sgl!\n");
+		if (ret != -WD_EBUSY)
+			WD_ERR("failed to get sgl!\n");
 		return ret;
 	}
 
-	sqe.bd_param |= (__u16)(de | scene);
-	sqe.a_len_key |= (__u32)msg->in_bytes;
-	sqe.data_src_addr = (__u64)msg->in;
-	sqe.mac_addr = (__u64)msg->out;
+	sqe->bd_param |= (__u16)(de | scene);
+	sqe->a_len_key |= (__u32)msg->in_bytes;
+	sqe->data_src_addr = (__u64)msg->in;
+	sqe->mac_addr = (__u64)msg->out;
 
-	ret = fill_digest_bd3_alg(msg, &sqe);
+	ret = fill_digest_bd3_alg(msg, sqe);
 	if (ret) {
 		WD_ERR("failed to fill digest bd alg!\n");
+		hisi_sec_put_sgl(h_qp, msg->data_fmt, msg->alg_type,
+			msg->in, msg->out);
 		return ret;
 	}
 
-	qm_fill_digest_long_bd3(msg, &sqe);
+	qm_fill_digest_long_bd3(msg, sqe);
 
 #ifdef DEBUG
 	WD_ERR("Dump digest send sqe-->!\n");
-	sec_dump_bd((unsigned char *)&sqe, SQE_BYTES_NUMS);
+	sec_dump_bd((unsigned char *)sqe, SQE_BYTES_NUMS);
 #endif
 
-	sqe.tag = (__u64)msg->tag;
+	sqe->tag = (__u64)msg->tag;
+
+	return 0;
+}
+
+int hisi_sec_digest_send_v3(handle_t ctx, struct wd_digest_msg *msg)
+{
+	handle_t h_qp = (handle_t)wd_ctx_get_priv(ctx);
+	struct hisi_sec_sqe3 *sqe;
+	__u16 count = 0;
+	int ret;
+
+	if (!msg) {
+		WD_ERR("input digest msg is NULL!\n");
+		return -WD_EINVAL;
+	}
 
-	ret = hisi_qm_send(h_qp, &sqe, 1, &count);
+	ret = hisi_qm_reserve_sqe(h_qp, 1, &count, (void **)&sqe);
 	if (ret < 0) {
 		WD_ERR("hisi qm send is err(%d)!\n", ret);
 		return ret;
 	}
 
-	return ret;
+	ret = fill_digest_bd3(h_qp, msg, sqe);
+	if (ret) {
+		hisi_qm_commit_sqe(h_qp, 0);
+		return ret;
+	}
+
+	hisi_qm_commit_sqe(h_qp, 1);
+
+	return 0;
 }
 
-static void parse_digest_bd3(struct hisi_sec_sqe3 *sqe, struct wd_digest_msg *recv_msg)
+int hisi_sec_digest_send_batch_v3(handle_t ctx, struct wd_digest_msg *msgs,
+				  __u32 num)
 {
-	__u16 done;
+	handle_t h_qp = (handle_t)wd_ctx_get_priv(ctx);
+	struct hisi_sec_sqe3 *sqes[WD_DIGEST_BATCH_MAX];
+	__u16 count = 0;
+	__u32 i;
+	int ret;
 
-	done = sqe->done_flag & SEC_DONE_MASK;
-	if (done != SEC_HW_TASK_DONE || sqe->error_type) {
-		WD_ERR("SEC BD3 %s fail! done=0x%x, etype=0x%x\n", "digest",
-		done, sqe->error_type);
+	if (!msgs || !num || num > WD_DIGEST_BATCH_MAX) {
+		WD_ERR("invalid: digest batch msgs or num %u!\n", num);
+		return -WD_EINVAL;
+	}
+
+	ret = hisi_qm_reserve_sqe(h_qp, num, &count, (void **)sqes);
+	if (ret < 0) {
+		WD_ERR("hisi qm send is err(%d)!\n", ret);
+		return ret;
+	}
+
+	/* the queue may take part of them, the rest aren't filled */
+	for (i = 0; i < count; i++) {
+		ret = fill_digest_bd3(h_qp, msgs + i, sqes[i]);
+		if (ret)
+			goto put_sgl;
+	}
+
+	/* all BDs by one doorbell */
+	hisi_qm_commit_sqe(h_qp, count);
+
+	return count;
+
+put_sgl:
+	hisi_qm_commit_sqe(h_qp, 0);
+	while (i--)
+		hisi_sec_put_sgl(h_qp, msgs[i].data_fmt, msgs[i].alg_type,
+			msgs[i].in, msgs[i].out);
+	return ret;
+}
+
+static void parse_digest_bd3(struct hisi_sec_sqe3 *sqe, struct wd_digest_msg *recv_msg)
+{
+	__u16 done;
+
+	done = sqe->done_flag & SEC_DONE_MASK;
+	if (done != SEC_HW_TASK_DONE || sqe->error_type) {
+		WD_ERR("SEC BD3 %s fail! done=0x%x, etype=0x%x\n", "digest",
+		done, sqe->error_type);
 		recv_msg->result = WD_IN_EPARA;
 	} else {
 		recv_msg->result = WD_SUCCESS;
@@ -1460,22 +1709,50 @@ static void parse_digest_bd3(struct hisi_sec_sqe3 *sqe, struct wd_digest_msg *re
 int hisi_sec_digest_recv_v3(handle_t ctx, struct wd_digest_msg *recv_msg)
 {
 	handle_t h_qp = (handle_t)wd_ctx_get_priv(ctx);
-	struct hisi_sec_sqe3 sqe;
-	__u16 count = 0;
+	struct hisi_sec_sqe3 *sqe;
 	int ret;
 
-	ret = hisi_qm_recv(h_qp, &sqe, 1, &count);
+	ret = hisi_qm_peek_resp(h_qp, (void **)&sqe);
 	if (ret < 0)
 		return ret;
 
-	parse_digest_bd3(&sqe, recv_msg);
+	parse_digest_bd3(sqe, recv_msg);
 
 	hisi_sec_put_sgl(h_qp, recv_msg->data_fmt, recv_msg->alg_type,
 		recv_msg->in, recv_msg->out);
 
+	hisi_qm_release_resp(h_qp);
+
 	return 0;
 }
 
+int hisi_sec_digest_recv_batch_v3(handle_t ctx, struct wd_digest_msg *msgs,
+				  __u32 num)
+{
+	handle_t h_qp = (handle_t)wd_ctx_get_priv(ctx);
+	struct hisi_sec_sqe3 *sqe;
+	__u32 i;
+	int ret = 0;
+
+	if (num > WD_DIGEST_BATCH_MAX)
+		num = WD_DIGEST_BATCH_MAX;
+
+	for (i = 0; i < num; i++) {
+		ret = hisi_qm_peek_resp(h_qp, (void **)&sqe);
+		if (ret < 0)
+			break;
+
+		parse_digest_bd3(sqe, msgs + i);
+		hisi_sec_put_bd3_sgl(h_qp, WD_DIGEST, sqe);
+		hisi_qm_release_resp(h_qp);
+	}
+
+	if (!i && ret < 0 && ret != -WD_EAGAIN)
+		return ret;
+
+	return i;
+}
+
 static int aead_get_aes_key_len(struct wd_aead_msg *msg, __u8 *key_len)
 {
 	switch (msg->ckey_bytes) {
@@ -1564,14 +1841,12 @@ static int fill_aead_bd2_mode(struct wd_aead_msg *msg,
 		c_mode = C_MODE_CCM;
 		sqe->type_auth_cipher &= ~(AUTH_HMAC_CALCULATE <<
 			SEC_AUTH_OFFSET);
-		sqe->type2.alen_ivllen = msg->assoc_bytes;
 		sqe->type2.icvw_kmode |= msg->auth_bytes;
 		break;
 	case WD_CIPHER_GCM:
 		c_mode = C_MODE_GCM;
 		sqe->type_auth_cipher &= ~(AUTH_HMAC_CALCULATE <<
 			SEC_AUTH_OFFSET);
-		sqe->type2.alen_ivllen = msg->assoc_bytes;
 		sqe->type2.icvw_kmode |= msg->auth_bytes;
 		break;
 	default:
@@ -1647,8 +1922,6 @@ static void fill_aead_bd2_addr(struct wd_aead_msg *msg,
 		sqe->type2.mac_addr = addr;
 	}
 
-	sqe->type2.c_key_addr = (__u64)msg->ckey;
-	sqe->type2.a_key_addr = (__u64)msg->akey;
 	sqe->type2.c_ivin_addr = (__u64)msg->iv;
 
 	/* CCM/GCM should init a_iv */
@@ -1657,83 +1930,176 @@ static void fill_aead_bd2_addr(struct wd_aead_msg *msg,
 	sqe->type2.a_ivin_addr = (__u64)msg->aiv;
 }
 
-int hisi_sec_aead_send(handle_t ctx, struct wd_aead_msg *msg)
+static bool aead_is_ccm_gcm(struct wd_aead_msg *msg)
 {
-	handle_t h_qp = (handle_t)wd_ctx_get_priv(ctx);
-	struct hisi_sec_sqe sqe;
-	__u8 scene, cipher, de, auth;
-	__u16 count = 0;
-	int ret;
+	return msg->cmode == WD_CIPHER_CCM || msg->cmode == WD_CIPHER_GCM;
+}
 
-	if (!msg) {
-		WD_ERR("failed to check input aead msg!\n");
-		return -WD_EINVAL;
-	}
+/* fields decided by the session, it's the template of BDs of the session */
+static int fill_aead_bd2_tpl(struct wd_aead_msg *msg,
+			     struct hisi_sec_sqe *sqe)
+{
+	__u8 scene, de, auth;
+	int ret;
 
-	memset(&sqe, 0, sizeof(struct hisi_sec_sqe));
+	memset(sqe, 0, sizeof(struct hisi_sec_sqe));
 	/* config BD type */
-	sqe.type_auth_cipher = BD_TYPE2;
+	sqe->type_auth_cipher = BD_TYPE2;
 	/* config scence */
 	scene = SEC_IPSEC_SCENE << SEC_SCENE_OFFSET;
 	de = DATA_DST_ADDR_ENABLE << SEC_DE_OFFSET;
 	auth = AUTH_HMAC_CALCULATE << SEC_AUTH_OFFSET;
-	sqe.type_auth_cipher |= auth;
+	sqe->type_auth_cipher |= auth;
+	sqe->sds_sa_type = (__u8)(de | scene);
+
+	ret = fill_aead_bd2_alg(msg, sqe);
+	if (ret) {
+		WD_ERR("failed to fill aead bd alg!\n");
+		return ret;
+	}
+
+	ret = fill_aead_bd2_mode(msg, sqe);
+	if (ret) {
+		WD_ERR("failed to fill aead bd mode!\n");
+		return ret;
+	}
+
+	sqe->type2.c_key_addr = (__u64)msg->ckey;
+	sqe->type2.a_key_addr = (__u64)msg->akey;
+
+	return 0;
+}
+
+int hisi_sec_aead_build_tpl(struct wd_aead_msg *msg, void *tpl)
+{
+	return fill_aead_bd2_tpl(msg, tpl);
+}
+
+static int fill_aead_bd2(handle_t h_qp, struct wd_aead_msg *msg,
+			 struct hisi_sec_sqe *sqe)
+{
+	__u8 cipher, seq;
+	int ret;
 
 	if (msg->op_type == WD_CIPHER_ENCRYPTION_DIGEST) {
 		cipher = SEC_CIPHER_ENC << SEC_CIPHER_OFFSET;
-		sqe.sds_sa_type = WD_CIPHER_THEN_DIGEST;
+		seq = WD_CIPHER_THEN_DIGEST;
 	} else if (msg->op_type == WD_CIPHER_DECRYPTION_DIGEST) {
 		cipher = SEC_CIPHER_DEC << SEC_CIPHER_OFFSET;
-		sqe.sds_sa_type = WD_DIGEST_THEN_CIPHER;
+		seq = WD_DIGEST_THEN_CIPHER;
 	} else {
 		WD_ERR("failed to check aead op type!\n");
 		return -WD_EINVAL;
 	}
-	sqe.sds_sa_type |= (__u8)(de | scene);
-	sqe.type_auth_cipher |= cipher;
 
 	if (unlikely(msg->in_bytes == 0 ||
 		msg->in_bytes > MAX_INPUT_DATA_LEN)) {
 		WD_ERR("failed to check aead input data length!\n");
 		return -WD_EINVAL;
 	}
-	sqe.type2.clen_ivhlen = msg->in_bytes;
-	sqe.type2.cipher_src_offset = msg->assoc_bytes;
-	sqe.type2.alen_ivllen = msg->in_bytes + msg->assoc_bytes;
 
-	ret = fill_aead_bd2_alg(msg, &sqe);
+	if (msg->bd_tpl) {
+		memcpy(sqe, msg->bd_tpl, sizeof(struct hisi_sec_sqe));
+	} else {
+		ret = fill_aead_bd2_tpl(msg, sqe);
+		if (ret)
+			return ret;
+	}
+
+	sqe->sds_sa_type |= seq;
+	sqe->type_auth_cipher |= cipher;
+	sqe->type2.clen_ivhlen = msg->in_bytes;
+	sqe->type2.cipher_src_offset = msg->assoc_bytes;
+	if (aead_is_ccm_gcm(msg))
+		sqe->type2.alen_ivllen = msg->assoc_bytes;
+	else
+		sqe->type2.alen_ivllen = msg->in_bytes + msg->assoc_bytes;
+
+	ret = hisi_sec_fill_sgl(h_qp, msg->data_fmt, &msg->in, &msg->out, sqe);
 	if (ret) {
-		WD_ERR("failed to fill aead bd alg!\n");
+		if (ret != -WD_EBUSY)
+			WD_ERR("failed to get sgl!\n");
 		return ret;
 	}
 
-	ret = fill_aead_bd2_mode(msg, &sqe);
-	if (ret) {
-		WD_ERR("failed to fill aead bd mode!\n");
+	fill_aead_bd2_addr(msg, sqe);
+
+#ifdef DEBUG
+	WD_ERR("Dump aead send sqe-->!\n");
+	sec_dump_bd((unsigned char *)sqe, SQE_BYTES_NUMS);
+#endif
+
+	sqe->type2.tag = (__u16)msg->tag;
+
+	return 0;
+}
+
+int hisi_sec_aead_send(handle_t ctx, struct wd_aead_msg *msg)
+{
+	handle_t h_qp = (handle_t)wd_ctx_get_priv(ctx);
+	struct hisi_sec_sqe *sqe;
+	__u16 count = 0;
+	int ret;
+
+	if (!msg) {
+		WD_ERR("failed to check input aead msg!\n");
+		return -WD_EINVAL;
+	}
+
+	ret = hisi_qm_reserve_sqe(h_qp, 1, &count, (void **)&sqe);
+	if (ret < 0) {
+		WD_ERR("hisi qm send is err(%d)!\n", ret);
 		return ret;
 	}
 
-	ret = hisi_sec_fill_sgl(h_qp, msg->data_fmt, &msg->in, &msg->out, &sqe);
+	ret = fill_aead_bd2(h_qp, msg, sqe);
 	if (ret) {
-		WD_ERR("failed to get sgl!\n");
+		hisi_qm_commit_sqe(h_qp, 0);
 		return ret;
 	}
 
-	fill_aead_bd2_addr(msg, &sqe);
+	hisi_qm_commit_sqe(h_qp, 1);
 
-#ifdef DEBUG
-	WD_ERR("Dump aead send sqe-->!\n");
-	sec_dump_bd((unsigned char *)&sqe, SQE_BYTES_NUMS);
-#endif
+	return 0;
+}
 
-	sqe.type2.tag = (__u16)msg->tag;
+int hisi_sec_aead_send_batch(handle_t ctx, struct wd_aead_msg *msgs,
+			     __u32 num)
+{
+	handle_t h_qp = (handle_t)wd_ctx_get_priv(ctx);
+	struct hisi_sec_sqe *sqes[WD_AEAD_BATCH_MAX];
+	__u16 count = 0;
+	__u32 i;
+	int ret;
+
+	if (!msgs || !num || num > WD_AEAD_BATCH_MAX) {
+		WD_ERR("invalid: aead batch msgs or num %u!\n", num);
+		return -WD_EINVAL;
+	}
 
-	ret = hisi_qm_send(h_qp, &sqe, 1, &count);
+	ret = hisi_qm_reserve_sqe(h_qp, num, &count, (void **)sqes);
 	if (ret < 0) {
 		WD_ERR("hisi qm send is err(%d)!\n", ret);
 		return ret;
 	}
 
+	/* the queue may take part of them, the rest aren't filled */
+	for (i = 0; i < count; i++) {
+		ret = fill_aead_bd2(h_qp, msgs + i, sqes[i]);
+		if (ret)
+			goto put_sgl;
+	}
+
+	/* all BDs by one doorbell */
+	hisi_qm_commit_sqe(h_qp, count);
+
+	return count;
+
+put_sgl:
+	hisi_qm_commit_sqe(h_qp, 0);
+	while (i--)
+		hisi_sec_put_sgl(h_qp, msgs[i].data_fmt, msgs[i].alg_type,
+			msgs[i].in, msgs[i].out);
 	return ret;
 }
 
@@ -1762,23 +2128,51 @@ static void parse_aead_bd2(struct hisi_sec_sqe *sqe,
 
 int hisi_sec_aead_recv(handle_t ctx, struct wd_aead_msg *recv_msg)
 {
-	struct hisi_sec_sqe sqe;
+	struct hisi_sec_sqe *sqe;
 	handle_t h_qp = (handle_t)wd_ctx_get_priv(ctx);
-	__u16 count = 0;
 	int ret;
 
-	ret = hisi_qm_recv(h_qp, &sqe, 1, &count);
+	ret = hisi_qm_peek_resp(h_qp, (void **)&sqe);
 	if (ret < 0)
 		return ret;
 
-	parse_aead_bd2(&sqe, recv_msg);
+	parse_aead_bd2(sqe, recv_msg);
 
 	hisi_sec_put_sgl(h_qp, recv_msg->data_fmt, recv_msg->alg_type,
 		recv_msg->in, recv_msg->out);
 
+	hisi_qm_release_resp(h_qp);
+
 	return 0;
 }
 
+int hisi_sec_aead_recv_batch(handle_t ctx, struct wd_aead_msg *msgs,
+			     __u32 num)
+{
+	handle_t h_qp = (handle_t)wd_ctx_get_priv(ctx);
+	struct hisi_sec_sqe *sqe;
+	__u32 i;
+	int ret = 0;
+
+	if (num > WD_AEAD_BATCH_MAX)
+		num = WD_AEAD_BATCH_MAX;
+
+	for (i = 0; i < num; i++) {
+		ret = hisi_qm_peek_resp(h_qp, (void **)&sqe);
+		if (ret < 0)
+			break;
+
+		parse_aead_bd2(sqe, msgs + i);
+		hisi_sec_put_bd2_sgl(h_qp, WD_AEAD, sqe);
+		hisi_qm_release_resp(h_qp);
+	}
+
+	if (!i && ret < 0 && ret != -WD_EAGAIN)
+		return ret;
+
+	return i;
+}
+
 static struct wd_aead_driver hisi_aead_driver = {
 	.drv_name	= "hisi_sec2",
 	.alg_name	= "aead",
@@ -1815,11 +2209,6 @@ static int fill_aead_bd3_alg(struct wd_aead_msg *msg,
 	    msg->cmode == WD_CIPHER_GCM)
 		return ret;
 
-	if (unlikely(!msg->in_bytes)) {
-		WD_ERR("failed to check aead in_bytes 0 length!\n");
-		return -WD_EINVAL;
-	}
-
 	if (unlikely(msg->auth_bytes & WORD_ALIGNMENT_MASK)) {
 		WD_ERR("failed to check aead auth_bytes!\n");
 		return -WD_EINVAL;
@@ -1863,13 +2252,11 @@ static int fill_aead_bd3_mode(struct wd_aead_msg *msg,
 	case WD_CIPHER_CCM:
 		sqe->c_mode_alg |= C_MODE_CCM;
 		sqe->auth_mac_key &= ~(AUTH_HMAC_CALCULATE);
-		sqe->a_len_key = msg->assoc_bytes;
 		sqe->c_icv_key |= msg->auth_bytes << SEC_MAC_OFFSET_V3;
 		break;
 	case WD_CIPHER_GCM:
 		sqe->c_mode_alg |= C_MODE_GCM;
 		sqe->auth_mac_key &= ~(AUTH_HMAC_CALCULATE);
-		sqe->a_len_key = msg->assoc_bytes;
 		sqe->c_icv_key |= msg->auth_bytes << SEC_MAC_OFFSET_V3;
 		break;
 	default:
@@ -1900,8 +2287,6 @@ static void fill_aead_bd3_addr(struct wd_aead_msg *msg,
 		sqe->mac_addr = addr;
 	}
 
-	sqe->c_key_addr = (__u64)msg->ckey;
-	sqe->a_key_addr = (__u64)msg->akey;
 	sqe->no_scene.c_ivin_addr = (__u64)msg->iv;
 
 	/* CCM/GCM should init a_iv */
@@ -1910,80 +2295,175 @@ static void fill_aead_bd3_addr(struct wd_aead_msg *msg,
 	sqe->auth_ivin.a_ivin_addr = (__u64)msg->aiv;
 }
 
-int hisi_sec_aead_send_v3(handle_t ctx, struct wd_aead_msg *msg)
+/* fields decided by the session, it's the template of BDs of the session */
+static int fill_aead_bd3_tpl(struct wd_aead_msg *msg,
+			     struct hisi_sec_sqe3 *sqe)
 {
-	handle_t h_qp = (handle_t)wd_ctx_get_priv(ctx);
-	struct hisi_sec_sqe3 sqe;
 	__u16 scene, de;
-	__u16 count = 0;
 	int ret;
 
-	if (!msg) {
-		WD_ERR("failed to check input aead msg!\n");
-		return -WD_EINVAL;
-	}
-
-	memset(&sqe, 0, sizeof(struct hisi_sec_sqe3));
+	memset(sqe, 0, sizeof(struct hisi_sec_sqe3));
 	/* config BD type */
-	sqe.bd_param = BD_TYPE3;
+	sqe->bd_param = BD_TYPE3;
 	/* config scence */
 	scene = SEC_IPSEC_SCENE << SEC_SCENE_OFFSET_V3;
 	de = DATA_DST_ADDR_ENABLE << SEC_DE_OFFSET_V3;
-	sqe.auth_mac_key = AUTH_HMAC_CALCULATE;
+	sqe->bd_param |= (__u16)(de | scene);
+	sqe->auth_mac_key = AUTH_HMAC_CALCULATE;
+
+	ret = fill_aead_bd3_alg(msg, sqe);
+	if (ret) {
+		WD_ERR("failed to fill aead bd alg!\n");
+		return ret;
+	}
+
+	ret = fill_aead_bd3_mode(msg, sqe);
+	if (ret) {
+		WD_ERR("failed to fill aead bd mode!\n");
+		return ret;
+	}
+
+	sqe->c_key_addr = (__u64)msg->ckey;
+	sqe->a_key_addr = (__u64)msg->akey;
+
+	return 0;
+}
+
+int hisi_sec_aead_build_tpl_v3(struct wd_aead_msg *msg, void *tpl)
+{
+	return fill_aead_bd3_tpl(msg, tpl);
+}
+
+static int fill_aead_bd3(handle_t h_qp, struct wd_aead_msg *msg,
+			 struct hisi_sec_sqe3 *sqe)
+{
+	__u8 cipher, seq;
+	int ret;
 
 	if (msg->op_type == WD_CIPHER_ENCRYPTION_DIGEST) {
-		sqe.c_icv_key = SEC_CIPHER_ENC;
-		sqe.huk_iv_seq = WD_CIPHER_THEN_DIGEST << SEC_SEQ_OFFSET_V3;
+		cipher = SEC_CIPHER_ENC;
+		seq = WD_CIPHER_THEN_DIGEST;
 	} else if (msg->op_type == WD_CIPHER_DECRYPTION_DIGEST) {
-		sqe.c_icv_key = SEC_CIPHER_DEC;
-		sqe.huk_iv_seq = WD_DIGEST_THEN_CIPHER << SEC_SEQ_OFFSET_V3;
+		cipher = SEC_CIPHER_DEC;
+		seq = WD_DIGEST_THEN_CIPHER;
 	} else {
 		WD_ERR("failed to check aead op type!\n");
 		return -WD_EINVAL;
 	}
-	sqe.bd_param |= (__u16)(de | scene);
 
 	if (unlikely(msg->in_bytes > MAX_INPUT_DATA_LEN)) {
 		WD_ERR("failed to check aead input data length!\n");
 		return -WD_EINVAL;
 	}
-	sqe.c_len_ivin = msg->in_bytes;
-	sqe.cipher_src_offset = msg->assoc_bytes;
-	sqe.a_len_key = msg->in_bytes + msg->assoc_bytes;
 
-	ret = fill_aead_bd3_alg(msg, &sqe);
-	if (ret) {
-		WD_ERR("failed to fill aead bd alg!\n");
-		return ret;
+	if (unlikely(!msg->in_bytes && !aead_is_ccm_gcm(msg))) {
+		WD_ERR("failed to check aead in_bytes 0 length!\n");
+		return -WD_EINVAL;
 	}
 
-	ret = fill_aead_bd3_mode(msg, &sqe);
-	if (ret) {
-		WD_ERR("failed to fill aead bd mode!\n");
-		return ret;
+	if (msg->bd_tpl) {
+		memcpy(sqe, msg->bd_tpl, sizeof(struct hisi_sec_sqe3));
+	} else {
+		ret = fill_aead_bd3_tpl(msg, sqe);
+		if (ret)
+			return ret;
 	}
 
+	sqe->c_icv_key |= cipher;
+	sqe->huk_iv_seq |= seq << SEC_SEQ_OFFSET_V3;
+	sqe->c_len_ivin = msg->in_bytes;
+	sqe->cipher_src_offset = msg->assoc_bytes;
+	if (aead_is_ccm_gcm(msg))
+		sqe->a_len_key = msg->assoc_bytes;
+	else
+		sqe->a_len_key = msg->in_bytes + msg->assoc_bytes;
+
 	ret = hisi_sec_fill_sgl_v3(h_qp, msg->data_fmt, &msg->in, &msg->out,
-		&sqe, msg->alg_type);
+		sqe, msg->alg_type);
 	if (ret) {
-		WD_ERR("failed to get sgl!\n");
+		if (ret != -WD_EBUSY)
+			WD_ERR("failed to get sgl!\n");
 		return ret;
 	}
 
-	fill_aead_bd3_addr(msg, &sqe);
+	fill_aead_bd3_addr(msg, sqe);
 
 #ifdef DEBUG
 	WD_ERR("Dump aead send sqe-->!\n");
-	sec_dump_bd((unsigned char *)&sqe, SQE_BYTES_NUMS);
+	sec_dump_bd((unsigned char *)sqe, SQE_BYTES_NUMS);
 #endif
 
-	sqe.tag = msg->tag;
-	ret = hisi_qm_send(h_qp, &sqe, 1, &count);
+	sqe->tag = msg->tag;
+
+	return 0;
+}
+
+int hisi_sec_aead_send_v3(handle_t ctx, struct wd_aead_msg *msg)
+{
+	handle_t h_qp = (handle_t)wd_ctx_get_priv(ctx);
+	struct hisi_sec_sqe3 *sqe;
+	__u16 count = 0;
+	int ret;
+
+	if (!msg) {
+		WD_ERR("failed to check input aead msg!\n");
+		return -WD_EINVAL;
+	}
+
+	ret = hisi_qm_reserve_sqe(h_qp, 1, &count, (void **)&sqe);
 	if (ret < 0) {
 		WD_ERR("hisi qm send is err(%d)!\n", ret);
 		return ret;
 	}
 
+	ret = fill_aead_bd3(h_qp, msg, sqe);
+	if (ret) {
+		hisi_qm_commit_sqe(h_qp, 0);
+		return ret;
+	}
+
+	hisi_qm_commit_sqe(h_qp, 1);
+
+	return 0;
+}
+
+int hisi_sec_aead_send_batch_v3(handle_t ctx, struct wd_aead_msg *msgs,
+				__u32 num)
+{
+	handle_t h_qp = (handle_t)wd_ctx_get_priv(ctx);
+	struct hisi_sec_sqe3 *sqes[WD_AEAD_BATCH_MAX];
+	__u16 count = 0;
+	__u32 i;
+	int ret;
+
+	if (!msgs || !num || num > WD_AEAD_BATCH_MAX) {
+		WD_ERR("invalid: aead batch msgs or num %u!\n", num);
+		return -WD_EINVAL;
+	}
+
+	ret = hisi_qm_reserve_sqe(h_qp, num, &count, (void **)sqes);
+	if (ret < 0) {
+		WD_ERR("hisi qm send is err(%d)!\n", ret);
+		return ret;
+	}
+
+	/* the queue may take part of them, the rest aren't filled */
+	for (i = 0; i < count; i++) {
+		ret = fill_aead_bd3(h_qp, msgs + i, sqes[i]);
+		if (ret)
+			goto put_sgl;
+	}
+
+	/* all BDs by one doorbell */
+	hisi_qm_commit_sqe(h_qp, count);
+
+	return count;
+
+put_sgl:
+	hisi_qm_commit_sqe(h_qp, 0);
+	while (i--)
+		hisi_sec_put_sgl(h_qp, msgs[i].data_fmt, msgs[i].alg_type,
+			msgs[i].in, msgs[i].out);
 	return ret;
 }
 
@@ -2012,22 +2492,131 @@ static void parse_aead_bd3(struct hisi_sec_sqe3 *sqe,
 
 int hisi_sec_aead_recv_v3(handle_t ctx, struct wd_aead_msg *recv_msg)
 {
-	struct hisi_sec_sqe3 sqe;
+	struct hisi_sec_sqe3 *sqe;
 	handle_t h_qp = (handle_t)wd_ctx_get_priv(ctx);
-	__u16 count = 0;
 	int ret;
 
-	ret = hisi_qm_recv(h_qp, &sqe, 1, &count);
+	ret = hisi_qm_peek_resp(h_qp, (void **)&sqe);
 	if (ret < 0)
 		return ret;
 
-	parse_aead_bd3(&sqe, recv_msg);
+	parse_aead_bd3(sqe, recv_msg);
 	hisi_sec_put_sgl(h_qp, recv_msg->data_fmt, recv_msg->alg_type,
 		recv_msg->in, recv_msg->out);
 
+	hisi_qm_release_resp(h_qp);
+
 	return 0;
 }
 
+int hisi_sec_aead_recv_batch_v3(handle_t ctx, struct wd_aead_msg *msgs,
+				__u32 num)
+{
+	handle_t h_qp = (handle_t)wd_ctx_get_priv(ctx);
+	struct hisi_sec_sqe3 *sqe;
+	__u32 i;
+	int ret = 0;
+
+	if (num > WD_AEAD_BATCH_MAX)
+		num = WD_AEAD_BATCH_MAX;
+
+	for (i = 0; i < num; i++) {
+		ret = hisi_qm_peek_resp(h_qp, (void **)&sqe);
+		if (ret < 0)
+			break;
+
+		parse_aead_bd3(sqe, msgs + i);
+		hisi_sec_put_bd3_sgl(h_qp, WD_AEAD, sqe);
+		hisi_qm_release_resp(h_qp);
+	}
+
+	if (!i && ret < 0 && ret != -WD_EAGAIN)
+		return ret;
+
+	return i;
+}
+
+/* on a shared ctx, the family of a BD is known by the high bits of its tag */
+int hisi_sec_crypto_recv(handle_t ctx, struct wd_crypto_msg *recv_msg)
+{
+	handle_t h_qp = (handle_t)wd_ctx_get_priv(ctx);
+	struct hisi_sec_sqe *sqe;
+	int ret;
+
+	ret = hisi_qm_peek_resp(h_qp, (void **)&sqe);
+	if (ret < 0)
+		return ret;
+
+	recv_msg->alg_type = wd_crypto_tag_type(sqe->type2.tag);
+	switch (recv_msg->alg_type) {
+	case WD_CIPHER:
+		parse_cipher_bd2(sqe, &recv_msg->cipher);
+		recv_msg->cipher.tag = sqe->type2.tag;
+		break;
+	case WD_DIGEST:
+		parse_digest_bd2(sqe, &recv_msg->digest);
+		break;
+	case WD_AEAD:
+		parse_aead_bd2(sqe, &recv_msg->aead);
+		break;
+	default:
+		WD_ERR("invalid: SEC BD tag 0x%x!\n", sqe->type2.tag);
+		hisi_qm_release_resp(h_qp);
+		return -WD_EINVAL;
+	}
+
+	hisi_sec_put_bd2_sgl(h_qp, recv_msg->alg_type, sqe);
+
+	hisi_qm_release_resp(h_qp);
+
+	return 0;
+}
+
+int hisi_sec_crypto_recv_v3(handle_t ctx, struct wd_crypto_msg *recv_msg)
+{
+	handle_t h_qp = (handle_t)wd_ctx_get_priv(ctx);
+	struct hisi_sec_sqe3 *sqe;
+	int ret;
+
+	ret = hisi_qm_peek_resp(h_qp, (void **)&sqe);
+	if (ret < 0)
+		return ret;
+
+	recv_msg->alg_type = wd_crypto_tag_type(sqe->tag);
+	switch (recv_msg->alg_type) {
+	case WD_CIPHER:
+		parse_cipher_bd3(sqe, &recv_msg->cipher);
+		recv_msg->cipher.tag = sqe->tag;
+		break;
+	case WD_DIGEST:
+		parse_digest_bd3(sqe, &recv_msg->digest);
+		break;
+	case WD_AEAD:
+		parse_aead_bd3(sqe, &recv_msg->aead);
+		break;
+	default:
+		WD_ERR("invalid: SEC BD3 tag 0x%llx!\n", sqe->tag);
+		hisi_qm_release_resp(h_qp);
+		return -WD_EINVAL;
+	}
+
+	hisi_sec_put_bd3_sgl(h_qp, recv_msg->alg_type, sqe);
+
+	hisi_qm_release_resp(h_qp);
+
+	return 0;
+}
+
+static struct wd_crypto_driver hisi_crypto_driver = {
+	.drv_name	= "hisi_sec2",
+	.alg_name	= "crypto",
+	.drv_ctx_size	= sizeof(struct hisi_sec_ctx),
+	.init		= hisi_sec_init,
+	.exit		= hisi_sec_exit,
+};
+
+WD_CRYPTO_SET_DRIVER(hisi_crypto_driver);
+
 static void hisi_sec_driver_adapter(struct hisi_qp *qp)
 {
 	struct hisi_qm_queue_info q_info = qp->q_info;
@@ -2036,22 +2625,43 @@ static void hisi_sec_driver_adapter(struct hisi_qp *qp)
 		WD_ERR("hisi sec init Kunpeng920!\n");
 		hisi_cipher_driver.cipher_send = hisi_sec_cipher_send;
 		hisi_cipher_driver.cipher_recv = hisi_sec_cipher_recv;
+		hisi_cipher_driver.cipher_build_tpl = hisi_sec_cipher_build_tpl;
 
 		hisi_digest_driver.digest_send = hisi_sec_digest_send;
 		hisi_digest_driver.digest_recv = hisi_sec_digest_recv;
+		hisi_digest_driver.digest_send_batch =
+			hisi_sec_digest_send_batch;
+		hisi_digest_driver.digest_recv_batch =
+			hisi_sec_digest_recv_batch;
 
 		hisi_aead_driver.aead_send = hisi_sec_aead_send;
 		hisi_aead_driver.aead_recv = hisi_sec_aead_recv;
+		hisi_aead_driver.aead_send_batch = hisi_sec_aead_send_batch;
+		hisi_aead_driver.aead_recv_batch = hisi_sec_aead_recv_batch;
+		hisi_aead_driver.aead_build_tpl = hisi_sec_aead_build_tpl;
+
+		hisi_crypto_driver.crypto_recv = hisi_sec_crypto_recv;
 	} else {
 		WD_ERR("hisi sec init Kunpeng930!\n");
 		hisi_cipher_driver.cipher_send = hisi_sec_cipher_send_v3;
 		hisi_cipher_driver.cipher_recv = hisi_sec_cipher_recv_v3;
+		hisi_cipher_driver.cipher_build_tpl =
+			hisi_sec_cipher_build_tpl_v3;
 
 		hisi_digest_driver.digest_send = hisi_sec_digest_send_v3;
 		hisi_digest_driver.digest_recv = hisi_sec_digest_recv_v3;
+		hisi_digest_driver.digest_send_batch =
+			hisi_sec_digest_send_batch_v3;
+		hisi_digest_driver.digest_recv_batch =
+			hisi_sec_digest_recv_batch_v3;
 
 		hisi_aead_driver.aead_send = hisi_sec_aead_send_v3;
 		hisi_aead_driver.aead_recv = hisi_sec_aead_recv_v3;
+		hisi_aead_driver.aead_send_batch = hisi_sec_aead_send_batch_v3;
+		hisi_aead_driver.aead_recv_batch = hisi_sec_aead_recv_batch_v3;
+		hisi_aead_driver.aead_build_tpl = hisi_sec_aead_build_tpl_v3;
+
+		hisi_crypto_driver.crypto_recv = hisi_sec_crypto_recv_v3;
 	}
 }
 
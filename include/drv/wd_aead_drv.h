@@ -5,6 +5,9 @@
 #include "include/wd_alg_common.h"
 #include "include/wd_aead.h"
 
+/* room of a BD template in the session, not less than any BD of drivers */
+#define WD_AEAD_TPL_SIZE	128
+
 struct wd_aead_msg {
 	struct wd_aead_req req;
 	__u32 tag;		/* Request identifier */
@@ -31,6 +34,7 @@ struct wd_aead_msg {
 	__u8 *aiv;		/* input auth iv pointer */
 	__u8 *in;		/* input data pointer */
 	__u8 *out;		/* output data pointer  */
+	void *bd_tpl;		/* BD template of the session, may be NULL */
 };
 
 struct wd_aead_driver {
@@ -41,6 +45,20 @@ struct wd_aead_driver {
 	void	(*exit)(void *priv);
 	int	(*aead_send)(handle_t ctx, struct wd_aead_msg *msg);
 	int	(*aead_recv)(handle_t ctx, struct wd_aead_msg *msg);
+	/*
+	 * Optional. Send num msgs by one doorbell and return the number sent,
+	 * receive at most num msgs and return the number received.
+	 */
+	int	(*aead_send_batch)(handle_t ctx, struct wd_aead_msg *msgs,
+				   __u32 num);
+	int	(*aead_recv_batch)(handle_t ctx, struct wd_aead_msg *msgs,
+				   __u32 num);
+	/*
+	 * Optional. Fill the BD fields decided by the session, such as algs,
+	 * modes, authsize and keys, to tpl. Only those of the request are
+	 * filled then.
+	 */
+	int	(*aead_build_tpl)(struct wd_aead_msg *msg, void *tpl);
 };
 
 void wd_aead_set_driver(struct wd_aead_driver *drv);
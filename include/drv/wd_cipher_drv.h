@@ -5,6 +5,9 @@
 #include "../wd_cipher.h"
 #include "../wd_alg_common.h"
 
+/* room of a BD template in the session, not less than any BD of drivers */
+#define WD_CIPHER_TPL_SIZE	128
+
 /* fixme wd_cipher_msg */
 struct wd_cipher_msg {
 	struct wd_cipher_req req;
@@ -25,6 +28,7 @@ struct wd_cipher_msg {
 	__u8 *iv;		/* input iv pointer */
 	__u8 *in;		/* input data pointer */
 	__u8 *out;		/* output data pointer  */
+	void *bd_tpl;		/* BD template of the session, may be NULL */
 };
 
 struct wd_cipher_driver {
@@ -35,6 +39,11 @@ struct wd_cipher_driver {
 	void	(*exit)(void *priv);
 	int	(*cipher_send)(handle_t ctx, struct wd_cipher_msg *msg);
 	int	(*cipher_recv)(handle_t ctx, struct wd_cipher_msg *msg);
+	/*
+	 * Optional. Fill the BD fields decided by the session, such as alg,
+	 * mode and key, to tpl. Only those of the request are filled then.
+	 */
+	int	(*cipher_build_tpl)(struct wd_cipher_msg *msg, void *tpl);
 };
 
 void wd_cipher_set_driver(struct wd_cipher_driver *drv);
@@ -0,0 +1,69 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+#ifndef __WD_CRYPTO_DRV_H
+#define __WD_CRYPTO_DRV_H
+
+#include "include/wd_alg_common.h"
+#include "include/wd_crypto.h"
+#include "include/drv/wd_aead_drv.h"
+#include "include/drv/wd_cipher_drv.h"
+#include "include/drv/wd_digest_drv.h"
+
+/*
+ * Tag of an async msg carries its family, denoted by enum wcrypto_type, in
+ * the high bits, so that the driver knows how to parse it on a shared ctx.
+ * It should fit the 16 bits tag of the hardware BD.
+ */
+#define WD_CRYPTO_TAG_SHIFT	14
+#define WD_CRYPTO_TAG_MASK	((1U << WD_CRYPTO_TAG_SHIFT) - 1)
+
+static inline __u32 wd_crypto_tag(__u8 alg_type, __u32 idx)
+{
+	return ((__u32)alg_type << WD_CRYPTO_TAG_SHIFT) | idx;
+}
+
+static inline __u8 wd_crypto_tag_type(__u32 tag)
+{
+	return tag >> WD_CRYPTO_TAG_SHIFT;
+}
+
+static inline __u32 wd_crypto_tag_idx(__u32 tag)
+{
+	return tag & WD_CRYPTO_TAG_MASK;
+}
+
+struct wd_crypto_msg {
+	__u8 alg_type;		/* Denoted by enum wcrypto_type */
+	union {
+		struct wd_cipher_msg cipher;
+		struct wd_digest_msg digest;
+		struct wd_aead_msg aead;
+	};
+};
+
+struct wd_crypto_driver {
+	const char	*drv_name;
+	const char	*alg_name;
+	__u32	drv_ctx_size;
+	int	(*init)(struct wd_ctx_config_internal *config, void *priv);
+	void	(*exit)(void *priv);
+	/*
+	 * Receive one msg of any family from a shared ctx, alg_type and the
+	 * msg of that family are filled.
+	 */
+	int	(*crypto_recv)(handle_t ctx, struct wd_crypto_msg *msg);
+};
+
+void wd_crypto_set_driver(struct wd_crypto_driver *drv);
+
+#ifdef WD_STATIC_DRV
+#define WD_CRYPTO_SET_DRIVER(drv)					      \
+extern const struct wd_crypto_driver wd_crypto_##drv __attribute__((alias(#drv)));
+
+#else
+#define WD_CRYPTO_SET_DRIVER(drv)					      \
+static void __attribute__((constructor)) set_crypto_driver(void)	      \
+{									      \
+	wd_crypto_set_driver(&drv);					      \
+}
+#endif
+#endif /* __WD_CRYPTO_DRV_H */
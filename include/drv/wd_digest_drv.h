@@ -26,6 +26,7 @@ struct wd_digest_msg {
 	__u8 *iv;		/* input iv pointer */
 	__u8 *in;		/* input data pointer */
 	__u8 *out;		/* output data pointer  */
+	__u64 long_data_len;	/* total bytes of stream for the end BD */
 };
 
 struct wd_digest_driver {
@@ -36,6 +37,14 @@ struct wd_digest_driver {
 	void	(*exit)(void *priv);
 	int	(*digest_send)(handle_t ctx, struct wd_digest_msg *msg);
 	int	(*digest_recv)(handle_t ctx, struct wd_digest_msg *msg);
+	/*
+	 * Optional. Send num msgs by one doorbell and return the number sent,
+	 * receive at most num msgs and return the number received.
+	 */
+	int	(*digest_send_batch)(handle_t ctx, struct wd_digest_msg *msgs,
+				     __u32 num);
+	int	(*digest_recv_batch)(handle_t ctx, struct wd_digest_msg *msgs,
+				     __u32 num);
 };
 
 void wd_digest_set_driver(struct wd_digest_driver *drv);
@@ -93,6 +93,45 @@ int hisi_qm_send(handle_t h_qp, void *req, __u16 expect, __u16 *count);
  */
 int hisi_qm_recv(handle_t h_qp, void *resp, __u16 expect, __u16 *count);
 
+/**
+ * hisi_qm_reserve_sqe - Reserve free sqes of the queue to be filled in place.
+ * @h_qp: Handle of the qp.
+ * @expect: User wanted sqe num.
+ * @count: The count of actual reserved sqes.
+ * @sqe: Addresses of the reserved sqes in the ring, it should hold expect
+ *	 entries. They aren't zeroed, the whole sqe should be filled.
+ *
+ * The queue is locked until hisi_qm_commit_sqe(), which must be called by
+ * the same thread whenever it returns 0.
+ * If the free queue num is zero, the return value is -WD_EBUSY
+ */
+int hisi_qm_reserve_sqe(handle_t h_qp, __u16 expect, __u16 *count,
+			void **sqe);
+
+/**
+ * hisi_qm_commit_sqe - Send the reserved sqes with one doorbell.
+ * @h_qp: Handle of the qp.
+ * @num: The count of the leading reserved sqes to send, the rest are given
+ *	 back, 0 gives back all of them.
+ */
+void hisi_qm_commit_sqe(handle_t h_qp, __u16 num);
+
+/**
+ * hisi_qm_peek_resp - Get the next finished sqe in the ring without copying.
+ * @h_qp: Handle of the qp.
+ * @resp: Address of the sqe in the ring.
+ *
+ * The sqe is valid until hisi_qm_release_resp(), which must be called once
+ * it's parsed. Return -WD_EAGAIN if no finished sqe.
+ */
+int hisi_qm_peek_resp(handle_t h_qp, void **resp);
+
+/**
+ * hisi_qm_release_resp - Give back the sqe got by hisi_qm_peek_resp().
+ * @h_qp: Handle of the qp.
+ */
+void hisi_qm_release_resp(handle_t h_qp);
+
 handle_t hisi_qm_alloc_qp(struct hisi_qm_priv *config, handle_t ctx);
 void hisi_qm_free_qp(handle_t h_qp);
 
@@ -100,10 +139,11 @@ void hisi_qm_free_qp(handle_t h_qp);
  * hisi_qm_create_sglpool - Create sgl pool in qm.
  * @sgl_num: the sgl number.
  * @sge_num: the sge num in every sgl num.
+ * @numa_id: the node the sgls are allocated on, less than 0 means any.
  *
  * Fixed me: the sge buff's size now is Fixed.
  */
-handle_t hisi_qm_create_sglpool(__u32 sgl_num, __u32 sge_num);
+handle_t hisi_qm_create_sglpool(__u32 sgl_num, __u32 sge_num, int numa_id);
 
 /**
  * hisi_qm_destroy_sglpool - Destroy sgl pool in qm.
@@ -120,6 +160,18 @@ void hisi_qm_destroy_sglpool(handle_t sgl_pool);
  */
 void *hisi_qm_get_hw_sgl(handle_t sgl_pool, struct wd_datalist *sgl);
 
+/**
+ * hisi_qm_try_get_hw_sgl - Get sgl pointer from sgl pool, and tell why not.
+ * @sgl_pool: Handle of the sgl pool.
+ * @sgl: The user sgl info's pointer.
+ * @hw_sgl: Return the hw sgl addr which can fill into the sqe.
+ *
+ * Return 0 if successful, -WD_EBUSY if the pool has run out of sgls until
+ * some are put back, -WD_EINVAL if the user sgl is invalid.
+ */
+int hisi_qm_try_get_hw_sgl(handle_t sgl_pool, struct wd_datalist *sgl,
+			   void **hw_sgl);
+
 /**
  * hisi_qm_put_hw_sgl - Reback the hw sgl to the sgl pool.
  * @sgl_pool: Handle of the sgl pool.
@@ -269,6 +269,28 @@ extern char *wd_get_accel_name(char *dev_path, int no_apdx);
  */
 extern int wd_get_numa_id(handle_t h_ctx);
 
+/**
+ * wd_ctx_set_sgl_num() - Set the number of hardware sgls kept for one context.
+ * @h_ctx: The handle of context.
+ * @sgl_num: Number of hardware sgls, 0 means the default of the driver.
+ *
+ * Each request of SGL buffers takes at least one hardware sgl for its source
+ * and one for its destination until it's received, so workloads with many
+ * such requests in flight need a larger pool. It should be called before
+ * the context is initialised by an algorithm, e.g. wd_cipher_init().
+ *
+ * Return 0 if successful or less than 0 otherwise.
+ */
+extern int wd_ctx_set_sgl_num(handle_t h_ctx, __u32 sgl_num);
+
+/**
+ * wd_ctx_get_sgl_num() - Get the number of hardware sgls set for one context.
+ * @h_ctx: The handle of context.
+ *
+ * Return the number set by wd_ctx_set_sgl_num(), 0 if not set.
+ */
+extern __u32 wd_ctx_get_sgl_num(handle_t h_ctx);
+
 /**
  * wd_get_avail_ctx() - Get available context in one device.
  * @dev: The uacce_dev for one device.
@@ -3,6 +3,7 @@
 #define __WD_AEAD_H
 
 #include <dlfcn.h>
+#include <stdbool.h>
 #include "wd_alg_common.h"
 #include "config.h"
 #include "wd_cipher.h"
@@ -34,6 +35,9 @@ struct wd_aead_sess_setup {
 	enum wd_digest_mode dmode;
 };
 
+/* max records of wd_do_aead_rec_batch() sent by one doorbell */
+#define WD_AEAD_BATCH_MAX	64
+
 struct wd_aead_req;
 typedef void *wd_alg_aead_cb_t(struct wd_aead_req *req, void *cb_param);
 
@@ -49,6 +53,8 @@ struct wd_aead_sess {
 	__u16			akey_bytes;
 	__u16			auth_bytes;
 	void			*priv;
+	/* in_bytes below it is done by CPU, 0 means off */
+	__u32			sw_thresh;
 };
 
 /**
@@ -88,6 +94,39 @@ struct wd_aead_req {
 	void			*cb_param;
 };
 
+/**
+ * struct wd_aead_rec - One record of a record batch.
+ * @ data: in place buffer of associated data, text and MAC
+ * @ seq: sequence number of the record
+ * @ in_bytes: text length, MAC isn't included
+ * @ assoc_bytes: associated data length
+ * @ state: operation result, denoted by WD error code
+ */
+struct wd_aead_rec {
+	void			*data;
+	__u64			seq;
+	__u32			in_bytes;
+	__u16			assoc_bytes;
+	__u16			state;
+};
+
+/**
+ * struct wd_aead_rec_batch - Records of one connection and direction.
+ * @ op_type: WD_CIPHER_ENCRYPTION_DIGEST or WD_CIPHER_DECRYPTION_DIGEST
+ * @ nonce: base nonce, the big endian seq of each record is XORed into
+ *	    its last 8 bytes, like TLS 1.3
+ * @ nonce_bytes: nonce length, GCM_BLOCK_SIZE
+ * @ recs: records
+ * @ num: number of records
+ */
+struct wd_aead_rec_batch {
+	enum wd_aead_op_type	op_type;
+	const __u8		*nonce;
+	__u16			nonce_bytes;
+	struct wd_aead_rec	*recs;
+	__u32			num;
+};
+
 /**
  * wd_aead_init() Initialise ctx configuration and schedule.
  * @ config	    User defined ctx configuration.
@@ -135,6 +174,17 @@ int wd_aead_set_akey(handle_t h_sess, const __u8 *key, __u16 key_len);
  */
 int wd_do_aead_sync(handle_t h_sess, struct wd_aead_req *req);
 
+/**
+ * wd_do_aead_rec_batch() seal or open many records of AES-GCM in place.
+ * @h_sess: wd aead session, the authsize should be set.
+ * @batch: records and their base nonce.
+ *
+ * Up to WD_AEAD_BATCH_MAX records are filled and sent by one doorbell, then
+ * all of them are received. MAC follows the text of each record, space of
+ * it is needed for sealing. Result of each record is in its state.
+ */
+int wd_do_aead_rec_batch(handle_t h_sess, struct wd_aead_rec_batch *batch);
+
 /**
  * wd_do_aead_async() asynchronous aead operation
  * @sess: wd aead session
@@ -142,6 +192,44 @@ int wd_do_aead_sync(handle_t h_sess, struct wd_aead_req *req);
  */
 int wd_do_aead_async(handle_t h_sess, struct wd_aead_req *req);
 
+/**
+ * wd_aead_set_sw_thresh() - Set the length threshold of the CPU engine.
+ * @h_sess: wd aead session.
+ * @thresh: Flat requests with in_bytes below it are done by CPU in
+ *	    wd_do_aead_sync(), 0 means off.
+ *
+ * Only AES-GCM is supported by the CPU engine, others always go to hardware.
+ *
+ * Return 0 if successful, -WD_EINVAL if libwd_crypto is built without
+ * libcrypto and thresh isn't 0.
+ */
+int wd_aead_set_sw_thresh(handle_t h_sess, __u32 thresh);
+
+/**
+ * wd_aead_sw_calibrate() - Find the threshold of the CPU engine.
+ * @h_sess: wd aead session, its key and authsize are set.
+ * @thresh: Return the length from which hardware is faster than CPU.
+ *
+ * Requests from 16 bytes to 4KB with 16 bytes of associated data are
+ * encrypted by both engines on a sync ctx, the result is also set to the
+ * session.
+ *
+ * Return 0 if successful or less than 0 otherwise.
+ */
+int wd_aead_sw_calibrate(handle_t h_sess, __u32 *thresh);
+
+/**
+ * wd_aead_set_bd_tpl() - Choose how BDs of the session are filled.
+ * @h_sess: wd aead session.
+ * @enable: true (default) copies the BD template built when keys and authsize are set,
+ *	    false fills every BD in full by the driver.
+ *
+ * Both ways give the same BDs, it's used to check the template.
+ *
+ * Return 0 if successful or less than 0 otherwise.
+ */
+int wd_aead_set_bd_tpl(handle_t h_sess, bool enable);
+
 /**
  * wd_aead_set_authsize() Set authenticate data length to aead session.
  * @h_sess: wd aead session.
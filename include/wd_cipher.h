@@ -3,6 +3,7 @@
 #define __WD_CIPHER_H
 
 #include <dlfcn.h>
+#include <stdbool.h>
 #include "wd.h"
 #include "wd_alg_common.h"
 
@@ -74,6 +75,8 @@ struct wd_cipher_sess {
 	void			*key;
 	__u32			key_bytes;
 	int				numa;
+	/* in_bytes below it is done by CPU, 0 means off */
+	__u32			sw_thresh;
 };
 
 struct wd_cipher_req {
@@ -109,6 +112,10 @@ void wd_cipher_uninit(void);
 /**
  * wd_cipher_alloc_sess() Allocate a wd cipher session
  * @ setup Parameters to setup this session.
+ *
+ * The session takes the NUMA node of the calling thread, which is cached per
+ * thread and only refreshed when no freed session can be reused. Pin threads
+ * that could migrate between nodes, so sessions stay on the local node.
  */
 handle_t wd_cipher_alloc_sess(struct wd_cipher_sess_setup *setup);
 
@@ -130,9 +137,51 @@ int wd_cipher_set_key(handle_t h_sess, const __u8 *key, __u32 key_len);
  * wd_do_cipher_sync()/ async() Syn/asynchronous cipher operation
  * @sess: wd cipher session
  * @req: operational data.
+ *
+ * A flat request of ECB, CTR or CBC decryption longer than 1MB is split to
+ * segments by wd_do_cipher_sync(), which are done on several sync ctxs at
+ * the same time. Such request could be longer than the limit of one BD.
  */
 int wd_do_cipher_sync(handle_t h_sess, struct wd_cipher_req *req);
 int wd_do_cipher_async(handle_t h_sess, struct wd_cipher_req *req);
+
+/**
+ * wd_cipher_set_sw_thresh() - Set the length threshold of the CPU engine.
+ * @h_sess: wd cipher session.
+ * @thresh: Flat requests with in_bytes below it are done by CPU in
+ *	    wd_do_cipher_sync(), 0 means off.
+ *
+ * AES and SM4 in ECB, CBC and CTR mode are supported by the CPU engine,
+ * others always go to hardware. IV is updated the same way as hardware.
+ *
+ * Return 0 if successful, -WD_EINVAL if libwd_crypto is built without
+ * libcrypto and thresh isn't 0.
+ */
+int wd_cipher_set_sw_thresh(handle_t h_sess, __u32 thresh);
+
+/**
+ * wd_cipher_sw_calibrate() - Find the threshold of the CPU engine.
+ * @h_sess: wd cipher session, its key is set.
+ * @thresh: Return the length from which hardware is faster than CPU.
+ *
+ * Requests from 16 bytes to 4KB are encrypted by both engines on a sync
+ * ctx, the result is also set to the session.
+ *
+ * Return 0 if successful or less than 0 otherwise.
+ */
+int wd_cipher_sw_calibrate(handle_t h_sess, __u32 *thresh);
+
+/**
+ * wd_cipher_set_bd_tpl() - Choose how BDs of the session are filled.
+ * @h_sess: wd cipher session.
+ * @enable: true (default) copies the BD template built when the key is set,
+ *	    false fills every BD in full by the driver.
+ *
+ * Both ways give the same BDs, it's used to check the template.
+ *
+ * Return 0 if successful or less than 0 otherwise.
+ */
+int wd_cipher_set_bd_tpl(handle_t h_sess, bool enable);
 /**
  * wd_cipher_poll_ctx() poll operation for asynchronous operation
  * @index: index of ctx which will be polled.
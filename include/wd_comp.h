@@ -32,6 +32,7 @@ enum wd_comp_level {
 };
 
 enum wd_comp_winsz_type {
+	WD_COMP_WS_DEF, /* default window size, the same as 32k */
 	WD_COMP_WS_4K,  /* 4k bytes window size */
 	WD_COMP_WS_8K,  /* 8k bytes window size */
 	WD_COMP_WS_16K, /* 16k bytes window size */
@@ -43,15 +44,22 @@ struct wd_comp_req;
 typedef void *wd_alg_comp_cb_t(struct wd_comp_req *req, void *cb_param);
 
 struct wd_comp_req {
-	void			*src;
+	union {
+		void			*src;
+		struct wd_datalist	*list_src;
+	};
 	__u32			src_len;
-	void			*dst;
+	union {
+		void			*dst;
+		struct wd_datalist	*list_dst;
+	};
 	__u32			dst_len;
 	wd_alg_comp_cb_t	*cb;
 	void			*cb_param;
 	__u8			op_type;     /* denoted by wd_comp_op_type */
 	__u32			last;
 	__u32			status;
+	__u8			data_fmt;    /* denoted by wd_buff_type */
 };
 
 /**
@@ -66,6 +74,13 @@ extern int wd_comp_init(struct wd_ctx_config *config, struct wd_sched *sched);
  */
 extern void wd_comp_uninit(void);
 
+/*
+ * comp_lv and win_sz are used by compression, independently of each other.
+ * If either is 0, its default is used, so a zeroed setup gets the default
+ * level and a 32KB window. The window is programmed into the hardware if it
+ * supports, and the level is used by the software engine, since the
+ * hardware works at a fixed level.
+ */
 struct wd_comp_sess_setup {
 	enum wd_comp_alg_type alg_type; /* Denoted by enum wd_comp_alg_type */
 	enum wd_comp_level comp_lv; /* Denoted by enum wd_comp_level */
@@ -86,6 +101,24 @@ extern handle_t wd_comp_alloc_sess(struct wd_comp_sess_setup *setup);
  */
 extern void wd_comp_free_sess(handle_t h_sess);
 
+/**
+ * wd_comp_set_dict() - Set preset dictionary of a stateless session.
+ * @h_sess:	The session, it mustn't be in a stream.
+ * @dict:	Dictionary, it is copied into the session.
+ * @dict_len:	Length of dictionary, 0 removes the dictionary.
+ *
+ * It has the semantics of deflateSetDictionary() and
+ * inflateSetDictionary() of zlib. zlib output carries FDICT and the DICTID
+ * of the dictionary, which is checked in decompression. Deflate uses it
+ * without any mark, and gzip doesn't support it. The hardware has no input
+ * of dictionary, so requests of the session are done by the software
+ * engine, and stream or page requests are refused.
+ *
+ * Return 0 if successful or less than 0 otherwise.
+ */
+extern int wd_comp_set_dict(handle_t h_sess, const void *dict,
+			    __u32 dict_len);
+
 /**
  * wd_do_comp_sync() - Send a sync compression request.
  * @h_sess:	The session which request will be sent to.
@@ -125,5 +158,279 @@ extern int wd_comp_poll(__u32 expt, __u32 *count);
  */
 extern int wd_do_comp_sync2(handle_t h_sess, struct wd_comp_req *req);
 
+/*
+ * wd_comp_sink_t - Output sink, it's called with every piece of output
+ * in order. Return less than 0 to abort the request.
+ */
+typedef int wd_comp_sink_t(void *data, __u32 len, void *param);
+
+/*
+ * wd_comp_alloc_t - Output allocator, return a node with data and len set
+ * to an empty buffer, or NULL if no more memory.
+ */
+typedef struct wd_datalist *wd_comp_alloc_t(void *param);
+
+/**
+ * wd_do_comp_sync_sink() - Sync decompression without output size limit.
+ * @h_sess:	The session which request will be sent to.
+ * @req:	Request. dst and dst_len are used as staging buffer if they
+ *		are set, otherwise an internal buffer is used. src_len
+ *		returns the consumed input.
+ * @sink:	Called every time the staging buffer is full, and at the end.
+ * @param:	Parameter of sink.
+ *
+ * Output size isn't limited by dst_len, decompression is done in one pass
+ * no matter how much output is produced.
+ */
+extern int wd_do_comp_sync_sink(handle_t h_sess, struct wd_comp_req *req,
+				wd_comp_sink_t *sink, void *param);
+
+/**
+ * wd_do_comp_sync_chain() - Sync decompression into a chain of buffers.
+ * @h_sess:	The session which request will be sent to.
+ * @req:	Request, dst and dst_len are not used. src_len returns the
+ *		consumed input.
+ * @alloc:	Called to get a new output buffer when the last one is full.
+ * @param:	Parameter of alloc.
+ * @list:	Returned chain of output buffers in order, len of every node
+ *		is updated to the produced bytes in it.
+ *
+ * Hardware writes output into the buffers directly. Nodes got from alloc
+ * are always linked into @list, even on error, so caller could free them.
+ */
+extern int wd_do_comp_sync_chain(handle_t h_sess, struct wd_comp_req *req,
+				 wd_comp_alloc_t *alloc, void *param,
+				 struct wd_datalist **list);
+
+/**
+ * wd_comp_frame_compress() - Compress data into a seekable frame.
+ * @h_sess:	Compression session.
+ * @req:	Request. dst_len returns the length of the whole frame.
+ * @block_size:	Uncompressed size of every block, 0 means 128KB.
+ *
+ * Input is split into blocks which are compressed independently in
+ * parallel on all sync ctxs of the session's op type. Every block is a
+ * complete stream of the session's algorithm. An index of compressed and
+ * uncompressed block length and a trailer follow the last block:
+ *
+ *	| block 0 | ... | block n-1 | index[n] | trailer |
+ */
+extern int wd_comp_frame_compress(handle_t h_sess, struct wd_comp_req *req,
+				  __u32 block_size);
+
+/**
+ * wd_comp_frame_info() - Get information of a seekable frame.
+ * @frame:	The frame made by wd_comp_frame_compress().
+ * @frame_len:	Length of the frame.
+ * @orig_len:	Returned uncompressed length, could be NULL.
+ * @block_num:	Returned number of blocks, could be NULL.
+ */
+extern int wd_comp_frame_info(void *frame, __u32 frame_len, __u64 *orig_len,
+			      __u32 *block_num);
+
+/**
+ * wd_comp_read_range() - Decompress a byte range from a seekable frame.
+ * @h_sess:	Decompression session with the same algorithm as the frame.
+ * @frame:	The frame made by wd_comp_frame_compress().
+ * @frame_len:	Length of the frame.
+ * @offset:	Uncompressed offset of the range.
+ * @dst:	Output buffer.
+ * @len:	Input the length of the range, returns the length read, which
+ *		is shorter if the range is out of the end of data.
+ *
+ * Only the blocks covering the range are decompressed, in parallel on all
+ * sync ctxs of the session's op type.
+ */
+extern int wd_comp_read_range(handle_t h_sess, void *frame, __u32 frame_len,
+			      __u64 offset, void *dst, __u32 *len);
+
+/**
+ * wd_do_comp_gzip_multi() - Decompress concatenated gzip members.
+ * @h_sess:	Gzip decompression session.
+ * @req:	Request. src_len and dst_len return the consumed input and the
+ *		total output.
+ *
+ * Members are inflated in parallel on all sync ctxs of the session's op type,
+ * and written to dst in order. The size of a member is taken from a BGZF "BC"
+ * extra subfield, or else guessed from the next gzip head. A member whose
+ * guessed end is wrong, or which is empty or over 8MB, is inflated in stream
+ * mode. The CRC-32 and ISIZE of every member are checked.
+ */
+extern int wd_do_comp_gzip_multi(handle_t h_sess, struct wd_comp_req *req);
+
+struct wd_comp_page {
+	void	*src;
+	void	*dst;
+	__u32	src_len;	/* compressed length, only for decompression */
+	__u32	dst_len;	/* size of dst, returns the produced length */
+	__u32	status;		/* same as status of struct wd_comp_req */
+};
+
+/**
+ * wd_comp_page_alloc() - Bind a sync ctx for fixed-size page requests.
+ * @h_sess:	Stateless sync session.
+ * @page_size:	Uncompressed size of every page, e.g. 4KB or 64KB.
+ *
+ * The ctx is picked by the scheduler once, and the message is prepared
+ * once, so a page request only fills its buffers. A page handle should be
+ * used by one thread, every thread could allocate its own.
+ */
+extern handle_t wd_comp_page_alloc(handle_t h_sess, __u32 page_size);
+
+/**
+ * wd_comp_page_free() - Free a page handle.
+ * @h_page:	The handle returned by wd_comp_page_alloc().
+ */
+extern void wd_comp_page_free(handle_t h_page);
+
+/**
+ * wd_do_comp_page_batch() - Compress or decompress an array of pages.
+ * @h_page:	The handle returned by wd_comp_page_alloc().
+ * @pages:	Pages, dst_len and status of every page are updated.
+ * @num:	Number of pages.
+ *
+ * Input of compression is always page_size long. Pages are sent as long
+ * as the queue has room, and the call returns after all of them are done.
+ * If it fails, dst_len and status are only valid for pages done before.
+ */
+extern int wd_do_comp_page_batch(handle_t h_page, struct wd_comp_page *pages,
+				 __u32 num);
+
+typedef void wd_comp_seq_sink_t(struct wd_comp_req *req, __u64 id,
+				void *sink_param);
+
+/**
+ * struct wd_comp_seq_setup - Setup of an ordered sequence of requests.
+ * @window:	Max number of requests in flight, a power of 2 up to 4096.
+ *		0 means 64.
+ * @sink:	Called with every completed request strictly in the order of
+ *		submission. dst_len, src_len and status are the results, and
+ *		cb_param is the one of the submitted request.
+ * @sink_param:	Parameter of sink.
+ */
+struct wd_comp_seq_setup {
+	__u32 window;
+	wd_comp_seq_sink_t *sink;
+	void *sink_param;
+};
+
+/**
+ * wd_comp_seq_alloc() - Attach an ordered sequence to a session.
+ * @h_sess:	Stateless async session.
+ * @setup:	Parameters of the sequence.
+ *
+ * Requests of a sequence could be spread over several ctxs by the
+ * scheduler, and completed in any order by wd_comp_poll_ctx(), while the
+ * sink sees them in the submission order, e.g. chunks of one file.
+ */
+extern handle_t wd_comp_seq_alloc(handle_t h_sess,
+				  struct wd_comp_seq_setup *setup);
+
+/**
+ * wd_comp_seq_free() - Free a sequence, no request should be in flight.
+ * @h_seq:	The handle returned by wd_comp_seq_alloc().
+ */
+extern void wd_comp_seq_free(handle_t h_seq);
+
+/**
+ * wd_do_comp_seq_async() - Submit the next request of a sequence.
+ * @h_seq:	The handle returned by wd_comp_seq_alloc().
+ * @req:	Request, cb of it isn't used, cb_param is passed to the sink.
+ *		The request is copied, so it could be reused after return.
+ * @id:	Returns the sequence number of the request, it could be NULL.
+ *
+ * The sequence number is taken when the request enters the window. If it
+ * fails to be sent later, the number is skipped and the sink isn't called
+ * for it, so a resubmitted request gets a new one.
+ *
+ * Return 0 if successful, -WD_EBUSY if the window is full or the queue is
+ * busy, then try again after polling, or other negative value otherwise.
+ */
+extern int wd_do_comp_seq_async(handle_t h_seq, struct wd_comp_req *req,
+				__u64 *id);
+
+/*
+ * Policy of the software engine. A stateless request is done by the CPU
+ * instead of the hardware if it hits one of the conditions below. All
+ * conditions are off by default. Stateful requests always go to hardware,
+ * since the stream context lives in the hardware ctx_buf.
+ */
+struct wd_comp_sw_policy {
+	__u32 small_thresh;	/* src_len below it goes to CPU, 0: off */
+	__u32 large_thresh;	/* src_len above it goes to CPU, 0: off */
+	bool busy_fallback;	/* go to CPU if msg pool or queue is full */
+	bool err_fallback;	/* go to CPU if hardware reports an error */
+	/*
+	 * Sample the input of stateless compression, and emit stored blocks
+	 * by CPU if it looks incompressible. It works without zlib.
+	 */
+	bool store_precheck;
+};
+
+struct wd_comp_engine_stat {
+	__u64 hw_reqs;		/* requests done by hardware */
+	__u64 sw_reqs;		/* requests done by CPU */
+	__u64 sw_small;		/* CPU requests caused by small_thresh */
+	__u64 sw_large;		/* CPU requests caused by large_thresh */
+	__u64 sw_busy;		/* CPU requests caused by a full queue */
+	__u64 sw_hw_err;	/* CPU requests caused by hardware error */
+	__u64 precheck_reqs;	/* requests sampled by store_precheck */
+	__u64 stored_reqs;	/* requests emitted as stored blocks */
+};
+
+/**
+ * wd_comp_set_sw_policy() - Set the policy of the software engine.
+ * @policy:	New policy, all conditions are cleared if it's NULL.
+ *
+ * The software engine outputs standard deflate/zlib/gzip streams, so data
+ * compressed by one engine could be decompressed by the other one. In async
+ * mode the callback of a request done by CPU is called before
+ * wd_do_comp_async() returns.
+ *
+ * Return 0 if successful, -WD_EINVAL if libwd_comp is built without zlib
+ * and any condition other than store_precheck is set.
+ */
+extern int wd_comp_set_sw_policy(struct wd_comp_sw_policy *policy);
+
+/**
+ * wd_comp_get_engine_stat() - Get the number of requests done by each engine.
+ * @stat:	Returned statistics.
+ */
+extern void wd_comp_get_engine_stat(struct wd_comp_engine_stat *stat);
+
+/**
+ * wd_crc32() - Update the CRC-32 of gzip with a buffer.
+ * @crc:	CRC-32 of the data before, 0 for the first buffer.
+ * @buf:	Data, crc is returned as it is if buf is NULL.
+ * @len:	Length of data.
+ *
+ * Hardware CRC instructions or carry-less multiply are used if the CPU
+ * supports, otherwise a table driven implementation.
+ */
+extern __u32 wd_crc32(__u32 crc, const void *buf, __u64 len);
+
+/**
+ * wd_crc32_combine() - Get CRC-32 of two pieces of data joined.
+ * @crc1:	CRC-32 of the first piece.
+ * @crc2:	CRC-32 of the second piece.
+ * @len2:	Length of the second piece.
+ */
+extern __u32 wd_crc32_combine(__u32 crc1, __u32 crc2, __u64 len2);
+
+/**
+ * wd_adler32() - Update the Adler-32 of zlib with a buffer.
+ * @adler:	Adler-32 of the data before, 1 for the first buffer.
+ * @buf:	Data, adler is returned as it is if buf is NULL.
+ * @len:	Length of data.
+ */
+extern __u32 wd_adler32(__u32 adler, const void *buf, __u64 len);
+
+/**
+ * wd_adler32_combine() - Get Adler-32 of two pieces of data joined.
+ * @adler1:	Adler-32 of the first piece.
+ * @adler2:	Adler-32 of the second piece.
+ * @len2:	Length of the second piece.
+ */
+extern __u32 wd_adler32_combine(__u32 adler1, __u32 adler2, __u64 len2);
 
 #endif /* __WD_COMP_H */
@@ -0,0 +1,60 @@
+// SPDX-License-Identifier: Apache-2.0
+#ifndef __WD_COMP_SW_H
+#define __WD_COMP_SW_H
+
+#include <stdbool.h>
+
+#include "wd_comp.h"
+
+/*
+ * wd_comp_sw_supported() - Check whether the software engine is built in.
+ *
+ * Return true if libwd_comp is linked with zlib, false otherwise.
+ */
+bool wd_comp_sw_supported(void);
+
+/*
+ * wd_comp_sw_do() - Run one stateless request on the CPU.
+ * @alg_type: Denoted by enum wd_comp_alg_type.
+ * @comp_lv: Compression level, 0 means the default level.
+ * @win_sz: Compression window, denoted by enum wd_comp_winsz_type.
+ * @dict: Preset dictionary, NULL if dict_len is 0.
+ * @dict_len: Length of preset dictionary.
+ * @req: Request. src_len, dst_len and status are updated the same way
+ *	 as the hardware path does.
+ *
+ * The output is a standard deflate/zlib/gzip stream, so it could be
+ * decompressed by the hardware and vice versa, unless a dictionary is used.
+ *
+ * Return 0 if the request is handled or less than 0 otherwise.
+ */
+int wd_comp_sw_do(int alg_type, int comp_lv, int win_sz, const void *dict,
+		  __u32 dict_len, struct wd_comp_req *req);
+
+/*
+ * wd_comp_sw_incompressible() - Estimate whether data is incompressible.
+ * @src: Input data.
+ * @len: Length of input data.
+ *
+ * A byte histogram of at most 4KB samples spread over the input is taken,
+ * data is incompressible if its collision entropy is close to 8 bits.
+ */
+bool wd_comp_sw_incompressible(const void *src, __u32 len);
+
+/*
+ * wd_comp_sw_store_bound() - Output size of wd_comp_sw_store().
+ * @alg_type: Denoted by enum wd_comp_alg_type.
+ * @len: Length of input data.
+ */
+__u32 wd_comp_sw_store_bound(int alg_type, __u32 len);
+
+/*
+ * wd_comp_sw_store() - Frame input as stored deflate blocks.
+ * @alg_type: Denoted by enum wd_comp_alg_type.
+ * @req: Compression request, dst_len must be no less than the bound.
+ *
+ * Return 0 if successful or less than 0 otherwise.
+ */
+int wd_comp_sw_store(int alg_type, struct wd_comp_req *req);
+
+#endif /* __WD_COMP_SW_H */
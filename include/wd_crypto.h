@@ -0,0 +1,52 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+#ifndef __WD_CRYPTO_H
+#define __WD_CRYPTO_H
+
+#include "wd_alg_common.h"
+#include "wd.h"
+
+/**
+ * wd_crypto_init() - Initialise one ctx set shared by cipher, digest and
+ *		      aead.
+ * @config: User defined ctx configuration, each ctx serves all families.
+ * @sched: User defined schedule, NULL means the built-in one which spreads
+ *	   requests of all families over the ctxs of the wanted mode, idle
+ *	   sync ctxs are preferred.
+ *
+ * Sessions and requests of wd_cipher, wd_digest and wd_aead are used as
+ * before, but wd_cipher_init(), wd_digest_init() and wd_aead_init() aren't
+ * needed, and they shouldn't be initialised on their own before it.
+ *
+ * Return 0 if successful or less than 0 otherwise.
+ */
+int wd_crypto_init(struct wd_ctx_config *config, struct wd_sched *sched);
+
+/**
+ * wd_crypto_uninit() - Uninitialise the shared ctx set.
+ */
+void wd_crypto_uninit(void);
+
+/**
+ * wd_crypto_poll_ctx() - Poll one async ctx of the shared ctx set.
+ * @index: Index of ctx which will be polled.
+ * @expt: User expected num respondings.
+ * @count: How many respondings this poll has to get.
+ *
+ * Responses of all families are received, the callback of each request is
+ * called. wd_cipher_poll_ctx(), wd_digest_poll_ctx() and wd_aead_poll_ctx()
+ * are the same as it in shared mode.
+ *
+ * Return 0 if successful, -WD_EAGAIN if no more response, less than 0
+ * otherwise.
+ */
+int wd_crypto_poll_ctx(__u32 index, __u32 expt, __u32 *count);
+
+/**
+ * wd_crypto_poll() - Poll finished requests of the shared ctx set by the
+ *		      poll_policy of the schedule.
+ * @expt: User expected num respondings.
+ * @count: How many respondings this poll has to get.
+ */
+int wd_crypto_poll(__u32 expt, __u32 *count);
+
+#endif /* __WD_CRYPTO_H */
@@ -0,0 +1,46 @@
+// SPDX-License-Identifier: Apache-2.0
+#ifndef __WD_CRYPTO_SHARE_H
+#define __WD_CRYPTO_SHARE_H
+
+#include "include/drv/wd_crypto_drv.h"
+
+/*
+ * Hooks of cipher, digest and aead used by wd_crypto.c only.
+ *
+ * wd_X_init_shared() - Attach the family to the shared ctx set.
+ * @config: Shared ctx configuration, its ctxs and locks are referred, not
+ *	    copied, and it's released by wd_crypto_uninit().
+ * @sched: Schedule of the shared ctx set.
+ *
+ * The driver isn't initialised again, the async msg pool is the family's
+ * own. Return 0 if successful, -WD_EBUSY if the family is initialised
+ * already, less than 0 otherwise.
+ *
+ * wd_X_uninit_shared() - Detach the family from the shared ctx set.
+ *
+ * wd_X_msg_done() - Complete an async msg received from ctx index, the
+ * callback of its request is called and the msg is put back to the pool.
+ * Return 0 if successful or less than 0 otherwise.
+ */
+int wd_cipher_init_shared(struct wd_ctx_config_internal *config,
+			  struct wd_sched *sched);
+void wd_cipher_uninit_shared(void);
+int wd_cipher_msg_done(__u32 index, struct wd_cipher_msg *resp);
+
+int wd_digest_init_shared(struct wd_ctx_config_internal *config,
+			  struct wd_sched *sched);
+void wd_digest_uninit_shared(void);
+int wd_digest_msg_done(__u32 index, struct wd_digest_msg *resp);
+
+/*
+ * wd_digest_poll_end() - Resend pending segments of digest streams once
+ * a poll round frees some room of the ctxs.
+ */
+void wd_digest_poll_end(void);
+
+int wd_aead_init_shared(struct wd_ctx_config_internal *config,
+			struct wd_sched *sched);
+void wd_aead_uninit_shared(void);
+int wd_aead_msg_done(__u32 index, struct wd_aead_msg *resp);
+
+#endif /* __WD_CRYPTO_SHARE_H */
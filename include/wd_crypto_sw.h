@@ -0,0 +1,78 @@
+// SPDX-License-Identifier: Apache-2.0
+#ifndef __WD_CRYPTO_SW_H
+#define __WD_CRYPTO_SW_H
+
+#include <stdbool.h>
+
+#include "wd_aead.h"
+#include "wd_cipher.h"
+#include "wd_digest.h"
+
+/*
+ * wd_crypto_sw_supported() - Check whether the CPU engine is built in.
+ *
+ * Return true if libwd_crypto is linked with libcrypto, false otherwise.
+ */
+bool wd_crypto_sw_supported(void);
+
+/*
+ * wd_cipher_sw_support() - Check whether CPU could do the cipher request.
+ * @sess: Session of the request.
+ * @req: Request, only flat buffers are supported.
+ *
+ * AES and SM4 in ECB, CBC and CTR mode are supported.
+ */
+bool wd_cipher_sw_support(struct wd_cipher_sess *sess,
+			  struct wd_cipher_req *req);
+
+/*
+ * wd_cipher_sw_do() - Run one cipher request on the CPU.
+ * @sess: Session of the request.
+ * @req: Request. IV and state are updated the same way as the hardware
+ *	 path does.
+ *
+ * Return 0 if the request is handled or less than 0 otherwise.
+ */
+int wd_cipher_sw_do(struct wd_cipher_sess *sess, struct wd_cipher_req *req);
+
+/*
+ * wd_aead_sw_support() - Check whether CPU could do the aead request.
+ * @sess: Session of the request.
+ * @req: Request, only flat buffers are supported.
+ *
+ * Only AES-GCM is supported.
+ */
+bool wd_aead_sw_support(struct wd_aead_sess *sess, struct wd_aead_req *req);
+
+/*
+ * wd_aead_sw_do() - Run one aead request on the CPU.
+ * @sess: Session of the request.
+ * @req: Request. The layout of associated data, text and MAC is the same
+ *	 as the hardware path. state is WD_IN_EPARA if MAC isn't verified.
+ *
+ * Return 0 if the request is handled or less than 0 otherwise.
+ */
+int wd_aead_sw_do(struct wd_aead_sess *sess, struct wd_aead_req *req);
+
+/*
+ * wd_digest_sw_support() - Check whether CPU could do the digest request.
+ * @sess: Session of the request.
+ * @req: Request, only flat buffers of a whole message are supported.
+ *
+ * All digest types in normal and HMAC mode are supported, SM3 only if
+ * libcrypto has it.
+ */
+bool wd_digest_sw_support(struct wd_digest_sess *sess,
+			  struct wd_digest_req *req);
+
+/*
+ * wd_digest_sw_do() - Run one digest request on the CPU.
+ * @sess: Session of the request.
+ * @req: Request. The first out_bytes of the MAC are written to out, the
+ *	 same as the hardware path.
+ *
+ * Return 0 if the request is handled or less than 0 otherwise.
+ */
+int wd_digest_sw_do(struct wd_digest_sess *sess, struct wd_digest_req *req);
+
+#endif /* __WD_CRYPTO_SW_H */
@@ -35,6 +35,9 @@ enum wd_digest_mac_len {
 	WD_DIGEST_SHA512_256_LEN	= 32
 };
 
+/* max requests of wd_do_digest_batch() sent by one doorbell */
+#define WD_DIGEST_BATCH_MAX	64
+
 /**
  * wd_digest_mode - Mode of digest
  * Mode should be offered by struct wd_digest_arg
@@ -66,6 +69,10 @@ struct wd_digest_sess {
 	void			*priv;
 	void			*key;
 	__u32			key_bytes;
+	/* stream state, allocated by the first stream operation */
+	void			*strm;
+	/* in_bytes below it is done by CPU in batch, 0 means off */
+	__u32			sw_thresh;
 };
 
 /**
@@ -127,6 +134,10 @@ handle_t wd_digest_alloc_sess(struct wd_digest_sess_setup *setup);
 /**
  * wd_alg_digest_free_sess() - Free digest session.
  * @h_sess: session handler which will be free
+ *
+ * If asynchronous stream jobs are still queued, the session is freed and
+ * its key wiped after the callback of the last one. No request should be
+ * sent on the session after this call.
  */
 void wd_digest_free_sess(handle_t h_sess);
 
@@ -144,6 +155,31 @@ int wd_do_digest_sync(handle_t h_sess, struct wd_digest_req *req);
  */
 int wd_do_digest_async(handle_t h_sess, struct wd_digest_req *req);
 
+/**
+ * wd_do_digest_batch() - Do sync digest of many requests in bursts.
+ * @h_sess: Session handler
+ * @reqs: Requests of flat buffers, has_next should be 0.
+ * @num: Number of requests.
+ *
+ * Up to WD_DIGEST_BATCH_MAX requests are filled and sent by one doorbell,
+ * then all of them are received. Requests shorter than the threshold set by
+ * wd_digest_set_sw_thresh() are done by CPU instead. Result of each request
+ * is in its state.
+ */
+int wd_do_digest_batch(handle_t h_sess, struct wd_digest_req **reqs,
+		       __u32 num);
+
+/**
+ * wd_digest_set_sw_thresh() - Set the length threshold of the CPU engine.
+ * @h_sess: Session handler
+ * @thresh: Requests of wd_do_digest_batch() with in_bytes below it are done
+ *	    by CPU, 0 means off.
+ *
+ * Return 0 if successful, -WD_EINVAL if libwd_crypto is built without
+ * libcrypto and thresh isn't 0.
+ */
+int wd_digest_set_sw_thresh(handle_t h_sess, __u32 thresh);
+
 /**
  * wd_digest_set_key() - Set auth key to digest session.
  * @h_sess: Session handler
@@ -152,6 +188,54 @@ int wd_do_digest_async(handle_t h_sess, struct wd_digest_req *req);
  */
 int wd_digest_set_key(handle_t h_sess, const __u8 *key, __u32 key_len);
 
+/**
+ * wd_digest_strm_init() - Start a new stream in digest session.
+ * @h_sess: Session handler
+ *
+ * Data and intermediate MAC of the last stream are dropped. A new stream
+ * also starts after wd_do_digest_strm_final() is done. Return -WD_EBUSY if
+ * asynchronous stream requests are not done.
+ */
+int wd_digest_strm_init(handle_t h_sess);
+
+/**
+ * wd_do_digest_strm_update() - Hash the next part of a long message.
+ * @h_sess: Session handler
+ * @req: in and in_bytes hold the part in flat buffer, out isn't used.
+ *
+ * Parts could be any length. Whole hash blocks are hashed by long BDs which
+ * chain the intermediate MAC, the tail is kept in session until next part.
+ */
+int wd_do_digest_strm_update(handle_t h_sess, struct wd_digest_req *req);
+
+/**
+ * wd_do_digest_strm_final() - Hash the last part and get MAC of the stream.
+ * @h_sess: Session handler
+ * @req: in and in_bytes hold the last part, in_bytes could be 0. MAC is
+ *       written to out by out_bytes.
+ */
+int wd_do_digest_strm_final(handle_t h_sess, struct wd_digest_req *req);
+
+/**
+ * wd_do_digest_strm_update_async() - Asynchronous wd_do_digest_strm_update().
+ * @h_sess: Session handler
+ * @req: Same as wd_do_digest_strm_update(), cb is called with req when the
+ *       part is hashed, in could be reused then.
+ *
+ * Requests of a session are hashed in order, one BD in flight, the next BD
+ * is sent by polling. So the caller could read the next part meanwhile.
+ * Return -WD_EBUSY if too many requests are waiting.
+ */
+int wd_do_digest_strm_update_async(handle_t h_sess, struct wd_digest_req *req);
+
+/**
+ * wd_do_digest_strm_final_async() - Asynchronous wd_do_digest_strm_final().
+ * @h_sess: Session handler
+ * @req: Same as wd_do_digest_strm_final(), cb is called with req when MAC
+ *       is written.
+ */
+int wd_do_digest_strm_final_async(handle_t h_sess, struct wd_digest_req *req);
+
 /**
  * wd_digest_poll() - Poll operation for asynchronous operation.
  * @index: index of ctx which will be polled.
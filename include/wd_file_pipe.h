@@ -0,0 +1,68 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+#ifndef __WD_FILE_PIPE_H
+#define __WD_FILE_PIPE_H
+
+#include <stdbool.h>
+
+#include "wd.h"
+#include "wd_comp.h"
+
+/* default size and number of blocks in flight */
+#define WD_FILE_PIPE_BLOCK_SIZE	(512 * 1024)
+#define WD_FILE_PIPE_DEPTH	32
+
+/**
+ * struct wd_file_pipe_setup - Setup of a file compression pipeline.
+ * @h_sess:	Stateless async compression session, every block becomes a
+ *		member of alg_type, e.g. concatenated gzip members.
+ * @in_fd:	Input file, read by offset from 0.
+ * @out_fd:	Output file, written by offset from 0.
+ * @block_size:	Size of input blocks, 0 means WD_FILE_PIPE_BLOCK_SIZE.
+ * @depth:	Blocks in flight, a power of 2, 0 means WD_FILE_PIPE_DEPTH.
+ * @poll:	Poll wd_comp by a thread of the pipeline. False if requests
+ *		complete inline, e.g. done by the software engine, or are
+ *		polled by the user.
+ * @sync_io:	Read and write by pread and pwrite even if io_uring is
+ *		available.
+ */
+struct wd_file_pipe_setup {
+	handle_t h_sess;
+	int in_fd;
+	int out_fd;
+	__u32 block_size;
+	__u32 depth;
+	bool poll;
+	bool sync_io;
+};
+
+/**
+ * struct wd_file_pipe_stat - Result of a file compression pipeline.
+ * @in_bytes:	Bytes read from in_fd.
+ * @out_bytes:	Bytes written to out_fd.
+ * @blocks:	Number of compressed blocks.
+ * @uring:	Whether block I/O is done by io_uring.
+ */
+struct wd_file_pipe_stat {
+	__u64 in_bytes;
+	__u64 out_bytes;
+	__u64 blocks;
+	bool uring;
+};
+
+/**
+ * wd_file_pipe_compress() - Compress a file block by block.
+ * @setup:	Parameters of the pipeline.
+ * @stat:	Returns the counters of the pipeline.
+ *
+ * Reading, compression and writing of different blocks overlap. The caller
+ * thread reads blocks and sends them to an ordered sequence of wd_comp, a
+ * writer thread writes them back in order. If the library is built with
+ * liburing, several reads and writes are in flight on io_uring, otherwise
+ * or if the kernel doesn't support it, they are done by pread and pwrite.
+ *
+ * Return 0 if the whole file is compressed, or a negative value otherwise.
+ */
+int wd_file_pipe_compress(struct wd_file_pipe_setup *setup,
+			  struct wd_file_pipe_stat *stat);
+
+#endif /* __WD_FILE_PIPE_H */
@@ -0,0 +1,111 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+#ifndef __WD_PIPE_H
+#define __WD_PIPE_H
+
+#include "wd.h"
+#include "wd_aead.h"
+#include "wd_comp.h"
+
+/* default size and number of intermediate buffers of a session */
+#define WD_PIPE_BUF_SIZE	(128 * 1024)
+#define WD_PIPE_BUF_NUM		64
+
+/**
+ * struct wd_pipe_sess_setup - Setup of a compress then encrypt session.
+ * @h_comp:	Compression session, it could be shared with other users.
+ * @h_aead:	AEAD session whose keys and authsize are already set.
+ *		CBC mode isn't supported as compressed data isn't aligned.
+ * @buf_size:	Size of every intermediate buffer, 0 means WD_PIPE_BUF_SIZE.
+ *		It holds associated data and compressed data of one request.
+ * @buf_num:	Number of intermediate buffers, 0 means WD_PIPE_BUF_NUM.
+ *		It is the max number of requests in flight in the session.
+ */
+struct wd_pipe_sess_setup {
+	handle_t h_comp;
+	handle_t h_aead;
+	__u32 buf_size;
+	__u32 buf_num;
+};
+
+struct wd_pipe_req;
+typedef void *wd_alg_pipe_cb_t(struct wd_pipe_req *req, void *cb_param);
+
+/**
+ * struct wd_pipe_req - Parameters of one compress then encrypt operation.
+ * @src:	Plain input data.
+ * @src_len:	Length of input data.
+ * @dst:	Output buffer, it gets associated data, the encrypted
+ *		compressed data and the MAC in the layout of wd_aead.
+ * @dst_len:	Size of output buffer, updated to the output length.
+ * @assoc:	Associated data, it could be NULL if assoc_bytes is 0.
+ * @assoc_bytes: Length of associated data.
+ * @iv:		IV of AEAD, it must be valid until the callback.
+ * @iv_bytes:	Length of IV.
+ * @comp_len:	Output, length of compressed data.
+ * @status:	Output, 0 if successful, otherwise the status of the
+ *		compression or AEAD stage which fails, or a negative WD error.
+ * @cb:		Callback invoked once both stages are done or any fails.
+ * @cb_param:	Parameter of callback.
+ */
+struct wd_pipe_req {
+	void			*src;
+	__u32			src_len;
+	void			*dst;
+	__u32			dst_len;
+	void			*assoc;
+	__u16			assoc_bytes;
+	void			*iv;
+	__u16			iv_bytes;
+	__u32			comp_len;
+	int			status;
+	wd_alg_pipe_cb_t	*cb;
+	void			*cb_param;
+};
+
+/**
+ * wd_pipe_alloc_sess() - Allocate a compress then encrypt session.
+ * @setup:	Parameters to setup this session.
+ *
+ * Both wd_comp and wd_aead must be initialized with async ctxs.
+ */
+handle_t wd_pipe_alloc_sess(struct wd_pipe_sess_setup *setup);
+
+/**
+ * wd_pipe_free_sess() - Free a compress then encrypt session.
+ * @h_sess:	The session to be freed.
+ *
+ * The compression and AEAD sessions are kept for the user.
+ *
+ * Return 0 if the session is freed, -WD_EBUSY if any request of it is in
+ * flight or waits in wd_pipe_poll(), and the session is kept then, or other
+ * negative value otherwise.
+ */
+int wd_pipe_free_sess(handle_t h_sess);
+
+/**
+ * wd_do_pipe_async() - Compress data then encrypt it asynchronously.
+ * @h_sess:	The session which request will be sent to.
+ * @req:	Request, it must be valid until the callback.
+ *
+ * Compressed data is kept in an intermediate buffer of the session and
+ * fed to AEAD when compression completes, only one callback is invoked.
+ *
+ * Return 0 if the request is submitted, -WD_EBUSY if no intermediate
+ * buffer or compression queue is free, or other negative value otherwise.
+ */
+int wd_do_pipe_async(handle_t h_sess, struct wd_pipe_req *req);
+
+/**
+ * wd_pipe_poll() - Poll both wd_comp and wd_aead for finished requests.
+ * @expt:	Expected number of pipeline requests to complete.
+ * @count:	Number of pipeline requests completed.
+ *
+ * AEAD requests which met a busy queue on completion of compression are
+ * submitted again here. Requests of other wd_comp and wd_aead users
+ * completed meanwhile get their callbacks, but they aren't counted.
+ *
+ * Return 0 if successful or less than 0 otherwise.
+ */
+int wd_pipe_poll(__u32 expt, __u32 *count);
+
+#endif /* __WD_PIPE_H */
@@ -7,6 +7,14 @@ struct wd_async_msg_pool {
 	__u32 pool_num;
 };
 
+/* session types recycled by the per-thread session cache */
+enum wd_sess_type {
+	WD_SESS_CIPHER,
+	WD_SESS_DIGEST,
+	WD_SESS_AEAD,
+	WD_SESS_TYPE_MAX,
+};
+
 /*
  * wd_init_ctx_config() - Init internal ctx configuration.
  * @in:	ctx configuration in global setting.
@@ -106,4 +114,34 @@ void wd_put_msg_to_pool(struct wd_async_msg_pool *pool, int index, __u32 tag);
  */
 void *wd_find_msg_in_pool(struct wd_async_msg_pool *pool, int index, __u32 tag);
 
+/*
+ * wd_sess_obj_alloc() - Get a zeroed session object of the calling thread.
+ * @type: Session type, objects of one type always have the same size.
+ * @size: Size of the object, including the embedded keys.
+ *
+ * Objects freed by this thread are reused first, others are allocated
+ * aligned to the cache line. Return NULL if no memory.
+ */
+void *wd_sess_obj_alloc(enum wd_sess_type type, __u32 size);
+
+/*
+ * wd_sess_obj_free() - Recycle a session object into the calling thread.
+ * @type: Session type used to allocate the object.
+ * @obj: Object to recycle, the caller wipes the keys in it first.
+ *
+ * The object is freed if the cache of this thread is full. Cached objects
+ * are freed when the thread exits, objects freed after that, e.g. by other
+ * TLS destructors, are freed directly.
+ */
+void wd_sess_obj_free(enum wd_sess_type type, void *obj);
+
+/*
+ * wd_sess_numa() - Get the NUMA node of the calling thread.
+ *
+ * The node is cached per thread instead of looked up by every session
+ * allocation. It is refreshed when wd_sess_obj_alloc() misses the cache, so
+ * a thread that migrates between nodes may use the old one for a while.
+ */
+int wd_sess_numa(void);
+
 #endif /* __WD_UTIL_H */
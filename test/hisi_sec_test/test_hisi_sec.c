@@ -3,6 +3,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <pthread.h>
+#include <sched.h>
 #include <sys/syscall.h>
 #include <sys/mman.h>
 #include <sys/time.h>
@@ -12,11 +13,13 @@
 #include "wd_cipher.h"
 #include "wd_digest.h"
 #include "wd_aead.h"
+#include "wd_crypto.h"
 #include "sched_sample.h"
 
 #define SEC_TST_PRT printf
 #define HW_CTX_SIZE (24 * 1024)
 #define BUFF_SIZE 1024
+#define ARRAY_SIZE(x) (sizeof(x) / sizeof((x)[0]))
 #define IV_SIZE   256
 #define THREADS_NUM	64
 #define SVA_THREADS	64
@@ -46,6 +49,9 @@ static unsigned int g_syncmode;
 static unsigned int g_ctxnum;
 static unsigned int g_data_fmt = 0;
 static unsigned int g_sgl_num = 0;
+static unsigned int g_digest_strm;
+static unsigned int g_digest_batch;
+static unsigned int g_aead_batch;
 static pthread_spinlock_t lock = 0;
 
 char *skcipher_names[MAX_ALGO_PER_TYPE] =
@@ -102,6 +108,11 @@ struct test_sec_option {
 	__u32 block;
 	__u32 blknum;
 	__u32 sgl_num;
+	__u32 cpu;
+	__u32 crypto;
+	__u32 tpl;
+	__u32 sglpool;
+	__u32 split;
 };
 
 //static pthread_cond_t cond = PTHREAD_COND_INITIALIZER;
@@ -1542,6 +1553,193 @@ out:
 	return ret;
 }
 
+/* hash the message by parts of pktlen in stream, and compare with one BD */
+static int sec_digest_strm_once(void)
+{
+	struct wd_digest_sess_setup setup;
+	struct hash_testvec *tv = NULL;
+	struct wd_digest_req req;
+	__u8 out[64], strm_out[64];
+	handle_t h_sess = 0;
+	__u32 part, off;
+	int ret;
+
+	ret = init_digest_ctx_config(CTX_TYPE_ENCRYPT, CTX_MODE_SYNC);
+	if (ret) {
+		SEC_TST_PRT("Fail to init sigle ctx config!\n");
+		return ret;
+	}
+
+	memset(&req, 0, sizeof(struct wd_digest_req));
+	get_digest_resource(&tv, (int *)&setup.alg, (int *)&setup.mode);
+	h_sess = wd_digest_alloc_sess(&setup);
+	if (!h_sess) {
+		ret = -1;
+		goto out;
+	}
+
+	if (setup.mode == WD_DIGEST_HMAC) {
+		ret = wd_digest_set_key(h_sess, (const __u8 *)tv->key, tv->ksize);
+		if (ret) {
+			SEC_TST_PRT("sess set key failed!\n");
+			goto out;
+		}
+	}
+
+	req.in = (void *)tv->plaintext;
+	req.in_bytes = tv->psize;
+	req.out = out;
+	req.out_bytes = tv->dsize;
+	req.out_buf_bytes = sizeof(out);
+	ret = wd_do_digest_sync(h_sess, &req);
+	if (ret || req.state) {
+		SEC_TST_PRT("fail to do digest in one BD!\n");
+		ret = ret ? ret : -1;
+		goto out;
+	}
+
+	part = g_pktlen ? g_pktlen : 100;
+	for (off = 0; off + part < tv->psize; off += part) {
+		req.in = (void *)(tv->plaintext + off);
+		req.in_bytes = part;
+		ret = wd_do_digest_strm_update(h_sess, &req);
+		if (ret || req.state) {
+			SEC_TST_PRT("fail to update digest stream!\n");
+			ret = ret ? ret : -1;
+			goto out;
+		}
+	}
+
+	req.in = (void *)(tv->plaintext + off);
+	req.in_bytes = tv->psize - off;
+	req.out = strm_out;
+	ret = wd_do_digest_strm_final(h_sess, &req);
+	if (ret || req.state) {
+		SEC_TST_PRT("fail to final digest stream!\n");
+		ret = ret ? ret : -1;
+		goto out;
+	}
+
+	hexdump((char *)strm_out, tv->dsize);
+	if (memcmp(out, strm_out, tv->dsize)) {
+		SEC_TST_PRT("digest stream of %u bytes parts is mismatched!\n",
+			    part);
+		ret = -1;
+	} else {
+		SEC_TST_PRT("digest stream of %u bytes parts is matched!\n",
+			    part);
+	}
+
+out:
+	if (h_sess)
+		wd_digest_free_sess(h_sess);
+	digest_uninit_config();
+
+	return ret;
+}
+
+static double digest_time_us(struct timeval *start, struct timeval *end)
+{
+	return (end->tv_sec - start->tv_sec) * 1000000.0 +
+	       (end->tv_usec - start->tv_usec);
+}
+
+/* hash the same messages one by one and by batches, then compare */
+static int sec_digest_batch_once(void)
+{
+	struct wd_digest_req reqs[WD_DIGEST_BATCH_MAX];
+	struct wd_digest_req *preqs[WD_DIGEST_BATCH_MAX];
+	__u8 out[WD_DIGEST_BATCH_MAX][64], batch_out[WD_DIGEST_BATCH_MAX][64];
+	struct wd_digest_sess_setup setup;
+	struct hash_testvec *tv = NULL;
+	struct timeval start, end;
+	double single_us, batch_us;
+	handle_t h_sess = 0;
+	__u32 len, i;
+	long long n;
+	int ret;
+
+	ret = init_digest_ctx_config(CTX_TYPE_ENCRYPT, CTX_MODE_SYNC);
+	if (ret) {
+		SEC_TST_PRT("Fail to init sigle ctx config!\n");
+		return ret;
+	}
+
+	get_digest_resource(&tv, (int *)&setup.alg, (int *)&setup.mode);
+	h_sess = wd_digest_alloc_sess(&setup);
+	if (!h_sess) {
+		ret = -1;
+		goto out;
+	}
+
+	if (setup.mode == WD_DIGEST_HMAC) {
+		ret = wd_digest_set_key(h_sess, (const __u8 *)tv->key, tv->ksize);
+		if (ret) {
+			SEC_TST_PRT("sess set key failed!\n");
+			goto out;
+		}
+	}
+
+	len = g_pktlen && g_pktlen < tv->psize ? g_pktlen : tv->psize;
+	memset(reqs, 0, sizeof(reqs));
+	for (i = 0; i < WD_DIGEST_BATCH_MAX; i++) {
+		/* messages of different lengths in one batch */
+		reqs[i].in = (void *)tv->plaintext;
+		reqs[i].in_bytes = len - i % len;
+		reqs[i].out_bytes = tv->dsize;
+		reqs[i].out_buf_bytes = sizeof(out[i]);
+		preqs[i] = &reqs[i];
+	}
+
+	gettimeofday(&start, NULL);
+	for (n = 0; n < g_times; n++) {
+		for (i = 0; i < WD_DIGEST_BATCH_MAX; i++) {
+			reqs[i].out = out[i];
+			ret = wd_do_digest_sync(h_sess, &reqs[i]);
+			if (ret || reqs[i].state) {
+				SEC_TST_PRT("fail to do digest %u!\n", i);
+				ret = ret ? ret : -1;
+				goto out;
+			}
+		}
+	}
+	gettimeofday(&end, NULL);
+	single_us = digest_time_us(&start, &end);
+
+	for (i = 0; i < WD_DIGEST_BATCH_MAX; i++)
+		reqs[i].out = batch_out[i];
+	gettimeofday(&start, NULL);
+	for (n = 0; n < g_times; n++) {
+		ret = wd_do_digest_batch(h_sess, preqs, WD_DIGEST_BATCH_MAX);
+		if (ret) {
+			SEC_TST_PRT("fail to do digest batch, ret = %d!\n", ret);
+			goto out;
+		}
+	}
+	gettimeofday(&end, NULL);
+	batch_us = digest_time_us(&start, &end);
+
+	for (i = 0; i < WD_DIGEST_BATCH_MAX; i++) {
+		if (reqs[i].state || memcmp(out[i], batch_out[i], tv->dsize)) {
+			SEC_TST_PRT("digest batch of msg %u is mismatched!\n", i);
+			ret = -1;
+			goto out;
+		}
+	}
+
+	n = g_times * WD_DIGEST_BATCH_MAX;
+	SEC_TST_PRT("digest of %lld msgs: single %.0f hash/s, batch %.0f hash/s\n",
+		    n, single_us ? n * 1000000.0 / single_us : 0,
+		    batch_us ? n * 1000000.0 / batch_us : 0);
+
+out:
+	if (h_sess)
+		wd_digest_free_sess(h_sess);
+	digest_uninit_config();
+
+	return ret;
+}
+
 static void *digest_async_cb(void *data)
 {
 	// struct wd_digest_req *req = (struct wd_digest_req *)data;
@@ -2332,6 +2530,157 @@ out:
 	return ret;
 }
 
+#define REC_MAX_LEN		2048
+#define REC_AAD_LEN		13
+
+static void aead_rec_nonce(__u8 *iv, const __u8 *nonce, __u64 seq)
+{
+	int i;
+
+	memcpy(iv, nonce, GCM_BLOCK_SIZE);
+	for (i = 0; i < 8; i++)
+		iv[GCM_BLOCK_SIZE - 1 - i] ^= (__u8)(seq >> (i * 8));
+}
+
+/* seal the same TLS records one by one and by batches, then open them */
+static int sec_aead_rec_batch_once(void)
+{
+	static __u8 single[WD_AEAD_BATCH_MAX][REC_MAX_LEN];
+	static __u8 bufs[WD_AEAD_BATCH_MAX][REC_MAX_LEN];
+	struct wd_aead_rec recs[WD_AEAD_BATCH_MAX];
+	struct wd_aead_rec_batch batch;
+	struct wd_aead_sess_setup setup;
+	struct aead_testvec *tv = NULL;
+	__u8 iv[GCM_BLOCK_SIZE];
+	struct wd_aead_req req;
+	struct timeval start, end;
+	double single_us, batch_us;
+	__u32 len, auth_size, i;
+	handle_t h_sess = 0;
+	long long n;
+	int ret;
+
+	ret = init_aead_ctx_config(CTX_TYPE_ENCRYPT, CTX_MODE_SYNC);
+	if (ret) {
+		SEC_TST_PRT("Fail to init sigle ctx config!\n");
+		return ret;
+	}
+
+	ret = get_aead_resource(&tv, (int *)&setup.calg,
+		(int *)&setup.cmode, (int *)&setup.dalg, (int *)&setup.dmode);
+	if (ret || setup.cmode != WD_CIPHER_GCM) {
+		SEC_TST_PRT("record batch only supports gcm(aes)!\n");
+		ret = -1;
+		goto out;
+	}
+
+	h_sess = wd_aead_alloc_sess(&setup);
+	if (!h_sess) {
+		ret = -1;
+		goto out;
+	}
+
+	auth_size = tv->clen - tv->plen;
+	ret = wd_aead_set_ckey(h_sess, (const __u8 *)tv->key, tv->klen);
+	if (!ret)
+		ret = wd_aead_set_authsize(h_sess, auth_size);
+	if (ret) {
+		SEC_TST_PRT("aead sess set key or authsize failed!\n");
+		goto out;
+	}
+
+	len = g_pktlen && g_pktlen + REC_AAD_LEN + auth_size <= REC_MAX_LEN ?
+	      g_pktlen : 256;
+	memset(recs, 0, sizeof(recs));
+	for (i = 0; i < WD_AEAD_BATCH_MAX; i++) {
+		/* records of different lengths in one batch */
+		recs[i].data = bufs[i];
+		recs[i].seq = i;
+		recs[i].in_bytes = len - i % len;
+		recs[i].assoc_bytes = REC_AAD_LEN;
+		memset(single[i], i, REC_AAD_LEN + recs[i].in_bytes);
+	}
+
+	memset(&req, 0, sizeof(struct wd_aead_req));
+	req.op_type = WD_CIPHER_ENCRYPTION_DIGEST;
+	req.iv = iv;
+	req.iv_bytes = GCM_BLOCK_SIZE;
+	req.assoc_bytes = REC_AAD_LEN;
+	gettimeofday(&start, NULL);
+	for (n = 0; n < g_times; n++) {
+		for (i = 0; i < WD_AEAD_BATCH_MAX; i++) {
+			memset(single[i], i, REC_AAD_LEN + recs[i].in_bytes);
+			aead_rec_nonce(iv, (const __u8 *)tv->iv, recs[i].seq);
+			req.src = single[i];
+			req.dst = single[i];
+			req.in_bytes = recs[i].in_bytes;
+			req.out_bytes = REC_AAD_LEN + req.in_bytes + auth_size;
+			req.out_buf_bytes = REC_MAX_LEN;
+			ret = wd_do_aead_sync(h_sess, &req);
+			if (ret || req.state) {
+				SEC_TST_PRT("fail to seal record %u!\n", i);
+				ret = ret ? ret : -1;
+				goto out;
+			}
+		}
+	}
+	gettimeofday(&end, NULL);
+	single_us = digest_time_us(&start, &end);
+
+	batch.op_type = WD_CIPHER_ENCRYPTION_DIGEST;
+	batch.nonce = (const __u8 *)tv->iv;
+	batch.nonce_bytes = GCM_BLOCK_SIZE;
+	batch.recs = recs;
+	batch.num = WD_AEAD_BATCH_MAX;
+	gettimeofday(&start, NULL);
+	for (n = 0; n < g_times; n++) {
+		for (i = 0; i < WD_AEAD_BATCH_MAX; i++)
+			memset(bufs[i], i, REC_AAD_LEN + recs[i].in_bytes);
+		ret = wd_do_aead_rec_batch(h_sess, &batch);
+		if (ret) {
+			SEC_TST_PRT("fail to seal record batch, ret = %d!\n", ret);
+			goto out;
+		}
+	}
+	gettimeofday(&end, NULL);
+	batch_us = digest_time_us(&start, &end);
+
+	for (i = 0; i < WD_AEAD_BATCH_MAX; i++) {
+		if (recs[i].state || memcmp(single[i], bufs[i], REC_AAD_LEN +
+					    recs[i].in_bytes + auth_size)) {
+			SEC_TST_PRT("sealed record %u is mismatched!\n", i);
+			ret = -1;
+			goto out;
+		}
+	}
+
+	/* open them in place and get the plaintext back */
+	batch.op_type = WD_CIPHER_DECRYPTION_DIGEST;
+	ret = wd_do_aead_rec_batch(h_sess, &batch);
+	for (i = 0; !ret && i < WD_AEAD_BATCH_MAX; i++) {
+		memset(single[i], i, REC_AAD_LEN + recs[i].in_bytes);
+		if (recs[i].state || memcmp(single[i], bufs[i], REC_AAD_LEN +
+					    recs[i].in_bytes)) {
+			SEC_TST_PRT("opened record %u is mismatched!\n", i);
+			ret = -1;
+		}
+	}
+	if (ret)
+		goto out;
+
+	n = g_times * WD_AEAD_BATCH_MAX;
+	SEC_TST_PRT("seal of %lld records: single %.0f rec/s, batch %.0f rec/s\n",
+		    n, single_us ? n * 1000000.0 / single_us : 0,
+		    batch_us ? n * 1000000.0 / batch_us : 0);
+
+out:
+	if (h_sess)
+		wd_aead_free_sess(h_sess);
+	aead_uninit_config();
+
+	return ret;
+}
+
 static void *aead_async_cb(struct wd_aead_req *req, void *cb_param)
 {
 	//struct wd_aead_req *req = (struct wd_aead_req *)data;
@@ -3405,69 +3754,1345 @@ out_thr:
 	return ret;
 }
 
-static void print_help(void)
+struct sw_cipher_case {
+	const char *name;
+	enum wd_cipher_alg alg;
+	enum wd_cipher_mode mode;
+	struct cipher_testvec *tv;
+};
+
+struct sw_aead_case {
+	const char *name;
+	struct aead_testvec *tv;
+};
+
+static struct sw_cipher_case sw_cipher_cases[] = {
+	{"ecb(aes)-128", WD_CIPHER_AES, WD_CIPHER_ECB, aes_ecb_tv_template_128},
+	{"ecb(aes)-192", WD_CIPHER_AES, WD_CIPHER_ECB, aes_ecb_tv_template_192},
+	{"ecb(aes)-256", WD_CIPHER_AES, WD_CIPHER_ECB, aes_ecb_tv_template_256},
+	{"cbc(aes)-128", WD_CIPHER_AES, WD_CIPHER_CBC, aes_cbc_tv_template_128},
+	{"cbc(aes)-192", WD_CIPHER_AES, WD_CIPHER_CBC, aes_cbc_tv_template_192},
+	{"cbc(aes)-256", WD_CIPHER_AES, WD_CIPHER_CBC, aes_cbc_tv_template_256},
+	{"cbc(sm4)", WD_CIPHER_SM4, WD_CIPHER_CBC, sm4_cbc_tv_template},
+};
+
+static struct sw_aead_case sw_aead_cases[] = {
+	{"gcm(aes)-128", aes_gcm_tv_template_128},
+	{"gcm(aes)-192", aes_gcm_tv_template_192},
+	{"gcm(aes)-256", aes_gcm_tv_template_256},
+};
+
+static int sw_cipher_vec(struct sw_cipher_case *c, int op_type)
 {
-	SEC_TST_PRT("NAME\n");
-	SEC_TST_PRT("    test_hisi_sec: test wd sec function,etc\n");
-	SEC_TST_PRT("USAGE\n");
-	SEC_TST_PRT("    test_hisi_sec [--cipher] [--digest] [--aead] [--perf]\n");
-	SEC_TST_PRT("    test_hisi_sec [--optype] [--pktlen] [--keylen] [--times]\n");
-	SEC_TST_PRT("    test_hisi_sec [--multi] [--sync] [--async] [--help]\n");
-	SEC_TST_PRT("    test_hisi_sec [--block] [--blknum] [--ctxnum]\n");
-	SEC_TST_PRT("    numactl --cpubind=0  --membind=0,1 ./test_hisi_sec xxxx\n");
-	SEC_TST_PRT("        specify numa nodes for cpu and memory\n");
-	SEC_TST_PRT("DESCRIPTION\n");
-	SEC_TST_PRT("    [--cipher ]:\n");
-	SEC_TST_PRT("        specify symmetric cipher algorithm\n");
-	SEC_TST_PRT("        0 : AES-ECB; 1 : AES-CBC;  2 : AES-XTS;  3 : AES-OFB\n");
-	SEC_TST_PRT("        4 : AES-CFB; 5 : 3DES-ECB; 6 : 3DES-CBC; 7 : SM4-CBC\n");
-	SEC_TST_PRT("        8 : SM4-XTS; 9 : SM4-OFB; 10 : SM4-CFB;\n");
-	SEC_TST_PRT("    [--digest ]:\n");
-	SEC_TST_PRT("        specify symmetric hash algorithm\n");
-	SEC_TST_PRT("        0 : SM3;    1 : MD5;    2 : SHA1;   3 : SHA256\n");
-	SEC_TST_PRT("        4 : SHA224; 5 : SHA384; 6 : SHA512; 7 : SHA512_224\n");
-	SEC_TST_PRT("        8 : SHA512_256\n");
-	SEC_TST_PRT("    [--aead ]:\n");
-	SEC_TST_PRT("        specify symmetric aead algorithm\n");
-	SEC_TST_PRT("        0 : AES-CCM; 1 : AES-GCM;  2 : Hmac(sha256),cbc(aes)\n");
-	SEC_TST_PRT("    [--sync]: start synchronous mode test\n");
-	SEC_TST_PRT("    [--async]: start asynchronous mode test\n");
-	SEC_TST_PRT("    [--optype]:\n");
-	SEC_TST_PRT("        0 : encryption operation or normal mode for hash\n");
-	SEC_TST_PRT("        1 : decryption operation or hmac mode for hash\n");
-	SEC_TST_PRT("    [--pktlen]:\n");
-	SEC_TST_PRT("        set the length of BD message in bytes\n");
-	SEC_TST_PRT("    [--keylen]:\n");
-	SEC_TST_PRT("        set the key length in bytes\n");
-	SEC_TST_PRT("    [--times]:\n");
-	SEC_TST_PRT("        set the number of sent messages\n");
-	SEC_TST_PRT("    [--multi]:\n");
-	SEC_TST_PRT("        set the number of threads\n");
-	SEC_TST_PRT("    [--block]:\n");
-	SEC_TST_PRT("        set the memory size allocated for each BD message\n");
-	SEC_TST_PRT("    [--blknum]:\n");
-	SEC_TST_PRT("        the number of memory blocks in the pre-allocated BD message memory pool\n");
-	SEC_TST_PRT("    [--ctxnum]:\n");
-	SEC_TST_PRT("        the number of QP queues used by the entire test task\n");
-	SEC_TST_PRT("    [--help]  = usage\n");
-	SEC_TST_PRT("Example\n");
-	SEC_TST_PRT("    ./test_hisi_sec --cipher 0 --sync --optype 0 \n");
-	SEC_TST_PRT("    	     --pktlen 16 --keylen 16 --times 1 --multi 1\n");
-	SEC_TST_PRT("    ./test_hisi_sec --perf --sync --pktlen 1024 --block 1024 \n");
-	SEC_TST_PRT("    	     --blknum 100000 --times 10000 --multi 1 --ctxnum 1\n");
-	SEC_TST_PRT("UPDATE:2020-11-06\n");
+	struct cipher_testvec *tv = c->tv;
+	struct wd_cipher_sess_setup setup;
+	const char *in, *out;
+	struct wd_cipher_req req;
+	__u8 src[BUFF_SIZE], dst[BUFF_SIZE], iv[AES_BLOCK_SIZE] = {0};
+	handle_t h_sess;
+	int ret;
+
+	setup.alg = c->alg;
+	setup.mode = c->mode;
+	h_sess = wd_cipher_alloc_sess(&setup);
+	if (!h_sess)
+		return -1;
+
+	ret = wd_cipher_set_key(h_sess, (const __u8 *)tv->key, tv->klen);
+	if (!ret)
+		ret = wd_cipher_set_sw_thresh(h_sess, ~0U);
+	if (ret)
+		goto out;
+
+	in = op_type == WD_CIPHER_ENCRYPTION ? tv->ptext : tv->ctext;
+	out = op_type == WD_CIPHER_ENCRYPTION ? tv->ctext : tv->ptext;
+	memcpy(src, in, tv->len);
+	if (tv->iv)
+		memcpy(iv, tv->iv, AES_BLOCK_SIZE);
+
+	memset(&req, 0, sizeof(struct wd_cipher_req));
+	req.op_type = op_type;
+	req.src = src;
+	req.dst = dst;
+	req.in_bytes = tv->len;
+	req.out_bytes = tv->len;
+	req.out_buf_bytes = sizeof(dst);
+	req.iv = iv;
+	req.iv_bytes = AES_BLOCK_SIZE;
+	ret = wd_do_cipher_sync(h_sess, &req);
+	if (ret || req.state || memcmp(dst, out, tv->len) ||
+	    (tv->iv_out && memcmp(iv, tv->iv_out, AES_BLOCK_SIZE)))
+		ret = -1;
+
+out:
+	wd_cipher_free_sess(h_sess);
+	return ret;
 }
 
-static void test_sec_cmd_parse(int argc, char *argv[], struct test_sec_option *option)
+static int sw_aead_vec(struct sw_aead_case *c, int op_type)
 {
-	int option_index = 0;
-	int c;
+	struct aead_testvec *tv = c->tv;
+	struct wd_aead_sess_setup setup = {0};
+	__u8 src[BUFF_SIZE], dst[BUFF_SIZE];
+	__u16 auth_size = tv->clen - tv->plen;
+	struct wd_aead_req req;
+	handle_t h_sess;
+	int enc = op_type == WD_CIPHER_ENCRYPTION_DIGEST;
+	int ret;
 
-	static struct option long_options[] = {
-		{"cipher",    required_argument, 0,  1},
-		{"digest",    required_argument, 0,  2},
-		{"aead",      required_argument, 0,  3},
-		{"perf",      no_argument,       0,  4},
+	setup.calg = WD_CIPHER_AES;
+	setup.cmode = WD_CIPHER_GCM;
+	h_sess = wd_aead_alloc_sess(&setup);
+	if (!h_sess)
+		return -1;
+
+	ret = wd_aead_set_ckey(h_sess, (const __u8 *)tv->key, tv->klen);
+	if (!ret)
+		ret = wd_aead_set_authsize(h_sess, auth_size);
+	if (!ret)
+		ret = wd_aead_set_sw_thresh(h_sess, ~0U);
+	if (ret)
+		goto out;
+
+	memset(&req, 0, sizeof(struct wd_aead_req));
+	memcpy(src, tv->assoc, tv->alen);
+	memcpy(src + tv->alen, enc ? tv->ptext : tv->ctext,
+	       enc ? tv->plen : tv->clen);
+	req.op_type = op_type;
+	req.src = src;
+	req.dst = dst;
+	req.iv = (void *)tv->iv;
+	req.iv_bytes = GCM_BLOCK_SIZE;
+	req.assoc_bytes = tv->alen;
+	req.in_bytes = tv->plen;
+	req.out_bytes = tv->alen + (enc ? tv->clen : tv->plen);
+	req.out_buf_bytes = req.out_bytes + auth_size;
+	ret = wd_do_aead_sync(h_sess, &req);
+	if (ret || req.state ||
+	    memcmp(dst + tv->alen, enc ? tv->ctext : tv->ptext,
+		   enc ? tv->clen : tv->plen))
+		ret = -1;
+
+out:
+	wd_aead_free_sess(h_sess);
+	return ret;
+}
+
+/* check the CPU engine by test vectors, no device is needed */
+static int sec_sw_vec_test(void)
+{
+	int ret, fail = 0;
+	unsigned int i;
+
+	for (i = 0; i < ARRAY_SIZE(sw_cipher_cases); i++) {
+		ret = sw_cipher_vec(&sw_cipher_cases[i], WD_CIPHER_ENCRYPTION);
+		if (!ret)
+			ret = sw_cipher_vec(&sw_cipher_cases[i],
+					    WD_CIPHER_DECRYPTION);
+		SEC_TST_PRT("cpu %s: %s\n", sw_cipher_cases[i].name,
+			    ret ? "fail" : "pass");
+		fail += !!ret;
+	}
+
+	for (i = 0; i < ARRAY_SIZE(sw_aead_cases); i++) {
+		ret = sw_aead_vec(&sw_aead_cases[i],
+				  WD_CIPHER_ENCRYPTION_DIGEST);
+		if (!ret)
+			ret = sw_aead_vec(&sw_aead_cases[i],
+					  WD_CIPHER_DECRYPTION_DIGEST);
+		SEC_TST_PRT("cpu %s: %s\n", sw_aead_cases[i].name,
+			    ret ? "fail" : "pass");
+		fail += !!ret;
+	}
+
+	return fail ? -1 : 0;
+}
+
+/* ---------------shared ctxs of cipher, digest and aead--------------- */
+/* requests of each family in flight */
+#define CRYPTO_DEPTH		32
+#define CRYPTO_POLL_TIMES	1000000
+#define CRYPTO_FAMILY_NUM	3
+#define CRYPTO_NO_FAMILY	0xff
+
+struct crypto_job {
+	/* the family the request is sent by and the one of its callback */
+	__u8 alg_type;
+	__u8 cb_type;
+	__u32 done;
+	__u32 state;
+	union {
+		struct wd_cipher_req creq;
+		struct wd_digest_req dreq;
+		struct wd_aead_req areq;
+	};
+	__u8 src[BUFF_SIZE];
+	__u8 dst[BUFF_SIZE];
+	__u8 iv[AES_BLOCK_SIZE];
+};
+
+struct crypto_sess {
+	handle_t cipher;
+	handle_t digest;
+	handle_t aead;
+};
+
+/*
+ * The request given to a callback is the copy kept by the library, it's of
+ * the right family only if it points back to its own job and callback.
+ */
+static void *crypto_cipher_cb(struct wd_cipher_req *req, void *cb_param)
+{
+	struct crypto_job *job = cb_param;
+
+	if (req->cb == crypto_cipher_cb && req->cb_param == job)
+		job->cb_type = WD_CIPHER;
+	job->state = req->state;
+	job->done++;
+
+	return NULL;
+}
+
+/* the request is given instead of cb_param for digest */
+static void *crypto_digest_cb(void *data)
+{
+	struct wd_digest_req *req = data;
+	struct crypto_job *job = req->cb_param;
+
+	if (req->cb == crypto_digest_cb)
+		job->cb_type = WD_DIGEST;
+	job->state = req->state;
+	job->done++;
+
+	return NULL;
+}
+
+static void *crypto_aead_cb(struct wd_aead_req *req, void *cb_param)
+{
+	struct crypto_job *job = cb_param;
+
+	if (req->cb == crypto_aead_cb && req->cb_param == job)
+		job->cb_type = WD_AEAD;
+	job->state = req->state;
+	job->done++;
+
+	return NULL;
+}
+
+static int init_crypto_ctx_config(void)
+{
+	struct uacce_dev_list *list;
+	int ret, i;
+
+	list = wd_get_accel_list("cipher");
+	if (!list) {
+		SEC_TST_PRT("Fail to get cipher device\n");
+		return -ENODEV;
+	}
+
+	memset(&g_ctx_cfg, 0, sizeof(struct wd_ctx_config));
+	g_ctx_cfg.ctx_num = g_ctxnum;
+	g_ctx_cfg.ctxs = calloc(g_ctxnum, sizeof(struct wd_ctx));
+	if (!g_ctx_cfg.ctxs) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	/* all ctxs are async and serve cipher, digest and aead together */
+	for (i = 0; i < g_ctxnum; i++) {
+		g_ctx_cfg.ctxs[i].ctx = wd_request_ctx(list->dev);
+		if (!g_ctx_cfg.ctxs[i].ctx) {
+			SEC_TST_PRT("Fail to request ctx!\n");
+			ret = -EINVAL;
+			goto out_ctx;
+		}
+		g_ctx_cfg.ctxs[i].op_type = CTX_TYPE_ENCRYPT;
+		g_ctx_cfg.ctxs[i].ctx_mode = CTX_MODE_ASYNC;
+	}
+
+	/* the built-in schedule spreads all families over the ctxs */
+	ret = wd_crypto_init(&g_ctx_cfg, NULL);
+	if (ret) {
+		SEC_TST_PRT("Fail to init shared crypto ctxs!\n");
+		goto out_ctx;
+	}
+
+	wd_free_list_accels(list);
+
+	return 0;
+
+out_ctx:
+	while (i--)
+		wd_release_ctx(g_ctx_cfg.ctxs[i].ctx);
+	free(g_ctx_cfg.ctxs);
+out:
+	wd_free_list_accels(list);
+	return ret;
+}
+
+static void crypto_uninit_config(void)
+{
+	int i;
+
+	wd_crypto_uninit();
+	for (i = 0; i < g_ctx_cfg.ctx_num; i++)
+		wd_release_ctx(g_ctx_cfg.ctxs[i].ctx);
+	free(g_ctx_cfg.ctxs);
+}
+
+static int crypto_sess_alloc(struct crypto_sess *sess)
+{
+	struct aead_testvec *atv = aes_gcm_tv_template_128;
+	struct cipher_testvec *ctv = aes_cbc_tv_template_128;
+	struct wd_cipher_sess_setup csetup = {0};
+	struct wd_digest_sess_setup dsetup = {0};
+	struct wd_aead_sess_setup asetup = {0};
+	int ret;
+
+	csetup.alg = WD_CIPHER_AES;
+	csetup.mode = WD_CIPHER_CBC;
+	sess->cipher = wd_cipher_alloc_sess(&csetup);
+	dsetup.alg = WD_DIGEST_SHA256;
+	dsetup.mode = WD_DIGEST_NORMAL;
+	sess->digest = wd_digest_alloc_sess(&dsetup);
+	asetup.calg = WD_CIPHER_AES;
+	asetup.cmode = WD_CIPHER_GCM;
+	sess->aead = wd_aead_alloc_sess(&asetup);
+	if (!sess->cipher || !sess->digest || !sess->aead) {
+		SEC_TST_PRT("Fail to alloc crypto sessions!\n");
+		return -EINVAL;
+	}
+
+	ret = wd_cipher_set_key(sess->cipher, (const __u8 *)ctv->key,
+				ctv->klen);
+	if (!ret)
+		ret = wd_aead_set_ckey(sess->aead, (const __u8 *)atv->key,
+				       atv->klen);
+	if (!ret)
+		ret = wd_aead_set_authsize(sess->aead, atv->clen - atv->plen);
+	if (ret)
+		SEC_TST_PRT("Fail to set keys of crypto sessions!\n");
+
+	return ret;
+}
+
+static void crypto_sess_free(struct crypto_sess *sess)
+{
+	if (sess->cipher)
+		wd_cipher_free_sess(sess->cipher);
+	if (sess->digest)
+		wd_digest_free_sess(sess->digest);
+	if (sess->aead)
+		wd_aead_free_sess(sess->aead);
+}
+
+static int crypto_job_send(struct crypto_sess *sess, struct crypto_job *job)
+{
+	struct aead_testvec *atv = aes_gcm_tv_template_128;
+	struct cipher_testvec *ctv = aes_cbc_tv_template_128;
+	struct hash_testvec *dtv = sha256_tv_template;
+	struct wd_cipher_req *creq = &job->creq;
+	struct wd_digest_req *dreq = &job->dreq;
+	struct wd_aead_req *areq = &job->areq;
+
+	__u8 alg_type = job->alg_type;
+
+	memset(job, 0, sizeof(struct crypto_job));
+	job->alg_type = alg_type;
+	job->cb_type = CRYPTO_NO_FAMILY;
+
+	switch (alg_type) {
+	case WD_CIPHER:
+		memcpy(job->src, ctv->ptext, ctv->len);
+		memcpy(job->iv, ctv->iv, AES_BLOCK_SIZE);
+		creq->op_type = WD_CIPHER_ENCRYPTION;
+		creq->src = job->src;
+		creq->dst = job->dst;
+		creq->in_bytes = ctv->len;
+		creq->out_bytes = ctv->len;
+		creq->out_buf_bytes = BUFF_SIZE;
+		creq->iv = job->iv;
+		creq->iv_bytes = AES_BLOCK_SIZE;
+		creq->cb = crypto_cipher_cb;
+		creq->cb_param = job;
+		return wd_do_cipher_async(sess->cipher, creq);
+	case WD_DIGEST:
+		memcpy(job->src, dtv->plaintext, dtv->psize);
+		dreq->in = job->src;
+		dreq->in_bytes = dtv->psize;
+		dreq->out = job->dst;
+		dreq->out_bytes = WD_DIGEST_SHA256_LEN;
+		dreq->out_buf_bytes = BUFF_SIZE;
+		dreq->cb = crypto_digest_cb;
+		dreq->cb_param = job;
+		return wd_do_digest_async(sess->digest, dreq);
+	default:
+		memcpy(job->src, atv->ptext, atv->plen);
+		memcpy(job->iv, atv->iv, GCM_BLOCK_SIZE);
+		areq->op_type = WD_CIPHER_ENCRYPTION_DIGEST;
+		areq->src = job->src;
+		areq->dst = job->dst;
+		areq->in_bytes = atv->plen;
+		areq->out_bytes = atv->clen;
+		areq->out_buf_bytes = BUFF_SIZE;
+		areq->iv = job->iv;
+		areq->iv_bytes = GCM_BLOCK_SIZE;
+		areq->cb = crypto_aead_cb;
+		areq->cb_param = job;
+		return wd_do_aead_async(sess->aead, areq);
+	}
+}
+
+static int crypto_job_check(struct crypto_job *job)
+{
+	struct aead_testvec *atv = aes_gcm_tv_template_128;
+	struct cipher_testvec *ctv = aes_cbc_tv_template_128;
+	struct hash_testvec *dtv = sha256_tv_template;
+	int ret;
+
+	if (job->done != 1 || job->cb_type != job->alg_type) {
+		SEC_TST_PRT("family %u: callback done %u times by family %u!\n",
+			    job->alg_type, job->done, job->cb_type);
+		return -EINVAL;
+	}
+
+	switch (job->alg_type) {
+	case WD_CIPHER:
+		ret = memcmp(job->dst, ctv->ctext, ctv->len);
+		break;
+	case WD_DIGEST:
+		ret = memcmp(job->dst, dtv->digest, WD_DIGEST_SHA256_LEN);
+		break;
+	default:
+		ret = memcmp(job->dst, atv->ctext, atv->clen);
+		break;
+	}
+
+	if (job->state || ret) {
+		SEC_TST_PRT("family %u: state %u, output %s!\n", job->alg_type,
+			    job->state, ret ? "mismatch" : "match");
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+static int crypto_poll_all(struct crypto_job *jobs, __u32 num)
+{
+	__u32 cnt, done, i;
+	int ret, try;
+
+	for (try = 0; try < CRYPTO_POLL_TIMES; try++) {
+		for (i = 0, done = 0; i < num; i++)
+			done += !!jobs[i].done;
+		if (done == num)
+			return 0;
+
+		ret = wd_crypto_poll(num - done, &cnt);
+		if (ret < 0 && ret != -WD_EAGAIN) {
+			SEC_TST_PRT("Fail to poll shared ctxs, ret %d!\n", ret);
+			return ret;
+		}
+	}
+
+	SEC_TST_PRT("Fail to poll all requests, timeout!\n");
+	return -ETIMEDOUT;
+}
+
+/*
+ * Cipher, digest and aead requests are mixed on the ctxs of one
+ * wd_crypto_init(), each callback should be called once by its own family.
+ */
+static int sec_crypto_async_test(void)
+{
+	__u32 num = CRYPTO_DEPTH * CRYPTO_FAMILY_NUM;
+	struct crypto_sess sess = {0};
+	struct crypto_job *jobs;
+	long long int sent = 0;
+	__u32 i, cnt;
+	int ret, try;
+
+	ret = init_crypto_ctx_config();
+	if (ret)
+		return ret;
+
+	jobs = calloc(num, sizeof(struct crypto_job));
+	if (!jobs) {
+		ret = -ENOMEM;
+		goto out_config;
+	}
+
+	ret = crypto_sess_alloc(&sess);
+	if (ret)
+		goto out_sess;
+
+	while (sent < g_times) {
+		for (i = 0; i < num; i++) {
+			jobs[i].alg_type = i % CRYPTO_FAMILY_NUM == 0 ? WD_CIPHER :
+					   i % CRYPTO_FAMILY_NUM == 1 ?
+					   WD_DIGEST : WD_AEAD;
+			try = 0;
+			do {
+				ret = crypto_job_send(&sess, &jobs[i]);
+				if (ret == -WD_EBUSY)
+					wd_crypto_poll(num, &cnt);
+			} while (ret == -WD_EBUSY && ++try < CRYPTO_POLL_TIMES);
+			if (ret) {
+				SEC_TST_PRT("Fail to send family %u, ret %d!\n",
+					    jobs[i].alg_type, ret);
+				goto out_sess;
+			}
+		}
+
+		ret = crypto_poll_all(jobs, num);
+		if (ret)
+			goto out_sess;
+
+		for (i = 0; i < num; i++) {
+			ret = crypto_job_check(&jobs[i]);
+			if (ret)
+				goto out_sess;
+		}
+		sent += CRYPTO_DEPTH;
+	}
+
+	SEC_TST_PRT("shared ctxs: %lld requests of each family pass!\n", sent);
+
+out_sess:
+	crypto_sess_free(&sess);
+	free(jobs);
+out_config:
+	crypto_uninit_config();
+	return ret;
+}
+
+/* ---------------BD templates compared with full filled BDs--------------- */
+#define TPL_DATA_LEN	512
+#define TPL_SEED	0x7e57
+
+struct tpl_aead_case {
+	const char *name;
+	enum wd_cipher_mode cmode;
+	enum wd_digest_type dalg;
+	enum wd_digest_mode dmode;
+	struct aead_testvec *tv;
+};
+
+static struct tpl_aead_case tpl_aead_cases[] = {
+	{"ccm(aes)-128", WD_CIPHER_CCM, 0, 0, aes_ccm_tv_template_128},
+	{"gcm(aes)-128", WD_CIPHER_GCM, 0, 0, aes_gcm_tv_template_128},
+	{"gcm(aes)-256", WD_CIPHER_GCM, 0, 0, aes_gcm_tv_template_256},
+	{"hmac(sha256),cbc(aes)", WD_CIPHER_CBC, WD_DIGEST_SHA256,
+	 WD_DIGEST_HMAC, hmac_sha256_aes_cbc_tv_temp},
+};
+
+static int tpl_cipher_do(struct sw_cipher_case *c, bool tpl, int op_type,
+			 const __u8 *in, __u8 *out, __u32 len)
+{
+	struct cipher_testvec *tv = c->tv;
+	struct wd_cipher_sess_setup setup = {0};
+	__u8 iv[AES_BLOCK_SIZE] = {0};
+	struct wd_cipher_req req;
+	handle_t h_sess;
+	int ret;
+
+	setup.alg = c->alg;
+	setup.mode = c->mode;
+	h_sess = wd_cipher_alloc_sess(&setup);
+	if (!h_sess)
+		return -1;
+
+	ret = wd_cipher_set_key(h_sess, (const __u8 *)tv->key, tv->klen);
+	if (!ret)
+		ret = wd_cipher_set_bd_tpl(h_sess, tpl);
+	if (ret)
+		goto out;
+
+	if (tv->iv)
+		memcpy(iv, tv->iv, AES_BLOCK_SIZE);
+
+	memset(&req, 0, sizeof(struct wd_cipher_req));
+	req.op_type = op_type;
+	req.src = (void *)in;
+	req.dst = out;
+	req.in_bytes = len;
+	req.out_bytes = len;
+	req.out_buf_bytes = len;
+	req.iv = iv;
+	req.iv_bytes = AES_BLOCK_SIZE;
+	ret = wd_do_cipher_sync(h_sess, &req);
+	if (!ret && req.state)
+		ret = -1;
+
+out:
+	wd_cipher_free_sess(h_sess);
+	return ret;
+}
+
+/* the output of both ways should be the same, and expected if given */
+static int tpl_cipher_cmp(struct sw_cipher_case *c, int op_type,
+			  const void *in, __u32 len, const void *expect,
+			  __u8 *out)
+{
+	__u8 full[BUFF_SIZE];
+	int ret;
+
+	ret = tpl_cipher_do(c, true, op_type, in, out, len);
+	if (!ret)
+		ret = tpl_cipher_do(c, false, op_type, in, full, len);
+	if (ret || memcmp(out, full, len) ||
+	    (expect && memcmp(out, expect, len)))
+		return -1;
+
+	return 0;
+}
+
+static int tpl_cipher_case(struct sw_cipher_case *c)
+{
+	__u8 data[TPL_DATA_LEN], enc[BUFF_SIZE], dec[BUFF_SIZE];
+	struct cipher_testvec *tv = c->tv;
+	unsigned int seed = TPL_SEED;
+	int i;
+
+	if (tpl_cipher_cmp(c, WD_CIPHER_ENCRYPTION, tv->ptext, tv->len,
+			   tv->ctext, enc) ||
+	    tpl_cipher_cmp(c, WD_CIPHER_DECRYPTION, tv->ctext, tv->len,
+			   tv->ptext, dec))
+		return -1;
+
+	/* longer random data, decrypted back by the other way */
+	for (i = 0; i < TPL_DATA_LEN; i++)
+		data[i] = rand_r(&seed);
+
+	if (tpl_cipher_cmp(c, WD_CIPHER_ENCRYPTION, data, TPL_DATA_LEN, NULL,
+			   enc) ||
+	    tpl_cipher_cmp(c, WD_CIPHER_DECRYPTION, enc, TPL_DATA_LEN, data,
+			   dec))
+		return -1;
+
+	return 0;
+}
+
+static int tpl_aead_do(struct tpl_aead_case *c, bool tpl, int op_type,
+		       __u8 *src, __u32 in_bytes, __u8 *dst)
+{
+	struct aead_testvec *tv = c->tv;
+	__u16 auth_size = tv->clen - tv->plen;
+	struct wd_aead_sess_setup setup = {0};
+	__u8 iv[AES_BLOCK_SIZE] = {0};
+	struct wd_aead_req req;
+	handle_t h_sess;
+	int ret;
+
+	setup.calg = WD_CIPHER_AES;
+	setup.cmode = c->cmode;
+	setup.dalg = c->dalg;
+	setup.dmode = c->dmode;
+	h_sess = wd_aead_alloc_sess(&setup);
+	if (!h_sess)
+		return -1;
+
+	if (c->cmode == WD_CIPHER_CBC) {
+		/* cipher key is the tail of the template key, auth key the mid */
+		ret = wd_aead_set_ckey(h_sess, (__u8 *)tv->key + 0x28, 0x10);
+		if (!ret)
+			ret = wd_aead_set_akey(h_sess, (__u8 *)tv->key + 0x08,
+					       0x20);
+	} else {
+		ret = wd_aead_set_ckey(h_sess, (const __u8 *)tv->key,
+				       tv->klen);
+	}
+	if (!ret)
+		ret = wd_aead_set_authsize(h_sess, auth_size);
+	if (!ret)
+		ret = wd_aead_set_bd_tpl(h_sess, tpl);
+	if (ret)
+		goto out;
+
+	memset(&req, 0, sizeof(struct wd_aead_req));
+	req.op_type = op_type;
+	req.src = src;
+	req.dst = dst;
+	req.assoc_bytes = tv->alen;
+	req.in_bytes = in_bytes;
+	req.out_bytes = tv->alen + in_bytes +
+			(op_type == WD_CIPHER_ENCRYPTION_DIGEST ? auth_size : 0);
+	req.out_buf_bytes = req.out_bytes + auth_size;
+	req.iv_bytes = c->cmode == WD_CIPHER_GCM ? GCM_BLOCK_SIZE :
+						   AES_BLOCK_SIZE;
+	memcpy(iv, tv->iv, req.iv_bytes);
+	req.iv = iv;
+	ret = wd_do_aead_sync(h_sess, &req);
+	if (!ret && req.state)
+		ret = -1;
+
+out:
+	wd_aead_free_sess(h_sess);
+	return ret;
+}
+
+static int tpl_aead_cmp(struct tpl_aead_case *c, int op_type, __u8 *src,
+			__u32 in_bytes, const void *expect, __u8 *out)
+{
+	struct aead_testvec *tv = c->tv;
+	__u32 len = in_bytes + (op_type == WD_CIPHER_ENCRYPTION_DIGEST ?
+				tv->clen - tv->plen : 0);
+	__u8 full[BUFF_SIZE];
+	int ret;
+
+	memset(out, 0, BUFF_SIZE);
+	memset(full, 0, BUFF_SIZE);
+	ret = tpl_aead_do(c, true, op_type, src, in_bytes, out);
+	if (!ret)
+		ret = tpl_aead_do(c, false, op_type, src, in_bytes, full);
+	if (ret || memcmp(out + tv->alen, full + tv->alen, len) ||
+	    (expect && memcmp(out + tv->alen, expect, len)))
+		return -1;
+
+	return 0;
+}
+
+static int tpl_aead_case(struct tpl_aead_case *c)
+{
+	__u8 src[BUFF_SIZE], enc[BUFF_SIZE], dec[BUFF_SIZE];
+	struct aead_testvec *tv = c->tv;
+	unsigned int seed = TPL_SEED;
+	int i;
+
+	memcpy(src, tv->assoc, tv->alen);
+	memcpy(src + tv->alen, tv->ptext, tv->plen);
+	if (tpl_aead_cmp(c, WD_CIPHER_ENCRYPTION_DIGEST, src, tv->plen,
+			 tv->ctext, enc))
+		return -1;
+
+	/* MAC follows the cipher text for decryption */
+	memcpy(src + tv->alen, tv->ctext, tv->clen);
+	if (tpl_aead_cmp(c, WD_CIPHER_DECRYPTION_DIGEST, src, tv->plen,
+			 tv->ptext, dec))
+		return -1;
+
+	for (i = 0; i < TPL_DATA_LEN; i++)
+		src[tv->alen + i] = rand_r(&seed);
+
+	if (tpl_aead_cmp(c, WD_CIPHER_ENCRYPTION_DIGEST, src, TPL_DATA_LEN,
+			 NULL, enc))
+		return -1;
+
+	memcpy(enc, src, tv->alen);
+	if (tpl_aead_cmp(c, WD_CIPHER_DECRYPTION_DIGEST, enc, TPL_DATA_LEN,
+			 src + tv->alen, dec))
+		return -1;
+
+	return 0;
+}
+
+/*
+ * Requests of sessions filling BDs by the template and in full are compared
+ * in both directions, by test vectors and by random data.
+ */
+static int sec_bd_tpl_test(void)
+{
+	int ret, fail = 0;
+	unsigned int i;
+
+	ret = init_ctx_config(CTX_TYPE_ENCRYPT, CTX_MODE_SYNC);
+	if (ret)
+		return ret;
+
+	for (i = 0; i < ARRAY_SIZE(sw_cipher_cases); i++) {
+		ret = tpl_cipher_case(&sw_cipher_cases[i]);
+		SEC_TST_PRT("bd tpl %s: %s\n", sw_cipher_cases[i].name,
+			    ret ? "fail" : "pass");
+		fail += !!ret;
+	}
+	uninit_config();
+
+	ret = init_aead_ctx_config(CTX_TYPE_ENCRYPT, CTX_MODE_SYNC);
+	if (ret)
+		return ret;
+
+	for (i = 0; i < ARRAY_SIZE(tpl_aead_cases); i++) {
+		ret = tpl_aead_case(&tpl_aead_cases[i]);
+		SEC_TST_PRT("bd tpl %s: %s\n", tpl_aead_cases[i].name,
+			    ret ? "fail" : "pass");
+		fail += !!ret;
+	}
+	aead_uninit_config();
+
+	return fail ? -1 : 0;
+}
+
+/* ---------------hw sgl pool used up by SGL requests--------------- */
+#define SGL_POOL_DEPTH		16
+#define SGL_POOL_PKTLEN		4096
+#define SGL_POOL_SGE_NUM	8
+#define SGL_POOL_SEED		0x5e11
+
+struct sgl_pool_job {
+	struct wd_cipher_req req;
+	__u8 iv[AES_BLOCK_SIZE];
+	__u8 *src;
+	__u8 *dst;
+	__u32 inflight;
+	__u32 state;
+	/* output isn't checked yet */
+	bool sent;
+};
+
+struct sgl_pool_thread {
+	pthread_t td;
+	handle_t h_sess;
+	struct sgl_pool_job jobs[SGL_POOL_DEPTH];
+	unsigned long long sent;
+	unsigned long long busy;
+	unsigned long long bad;
+};
+
+static __u32 g_sgl_pool;
+static __u32 g_sgl_pool_pos;
+static int g_sgl_pool_stop;
+static __u8 *g_sgl_pool_plain;
+static __u8 *g_sgl_pool_ref;
+
+/* ctx 0 is sync for the reference, the others are async by turns */
+static __u32 sgl_pool_pick_next_ctx(handle_t h_sched_ctx, const void *req,
+				    const struct sched_key *key)
+{
+	if (key->mode == CTX_MODE_SYNC)
+		return 0;
+
+	return 1 + __atomic_fetch_add(&g_sgl_pool_pos, 1, __ATOMIC_RELAXED) %
+		   (g_ctx_cfg.ctx_num - 1);
+}
+
+static int init_sgl_pool_config(void)
+{
+	struct uacce_dev_list *list;
+	struct wd_sched sched;
+	int ret, i;
+
+	list = wd_get_accel_list("cipher");
+	if (!list) {
+		SEC_TST_PRT("Fail to get cipher device\n");
+		return -ENODEV;
+	}
+
+	memset(&g_ctx_cfg, 0, sizeof(struct wd_ctx_config));
+	g_ctx_cfg.ctx_num = g_ctxnum + 1;
+	g_ctx_cfg.ctxs = calloc(g_ctx_cfg.ctx_num, sizeof(struct wd_ctx));
+	if (!g_ctx_cfg.ctxs) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	for (i = 0; i < g_ctx_cfg.ctx_num; i++) {
+		g_ctx_cfg.ctxs[i].ctx = wd_request_ctx(list->dev);
+		if (!g_ctx_cfg.ctxs[i].ctx) {
+			SEC_TST_PRT("Fail to request ctx!\n");
+			ret = -EINVAL;
+			goto out_ctx;
+		}
+		g_ctx_cfg.ctxs[i].op_type = CTX_TYPE_ENCRYPT;
+		g_ctx_cfg.ctxs[i].ctx_mode = i ? CTX_MODE_ASYNC : CTX_MODE_SYNC;
+		/* a small pool is used up by the requests in flight */
+		ret = wd_ctx_set_sgl_num(g_ctx_cfg.ctxs[i].ctx, g_sgl_pool);
+		if (ret) {
+			SEC_TST_PRT("Fail to set sgl num %u!\n", g_sgl_pool);
+			i++;
+			goto out_ctx;
+		}
+	}
+
+	sched.name = SCHED_SINGLE;
+	sched.pick_next_ctx = sgl_pool_pick_next_ctx;
+	sched.poll_policy = sched_single_poll_policy;
+	ret = wd_cipher_init(&g_ctx_cfg, &sched);
+	if (ret) {
+		SEC_TST_PRT("Fail to cipher ctx!\n");
+		goto out_ctx;
+	}
+
+	wd_free_list_accels(list);
+
+	return 0;
+
+out_ctx:
+	while (i--)
+		wd_release_ctx(g_ctx_cfg.ctxs[i].ctx);
+	free(g_ctx_cfg.ctxs);
+out:
+	wd_free_list_accels(list);
+	return ret;
+}
+
+static void sgl_pool_uninit_config(void)
+{
+	int i;
+
+	wd_cipher_uninit();
+	for (i = 0; i < g_ctx_cfg.ctx_num; i++)
+		wd_release_ctx(g_ctx_cfg.ctxs[i].ctx);
+	free(g_ctx_cfg.ctxs);
+}
+
+static void *sgl_pool_cb(struct wd_cipher_req *req, void *cb_param)
+{
+	struct sgl_pool_job *job = cb_param;
+
+	job->state = req->state;
+	__atomic_store_n(&job->inflight, 0, __ATOMIC_RELEASE);
+
+	return NULL;
+}
+
+static void sgl_pool_check(struct sgl_pool_thread *thr,
+			   struct sgl_pool_job *job)
+{
+	while (__atomic_load_n(&job->inflight, __ATOMIC_ACQUIRE))
+		sched_yield();
+
+	if (job->sent && (job->state ||
+	    memcmp(job->dst, g_sgl_pool_ref, g_pktlen)))
+		thr->bad++;
+	job->sent = false;
+}
+
+static void *sgl_pool_send_thread(void *data)
+{
+	struct sgl_pool_thread *thr = data;
+	struct sgl_pool_job *job;
+	long long int i;
+	int ret;
+
+	for (i = 0; i < g_times; i++) {
+		job = &thr->jobs[i % SGL_POOL_DEPTH];
+		sgl_pool_check(thr, job);
+
+		memset(job->dst, 0, g_pktlen);
+		job->inflight = 1;
+		do {
+			ret = wd_do_cipher_async(thr->h_sess, &job->req);
+			/* sgls of the pool are back when requests are polled */
+			if (ret == -WD_EBUSY) {
+				thr->busy++;
+				sched_yield();
+			}
+		} while (ret == -WD_EBUSY);
+
+		if (ret) {
+			SEC_TST_PRT("Fail to send sgl request, ret %d!\n", ret);
+			job->inflight = 0;
+			thr->bad++;
+			break;
+		}
+		job->sent = true;
+		thr->sent++;
+	}
+
+	for (i = 0; i < SGL_POOL_DEPTH; i++)
+		sgl_pool_check(thr, &thr->jobs[i]);
+
+	return NULL;
+}
+
+static void *sgl_pool_poll_thread(void *data)
+{
+	__u32 cnt, i;
+
+	while (!__atomic_load_n(&g_sgl_pool_stop, __ATOMIC_ACQUIRE)) {
+		for (i = 1; i < g_ctx_cfg.ctx_num; i++)
+			wd_cipher_poll_ctx(i, SGL_POOL_DEPTH, &cnt);
+	}
+
+	return NULL;
+}
+
+static void sgl_pool_job_free(struct sgl_pool_job *job)
+{
+	test_sec_sgl_free(WD_SGL_BUF, job->req.list_src);
+	test_sec_sgl_free(WD_SGL_BUF, job->req.list_dst);
+	free(job->src);
+	free(job->dst);
+}
+
+static int sgl_pool_job_init(struct sgl_pool_job *job, void *cb_param)
+{
+	memset(job, 0, sizeof(struct sgl_pool_job));
+	job->src = malloc(g_pktlen);
+	job->dst = malloc(g_pktlen);
+	if (!job->src || !job->dst)
+		goto out;
+
+	memcpy(job->src, g_sgl_pool_plain, g_pktlen);
+	job->req.list_src = test_sec_buff_create(WD_SGL_BUF, job->src,
+						 g_pktlen);
+	job->req.list_dst = test_sec_buff_create(WD_SGL_BUF, job->dst,
+						 g_pktlen);
+	if (!job->req.list_src || !job->req.list_dst)
+		goto out;
+
+	/* ECB, so that IV isn't changed by requests */
+	job->req.op_type = WD_CIPHER_ENCRYPTION;
+	job->req.in_bytes = g_pktlen;
+	job->req.out_bytes = g_pktlen;
+	job->req.out_buf_bytes = g_pktlen;
+	job->req.iv = job->iv;
+	job->req.iv_bytes = AES_BLOCK_SIZE;
+	job->req.data_fmt = WD_SGL_BUF;
+	job->req.cb = sgl_pool_cb;
+	job->req.cb_param = cb_param;
+
+	return 0;
+
+out:
+	sgl_pool_job_free(job);
+	return -ENOMEM;
+}
+
+static int sgl_pool_ref_init(handle_t h_sess)
+{
+	__u8 iv[AES_BLOCK_SIZE] = {0};
+	unsigned int seed = SGL_POOL_SEED;
+	struct wd_cipher_req req;
+	__u32 i;
+	int ret;
+
+	g_sgl_pool_plain = malloc(g_pktlen);
+	g_sgl_pool_ref = malloc(g_pktlen);
+	if (!g_sgl_pool_plain || !g_sgl_pool_ref)
+		return -ENOMEM;
+
+	for (i = 0; i < g_pktlen; i++)
+		g_sgl_pool_plain[i] = rand_r(&seed);
+
+	/* flat request on the sync ctx, no sgl is used */
+	memset(&req, 0, sizeof(struct wd_cipher_req));
+	req.op_type = WD_CIPHER_ENCRYPTION;
+	req.src = g_sgl_pool_plain;
+	req.dst = g_sgl_pool_ref;
+	req.in_bytes = g_pktlen;
+	req.out_bytes = g_pktlen;
+	req.out_buf_bytes = g_pktlen;
+	req.iv = iv;
+	req.iv_bytes = AES_BLOCK_SIZE;
+	ret = wd_do_cipher_sync(h_sess, &req);
+	if (ret || req.state) {
+		SEC_TST_PRT("Fail to get reference, ret %d!\n", ret);
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+/*
+ * Threads keep SGL_POOL_DEPTH async SGL requests in flight each, more than
+ * the hw sgls of a ctx, so sending is busy until polling puts them back.
+ */
+static int sec_sgl_pool_test(void)
+{
+	struct cipher_testvec *tv = aes_ecb_tv_template_128;
+	unsigned long long sent = 0, busy = 0, bad = 0;
+	struct wd_cipher_sess_setup setup = {0};
+	struct sgl_pool_thread *thrs;
+	pthread_t poll_td;
+	handle_t h_sess;
+	__u32 i, j;
+	int ret;
+
+	if (!g_sgl_num)
+		g_sgl_num = SGL_POOL_SGE_NUM;
+	if (!g_pktlen)
+		g_pktlen = SGL_POOL_PKTLEN;
+	if (g_pktlen % AES_BLOCK_SIZE || g_pktlen < g_sgl_num ||
+	    g_thread_num > THREADS_NUM) {
+		SEC_TST_PRT("invalid pktlen %u or threads %u!\n", g_pktlen,
+			    g_thread_num);
+		return -EINVAL;
+	}
+
+	ret = init_sgl_pool_config();
+	if (ret)
+		return ret;
+
+	thrs = calloc(g_thread_num, sizeof(struct sgl_pool_thread));
+	if (!thrs) {
+		ret = -ENOMEM;
+		goto out_config;
+	}
+
+	setup.alg = WD_CIPHER_AES;
+	setup.mode = WD_CIPHER_ECB;
+	h_sess = wd_cipher_alloc_sess(&setup);
+	if (!h_sess) {
+		ret = -EINVAL;
+		goto out_thrs;
+	}
+
+	ret = wd_cipher_set_key(h_sess, (const __u8 *)tv->key, tv->klen);
+	if (!ret)
+		ret = sgl_pool_ref_init(h_sess);
+	if (ret)
+		goto out_sess;
+
+	for (i = 0; i < g_thread_num; i++) {
+		thrs[i].h_sess = h_sess;
+		for (j = 0; j < SGL_POOL_DEPTH; j++) {
+			ret = sgl_pool_job_init(&thrs[i].jobs[j],
+						&thrs[i].jobs[j]);
+			if (ret)
+				goto out_jobs;
+		}
+	}
+
+	g_sgl_pool_stop = 0;
+	ret = pthread_create(&poll_td, NULL, sgl_pool_poll_thread, NULL);
+	if (ret)
+		goto out_jobs;
+
+	for (i = 0; i < g_thread_num; i++) {
+		ret = pthread_create(&thrs[i].td, NULL, sgl_pool_send_thread,
+				     &thrs[i]);
+		if (ret)
+			break;
+	}
+
+	for (j = 0; j < i; j++) {
+		pthread_join(thrs[j].td, NULL);
+		sent += thrs[j].sent;
+		busy += thrs[j].busy;
+		bad += thrs[j].bad;
+	}
+	__atomic_store_n(&g_sgl_pool_stop, 1, __ATOMIC_RELEASE);
+	pthread_join(poll_td, NULL);
+
+	SEC_TST_PRT("sgl pool %u: %llu requests, %llu busy, %llu bad\n",
+		    g_sgl_pool, sent, busy, bad);
+	if (!busy)
+		SEC_TST_PRT("sgl pool isn't used up, more threads or a smaller pool is needed\n");
+	if (ret || bad || sent != (unsigned long long)g_times * g_thread_num)
+		ret = -1;
+
+out_jobs:
+	for (i = 0; i < g_thread_num; i++)
+		for (j = 0; j < SGL_POOL_DEPTH; j++)
+			sgl_pool_job_free(&thrs[i].jobs[j]);
+out_sess:
+	free(g_sgl_pool_plain);
+	free(g_sgl_pool_ref);
+	wd_cipher_free_sess(h_sess);
+out_thrs:
+	free(thrs);
+out_config:
+	sgl_pool_uninit_config();
+	return ret;
+}
+
+/* ---------------large sync cipher split across ctxs--------------- */
+#define SPLIT_SEED	0x5b17
+
+struct split_case {
+	const char *name;
+	enum wd_cipher_mode mode;
+	int op_type;
+};
+
+static struct split_case split_cases[] = {
+	{"ecb(aes) enc", WD_CIPHER_ECB, WD_CIPHER_ENCRYPTION},
+	{"ecb(aes) dec", WD_CIPHER_ECB, WD_CIPHER_DECRYPTION},
+	{"ctr(aes) enc", WD_CIPHER_CTR, WD_CIPHER_ENCRYPTION},
+	{"ctr(aes) dec", WD_CIPHER_CTR, WD_CIPHER_DECRYPTION},
+	{"cbc(aes) dec", WD_CIPHER_CBC, WD_CIPHER_DECRYPTION},
+};
+
+/* a few segments, and longer than the 0xFFFE00 limit of one BD */
+static __u32 split_lens[] = {
+	5 * 1024 * 1024 + 3 * AES_BLOCK_SIZE,
+	20 * 1024 * 1024 + AES_BLOCK_SIZE,
+};
+
+static const __u8 split_key[AES_KEYSIZE_128] = {
+	0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6,
+	0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c,
+};
+
+/* the low bytes of the counter carry within the data */
+static const __u8 split_iv[AES_BLOCK_SIZE] = {
+	0xf0, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7,
+	0xf8, 0xf9, 0xfa, 0xfb, 0xfc, 0xff, 0xff, 0xf0,
+};
+
+static int split_do(struct split_case *c, bool cpu, __u8 *src, __u8 *dst,
+		    __u32 len, __u8 *iv)
+{
+	struct wd_cipher_sess_setup setup = {0};
+	struct wd_cipher_req req;
+	handle_t h_sess;
+	int ret;
+
+	setup.alg = WD_CIPHER_AES;
+	setup.mode = c->mode;
+	h_sess = wd_cipher_alloc_sess(&setup);
+	if (!h_sess)
+		return -1;
+
+	ret = wd_cipher_set_key(h_sess, split_key, sizeof(split_key));
+	if (!ret && cpu)
+		ret = wd_cipher_set_sw_thresh(h_sess, ~0U);
+	if (ret)
+		goto out;
+
+	memset(&req, 0, sizeof(struct wd_cipher_req));
+	req.op_type = c->op_type;
+	req.src = src;
+	req.dst = dst;
+	req.in_bytes = len;
+	req.out_bytes = len;
+	req.out_buf_bytes = len;
+	req.iv = iv;
+	req.iv_bytes = AES_BLOCK_SIZE;
+	ret = wd_do_cipher_sync(h_sess, &req);
+	if (!ret && req.state)
+		ret = -1;
+
+out:
+	wd_cipher_free_sess(h_sess);
+	return ret;
+}
+
+/*
+ * Requests over 1MB of ECB, CTR and CBC decryption are split across the
+ * sync ctxs, output and IV are compared with the ones of the CPU engine.
+ */
+static int sec_split_test(void)
+{
+	__u8 iv[AES_BLOCK_SIZE], ref_iv[AES_BLOCK_SIZE];
+	__u32 max = split_lens[ARRAY_SIZE(split_lens) - 1];
+	unsigned int seed = SPLIT_SEED;
+	__u8 *src, *dst, *ref;
+	unsigned int i, j;
+	int ret, fail = 0;
+
+	ret = init_ctx_config(CTX_TYPE_ENCRYPT, CTX_MODE_SYNC);
+	if (ret)
+		return ret;
+
+	src = malloc(max);
+	dst = malloc(max);
+	ref = malloc(max);
+	if (!src || !dst || !ref) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	for (i = 0; i < max; i++)
+		src[i] = rand_r(&seed);
+
+	for (i = 0; i < ARRAY_SIZE(split_lens); i++) {
+		for (j = 0; j < ARRAY_SIZE(split_cases); j++) {
+			memcpy(ref_iv, split_iv, AES_BLOCK_SIZE);
+			memcpy(iv, split_iv, AES_BLOCK_SIZE);
+			memset(dst, 0, split_lens[i]);
+			ret = split_do(&split_cases[j], true, src, ref,
+				       split_lens[i], ref_iv);
+			if (!ret)
+				ret = split_do(&split_cases[j], false, src, dst,
+					       split_lens[i], iv);
+			if (!ret && (memcmp(dst, ref, split_lens[i]) ||
+			    memcmp(iv, ref_iv, AES_BLOCK_SIZE)))
+				ret = -1;
+			SEC_TST_PRT("split %s %u bytes on %u ctxs: %s\n",
+				    split_cases[j].name, split_lens[i],
+				    g_ctxnum, ret ? "fail" : "pass");
+			fail += !!ret;
+		}
+	}
+	ret = fail ? -1 : 0;
+
+out:
+	free(src);
+	free(dst);
+	free(ref);
+	uninit_config();
+	return ret;
+}
+
+static void print_help(void)
+{
+	SEC_TST_PRT("NAME\n");
+	SEC_TST_PRT("    test_hisi_sec: test wd sec function,etc\n");
+	SEC_TST_PRT("USAGE\n");
+	SEC_TST_PRT("    test_hisi_sec [--cipher] [--digest] [--aead] [--perf]\n");
+	SEC_TST_PRT("    test_hisi_sec [--optype] [--pktlen] [--keylen] [--times]\n");
+	SEC_TST_PRT("    test_hisi_sec [--multi] [--sync] [--async] [--help]\n");
+	SEC_TST_PRT("    test_hisi_sec [--block] [--blknum] [--ctxnum]\n");
+	SEC_TST_PRT("    numactl --cpubind=0  --membind=0,1 ./test_hisi_sec xxxx\n");
+	SEC_TST_PRT("        specify numa nodes for cpu and memory\n");
+	SEC_TST_PRT("DESCRIPTION\n");
+	SEC_TST_PRT("    [--cipher ]:\n");
+	SEC_TST_PRT("        specify symmetric cipher algorithm\n");
+	SEC_TST_PRT("        0 : AES-ECB; 1 : AES-CBC;  2 : AES-XTS;  3 : AES-OFB\n");
+	SEC_TST_PRT("        4 : AES-CFB; 5 : 3DES-ECB; 6 : 3DES-CBC; 7 : SM4-CBC\n");
+	SEC_TST_PRT("        8 : SM4-XTS; 9 : SM4-OFB; 10 : SM4-CFB;\n");
+	SEC_TST_PRT("    [--digest ]:\n");
+	SEC_TST_PRT("        specify symmetric hash algorithm\n");
+	SEC_TST_PRT("        0 : SM3;    1 : MD5;    2 : SHA1;   3 : SHA256\n");
+	SEC_TST_PRT("        4 : SHA224; 5 : SHA384; 6 : SHA512; 7 : SHA512_224\n");
+	SEC_TST_PRT("        8 : SHA512_256\n");
+	SEC_TST_PRT("    [--aead ]:\n");
+	SEC_TST_PRT("        specify symmetric aead algorithm\n");
+	SEC_TST_PRT("        0 : AES-CCM; 1 : AES-GCM;  2 : Hmac(sha256),cbc(aes)\n");
+	SEC_TST_PRT("    [--sync]: start synchronous mode test\n");
+	SEC_TST_PRT("    [--async]: start asynchronous mode test\n");
+	SEC_TST_PRT("    [--optype]:\n");
+	SEC_TST_PRT("        0 : encryption operation or normal mode for hash\n");
+	SEC_TST_PRT("        1 : decryption operation or hmac mode for hash\n");
+	SEC_TST_PRT("        3 : long hash mode for hash\n");
+	SEC_TST_PRT("        4 : stream of long hash by pktlen parts for hash\n");
+	SEC_TST_PRT("        5 : batch of small hash compared with single ones\n");
+	SEC_TST_PRT("            or batch of gcm(aes) records for aead\n");
+	SEC_TST_PRT("    [--pktlen]:\n");
+	SEC_TST_PRT("        set the length of BD message in bytes\n");
+	SEC_TST_PRT("    [--keylen]:\n");
+	SEC_TST_PRT("        set the key length in bytes\n");
+	SEC_TST_PRT("    [--times]:\n");
+	SEC_TST_PRT("        set the number of sent messages\n");
+	SEC_TST_PRT("    [--multi]:\n");
+	SEC_TST_PRT("        set the number of threads\n");
+	SEC_TST_PRT("    [--block]:\n");
+	SEC_TST_PRT("        set the memory size allocated for each BD message\n");
+	SEC_TST_PRT("    [--blknum]:\n");
+	SEC_TST_PRT("        the number of memory blocks in the pre-allocated BD message memory pool\n");
+	SEC_TST_PRT("    [--ctxnum]:\n");
+	SEC_TST_PRT("        the number of QP queues used by the entire test task\n");
+	SEC_TST_PRT("    [--cpu]:\n");
+	SEC_TST_PRT("        check the CPU engine by test vectors\n");
+	SEC_TST_PRT("    [--crypto]:\n");
+	SEC_TST_PRT("        mix async cipher, digest and aead on one shared ctx set\n");
+	SEC_TST_PRT("    [--tpl]:\n");
+	SEC_TST_PRT("        compare BDs filled by template and in full for cipher and aead\n");
+	SEC_TST_PRT("    [--sglpool]:\n");
+	SEC_TST_PRT("        set hw sgls of each ctx and use them up by async sgl cipher of --multi threads\n");
+	SEC_TST_PRT("    [--split]:\n");
+	SEC_TST_PRT("        split large sync cipher across --ctxnum ctxs, compared with the CPU engine\n");
+	SEC_TST_PRT("    [--help]  = usage\n");
+	SEC_TST_PRT("Example\n");
+	SEC_TST_PRT("    ./test_hisi_sec --cipher 0 --sync --optype 0 \n");
+	SEC_TST_PRT("    	     --pktlen 16 --keylen 16 --times 1 --multi 1\n");
+	SEC_TST_PRT("    ./test_hisi_sec --perf --sync --pktlen 1024 --block 1024 \n");
+	SEC_TST_PRT("    	     --blknum 100000 --times 10000 --multi 1 --ctxnum 1\n");
+	SEC_TST_PRT("UPDATE:2020-11-06\n");
+}
+
+static void test_sec_cmd_parse(int argc, char *argv[], struct test_sec_option *option)
+{
+	int option_index = 0;
+	int c;
+
+	static struct option long_options[] = {
+		{"cipher",    required_argument, 0,  1},
+		{"digest",    required_argument, 0,  2},
+		{"aead",      required_argument, 0,  3},
+		{"perf",      no_argument,       0,  4},
 		{"optype",    required_argument, 0,  5},
 		{"pktlen",    required_argument, 0,  6},
 		{"keylen",    required_argument, 0,  7},
@@ -3480,6 +5105,11 @@ static void test_sec_cmd_parse(int argc, char *argv[], struct test_sec_option *o
 		{"blknum",    required_argument, 0,  14},
 		{"help",      no_argument,       0,  15},
 		{"sglnum",    required_argument, 0,  16},
+		{"cpu",       no_argument,       0,  17},
+		{"crypto",    no_argument,       0,  18},
+		{"tpl",       no_argument,       0,  19},
+		{"sglpool",   required_argument, 0,  20},
+		{"split",     no_argument,       0,  21},
 		{0, 0, 0, 0}
 	};
 
@@ -3540,6 +5170,21 @@ static void test_sec_cmd_parse(int argc, char *argv[], struct test_sec_option *o
 		case 16:
 			option->sgl_num = strtol(optarg, NULL, 0);
 			break;
+		case 17:
+			option->cpu = 1;
+			break;
+		case 18:
+			option->crypto = 1;
+			break;
+		case 19:
+			option->tpl = 1;
+			break;
+		case 20:
+			option->sglpool = strtol(optarg, NULL, 0);
+			break;
+		case 21:
+			option->split = 1;
+			break;
 		default:
 			SEC_TST_PRT("bad input parameter, exit\n");
 			print_help();
@@ -3593,12 +5238,26 @@ static int test_sec_option_convert(struct test_sec_option *option)
 	g_thread_num = option->xmulti ? option->xmulti : 1;
 	g_direction = option->optype;
 	if (option->algclass == DIGEST_CLASS) {
-		//0 is normal mode, 1 is HMAC mode, 3 is long hash mode.
+		/*
+		 * 0 is normal mode, 1 is HMAC mode, 3 is long hash mode,
+		 * 4 is stream mode, 5 is batch mode.
+		 */
 		g_alg_op_type = g_direction;
 		if (g_direction == 3) {
 			g_alg_op_type = 0;
 			g_ivlen = 1;
+		} else if (g_direction == 4) {
+			g_alg_op_type = 0;
+			g_ivlen = 1;
+			g_digest_strm = 1;
+		} else if (g_direction == 5) {
+			g_alg_op_type = 0;
+			g_digest_batch = 1;
 		}
+	} else if (option->algclass == AEAD_CLASS && g_direction == 5) {
+		/* 5 is batch mode of TLS records */
+		g_direction = 0;
+		g_aead_batch = 1;
 	}
 
 	return 0;
@@ -3633,6 +5292,12 @@ static int test_sec_run(__u32 sync_mode, __u32 alg_class)
 			if (g_thread_num > 1) {
 				SEC_TST_PRT("currently digest test is synchronize multi -%d threads!\n", g_thread_num);
 				ret = sec_digest_sync_multi();
+			} else if (g_digest_strm) {
+				ret = sec_digest_strm_once();
+				SEC_TST_PRT("currently digest test is synchronize stream, one thread!\n");
+			} else if (g_digest_batch) {
+				ret = sec_digest_batch_once();
+				SEC_TST_PRT("currently digest test is synchronize batch, one thread!\n");
 			} else {
 				ret = sec_digest_sync_once();
 				SEC_TST_PRT("currently digest test is synchronize once, one thread!\n");
@@ -3641,6 +5306,9 @@ static int test_sec_run(__u32 sync_mode, __u32 alg_class)
 			if (g_thread_num > 1) {
 				SEC_TST_PRT("currently aead test is synchronize multi -%d threads!\n", g_thread_num);
 				ret = sec_aead_sync_multi();
+			} else if (g_aead_batch) {
+				ret = sec_aead_rec_batch_once();
+				SEC_TST_PRT("currently aead test is synchronize batch, one thread!\n");
 			} else {
 				ret = sec_aead_sync_once();
 				SEC_TST_PRT("currently aead test is synchronize once, one thread!\n");
@@ -3690,11 +5358,24 @@ int main(int argc, char *argv[])
 	}
 
 	test_sec_cmd_parse(argc, argv, &option);
+	if (option.cpu)
+		return sec_sw_vec_test();
+
 	ret = test_sec_option_convert(&option);
 	if (ret)
 		return ret;
 	if (option.algclass == PERF_CLASS)
 		return sec_sva_test();
+	if (option.crypto)
+		return sec_crypto_async_test();
+	if (option.tpl)
+		return sec_bd_tpl_test();
+	if (option.sglpool) {
+		g_sgl_pool = option.sglpool;
+		return sec_sgl_pool_test();
+	}
+	if (option.split)
+		return sec_split_test();
 
 	pthread_mutex_init(&test_sec_mutex, NULL);
 
@@ -214,7 +214,7 @@ void *zip_sys_async_test_thread(void *args)
 	int i = pdata->iteration;
 	int loop;
 	handle_t h_sess;
-	struct wd_comp_sess_setup setup;
+	struct wd_comp_sess_setup setup = {0};
 	struct wd_comp_req req;
 	__u32 count = 0;
 	int ret = 0;
@@ -256,6 +256,7 @@ therad_no_affinity:
 	req.dst = pdata->dst;
 	req.dst_len = pdata->dst_len;
 	req.op_type = pdata->op_type;
+	req.data_fmt = WD_FLAT_BUF;
 	req.cb = (void *)zip_callback;
 	req.cb_param = &u_param;
 
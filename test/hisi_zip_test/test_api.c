@@ -0,0 +1,734 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+ * Check the request interfaces of libwd_comp beyond a plain pair of flat
+ * buffers. Every check compresses the test data and decompresses it back
+ * by the interface, and compares the output with the data.
+ *
+ * $ zip_api_check
+ * $ zip_api_check -z -o sgl -q 2
+ */
+#include <string.h>
+
+#include "sched_sample.h"
+#include "test_lib.h"
+
+#define ARRAY_SIZE(x)		(sizeof(x) / sizeof((x)[0]))
+#define SCHED_RR_NAME		"sched_rr"
+#define CHECK_LEN_DEF		(1024 * 1024)
+#define CHECK_WORD_NUM		16
+
+/* sgl entries are cut at random lengths, the first one of dst holds a head */
+#define SGL_ENTRY_NUM		16
+#define SGL_HEAD_ROOM		64
+
+/* small output pieces, so the output grows many times */
+#define GROW_PIECE_SIZE		4096
+
+struct check_env {
+	struct test_options *opts;
+	handle_t h_comp;
+	handle_t h_decomp;
+	char *data;
+	__u32 len;
+};
+
+/* pages of a batch, a page handle is used for many batches */
+#define PAGE_SIZE_DEF		4096
+#define PAGE_BATCH_NUM		64
+
+/* chunks of one stream through a small window, so it's often full */
+#define SEQ_CHUNK_SIZE		(16 * 1024)
+#define SEQ_WINDOW		16
+#define SEQ_POLL_TIMES		1000000
+
+struct seq_chunk {
+	__u64 id;
+	__u32 dst_len;
+	__u32 status;
+};
+
+struct seq_out {
+	struct seq_chunk *chunks;
+	__u64 next;
+	__u32 bad;
+};
+
+struct grow_out {
+	char *buf;
+	__u32 size;
+	__u32 len;
+	__u32 calls;
+};
+
+struct api_check {
+	const char *name;
+	int (*check)(struct check_env *env);
+};
+
+/* words of a few letters, so the data is compressible as text */
+static void gen_data(char *buf, __u32 len)
+{
+	unsigned int seed = 1;
+	__u32 i, n;
+
+	for (i = 0; i < len; i++) {
+		n = rand_r(&seed) % CHECK_WORD_NUM;
+		buf[i] = n ? 'a' + n : ' ';
+	}
+}
+
+static handle_t alloc_sess(struct test_options *opts, int op_type, int mode)
+{
+	struct wd_comp_sess_setup setup = {0};
+
+	setup.alg_type = opts->alg_type;
+	setup.op_type = op_type;
+	setup.mode = mode;
+	setup.comp_lv = opts->comp_lv;
+	setup.win_sz = WD_COMP_WS_32K;
+
+	return wd_comp_alloc_sess(&setup);
+}
+
+/*
+ * q_num ctxs for each of sync and async, compression and decompression.
+ * Unlike init_ctx_config(), every ctx is set with the mode and op type of
+ * its region, since the checks use all of them.
+ */
+static int init_check_config(struct test_options *opts,
+			     struct uacce_dev_list *list,
+			     struct wd_ctx_config *conf,
+			     struct wd_sched **sched)
+{
+	int q_num = opts->q_num;
+	int i, mode, type, ret;
+
+	*sched = sample_sched_alloc(SCHED_POLICY_RR, 2, 2, lib_poll_func);
+	if (!*sched) {
+		WD_ERR("failed to alloc sched!\n");
+		return -ENOMEM;
+	}
+	(*sched)->name = SCHED_RR_NAME;
+
+	conf->ctx_num = q_num * 4;
+	conf->ctxs = calloc(conf->ctx_num, sizeof(struct wd_ctx));
+	if (!conf->ctxs) {
+		ret = -ENOMEM;
+		goto out_sched;
+	}
+
+	for (i = 0; i < conf->ctx_num; i++) {
+		mode = i / (q_num * 2);
+		type = i / q_num % 2;
+		if (!(i % q_num)) {
+			ret = sample_sched_fill_data(*sched, 0, mode, type, i,
+						     i + q_num - 1);
+			if (ret < 0) {
+				WD_ERR("failed to fill sched region!\n");
+				goto out_ctx;
+			}
+		}
+
+		conf->ctxs[i].ctx = wd_request_ctx(list->dev);
+		if (!conf->ctxs[i].ctx) {
+			WD_ERR("failed to request ctx %d!\n", i);
+			ret = -EINVAL;
+			goto out_ctx;
+		}
+		conf->ctxs[i].op_type = type;
+		conf->ctxs[i].ctx_mode = mode;
+	}
+
+	ret = wd_comp_init(conf, *sched);
+	if (!ret)
+		return 0;
+
+out_ctx:
+	for (i = 0; i < conf->ctx_num; i++)
+		if (conf->ctxs[i].ctx)
+			wd_release_ctx(conf->ctxs[i].ctx);
+	free(conf->ctxs);
+out_sched:
+	sample_sched_release(*sched);
+	return ret;
+}
+
+static void uninit_check_config(struct wd_ctx_config *conf,
+				struct wd_sched *sched)
+{
+	int i;
+
+	wd_comp_uninit();
+	for (i = 0; i < conf->ctx_num; i++)
+		wd_release_ctx(conf->ctxs[i].ctx);
+	free(conf->ctxs);
+	sample_sched_release(sched);
+}
+
+/* cut buf into a list of num entries at random lengths, the first >= min */
+static struct wd_datalist *make_sgl(char *buf, __u32 len, __u32 num,
+				    __u32 min, unsigned int *seed)
+{
+	struct wd_datalist *list;
+	__u32 i, off = 0, n;
+
+	list = calloc(num, sizeof(struct wd_datalist));
+	if (!list)
+		return NULL;
+
+	for (i = 0; i < num; i++) {
+		if (i == num - 1)
+			n = len - off;
+		else
+			n = rand_r(seed) % (2 * len / num + 1);
+		if (!i && n < min)
+			n = min;
+		if (n > len - off)
+			n = len - off;
+
+		list[i].data = buf + off;
+		list[i].len = n;
+		list[i].next = i < num - 1 ? &list[i + 1] : NULL;
+		off += n;
+	}
+
+	return list;
+}
+
+static int do_sgl(handle_t h_sess, int op_type, char *src, __u32 src_len,
+		  char *dst, __u32 *dst_len, unsigned int *seed)
+{
+	struct wd_datalist *list_src, *list_dst;
+	struct wd_comp_req req = {0};
+	int ret = -ENOMEM;
+
+	list_src = make_sgl(src, src_len, SGL_ENTRY_NUM, 0, seed);
+	list_dst = make_sgl(dst, *dst_len, SGL_ENTRY_NUM, SGL_HEAD_ROOM,
+			    seed);
+	if (!list_src || !list_dst)
+		goto out;
+
+	req.op_type = op_type;
+	req.data_fmt = WD_SGL_BUF;
+	req.list_src = list_src;
+	req.src_len = src_len;
+	req.list_dst = list_dst;
+	req.dst_len = *dst_len;
+	ret = wd_do_comp_sync(h_sess, &req);
+	if (!ret && (req.status == WD_IN_EPARA || req.src_len != src_len))
+		ret = -EIO;
+	*dst_len = req.dst_len;
+
+out:
+	free(list_src);
+	free(list_dst);
+	return ret;
+}
+
+/* compress and decompress by sgls, output is checked by flat requests too */
+static int check_sgl(struct check_env *env)
+{
+	__u32 out_len = env->len * EXPANSION_RATIO, back_len = env->len;
+	struct wd_comp_req req = {0};
+	char *out, *back;
+	unsigned int seed = 1;
+	int ret = -ENOMEM;
+
+	out = malloc(out_len);
+	back = malloc(back_len);
+	if (!out || !back)
+		goto out_free;
+
+	ret = do_sgl(env->h_comp, WD_DIR_COMPRESS, env->data, env->len, out,
+		     &out_len, &seed);
+	if (ret) {
+		WD_ERR("failed to compress sgl(%d)!\n", ret);
+		goto out_free;
+	}
+
+	req.op_type = WD_DIR_DECOMPRESS;
+	req.src = out;
+	req.src_len = out_len;
+	req.dst = back;
+	req.dst_len = back_len;
+	ret = wd_do_comp_sync(env->h_decomp, &req);
+	if (ret || req.status != WD_STREAM_END || req.dst_len != env->len ||
+	    memcmp(back, env->data, env->len)) {
+		WD_ERR("failed to decompress the output of sgl!\n");
+		ret = ret ? ret : -EIO;
+		goto out_free;
+	}
+
+	memset(back, 0, back_len);
+	ret = do_sgl(env->h_decomp, WD_DIR_DECOMPRESS, out, out_len, back,
+		     &back_len, &seed);
+	if (ret || back_len != env->len || memcmp(back, env->data, env->len)) {
+		WD_ERR("failed to decompress sgl(%d)!\n", ret);
+		ret = ret ? ret : -EIO;
+	}
+
+out_free:
+	free(out);
+	free(back);
+	return ret;
+}
+
+/* compress data into a flat buffer big enough, for the checks of output */
+static int compress_flat(struct check_env *env, char *out, __u32 *out_len)
+{
+	struct wd_comp_req req = {0};
+	int ret;
+
+	req.op_type = WD_DIR_COMPRESS;
+	req.src = env->data;
+	req.src_len = env->len;
+	req.dst = out;
+	req.dst_len = *out_len;
+	ret = wd_do_comp_sync(env->h_comp, &req);
+	if (ret || req.status == WD_IN_EPARA) {
+		WD_ERR("failed to compress data(%d)!\n", ret);
+		return ret ? ret : -EIO;
+	}
+	*out_len = req.dst_len;
+
+	return 0;
+}
+
+static int grow_sink(void *data, __u32 len, void *param)
+{
+	struct grow_out *out = param;
+
+	if (len > out->size - out->len)
+		return -ENOSPC;
+
+	memcpy(out->buf + out->len, data, len);
+	out->len += len;
+	out->calls++;
+
+	return 0;
+}
+
+static struct wd_datalist *grow_alloc(void *param)
+{
+	struct wd_datalist *node;
+
+	node = malloc(sizeof(struct wd_datalist) + GROW_PIECE_SIZE);
+	if (!node)
+		return NULL;
+
+	node->data = node + 1;
+	node->len = GROW_PIECE_SIZE;
+	node->next = NULL;
+	((struct grow_out *)param)->calls++;
+
+	return node;
+}
+
+static int grow_chain(struct check_env *env, char *in, __u32 in_len,
+		      struct grow_out *out)
+{
+	struct wd_datalist *list, *node;
+	struct wd_comp_req req = {0};
+	int ret;
+
+	req.op_type = WD_DIR_DECOMPRESS;
+	req.src = in;
+	req.src_len = in_len;
+	ret = wd_do_comp_sync_chain(env->h_decomp, &req, grow_alloc, out,
+				    &list);
+	while (list) {
+		node = list;
+		list = list->next;
+		if (!ret && out->len + node->len <= out->size) {
+			memcpy(out->buf + out->len, node->data, node->len);
+			out->len += node->len;
+		}
+		free(node);
+	}
+	if (!ret && req.status != WD_STREAM_END)
+		ret = -EIO;
+
+	return ret;
+}
+
+/*
+ * Decompress into a staging buffer much smaller than the output by a sink,
+ * and into a chain of small buffers.
+ */
+static int check_grow(struct check_env *env)
+{
+	__u32 in_len = env->len * EXPANSION_RATIO;
+	struct wd_comp_req req = {0};
+	char stage[GROW_PIECE_SIZE];
+	struct grow_out out = {0};
+	char *in;
+	int ret = -ENOMEM;
+
+	in = malloc(in_len);
+	out.buf = malloc(env->len);
+	if (!in || !out.buf)
+		goto out_free;
+	out.size = env->len;
+
+	ret = compress_flat(env, in, &in_len);
+	if (ret)
+		goto out_free;
+
+	req.op_type = WD_DIR_DECOMPRESS;
+	req.src = in;
+	req.src_len = in_len;
+	req.dst = stage;
+	req.dst_len = sizeof(stage);
+	ret = wd_do_comp_sync_sink(env->h_decomp, &req, grow_sink, &out);
+	if (ret || req.status != WD_STREAM_END || out.len != env->len ||
+	    memcmp(out.buf, env->data, env->len)) {
+		WD_ERR("failed to decompress by sink(%d)!\n", ret);
+		ret = ret ? ret : -EIO;
+		goto out_free;
+	}
+	printf("sink: %u pieces of %u bytes\n", out.calls, env->len);
+
+	memset(out.buf, 0, out.size);
+	out.len = 0;
+	out.calls = 0;
+	ret = grow_chain(env, in, in_len, &out);
+	if (ret || out.len != env->len ||
+	    memcmp(out.buf, env->data, env->len)) {
+		WD_ERR("failed to decompress by chain(%d)!\n", ret);
+		ret = ret ? ret : -EIO;
+		goto out_free;
+	}
+	printf("chain: %u buffers of %u bytes\n", out.calls, env->len);
+
+out_free:
+	free(in);
+	free(out.buf);
+	return ret;
+}
+
+static int page_batch(handle_t h_sess, struct wd_comp_page *pages,
+		      __u32 num)
+{
+	handle_t h_page;
+	__u32 i, n;
+	int ret = 0;
+
+	h_page = wd_comp_page_alloc(h_sess, PAGE_SIZE_DEF);
+	if (!h_page)
+		return -EINVAL;
+
+	for (i = 0; i < num && !ret; i += n) {
+		n = num - i < PAGE_BATCH_NUM ? num - i : PAGE_BATCH_NUM;
+		ret = wd_do_comp_page_batch(h_page, pages + i, n);
+	}
+	wd_comp_page_free(h_page);
+
+	return ret;
+}
+
+/* compress the data page by page, and decompress every page back */
+static int check_page(struct check_env *env)
+{
+	__u32 num = env->len / PAGE_SIZE_DEF, bound, i;
+	struct wd_comp_page *pages;
+	char *out, *back;
+	int ret = -ENOMEM;
+
+	if (!num) {
+		WD_ERR("data is shorter than a page!\n");
+		return -EINVAL;
+	}
+
+	bound = PAGE_SIZE_DEF * EXPANSION_RATIO;
+	pages = calloc(num, sizeof(struct wd_comp_page));
+	out = malloc((size_t)num * bound);
+	back = malloc((size_t)num * PAGE_SIZE_DEF);
+	if (!pages || !out || !back)
+		goto out_free;
+
+	for (i = 0; i < num; i++) {
+		pages[i].src = env->data + i * PAGE_SIZE_DEF;
+		pages[i].dst = out + i * bound;
+		pages[i].dst_len = bound;
+	}
+	ret = page_batch(env->h_comp, pages, num);
+	if (ret) {
+		WD_ERR("failed to compress pages(%d)!\n", ret);
+		goto out_free;
+	}
+
+	for (i = 0; i < num; i++) {
+		if (pages[i].status == WD_IN_EPARA) {
+			WD_ERR("failed to compress page %u!\n", i);
+			ret = -EIO;
+			goto out_free;
+		}
+		pages[i].src = out + i * bound;
+		pages[i].src_len = pages[i].dst_len;
+		pages[i].dst = back + i * PAGE_SIZE_DEF;
+		pages[i].dst_len = PAGE_SIZE_DEF;
+	}
+	ret = page_batch(env->h_decomp, pages, num);
+	if (ret) {
+		WD_ERR("failed to decompress pages(%d)!\n", ret);
+		goto out_free;
+	}
+
+	for (i = 0; i < num; i++) {
+		if (pages[i].status != WD_STREAM_END ||
+		    pages[i].dst_len != PAGE_SIZE_DEF ||
+		    memcmp(pages[i].dst, env->data + i * PAGE_SIZE_DEF,
+			   PAGE_SIZE_DEF)) {
+			WD_ERR("failed to decompress page %u!\n", i);
+			ret = -EIO;
+			break;
+		}
+	}
+
+out_free:
+	free(pages);
+	free(out);
+	free(back);
+	return ret;
+}
+
+/*
+ * It must see chunks in the order they are submitted. Ids of failed sends
+ * are skipped, so they only grow, and each one is what the submit returned.
+ */
+static void seq_sink(struct wd_comp_req *req, __u64 id, void *sink_param)
+{
+	struct seq_out *out = sink_param;
+	struct seq_chunk *chunk = &out->chunks[out->next];
+
+	if (req->cb_param != chunk || id != chunk->id ||
+	    (out->next && id <= chunk[-1].id)) {
+		out->bad++;
+		return;
+	}
+
+	chunk->dst_len = req->dst_len;
+	chunk->status = req->status;
+	out->next++;
+}
+
+static int seq_compress(struct check_env *env, struct seq_out *out,
+			char *dst, __u32 bound, __u32 num)
+{
+	struct wd_comp_seq_setup setup = {0};
+	struct wd_comp_req req = {0};
+	__u32 i, count, times = 0;
+	handle_t h_sess, h_seq;
+	int ret = 0;
+
+	h_sess = alloc_sess(env->opts, WD_DIR_COMPRESS, CTX_MODE_ASYNC);
+	if (!h_sess)
+		return -EINVAL;
+
+	setup.window = SEQ_WINDOW;
+	setup.sink = seq_sink;
+	setup.sink_param = out;
+	h_seq = wd_comp_seq_alloc(h_sess, &setup);
+	if (!h_seq) {
+		ret = -EINVAL;
+		goto out_sess;
+	}
+
+	req.op_type = WD_DIR_COMPRESS;
+	for (i = 0; i < num && !ret; i++) {
+		req.src = env->data + i * SEQ_CHUNK_SIZE;
+		req.src_len = env->len - i * SEQ_CHUNK_SIZE;
+		if (req.src_len > SEQ_CHUNK_SIZE)
+			req.src_len = SEQ_CHUNK_SIZE;
+		req.dst = dst + i * bound;
+		req.dst_len = bound;
+		req.cb_param = &out->chunks[i];
+		/* the id is stored before sending, the sink may run at once */
+		do {
+			ret = wd_do_comp_seq_async(h_seq, &req,
+						   &out->chunks[i].id);
+			if (ret == -WD_EBUSY) {
+				count = 0;
+				ret = wd_comp_poll(1, &count);
+				ret = ret < 0 ? ret : -WD_EBUSY;
+			}
+		} while (ret == -WD_EBUSY && ++times < SEQ_POLL_TIMES);
+	}
+
+	/* the last ones are reaped if sending fails too */
+	while (out->next < i && times++ < SEQ_POLL_TIMES) {
+		count = 0;
+		if (wd_comp_poll(1, &count) < 0)
+			break;
+	}
+	if (!ret && out->next != num)
+		ret = -ETIMEDOUT;
+
+	wd_comp_seq_free(h_seq);
+out_sess:
+	wd_comp_free_sess(h_sess);
+	return ret;
+}
+
+/* compress chunks of the data by an ordered sequence, and check each one */
+static int check_seq(struct check_env *env)
+{
+	__u32 num = (env->len + SEQ_CHUNK_SIZE - 1) / SEQ_CHUNK_SIZE;
+	__u32 bound = SEQ_CHUNK_SIZE * EXPANSION_RATIO, i, off;
+	struct seq_out out = {0};
+	struct wd_comp_req req = {0};
+	char *dst, *back;
+	int ret = -ENOMEM;
+
+	out.chunks = calloc(num, sizeof(struct seq_chunk));
+	dst = malloc((size_t)num * bound);
+	back = malloc(SEQ_CHUNK_SIZE);
+	if (!out.chunks || !dst || !back)
+		goto out_free;
+
+	ret = seq_compress(env, &out, dst, bound, num);
+	if (ret || out.bad) {
+		WD_ERR("failed to compress by seq(%d), %u out of order!\n",
+		       ret, out.bad);
+		ret = ret ? ret : -EIO;
+		goto out_free;
+	}
+
+	req.op_type = WD_DIR_DECOMPRESS;
+	for (i = 0; i < num; i++) {
+		off = i * SEQ_CHUNK_SIZE;
+		req.src = dst + i * bound;
+		req.src_len = out.chunks[i].dst_len;
+		req.dst = back;
+		req.dst_len = SEQ_CHUNK_SIZE;
+		ret = out.chunks[i].status == WD_IN_EPARA ? -EIO :
+		      wd_do_comp_sync(env->h_decomp, &req);
+		if (ret || req.status != WD_STREAM_END ||
+		    memcmp(back, env->data + off, req.dst_len) ||
+		    req.dst_len != (env->len - off < SEQ_CHUNK_SIZE ?
+				    env->len - off : SEQ_CHUNK_SIZE)) {
+			WD_ERR("failed to decompress seq chunk %u!\n", i);
+			ret = ret ? ret : -EIO;
+			break;
+		}
+	}
+
+out_free:
+	free(out.chunks);
+	free(dst);
+	free(back);
+	return ret;
+}
+
+static struct api_check api_checks[] = {
+	{"sgl", check_sgl},
+	{"grow", check_grow},
+	{"page", check_page},
+	{"seq", check_seq},
+};
+
+static void usage(const char *name)
+{
+	printf("%s [opts]\n"
+	       "  -a / -z       deflate or zlib, default gzip\n"
+	       "  -b <size>     size of test data, default %d\n"
+	       "  -q <num>      number of queues of each mode and op type\n"
+	       "  -o <check>    run one check only, default all of them\n"
+	       "                  'sgl' scatter-gather buffers\n"
+	       "                  'grow' output of sink and buffer chain\n"
+	       "                  'page' batches of 4KB pages\n"
+	       "                  'seq' ordered sequence of async chunks\n",
+	       name, CHECK_LEN_DEF);
+}
+
+int main(int argc, char **argv)
+{
+	struct test_options opts = {0};
+	struct check_env env = {0};
+	struct wd_ctx_config conf = {0};
+	struct uacce_dev_list *list;
+	struct wd_sched *sched;
+	const char *only = NULL;
+	int opt, ret, run = 0, fail = 0;
+	unsigned int i;
+
+	opts.alg_type = WD_GZIP;
+	opts.q_num = 1;
+	env.len = CHECK_LEN_DEF;
+	while ((opt = getopt(argc, argv, "azb:q:o:h")) != -1) {
+		switch (opt) {
+		case 'a':
+			opts.alg_type = WD_DEFLATE;
+			break;
+		case 'z':
+			opts.alg_type = WD_ZLIB;
+			break;
+		case 'b':
+			env.len = strtoul(optarg, NULL, 0);
+			break;
+		case 'q':
+			opts.q_num = strtol(optarg, NULL, 0);
+			break;
+		case 'o':
+			only = optarg;
+			break;
+		default:
+			usage(argv[0]);
+			return opt == 'h' ? 0 : -EINVAL;
+		}
+	}
+
+	if (!env.len || opts.q_num <= 0) {
+		usage(argv[0]);
+		return -EINVAL;
+	}
+
+	env.opts = &opts;
+	env.data = malloc(env.len);
+	if (!env.data)
+		return -ENOMEM;
+	gen_data(env.data, env.len);
+
+	list = get_dev_list(&opts, 1);
+	if (!list) {
+		ret = -ENODEV;
+		goto out_data;
+	}
+
+	ret = init_check_config(&opts, list, &conf, &sched);
+	if (ret)
+		goto out_list;
+
+	env.h_comp = alloc_sess(&opts, WD_DIR_COMPRESS, CTX_MODE_SYNC);
+	env.h_decomp = alloc_sess(&opts, WD_DIR_DECOMPRESS, CTX_MODE_SYNC);
+	if (!env.h_comp || !env.h_decomp) {
+		ret = -EINVAL;
+		goto out_sess;
+	}
+
+	for (i = 0; i < ARRAY_SIZE(api_checks); i++) {
+		if (only && strcmp(only, api_checks[i].name))
+			continue;
+		ret = api_checks[i].check(&env);
+		printf("%-8s %s\n", api_checks[i].name, ret ? "fail" : "pass");
+		fail += !!ret;
+		run++;
+	}
+
+	if (!run) {
+		WD_ERR("no check is named %s!\n", only);
+		ret = -EINVAL;
+	} else {
+		ret = fail ? -EIO : 0;
+	}
+
+out_sess:
+	wd_comp_free_sess(env.h_comp);
+	wd_comp_free_sess(env.h_decomp);
+	uninit_check_config(&conf, sched);
+out_list:
+	wd_free_list_accels(list);
+out_data:
+	free(env.data);
+	return ret;
+}
@@ -0,0 +1,151 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+ * Check and benchmark the checksum helpers of libwd_comp. No device is
+ * needed.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef USE_ZLIB
+#include <zlib.h>
+#endif
+
+#include "wd_comp.h"
+
+#define DEFAULT_SIZE		(64 * 1024 * 1024)
+#define DEFAULT_LOOPS		10
+#define COMBINE_TESTS		64
+
+/* checksums of "123456789" */
+#define CRC32_CHECK		0xcbf43926
+#define ADLER32_CHECK		0x091e01de
+
+static double now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static int check_checksum(unsigned char *buf, size_t size)
+{
+	__u32 crc, adler, crc1, crc2, adler1, adler2;
+	size_t i, cut, len;
+
+	if (wd_crc32(0, "123456789", 9) != CRC32_CHECK ||
+	    wd_adler32(1, "123456789", 9) != ADLER32_CHECK) {
+		printf("check value mismatch\n");
+		return -1;
+	}
+
+	for (i = 0; i < COMBINE_TESTS; i++) {
+		/* odd lengths and offsets to cover the unaligned heads */
+		len = (size_t)rand() % (size < 1 << 20 ? size : 1 << 20);
+		cut = len ? (size_t)rand() % len : 0;
+
+		crc = wd_crc32(0, buf + i, len);
+		adler = wd_adler32(1, buf + i, len);
+#ifdef USE_ZLIB
+		if (crc != crc32(0, buf + i, len) ||
+		    adler != adler32(1, buf + i, len)) {
+			printf("mismatch with zlib, len %zu\n", len);
+			return -1;
+		}
+#endif
+		crc1 = wd_crc32(0, buf + i, cut);
+		crc2 = wd_crc32(0, buf + i + cut, len - cut);
+		adler1 = wd_adler32(1, buf + i, cut);
+		adler2 = wd_adler32(1, buf + i + cut, len - cut);
+		if (wd_crc32_combine(crc1, crc2, len - cut) != crc ||
+		    wd_adler32_combine(adler1, adler2, len - cut) != adler) {
+			printf("combine mismatch, len %zu, cut %zu\n", len, cut);
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+#ifdef USE_ZLIB
+static __u32 zlib_crc32(__u32 crc, const void *buf, __u64 len)
+{
+	return crc32(crc, buf, len);
+}
+
+static __u32 zlib_adler32(__u32 adler, const void *buf, __u64 len)
+{
+	return adler32(adler, buf, len);
+}
+#endif
+
+static void bench(const char *name, __u32 (*fn)(__u32, const void *, __u64),
+		  __u32 init, unsigned char *buf, size_t size, int loops)
+{
+	volatile __u32 sum = 0;
+	double start, ns;
+	int i;
+
+	start = now_ns();
+	for (i = 0; i < loops; i++)
+		sum ^= fn(init, buf, size);
+	ns = now_ns() - start;
+
+	printf("%-10s %8zu bytes: %.2f GB/s\n", name, size,
+	       (double)size * loops / ns);
+}
+
+int main(int argc, char **argv)
+{
+	size_t size = DEFAULT_SIZE;
+	int loops = DEFAULT_LOOPS;
+	unsigned char *buf;
+	size_t i;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "s:n:h")) != -1) {
+		switch (opt) {
+		case 's':
+			size = strtoul(optarg, NULL, 0);
+			break;
+		case 'n':
+			loops = strtol(optarg, NULL, 0);
+			break;
+		default:
+			printf("%s [opts]\n"
+			       "  -s <size>     buffer size\n"
+			       "  -n <num>      number of runs\n", argv[0]);
+			return opt == 'h' ? 0 : -1;
+		}
+	}
+
+	if (!size || loops <= 0) {
+		printf("invalid size or number of runs\n");
+		return -1;
+	}
+
+	/* a little more for the unaligned checks */
+	buf = malloc(size + COMBINE_TESTS);
+	if (!buf)
+		return -1;
+	for (i = 0; i < size + COMBINE_TESTS; i++)
+		buf[i] = rand();
+
+	if (check_checksum(buf, size)) {
+		free(buf);
+		return -1;
+	}
+
+	bench("crc32", wd_crc32, 0, buf, size, loops);
+	bench("adler32", wd_adler32, 1, buf, size, loops);
+#ifdef USE_ZLIB
+	bench("zlib crc32", zlib_crc32, 0, buf, size, loops);
+	bench("zlib adler", zlib_adler32, 1, buf, size, loops);
+#endif
+	free(buf);
+
+	return 0;
+}
@@ -0,0 +1,370 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+ * Compare compression of small messages with and without a preset
+ * dictionary. Messages are lines of the corpus file, or synthetic JSON RPC
+ * payloads of 200B to 2KB. The first messages train the dictionary, the
+ * others are compressed one by one.
+ *
+ * $ zip_dict_perf -S
+ * $ zip_dict_perf -c messages.txt -t 128 -n 10
+ */
+#include <fcntl.h>
+#include <string.h>
+#include <time.h>
+
+#include "sched_sample.h"
+#include "test_lib.h"
+
+#define MSG_MAX			(64 * 1024)
+#define MSG_NUM_DEF		4096
+#define TRAIN_NUM_DEF		64
+#define DICT_MAX		(32 * 1024)
+#define RUNS_DEF		5
+#define WORD_NUM		(sizeof(words) / sizeof(words[0]))
+
+struct msg_corpus {
+	char **msgs;
+	__u32 *lens;
+	__u32 num;
+};
+
+struct dict_result {
+	__u64 in_bytes;
+	__u64 out_bytes;
+	double sec;
+};
+
+static const char *words[] = {
+	"user_id", "session", "timestamp", "status", "payload", "items",
+	"price", "quantity", "currency", "region", "request_id", "trace",
+	"method", "GetOrder", "PutOrder", "ListItems", "ok", "error",
+	"shipping", "address", "country", "version", "retry", "deadline",
+};
+
+static void gen_msg(char *buf, __u32 *len, unsigned int *seed)
+{
+	__u32 target = 200 + rand_r(seed) % (2048 - 200);
+	__u32 n = 0;
+	int w;
+
+	n += sprintf(buf, "{\"jsonrpc\":\"2.0\",\"id\":%u,\"params\":{",
+		     rand_r(seed));
+	while (n < target - 64) {
+		w = rand_r(seed) % WORD_NUM;
+		n += sprintf(buf + n, "\"%s\":", words[w]);
+		if (rand_r(seed) & 1)
+			n += sprintf(buf + n, "%u,", rand_r(seed) % 100000);
+		else
+			n += sprintf(buf + n, "\"%s\",",
+				     words[rand_r(seed) % WORD_NUM]);
+	}
+	n += sprintf(buf + n, "\"end\":true}}");
+	*len = n;
+}
+
+static int gen_corpus(struct msg_corpus *corpus, __u32 num)
+{
+	unsigned int seed = 1;
+	__u32 i;
+
+	corpus->msgs = calloc(num, sizeof(char *));
+	corpus->lens = calloc(num, sizeof(__u32));
+	if (!corpus->msgs || !corpus->lens)
+		return -ENOMEM;
+
+	for (i = 0; i < num; i++) {
+		corpus->msgs[i] = malloc(MSG_MAX);
+		if (!corpus->msgs[i])
+			return -ENOMEM;
+		gen_msg(corpus->msgs[i], &corpus->lens[i], &seed);
+		corpus->num++;
+	}
+
+	return 0;
+}
+
+static int load_corpus(struct msg_corpus *corpus, const char *path)
+{
+	__u32 cap = MSG_NUM_DEF;
+	char *line = NULL;
+	size_t size = 0;
+	ssize_t len;
+	FILE *fp;
+
+	fp = fopen(path, "r");
+	if (!fp)
+		return -errno;
+
+	corpus->msgs = calloc(cap, sizeof(char *));
+	corpus->lens = calloc(cap, sizeof(__u32));
+	if (!corpus->msgs || !corpus->lens) {
+		fclose(fp);
+		return -ENOMEM;
+	}
+
+	while (corpus->num < cap && (len = getline(&line, &size, fp)) > 0) {
+		if (line[len - 1] == '\n')
+			len--;
+		if (!len || len > MSG_MAX)
+			continue;
+		corpus->msgs[corpus->num] = malloc(len);
+		if (!corpus->msgs[corpus->num])
+			break;
+		memcpy(corpus->msgs[corpus->num], line, len);
+		corpus->lens[corpus->num++] = len;
+	}
+	free(line);
+	fclose(fp);
+
+	return 0;
+}
+
+static void free_corpus(struct msg_corpus *corpus)
+{
+	__u32 i;
+
+	for (i = 0; i < corpus->num; i++)
+		free(corpus->msgs[i]);
+	free(corpus->msgs);
+	free(corpus->lens);
+}
+
+/* keep the latest messages, the end of a dictionary is the nearest to data */
+static __u32 build_dict(struct msg_corpus *corpus, __u32 train, char *dict)
+{
+	__u32 len = 0, i, n;
+
+	for (i = 0; i < train; i++) {
+		n = corpus->lens[i];
+		if (n > DICT_MAX)
+			continue;
+		if (len + n > DICT_MAX) {
+			memmove(dict, dict + len + n - DICT_MAX,
+				DICT_MAX - n);
+			len = DICT_MAX - n;
+		}
+		memcpy(dict + len, corpus->msgs[i], n);
+		len += n;
+	}
+
+	return len;
+}
+
+static handle_t alloc_sess(int alg_type, int op_type, int comp_lv,
+			   const char *dict, __u32 dict_len)
+{
+	struct wd_comp_sess_setup setup = {0};
+	handle_t h_sess;
+
+	setup.alg_type = alg_type;
+	setup.op_type = op_type;
+	setup.mode = CTX_MODE_SYNC;
+	setup.comp_lv = comp_lv;
+	setup.win_sz = WD_COMP_WS_32K;
+	h_sess = wd_comp_alloc_sess(&setup);
+	if (h_sess && dict_len && wd_comp_set_dict(h_sess, dict, dict_len)) {
+		wd_comp_free_sess(h_sess);
+		return 0;
+	}
+
+	return h_sess;
+}
+
+static int run_msgs(handle_t h_comp, handle_t h_decomp,
+		    struct msg_corpus *corpus, __u32 train, int runs,
+		    struct dict_result *res)
+{
+	struct wd_comp_req req = {0};
+	struct timespec start, end;
+	char *out, *back;
+	__u32 i;
+	int r, ret = 0;
+
+	out = malloc(MSG_MAX * EXPANSION_RATIO);
+	back = malloc(MSG_MAX);
+	if (!out || !back) {
+		ret = -ENOMEM;
+		goto out_free;
+	}
+
+	memset(res, 0, sizeof(struct dict_result));
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (r = 0; r < runs; r++) {
+		for (i = train; i < corpus->num; i++) {
+			req.src = corpus->msgs[i];
+			req.src_len = corpus->lens[i];
+			req.dst = out;
+			req.dst_len = MSG_MAX * EXPANSION_RATIO;
+			req.op_type = WD_DIR_COMPRESS;
+			ret = wd_do_comp_sync(h_comp, &req);
+			if (ret || req.status) {
+				WD_ERR("failed to compress msg %u!\n", i);
+				ret = ret ? ret : -EIO;
+				goto out_free;
+			}
+			res->in_bytes += corpus->lens[i];
+			res->out_bytes += req.dst_len;
+		}
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	res->sec = end.tv_sec - start.tv_sec +
+		   (end.tv_nsec - start.tv_nsec) / 1e9;
+
+	/* check the last message round trip */
+	req.src = out;
+	req.src_len = req.dst_len;
+	req.dst = back;
+	req.dst_len = MSG_MAX;
+	req.op_type = WD_DIR_DECOMPRESS;
+	ret = wd_do_comp_sync(h_decomp, &req);
+	if (ret || req.status != WD_STREAM_END ||
+	    req.dst_len != corpus->lens[corpus->num - 1] ||
+	    memcmp(back, corpus->msgs[corpus->num - 1], req.dst_len)) {
+		WD_ERR("failed to decompress the last msg!\n");
+		ret = ret ? ret : -EIO;
+	}
+
+out_free:
+	free(out);
+	free(back);
+	return ret;
+}
+
+static void print_result(const char *name, struct dict_result *res)
+{
+	printf("%-12s in %10llu out %10llu ratio %6.1f%% %8.2f MB/s\n", name,
+	       (unsigned long long)res->in_bytes,
+	       (unsigned long long)res->out_bytes,
+	       res->out_bytes ? res->in_bytes * 100.0 / res->out_bytes : 0,
+	       res->sec > 0 ? res->in_bytes / res->sec / (1024 * 1024) : 0);
+}
+
+static void usage(const char *name)
+{
+	printf("%s [opts]\n"
+	       "  -a / -z       deflate or zlib, default zlib\n"
+	       "  -c <file>     corpus, one message per line\n"
+	       "  -t <num>      training messages, default %d\n"
+	       "  -n <num>      number of runs, default %d\n"
+	       "  -L <level>    compression level\n"
+	       "  -q <num>      number of queues\n"
+	       "  -S            compress by CPU, no device is needed\n",
+	       name, TRAIN_NUM_DEF, RUNS_DEF);
+}
+
+int main(int argc, char **argv)
+{
+	struct test_options opts = {0};
+	struct hizip_test_info info = {0};
+	struct dict_result plain, dicted;
+	struct msg_corpus corpus = {0};
+	struct wd_comp_sw_policy policy = {0};
+	struct wd_sched *sched = NULL;
+	handle_t h_comp[2] = {0}, h_decomp[2] = {0};
+	__u32 train = TRAIN_NUM_DEF, dict_len;
+	const char *path = NULL;
+	int runs = RUNS_DEF;
+	bool sw = false;
+	char *dict;
+	int opt, ret, i;
+
+	opts.alg_type = WD_ZLIB;
+	opts.q_num = 1;
+	while ((opt = getopt(argc, argv, "azc:t:n:L:q:Sh")) != -1) {
+		switch (opt) {
+		case 'a':
+			opts.alg_type = WD_DEFLATE;
+			break;
+		case 'z':
+			opts.alg_type = WD_ZLIB;
+			break;
+		case 'c':
+			path = optarg;
+			break;
+		case 't':
+			train = strtoul(optarg, NULL, 0);
+			break;
+		case 'n':
+			runs = strtol(optarg, NULL, 0);
+			break;
+		case 'L':
+			opts.comp_lv = strtol(optarg, NULL, 0);
+			break;
+		case 'q':
+			opts.q_num = strtol(optarg, NULL, 0);
+			break;
+		case 'S':
+			sw = true;
+			break;
+		default:
+			usage(argv[0]);
+			return opt == 'h' ? 0 : -EINVAL;
+		}
+	}
+
+	ret = path ? load_corpus(&corpus, path) :
+		     gen_corpus(&corpus, MSG_NUM_DEF);
+	if (ret || corpus.num <= train || runs <= 0) {
+		WD_ERR("no message to test, or too many to train!\n");
+		ret = ret ? ret : -EINVAL;
+		goto out_corpus;
+	}
+
+	dict = malloc(DICT_MAX);
+	if (!dict) {
+		ret = -ENOMEM;
+		goto out_corpus;
+	}
+	dict_len = build_dict(&corpus, train, dict);
+
+	/* the session of init_ctx_config() isn't used */
+	opts.op_type = WD_DIR_COMPRESS;
+	opts.sync_mode = CTX_MODE_SYNC;
+	if (sw) {
+		policy.small_thresh = ~0U;
+		ret = wd_comp_set_sw_policy(&policy);
+	} else {
+		info.list = get_dev_list(&opts, 1);
+		ret = info.list ? init_ctx_config(&opts, &info, &sched) :
+				  -ENODEV;
+	}
+	if (ret)
+		goto out_dict;
+
+	for (i = 0; i < 2; i++) {
+		h_comp[i] = alloc_sess(opts.alg_type, WD_DIR_COMPRESS,
+				       opts.comp_lv, dict, i ? dict_len : 0);
+		h_decomp[i] = alloc_sess(opts.alg_type, WD_DIR_DECOMPRESS,
+					 0, dict, i ? dict_len : 0);
+		if (!h_comp[i] || !h_decomp[i]) {
+			ret = -EINVAL;
+			goto out_sess;
+		}
+	}
+
+	printf("%u messages, %u to train a dictionary of %u bytes\n",
+	       corpus.num, train, dict_len);
+	ret = run_msgs(h_comp[0], h_decomp[0], &corpus, train, runs, &plain);
+	if (ret)
+		goto out_sess;
+	ret = run_msgs(h_comp[1], h_decomp[1], &corpus, train, runs, &dicted);
+	if (ret)
+		goto out_sess;
+	print_result("no dict", &plain);
+	print_result("dict", &dicted);
+
+out_sess:
+	for (i = 0; i < 2; i++) {
+		wd_comp_free_sess(h_comp[i]);
+		wd_comp_free_sess(h_decomp[i]);
+	}
+	if (!sw)
+		uninit_config(&info, sched);
+out_dict:
+	if (info.list)
+		wd_free_list_accels(info.list);
+	free(dict);
+out_corpus:
+	free_corpus(&corpus);
+	return ret;
+}
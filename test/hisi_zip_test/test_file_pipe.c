@@ -0,0 +1,154 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+ * Compress a file into gzip by the block pipeline, e.g.
+ *
+ * $ zip_file_pipe -i input -o output.gz -b 1048576 -d 64
+ * $ zip_file_pipe -S -i input -o output.gz
+ *
+ * Every block is a gzip member, so the output is a valid gzip file. The
+ * pipeline itself is wd_file_pipe_compress() of libwd_pipe.
+ */
+#include <fcntl.h>
+#include <string.h>
+#include <time.h>
+
+#include "wd_file_pipe.h"
+#include "sched_sample.h"
+#include "test_lib.h"
+
+#define DEFAULT_Q_NUM		4
+
+static void usage(const char *name)
+{
+	printf("%s -i <input> -o <output> [opts]\n"
+	       "  -b <size>     block size, default %d\n"
+	       "  -d <num>      blocks in flight, a power of 2, default %d\n"
+	       "  -q <num>      number of queues, default %d\n"
+	       "  -P            read and write by pread and pwrite, not io_uring\n"
+	       "  -S            compress by CPU, no device is needed\n",
+	       name, WD_FILE_PIPE_BLOCK_SIZE, WD_FILE_PIPE_DEPTH, DEFAULT_Q_NUM);
+}
+
+static int init_sw_sess(struct hizip_test_info *info)
+{
+	struct wd_comp_sw_policy policy = {0};
+	struct wd_comp_sess_setup setup = {0};
+	int ret;
+
+	/* all requests go to the CPU and complete at once */
+	policy.small_thresh = ~0U;
+	ret = wd_comp_set_sw_policy(&policy);
+	if (ret) {
+		WD_ERR("software engine isn't supported!\n");
+		return ret;
+	}
+
+	setup.alg_type = WD_GZIP;
+	setup.op_type = WD_DIR_COMPRESS;
+	setup.mode = CTX_MODE_ASYNC;
+	info->h_sess = wd_comp_alloc_sess(&setup);
+	if (!info->h_sess)
+		return -EINVAL;
+
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	struct test_options opts = {0};
+	struct hizip_test_info info = {0};
+	struct wd_file_pipe_setup setup = {0};
+	struct wd_file_pipe_stat stat;
+	struct wd_sched *sched = NULL;
+	const char *in = NULL, *out = NULL;
+	struct timespec start, end;
+	bool sw = false;
+	double sec;
+	int opt, ret;
+
+	opts.q_num = DEFAULT_Q_NUM;
+
+	while ((opt = getopt(argc, argv, "i:o:b:d:q:PSh")) != -1) {
+		switch (opt) {
+		case 'i':
+			in = optarg;
+			break;
+		case 'o':
+			out = optarg;
+			break;
+		case 'b':
+			setup.block_size = strtoul(optarg, NULL, 0);
+			break;
+		case 'd':
+			setup.depth = strtoul(optarg, NULL, 0);
+			break;
+		case 'q':
+			opts.q_num = strtol(optarg, NULL, 0);
+			break;
+		case 'P':
+			setup.sync_io = true;
+			break;
+		case 'S':
+			sw = true;
+			break;
+		default:
+			usage(argv[0]);
+			return opt == 'h' ? 0 : -EINVAL;
+		}
+	}
+
+	if (!in || !out || opts.q_num <= 0) {
+		usage(argv[0]);
+		return -EINVAL;
+	}
+
+	setup.in_fd = open(in, O_RDONLY);
+	SYS_ERR_COND(setup.in_fd < 0, "open input");
+	setup.out_fd = open(out, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	SYS_ERR_COND(setup.out_fd < 0, "open output");
+
+	opts.alg_type = WD_GZIP;
+	opts.op_type = WD_DIR_COMPRESS;
+	opts.sync_mode = CTX_MODE_ASYNC;
+	if (sw) {
+		ret = init_sw_sess(&info);
+	} else {
+		info.list = get_dev_list(&opts, 1);
+		if (!info.list) {
+			ret = -ENODEV;
+			goto out_close;
+		}
+		ret = init_ctx_config(&opts, &info, &sched);
+	}
+	if (ret)
+		goto out_list;
+
+	setup.h_sess = info.h_sess;
+	setup.poll = !sw;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	ret = wd_file_pipe_compress(&setup, &stat);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	if (!ret)
+		ret = fsync(setup.out_fd) ? -errno : 0;
+
+	sec = end.tv_sec - start.tv_sec + (end.tv_nsec - start.tv_nsec) / 1e9;
+	printf("%llu blocks, in %llu bytes, out %llu bytes, ratio %.1f%%, "
+	       "%.2f MB/s, %s\n", (unsigned long long)stat.blocks,
+	       (unsigned long long)stat.in_bytes,
+	       (unsigned long long)stat.out_bytes,
+	       stat.out_bytes ? stat.in_bytes * 100.0 / stat.out_bytes : 0,
+	       sec > 0 ? stat.in_bytes / sec / (1024 * 1024) : 0,
+	       stat.uring ? "io_uring" : "pread/pwrite");
+
+	if (sw)
+		wd_comp_free_sess(info.h_sess);
+	else
+		uninit_config(&info, sched);
+out_list:
+	if (info.list)
+		wd_free_list_accels(info.list);
+out_close:
+	close(setup.out_fd);
+	close(setup.in_fd);
+	return ret;
+}
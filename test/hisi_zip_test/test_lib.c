@@ -1,4 +1,5 @@
 // SPDX-License-Identifier: Apache-2.0
+#include <fcntl.h>
 #include <pthread.h>
 #include <signal.h>
 #include <sys/mman.h>
@@ -89,7 +90,7 @@ int hw_blk_compress(int alg_type, int blksize,
 		    unsigned char *src, __u32 srclen)
 {
 	handle_t h_sess;
-	struct wd_comp_sess_setup setup;
+	struct wd_comp_sess_setup setup = {0};
 	struct wd_comp_req req;
 	int ret = 0;
 
@@ -106,6 +107,7 @@ int hw_blk_compress(int alg_type, int blksize,
 	req.dst = dst;
 	req.dst_len = *dstlen;
 	req.op_type = WD_DIR_COMPRESS;
+	req.data_fmt = WD_FLAT_BUF;
 
 	dbg("%s:input req: src:%p, dst:%p,src_len: %d, dst_len:%d\n",
 	    __func__, req.src, req.dst, req.src_len, req.dst_len);
@@ -137,7 +139,7 @@ int hw_blk_decompress(int alg_type, int blksize,
 		      unsigned char *src, __u32 srclen)
 {
 	handle_t h_sess;
-	struct wd_comp_sess_setup setup;
+	struct wd_comp_sess_setup setup = {0};
 	struct wd_comp_req req;
 	int ret = 0;
 
@@ -155,6 +157,7 @@ int hw_blk_decompress(int alg_type, int blksize,
 	req.dst = dst;
 	req.dst_len = *dstlen;
 	req.op_type = WD_DIR_DECOMPRESS;
+	req.data_fmt = WD_FLAT_BUF;
 
 	dbg("%s:input req: src:%p, dst:%p,src_len: %d, dst_len:%d\n",
 	    __func__, req.src, req.dst, req.src_len, req.dst_len);
@@ -187,7 +190,7 @@ int hw_stream_compress(int alg_type, int blksize,
 		       unsigned char *src, __u32 srclen)
 {
 	handle_t h_sess;
-	struct wd_comp_sess_setup setup;
+	struct wd_comp_sess_setup setup = {0};
 	struct wd_comp_req req;
 	int ret = 0;
 
@@ -204,6 +207,7 @@ int hw_stream_compress(int alg_type, int blksize,
 	req.dst = dst;
 	req.dst_len = *dstlen;
 	req.op_type = WD_DIR_COMPRESS;
+	req.data_fmt = WD_FLAT_BUF;
 
 	dbg("%s:input req: src:%p, dst:%p,src_len: %d, dst_len:%d\n",
 	    __func__, req.src, req.dst, req.src_len, req.dst_len);
@@ -236,7 +240,7 @@ int hw_stream_decompress(int alg_type, int blksize,
 		       unsigned char *src, __u32 srclen)
 {
 	handle_t h_sess;
-	struct wd_comp_sess_setup setup;
+	struct wd_comp_sess_setup setup = {0};
 	struct wd_comp_req req;
 	int ret = 0;
 
@@ -254,6 +258,7 @@ int hw_stream_decompress(int alg_type, int blksize,
 	req.dst = dst;
 	req.dst_len = *dstlen;
 	req.op_type = WD_DIR_DECOMPRESS;
+	req.data_fmt = WD_FLAT_BUF;
 
 	dbg("%s:input req: src:%p, dst:%p,src_len: %d, dst_len:%d\n",
 	    __func__, req.src, req.dst, req.src_len, req.dst_len);
@@ -321,6 +326,41 @@ void hizip_prepare_random_input_data(char *buf, size_t len, size_t block_size)
 	}
 }
 
+/* Fill the buffer with the content of a file, repeat it if it's short. */
+int hizip_prepare_corpus_input_data(char *buf, size_t len, const char *path)
+{
+	size_t off = 0;
+	ssize_t n;
+	int fd;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		WD_ERR("failed to open corpus %s (%d)\n", path, errno);
+		return -errno;
+	}
+
+	while (off < len) {
+		n = read(fd, buf + off, len - off);
+		if (n < 0) {
+			WD_ERR("failed to read corpus %s (%d)\n", path, errno);
+			close(fd);
+			return -errno;
+		}
+		if (!n) {
+			if (!off) {
+				WD_ERR("corpus %s is empty\n", path);
+				close(fd);
+				return -EINVAL;
+			}
+			lseek(fd, 0, SEEK_SET);
+		}
+		off += n;
+	}
+
+	close(fd);
+	return 0;
+}
+
 int hizip_prepare_random_compressed_data(char *buf, size_t out_len, size_t in_len,
 					 size_t *produced,
 					 struct test_options *opts)
@@ -680,6 +720,8 @@ int init_ctx_config(struct test_options *opts, void *priv,
 	setup.alg_type = opts->alg_type;
 	setup.mode = opts->sync_mode;
 	setup.op_type = opts->op_type;
+	setup.comp_lv = opts->comp_lv;
+	setup.win_sz = opts->win_sz;
 	info->h_sess = wd_comp_alloc_sess(&setup);
 	info->req.op_type = opts->op_type;
 	if (!info->h_sess) {
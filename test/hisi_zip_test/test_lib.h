@@ -60,9 +60,17 @@ struct test_options {
 
 	int warmup_num;
 
+	/* 0: default level and window */
+	int comp_lv;
+	int win_sz;
+	/* input file repeated as test data, NULL: random data */
+	const char *corpus;
+
 #define PERFORMANCE		(1UL << 0)
 #define TEST_ZLIB		(1UL << 1)
 #define TEST_THP		(1UL << 2)
+#define TEST_SW_FALLBACK	(1UL << 3)
+#define TEST_STORE_PRECHECK	(1UL << 4)
 	unsigned long option;
 
 #define STATS_NONE		0
@@ -117,6 +125,7 @@ void uninit_config(void *priv, struct wd_sched *sched);
 struct uacce_dev_list *get_dev_list(struct test_options *opts, int children);
 
 void hizip_prepare_random_input_data(char *buf, size_t len, size_t block_size);
+int hizip_prepare_corpus_input_data(char *buf, size_t len, const char *path);
 int hizip_prepare_random_compressed_data(char *buf, size_t out_len,
 					 size_t in_len, size_t *produced,
 					 struct test_options *opts);
@@ -0,0 +1,431 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+ * Run the compress then encrypt pipeline of wd_pipe on async ctxs of both
+ * wd_comp and wd_aead, e.g.
+ *
+ * $ zip_sec_pipe -n 4096 -l 65536 -d 64
+ *
+ * Every output is opened by a sync AEAD request, which checks the MAC, and
+ * inflated back to the input if zlib is present. Freeing the session while
+ * requests are in flight must fail with -WD_EBUSY.
+ */
+#include <string.h>
+#include <time.h>
+#ifdef USE_ZLIB
+#include <zlib.h>
+#endif
+
+#include "sched_sample.h"
+#include "test_lib.h"
+#include "wd_pipe.h"
+
+#define DEFAULT_REQ_NUM		1024
+#define DEFAULT_REQ_LEN		(64 * 1024)
+#define DEFAULT_DEPTH		64
+#define PIPE_KEY_LEN		16
+#define PIPE_IV_LEN		12
+#define PIPE_MAC_LEN		16
+#define PIPE_AAD_LEN		13
+/* ctx 0 is async for the pipe, ctx 1 is sync to open the output */
+#define PIPE_AEAD_CTX_NUM	2
+
+struct pipe_job {
+	struct wd_pipe_req req;
+	__u8 *src;
+	__u8 *dst;
+	__u32 dst_size;
+	__u8 aad[PIPE_AAD_LEN];
+	__u8 iv[PIPE_IV_LEN];
+	bool done;
+};
+
+static struct wd_ctx_config aead_conf;
+static __u32 done_num;
+
+static __u32 aead_pick_next_ctx(handle_t h_sched_ctx, const void *req,
+				const struct sched_key *key)
+{
+	return key->mode == CTX_MODE_SYNC ? 1 : 0;
+}
+
+static int aead_poll_policy(handle_t h_sched_ctx, __u32 expect, __u32 *count)
+{
+	return wd_aead_poll_ctx(0, expect, count);
+}
+
+static int init_aead_config(void)
+{
+	struct uacce_dev_list *list;
+	struct wd_sched sched = {0};
+	int i, ret;
+
+	list = wd_get_accel_list("aead");
+	if (!list)
+		return -ENODEV;
+
+	aead_conf.ctx_num = PIPE_AEAD_CTX_NUM;
+	aead_conf.ctxs = calloc(PIPE_AEAD_CTX_NUM, sizeof(struct wd_ctx));
+	if (!aead_conf.ctxs) {
+		ret = -ENOMEM;
+		goto out_list;
+	}
+
+	for (i = 0; i < PIPE_AEAD_CTX_NUM; i++) {
+		aead_conf.ctxs[i].ctx = wd_request_ctx(list->dev);
+		if (!aead_conf.ctxs[i].ctx) {
+			WD_ERR("failed to request aead ctx %d!\n", i);
+			ret = -EINVAL;
+			goto out_ctx;
+		}
+		aead_conf.ctxs[i].op_type = 0;
+		aead_conf.ctxs[i].ctx_mode = i ? CTX_MODE_SYNC : CTX_MODE_ASYNC;
+	}
+
+	sched.name = "pipe";
+	sched.pick_next_ctx = aead_pick_next_ctx;
+	sched.poll_policy = aead_poll_policy;
+	ret = wd_aead_init(&aead_conf, &sched);
+	if (ret)
+		goto out_ctx;
+
+	wd_free_list_accels(list);
+	return 0;
+
+out_ctx:
+	while (i--)
+		wd_release_ctx(aead_conf.ctxs[i].ctx);
+	free(aead_conf.ctxs);
+out_list:
+	wd_free_list_accels(list);
+	return ret;
+}
+
+static void uninit_aead_config(void)
+{
+	int i;
+
+	wd_aead_uninit();
+	for (i = 0; i < aead_conf.ctx_num; i++)
+		wd_release_ctx(aead_conf.ctxs[i].ctx);
+	free(aead_conf.ctxs);
+}
+
+static handle_t alloc_aead_sess(void)
+{
+	struct wd_aead_sess_setup setup = {0};
+	__u8 key[PIPE_KEY_LEN];
+	handle_t h_sess;
+	int i;
+
+	setup.calg = WD_CIPHER_AES;
+	setup.cmode = WD_CIPHER_GCM;
+	h_sess = wd_aead_alloc_sess(&setup);
+	if (!h_sess)
+		return 0;
+
+	for (i = 0; i < PIPE_KEY_LEN; i++)
+		key[i] = i;
+	if (wd_aead_set_ckey(h_sess, key, PIPE_KEY_LEN) ||
+	    wd_aead_set_authsize(h_sess, PIPE_MAC_LEN)) {
+		wd_aead_free_sess(h_sess);
+		return 0;
+	}
+
+	return h_sess;
+}
+
+static void *pipe_cb(struct wd_pipe_req *req, void *cb_param)
+{
+	struct pipe_job *job = cb_param;
+
+	job->done = true;
+	done_num++;
+
+	return NULL;
+}
+
+static int alloc_jobs(struct pipe_job *jobs, __u32 num, __u32 len)
+{
+	unsigned int seed = 1;
+	__u32 i, j;
+
+	for (i = 0; i < num; i++) {
+		jobs[i].src = malloc(len);
+		/* room of the MAC twice, as wd_aead checks the encryption */
+		jobs[i].dst_size = PIPE_AAD_LEN + len * EXPANSION_RATIO +
+				   PIPE_MAC_LEN * 2;
+		jobs[i].dst = malloc(jobs[i].dst_size);
+		if (!jobs[i].src || !jobs[i].dst)
+			return -ENOMEM;
+
+		/* compressible text of a few symbols */
+		for (j = 0; j < len; j++)
+			jobs[i].src[j] = 'a' + rand_r(&seed) % 8;
+		for (j = 0; j < PIPE_AAD_LEN; j++)
+			jobs[i].aad[j] = i + j;
+		for (j = 0; j < PIPE_IV_LEN; j++)
+			jobs[i].iv[j] = i * 3 + j;
+
+		jobs[i].req.src = jobs[i].src;
+		jobs[i].req.src_len = len;
+		jobs[i].req.dst = jobs[i].dst;
+		jobs[i].req.dst_len = jobs[i].dst_size;
+		jobs[i].req.assoc = jobs[i].aad;
+		jobs[i].req.assoc_bytes = PIPE_AAD_LEN;
+		jobs[i].req.iv = jobs[i].iv;
+		jobs[i].req.iv_bytes = PIPE_IV_LEN;
+		jobs[i].req.cb = pipe_cb;
+		jobs[i].req.cb_param = &jobs[i];
+	}
+
+	return 0;
+}
+
+static void free_jobs(struct pipe_job *jobs, __u32 num)
+{
+	__u32 i;
+
+	for (i = 0; i < num; i++) {
+		free(jobs[i].src);
+		free(jobs[i].dst);
+	}
+}
+
+static int run_jobs(handle_t h_pipe, struct pipe_job *jobs, __u32 num)
+{
+	bool busy_checked = false;
+	__u32 sent = 0, count;
+	int ret;
+
+	while (done_num < num) {
+		while (sent < num) {
+			ret = wd_do_pipe_async(h_pipe, &jobs[sent].req);
+			if (ret == -WD_EBUSY)
+				break;
+			if (ret) {
+				WD_ERR("failed to send pipe req %u, ret = %d!\n",
+				       sent, ret);
+				return ret;
+			}
+			sent++;
+		}
+
+		/* the session must be kept while its requests are running */
+		if (!busy_checked && done_num < sent) {
+			ret = wd_pipe_free_sess(h_pipe);
+			if (ret != -WD_EBUSY) {
+				WD_ERR("pipe sess is freed in flight, ret = %d!\n",
+				       ret);
+				return -EFAULT;
+			}
+			busy_checked = true;
+		}
+
+		ret = wd_pipe_poll(num - done_num, &count);
+		if (ret) {
+			WD_ERR("failed to poll pipe, ret = %d!\n", ret);
+			return ret;
+		}
+	}
+
+	return 0;
+}
+
+#ifdef USE_ZLIB
+static int check_inflate(struct pipe_job *job, __u8 *comp, __u8 *back)
+{
+	uLongf len = job->req.src_len;
+
+	if (uncompress(back, &len, comp, job->req.comp_len) != Z_OK ||
+	    len != job->req.src_len || memcmp(back, job->src, len)) {
+		WD_ERR("inflated data is mismatched!\n");
+		return -EIO;
+	}
+
+	return 0;
+}
+#else
+static int check_inflate(struct pipe_job *job, __u8 *comp, __u8 *back)
+{
+	return 0;
+}
+#endif
+
+static int check_job(handle_t h_aead, struct pipe_job *job, __u8 *plain,
+		     __u8 *back)
+{
+	struct wd_pipe_req *req = &job->req;
+	struct wd_aead_req aead_req = {0};
+	int ret;
+
+	if (!job->done || req->status ||
+	    req->dst_len != PIPE_AAD_LEN + req->comp_len + PIPE_MAC_LEN) {
+		WD_ERR("pipe req done %d, status %d, dst_len %u!\n", job->done,
+		       req->status, req->dst_len);
+		return -EIO;
+	}
+
+	aead_req.op_type = WD_CIPHER_DECRYPTION_DIGEST;
+	aead_req.src = job->dst;
+	aead_req.dst = plain;
+	aead_req.iv = job->iv;
+	aead_req.iv_bytes = PIPE_IV_LEN;
+	aead_req.assoc_bytes = PIPE_AAD_LEN;
+	aead_req.in_bytes = req->comp_len;
+	aead_req.out_bytes = PIPE_AAD_LEN + req->comp_len;
+	aead_req.out_buf_bytes = aead_req.out_bytes;
+	aead_req.data_fmt = WD_FLAT_BUF;
+	ret = wd_do_aead_sync(h_aead, &aead_req);
+	if (ret || aead_req.state) {
+		WD_ERR("failed to open pipe output, ret = %d, state = %u!\n",
+		       ret, aead_req.state);
+		return ret ? ret : -EIO;
+	}
+
+	if (memcmp(plain, job->aad, PIPE_AAD_LEN)) {
+		WD_ERR("associated data is mismatched!\n");
+		return -EIO;
+	}
+
+	return check_inflate(job, plain + PIPE_AAD_LEN, back);
+}
+
+static void usage(const char *name)
+{
+	printf("%s [opts]\n"
+	       "  -n <num>      number of requests, default %d\n"
+	       "  -l <len>      length of a request, default %d\n"
+	       "  -d <num>      requests in flight, default %d\n"
+	       "  -q <num>      number of compression queues\n",
+	       name, DEFAULT_REQ_NUM, DEFAULT_REQ_LEN, DEFAULT_DEPTH);
+}
+
+int main(int argc, char **argv)
+{
+	struct wd_pipe_sess_setup setup = {0};
+	struct test_options opts = {0};
+	struct hizip_test_info info = {0};
+	__u32 num = DEFAULT_REQ_NUM, len = DEFAULT_REQ_LEN;
+	struct pipe_job *jobs = NULL;
+	struct wd_sched *sched = NULL;
+	struct timespec start, end;
+	__u8 *plain = NULL, *back = NULL;
+	handle_t h_aead = 0, h_pipe = 0;
+	__u64 in_bytes = 0, out_bytes = 0;
+	double sec;
+	int opt, ret;
+	__u32 i;
+
+	setup.buf_num = DEFAULT_DEPTH;
+	opts.q_num = 1;
+	while ((opt = getopt(argc, argv, "n:l:d:q:h")) != -1) {
+		switch (opt) {
+		case 'n':
+			num = strtoul(optarg, NULL, 0);
+			break;
+		case 'l':
+			len = strtoul(optarg, NULL, 0);
+			break;
+		case 'd':
+			setup.buf_num = strtoul(optarg, NULL, 0);
+			break;
+		case 'q':
+			opts.q_num = strtol(optarg, NULL, 0);
+			break;
+		default:
+			usage(argv[0]);
+			return opt == 'h' ? 0 : -EINVAL;
+		}
+	}
+
+	if (!num || !len || !setup.buf_num || opts.q_num <= 0) {
+		usage(argv[0]);
+		return -EINVAL;
+	}
+
+	opts.alg_type = WD_ZLIB;
+	opts.op_type = WD_DIR_COMPRESS;
+	opts.sync_mode = CTX_MODE_ASYNC;
+	opts.win_sz = WD_COMP_WS_32K;
+	info.list = get_dev_list(&opts, 1);
+	if (!info.list)
+		return -ENODEV;
+	ret = init_ctx_config(&opts, &info, &sched);
+	if (ret)
+		goto out_list;
+
+	ret = init_aead_config();
+	if (ret) {
+		WD_ERR("failed to init aead, ret = %d!\n", ret);
+		goto out_comp;
+	}
+
+	h_aead = alloc_aead_sess();
+	if (!h_aead) {
+		ret = -EINVAL;
+		goto out_aead;
+	}
+
+	/* compressed data and associated data of a request fit a buffer */
+	setup.h_comp = info.h_sess;
+	setup.h_aead = h_aead;
+	setup.buf_size = PIPE_AAD_LEN + len * EXPANSION_RATIO;
+	h_pipe = wd_pipe_alloc_sess(&setup);
+	if (!h_pipe) {
+		ret = -EINVAL;
+		goto out_sess;
+	}
+
+	jobs = calloc(num, sizeof(struct pipe_job));
+	plain = malloc(PIPE_AAD_LEN + len * EXPANSION_RATIO + PIPE_MAC_LEN);
+	back = malloc(len);
+	if (!jobs || !plain || !back) {
+		ret = -ENOMEM;
+		goto out_jobs;
+	}
+	ret = alloc_jobs(jobs, num, len);
+	if (ret)
+		goto out_jobs;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	ret = run_jobs(h_pipe, jobs, num);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	if (ret)
+		goto out_jobs;
+
+	for (i = 0; i < num; i++) {
+		ret = check_job(h_aead, &jobs[i], plain, back);
+		if (ret) {
+			WD_ERR("pipe req %u is failed!\n", i);
+			goto out_jobs;
+		}
+		in_bytes += jobs[i].req.src_len;
+		out_bytes += jobs[i].req.dst_len;
+	}
+
+	sec = end.tv_sec - start.tv_sec + (end.tv_nsec - start.tv_nsec) / 1e9;
+	printf("%u requests, in %llu bytes, out %llu bytes, %.2f MB/s\n", num,
+	       (unsigned long long)in_bytes, (unsigned long long)out_bytes,
+	       sec > 0 ? in_bytes / sec / (1024 * 1024) : 0);
+
+out_jobs:
+	if (jobs)
+		free_jobs(jobs, num);
+	free(jobs);
+	free(plain);
+	free(back);
+	/* nothing is in flight once all callbacks are done */
+	if (h_pipe && done_num == num && wd_pipe_free_sess(h_pipe)) {
+		WD_ERR("failed to free idle pipe sess!\n");
+		ret = ret ? ret : -EFAULT;
+	}
+out_sess:
+	wd_aead_free_sess(h_aead);
+out_aead:
+	uninit_aead_config();
+out_comp:
+	uninit_config(&info, sched);
+out_list:
+	wd_free_list_accels(info.list);
+	return ret;
+}
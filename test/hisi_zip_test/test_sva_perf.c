@@ -19,6 +19,9 @@
 #include "test_lib.h"
 #include "sched_sample.h"
 
+/* requests smaller than it are done by CPU in 'fallback' mode */
+#define SW_FALLBACK_THRESH	1024
+
 enum hizip_stats_variable {
 	ST_SETUP_TIME,
 	ST_RUN_TIME,
@@ -341,8 +344,16 @@ static int run_one_test(struct test_options *opts, struct hizip_stats *stats)
 	}
 
 	if (opts->op_type == WD_DIR_COMPRESS) {
-		hizip_prepare_random_input_data(infl_buf, infl_size,
-						opts->block_size);
+		if (opts->corpus) {
+			ret = hizip_prepare_corpus_input_data(infl_buf,
+							      infl_size,
+							      opts->corpus);
+			if (ret)
+				goto out_with_defl_buf;
+		} else {
+			hizip_prepare_random_input_data(infl_buf, infl_size,
+							opts->block_size);
+		}
 		info.in_buf = infl_buf;
 		info.in_size = infl_size;
 		info.out_buf = defl_buf;
@@ -391,6 +402,22 @@ static int run_one_test(struct test_options *opts, struct hizip_stats *stats)
 		}
 		if (opts->faults & INJECT_SIG_BIND)
 			kill(getpid(), SIGTERM);
+		if (opts->option & (TEST_SW_FALLBACK | TEST_STORE_PRECHECK)) {
+			struct wd_comp_sw_policy policy = {0};
+
+			if (opts->option & TEST_SW_FALLBACK) {
+				policy.small_thresh = SW_FALLBACK_THRESH;
+				policy.busy_fallback = true;
+				policy.err_fallback = true;
+			}
+			if (opts->option & TEST_STORE_PRECHECK)
+				policy.store_precheck = true;
+			ret = wd_comp_set_sw_policy(&policy);
+			if (ret) {
+				WD_ERR("failed to set sw policy(%d)\n", ret);
+				goto out_with_config;
+			}
+		}
 	}
 
 	stat_start(&info);
@@ -433,7 +460,19 @@ static int run_one_test(struct test_options *opts, struct hizip_stats *stats)
 		ret = hizip_verify_random_output(opts, &info);
 	}
 
+	if (opts->option & (TEST_SW_FALLBACK | TEST_STORE_PRECHECK)) {
+		struct wd_comp_engine_stat stat;
+
+		wd_comp_get_engine_stat(&stat);
+		printf("engine: hw %llu, sw %llu (small %llu, large %llu, "
+		       "busy %llu, hw err %llu), stored %llu of %llu sampled\n",
+		       stat.hw_reqs, stat.sw_reqs, stat.sw_small,
+		       stat.sw_large, stat.sw_busy, stat.sw_hw_err,
+		       stat.stored_reqs, stat.precheck_reqs);
+	}
+
 	usleep(10);
+out_with_config:
 	if (!(opts->option & TEST_ZLIB))
 		uninit_config(&info, sched);
 	free(info.threads);
@@ -749,6 +788,7 @@ int main(int argc, char **argv)
 		.is_stream		= false,
 		.is_file		= false,
 		.warmup_num		= 0,
+		.win_sz			= WD_COMP_WS_32K,
 		.display_stats		= STATS_PRETTY,
 		.children		= 0,
 		.faults			= 0,
@@ -756,8 +796,36 @@ int main(int argc, char **argv)
 	int show_help = 0;
 	int opt;
 
-	while ((opt = getopt(argc, argv, COMMON_OPTSTRING "f:o:w:k:r:")) != -1) {
+	while ((opt = getopt(argc, argv, COMMON_OPTSTRING "f:o:w:k:r:L:W:c:")) != -1) {
 		switch (opt) {
+		case 'L':
+			opts.comp_lv = strtol(optarg, NULL, 0);
+			SYS_ERR_COND(opts.comp_lv < WD_COMP_L1 ||
+				     opts.comp_lv > WD_COMP_L9,
+				     "invalid level '%s'\n", optarg);
+			break;
+		case 'W':
+			switch (strtol(optarg, NULL, 0)) {
+			case 4:
+				opts.win_sz = WD_COMP_WS_4K;
+				break;
+			case 8:
+				opts.win_sz = WD_COMP_WS_8K;
+				break;
+			case 16:
+				opts.win_sz = WD_COMP_WS_16K;
+				break;
+			case 32:
+				opts.win_sz = WD_COMP_WS_32K;
+				break;
+			default:
+				SYS_ERR_COND(1, "invalid window '%s'\n", optarg);
+				break;
+			}
+			break;
+		case 'c':
+			opts.corpus = optarg;
+			break;
 		case 'f':
 			if (strcmp(optarg, "none") == 0) {
 				opts.display_stats = STATS_NONE;
@@ -781,6 +849,12 @@ int main(int argc, char **argv)
 			case 'z':
 				opts.option |= TEST_ZLIB;
 				break;
+			case 'f':
+				opts.option |= TEST_SW_FALLBACK;
+				break;
+			case 's':
+				opts.option |= TEST_STORE_PRECHECK;
+				break;
 			default:
 				SYS_ERR_COND(1, "invalid argument to -o: '%s'\n", optarg);
 				break;
@@ -825,6 +899,11 @@ int main(int argc, char **argv)
 
 	hizip_test_adjust_len(&opts);
 
+	/* output is only checked against random data */
+	SYS_ERR_COND(opts.corpus && (opts.verify ||
+		     opts.op_type == WD_DIR_DECOMPRESS),
+		     "-c only works for compression without -V\n");
+
 	SYS_ERR_COND(show_help || optind > argc,
 		     COMMON_HELP
 		     "  -f <format>   output format for the statistics\n"
@@ -835,6 +914,11 @@ int main(int argc, char **argv)
 		     "                  'perf' prefaults the output pages\n"
 		     "                  'thp' try to enable transparent huge pages\n"
 		     "                  'zlib' use zlib instead of the device\n"
+		     "                  'fallback' fall back to CPU for small or busy requests\n"
+		     "                  'store' emit stored blocks for incompressible data\n"
+		     "  -L <level>    compression level 1~9, default hardware level\n"
+		     "  -W <KB>       compression window 4, 8, 16 or 32, used with -L\n"
+		     "  -c <file>     compress the file (repeated) instead of random data\n"
 		     "  -w <num>      number of warmup runs\n"
 		     "  -r <children> number of children to create\n"
 		     "  -k <mode>     kill thread\n"
@@ -0,0 +1,71 @@
+#!/bin/bash
+#
+# Sweep compression level, window size and input corpus with zip_sva_perf,
+# and print compression ratio against throughput of every point, so that
+# an operating point could be chosen for a workload.
+#
+# $ zip_sweep.sh [-a | -z] [-m <mode>] [corpus file]...
+#
+#   -a            deflate, default gzip
+#   -z            zlib, default gzip
+#   -m <mode>     mode of queues: 0 sync, 1 async
+#
+# Random data is used if no corpus file is given. Points could be changed
+# from the environment, e.g.
+#
+# $ LEVELS="1 6" WINDOWS="4 32" SIZE=$((16 << 20)) zip_sweep.sh corpus.tar
+
+LEVELS=${LEVELS:-"1 3 6 9"}
+WINDOWS=${WINDOWS:-"4 8 16 32"}
+SIZE=${SIZE:-$((64 << 20))}
+BLOCK=${BLOCK:-$((512 << 10))}
+RUNS=${RUNS:-3}
+ALG_OPT=""
+MODE=0
+
+while getopts "azm:" opt; do
+	case $opt in
+	a|z)
+		ALG_OPT="-$opt"
+		;;
+	m)
+		MODE=$OPTARG
+		;;
+	*)
+		sed -n '3,16p' $0 | cut -c 3-
+		exit 1
+		;;
+	esac
+done
+shift $((OPTIND - 1))
+
+# csv ends with "speed;total_speed;cpu_idle;compression_ratio", speed is in
+# MB/s and ratio is input/output in percent
+run_point()
+{
+	zip_sva_perf $ALG_OPT -m $MODE -s $SIZE -b $BLOCK -n $RUNS -f csv "$@" |
+		awk -F';' '/^[0-9]/ { s += $(NF - 3); r += $NF; n++ }
+			   END { if (!n) exit 1;
+				 printf "%10.1f %10.3f\n", r / n, s / n / 1024 }'
+}
+
+printf "%-24s %5s %6s %10s %10s\n" corpus level window "ratio(%)" "GB/s"
+for corpus in "${@:-}"; do
+	if [ -z "$corpus" ]; then
+		name=random
+		corpus_opt=""
+	else
+		name=$(basename "$corpus")
+		corpus_opt="-c $corpus"
+	fi
+	for level in $LEVELS; do
+		for window in $WINDOWS; do
+			result=$(run_point $corpus_opt -L $level -W $window)
+			if [ $? -ne 0 ]; then
+				result=$(printf "%10s %10s" failed -)
+			fi
+			printf "%-24s %5s %5sK %s\n" "$name" $level $window \
+			       "$result"
+		done
+	done
+done
@@ -15,6 +15,7 @@
 #include <sys/types.h>
 #include "wd_util.h"
 #include "wd_comp.h"
+#include "wd_bmm.h"
 #include "hisi_zip_udrv.h"
 
 #define MIN_AVAILOUT_SIZE 4096
@@ -35,6 +36,104 @@ void zip_sqe_dump(struct hisi_zip_sqe *sqe)
 }
 #endif
 
+static uintptr_t zip_blk_dma_map(struct q_info *qinfo, void *pool, void *blk)
+{
+	if (qinfo->dev_flags & UACCE_DEV_NOIOMMU)
+		return (uintptr_t)wd_blk_dma_map(pool, blk);
+
+	return (uintptr_t)blk;
+}
+
+/* build the hardware sgl in a free block of the same pool */
+static int zip_build_hw_sgl(struct q_info *qinfo, struct wcrypto_comp_sgl *sgl,
+			    void **hw_sgl, uintptr_t *phy)
+{
+	size_t size = sizeof(struct hisi_zip_sgl) +
+		      sgl->sge_num * sizeof(struct hisi_zip_sge);
+	struct hisi_zip_sgl *hsgl;
+	__u64 total = 0;
+	int blk_size;
+	__u32 i;
+
+	blk_size = wd_blksize(sgl->pool);
+	if (blk_size < 0 || (size_t)blk_size < size) {
+		WD_ERR("zip sgl of %u sge is larger than pool block!\n",
+		       sgl->sge_num);
+		return -WD_EINVAL;
+	}
+
+	hsgl = wd_alloc_blk(sgl->pool);
+	if (!hsgl)
+		return -WD_EBUSY;
+
+	if ((uintptr_t)hsgl & (HZ_SGL_ALIGN - 1)) {
+		WD_ERR("zip sgl block isn't %d bytes aligned!\n", HZ_SGL_ALIGN);
+		goto err_free_blk;
+	}
+
+	memset(hsgl, 0, size);
+	for (i = 0; i < sgl->sge_num; i++) {
+		hsgl->sge_entries[i].buff = zip_blk_dma_map(qinfo, sgl->pool,
+							    sgl->sge[i].blk);
+		if (!hsgl->sge_entries[i].buff) {
+			WD_ERR("Get zip sge %u dma address fail!\n", i);
+			goto err_free_blk;
+		}
+		hsgl->sge_entries[i].len = sgl->sge[i].len;
+		total += sgl->sge[i].len;
+	}
+	hsgl->entry_sum_in_chain = sgl->sge_num;
+	hsgl->entry_sum_in_sgl = sgl->sge_num;
+	hsgl->entry_length_in_sgl = sgl->sge_num;
+	hsgl->entry_size_in_sgl = total;
+
+	*phy = zip_blk_dma_map(qinfo, sgl->pool, hsgl);
+	if (!*phy) {
+		WD_ERR("Get zip sgl dma address fail!\n");
+		goto err_free_blk;
+	}
+	*hw_sgl = hsgl;
+
+	return WD_SUCCESS;
+
+err_free_blk:
+	wd_free_blk(sgl->pool, hsgl);
+	return -WD_EINVAL;
+}
+
+static void zip_free_hw_sgl(struct wcrypto_comp_msg *msg)
+{
+	struct wcrypto_comp_sgl *src = (void *)msg->src;
+	struct wcrypto_comp_sgl *dst = (void *)msg->dst;
+
+	if (msg->src_hw_sgl) {
+		wd_free_blk(src->pool, msg->src_hw_sgl);
+		msg->src_hw_sgl = NULL;
+	}
+	if (msg->dst_hw_sgl) {
+		wd_free_blk(dst->pool, msg->dst_hw_sgl);
+		msg->dst_hw_sgl = NULL;
+	}
+}
+
+static int zip_fill_sgl(struct q_info *qinfo, struct wcrypto_comp_msg *msg,
+			uintptr_t *phy_in, uintptr_t *phy_out)
+{
+	int ret;
+
+	ret = zip_build_hw_sgl(qinfo, (void *)msg->src, &msg->src_hw_sgl,
+			       phy_in);
+	if (ret)
+		return ret;
+
+	ret = zip_build_hw_sgl(qinfo, (void *)msg->dst, &msg->dst_hw_sgl,
+			       phy_out);
+	if (ret)
+		zip_free_hw_sgl(msg);
+
+	return ret;
+}
+
 int qm_fill_zip_sqe(void *smsg, struct qm_queue_info *info, __u16 i)
 {
 	struct hisi_zip_sqe *sqe = (struct hisi_zip_sqe *)info->sq_base + i;
@@ -43,6 +142,7 @@ int qm_fill_zip_sqe(void *smsg, struct qm_queue_info *info, __u16 i)
 	uintptr_t phy_ctxbuf = 0;
 	struct wd_queue *q = info->q;
 	struct q_info *qinfo = q->info;
+	int ret;
 
 	memset((void *)sqe, 0, sizeof(*sqe));
 
@@ -57,7 +157,22 @@ int qm_fill_zip_sqe(void *smsg, struct qm_queue_info *info, __u16 i)
 		return -EINVAL;
 	}
 
-	if (qinfo->dev_flags & UACCE_DEV_NOIOMMU) {
+	if (msg->data_fmt == WCRYPTO_COMP_SGL_BUF) {
+		if (msg->stream_mode == WCRYPTO_COMP_STATEFUL &&
+		    (qinfo->dev_flags & UACCE_DEV_NOIOMMU)) {
+			phy_ctxbuf = (uintptr_t)drv_dma_map(q, msg->ctx_buf, 0);
+			if (!phy_ctxbuf) {
+				WD_ERR("Get zip ctx buf dma address fail!\n");
+				return -WD_ENOMEM;
+			}
+		} else {
+			phy_ctxbuf = (uintptr_t)msg->ctx_buf;
+		}
+		ret = zip_fill_sgl(qinfo, msg, &phy_in, &phy_out);
+		if (ret)
+			return ret;
+		sqe->dw9 |= HZ_SGL << HZ_BUF_TYPE_SHIFT;
+	} else if (qinfo->dev_flags & UACCE_DEV_NOIOMMU) {
 		phy_in = (uintptr_t)drv_dma_map(q, msg->src, msg->in_size);
 		if (!phy_in) {
 			WD_ERR("Get zip in buf dma address fail!\n");
@@ -129,6 +244,9 @@ int qm_parse_zip_sqe(void *hw_msg, const struct qm_queue_info *info,
 	if (usr && sqe->tag != usr)
 		return 0;
 
+	if (recv_msg->data_fmt == WCRYPTO_COMP_SGL_BUF)
+		zip_free_hw_sgl(recv_msg);
+
 	if (status != 0 && status != NEGACOMPRESS &&
 	    status != CRC_ERR && status != DECOMP_END) {
 		WD_ERR("bad status (s=%d, t=%d)\n", status, type);
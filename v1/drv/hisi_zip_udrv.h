@@ -14,6 +14,32 @@ enum hw_flush {
 	HZ_FINISH,
 };
 
+enum hw_buf_type {
+	HZ_PBUFFER,
+	HZ_SGL,
+};
+
+struct hisi_zip_sge {
+	__u64 buff;
+	__u64 page_ctrl;
+	__u32 len;
+	__u32 pad;
+	__u32 pad0;
+	__u32 pad1;
+};
+
+/* hardware sgl with 64 bytes head, only one sgl in chain */
+struct hisi_zip_sgl {
+	__u64 next_dma;
+	__u16 entry_sum_in_chain;
+	__u16 entry_sum_in_sgl;
+	__u16 entry_length_in_sgl;
+	__u16 pad0;
+	__u64 pad1[5];
+	__u64 entry_size_in_sgl;
+	struct hisi_zip_sge sge_entries[];
+};
+
 struct hisi_zip_sqe {
 	__u32 consumed;
 	__u32 produced;
@@ -52,6 +78,8 @@ struct hisi_zip_sqe {
 #define DECOMP_STREAM_END 0x113
 #define DECOMP_STREAM_END_MASK 0x1ff
 #define STREAM_FLUSH_SHIFT 25
+#define HZ_BUF_TYPE_SHIFT 8
+#define HZ_SGL_ALIGN 64
 
 int qm_fill_zip_sqe(void *smsg, struct qm_queue_info *info, __u16 i);
 int qm_parse_zip_sqe(void *msg,
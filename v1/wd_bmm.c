@@ -303,3 +303,13 @@ int wd_blk_alloc_failures(void *pool)
 	return __atomic_load_n(&p->alloc_failures, __ATOMIC_RELAXED);
 }
 
+
+int wd_blksize(void *pool)
+{
+	struct wd_blkpool *p = pool;
+
+	if (!p)
+		return -WD_EINVAL;
+
+	return p->setup.block_size;
+}
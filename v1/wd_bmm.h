@@ -18,6 +18,7 @@ extern void *wd_alloc_blk(void *pool);
 extern void wd_free_blk(void *pool, void *blk);
 extern int wd_get_free_blk_num(void *pool);
 extern int wd_blk_alloc_failures(void *pool);
+extern int wd_blksize(void *pool);
 extern void *wd_blk_dma_map(void *pool, void *blk);
 extern void wd_blk_dma_unmap(void *pool, void *blk_dma, void *blk);
 #endif
@@ -65,9 +65,38 @@ static void put_comp_cache(struct wcrypto_comp_ctx *ctx,
 	__atomic_clear(&ctx->cstatus[idx], __ATOMIC_RELEASE);
 }
 
+static int check_comp_sgl(struct wcrypto_comp_sgl *sgl)
+{
+	__u32 i;
+
+	if (!sgl || !sgl->pool || !sgl->sge || !sgl->sge_num) {
+		WD_ERR("invalid: comp sgl, pool or sge is NULL!\n");
+		return -WD_EINVAL;
+	}
+
+	for (i = 0; i < sgl->sge_num; i++) {
+		if (!sgl->sge[i].blk || !sgl->sge[i].len) {
+			WD_ERR("invalid: comp sge %u is empty!\n", i);
+			return -WD_EINVAL;
+		}
+	}
+
+	return WD_SUCCESS;
+}
+
 static int fill_comp_msg(struct wcrypto_comp_ctx *ctx, struct wcrypto_comp_msg *msg,
 						struct wcrypto_comp_op_data *opdata)
 {
+	if (opdata->data_fmt == WCRYPTO_COMP_SGL_BUF) {
+		if (check_comp_sgl((void *)opdata->in) ||
+		    check_comp_sgl((void *)opdata->out))
+			return -WD_EINVAL;
+	} else if (opdata->data_fmt != WCRYPTO_COMP_FLAT_BUF) {
+		WD_ERR("invalid: comp data_fmt %u!\n", opdata->data_fmt);
+		return -WD_EINVAL;
+	}
+
+	msg->data_fmt = opdata->data_fmt;
 	msg->avail_out = opdata->avail_out;
 	msg->src = opdata->in;
 	msg->dst = opdata->out;
@@ -75,6 +75,37 @@ enum wcrypto_stream_status {
 	WCRYPTO_COMP_STREAM_NEW,
 };
 
+/* Buffer types of in/out in operational data */
+enum wcrypto_comp_buf_type {
+	WCRYPTO_COMP_FLAT_BUF,
+	WCRYPTO_COMP_SGL_BUF,
+};
+
+/**
+ * one block of scatter-gather list
+ * @blk: block allocated by wd_alloc_blk()
+ * @len: data length of input, or available length of output in the block
+ */
+struct wcrypto_comp_sge {
+	void *blk;
+	__u32 len;
+};
+
+/**
+ * scatter-gather list of blocks from one block pool, in/out of operational
+ * data point to it if data_fmt is WCRYPTO_COMP_SGL_BUF. The hardware sgl is
+ * built in another block of the pool, so a block must be able to hold
+ * 64 bytes and 32 bytes for each sge, and be 64 bytes aligned.
+ * @pool: block pool created by wd_blkpool_create()
+ * @sge_num: number of sge
+ * @sge: sge array
+ */
+struct wcrypto_comp_sgl {
+	void *pool;
+	__u32 sge_num;
+	struct wcrypto_comp_sge *sge;
+};
+
 /**
  * different contexts for different users/threads
  * @alg_type:compressing algorithm type zlib/gzip
@@ -112,6 +143,7 @@ struct wcrypto_comp_ctx_setup {
  * @in_temp:stash for in
  * @consumed:output, denotes how many bytes are consumed this time
  * @produced:output, denotes how many bytes are produced this time
+ * @data_fmt:buffer type of in/out, from enum wcrypto_comp_buf_type
  */
 struct wcrypto_comp_op_data {
 	__u8 alg_type;
@@ -129,6 +161,7 @@ struct wcrypto_comp_op_data {
 	__u32 checksum;
 	struct wd_queue *q;
 	void *ctx;
+	__u8 data_fmt;
 };
 
 struct wcrypto_comp_msg {
@@ -149,6 +182,7 @@ struct wcrypto_comp_msg {
 	__u8 flush_type;
 	__u8 stream_mode;
 	__u8 stream_pos;
+	__u8 data_fmt;
 	__u32 status;
 	__u64 udata;
 	__u32 isize;
@@ -157,6 +191,9 @@ struct wcrypto_comp_msg {
 	__u32 ctx_priv1;
 	__u32 ctx_priv2;
 	void *ctx_buf;
+	/* blocks of hardware sgl, only used by driver */
+	void *src_hw_sgl;
+	void *dst_hw_sgl;
 };
 
 /**
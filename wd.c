@@ -25,6 +25,7 @@ struct wd_ctx_h {
 	void *qfrs_base[UACCE_QFRT_MAX];
 	struct uacce_dev *dev;
 	void *priv;
+	__u32 sgl_num;
 };
 
 static int get_raw_attr(char *dev_root, char *attr, char *buf, size_t sz)
@@ -448,6 +449,28 @@ int wd_get_numa_id(handle_t h_ctx)
 	return ctx->dev->numa_id;
 }
 
+int wd_ctx_set_sgl_num(handle_t h_ctx, __u32 sgl_num)
+{
+	struct wd_ctx_h	*ctx = (struct wd_ctx_h *)h_ctx;
+
+	if (!ctx)
+		return -WD_EINVAL;
+
+	ctx->sgl_num = sgl_num;
+
+	return 0;
+}
+
+__u32 wd_ctx_get_sgl_num(handle_t h_ctx)
+{
+	struct wd_ctx_h	*ctx = (struct wd_ctx_h *)h_ctx;
+
+	if (!ctx)
+		return 0;
+
+	return ctx->sgl_num;
+}
+
 int wd_get_avail_ctx(struct uacce_dev *dev)
 {
 	int avail_ctx, ret;
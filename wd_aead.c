@@ -1,8 +1,11 @@
 /* SPDX-License-Identifier: Apache-2.0 */
 #include <stdlib.h>
 #include <pthread.h>
+#include <time.h>
 #include "include/drv/wd_aead_drv.h"
 #include "wd_aead.h"
+#include "wd_crypto_share.h"
+#include "wd_crypto_sw.h"
 #include "wd_util.h"
 
 #define XTS_MODE_KEY_DIVISOR	2
@@ -18,6 +21,14 @@
 #define WD_POOL_MAX_ENTRIES	1024
 #define DES_WEAK_KEY_NUM	4
 #define MAX_RETRY_COUNTS	200000000
+#define SESS_KEY_ALIGN		64
+#define BYTE_BITS		8
+
+/* lengths and loops to compare CPU and hardware */
+#define SW_CALIB_MIN		16
+#define SW_CALIB_MAX		4096
+#define SW_CALIB_LOOPS		64
+#define SW_CALIB_ASSOC		16
 
 static __u64 des_weak_key[DES_WEAK_KEY_NUM] = {
 	0x0101010101010101, 0xFEFEFEFEFEFEFEFE,
@@ -31,6 +42,18 @@ static int g_aead_mac_len[WD_DIGEST_TYPE_MAX] = {
 	WD_DIGEST_SHA512_224_LEN, WD_DIGEST_SHA512_256_LEN
 };
 
+/* session and its keys in one object, recycled by the calling thread */
+struct wd_aead_sess_obj {
+	struct wd_aead_sess sess;
+	__u8 ckey[MAX_CIPHER_KEY_SIZE] __attribute__((aligned(SESS_KEY_ALIGN)));
+	__u8 akey[MAX_HMAC_KEY_SIZE] __attribute__((aligned(SESS_KEY_ALIGN)));
+	__u8 bd_tpl[WD_AEAD_TPL_SIZE] __attribute__((aligned(SESS_KEY_ALIGN)));
+	/* the template is valid for the driver which built it */
+	int (*tpl_build)(struct wd_aead_msg *msg, void *tpl);
+	/* BDs are filled in full if set */
+	bool tpl_off;
+};
+
 struct wd_aead_setting {
 	struct wd_ctx_config_internal config;
 	struct wd_sched sched;
@@ -38,6 +61,8 @@ struct wd_aead_setting {
 	struct wd_async_msg_pool pool;
 	void *sched_ctx;
 	void *priv;
+	/* ctxs are shared with cipher and digest by wd_crypto_init() */
+	bool shared;
 }wd_aead_setting;
 
 #ifdef WD_STATIC_DRV
@@ -130,6 +155,44 @@ static unsigned int get_iv_block_size(int mode)
 	return ret;
 }
 
+/* it's rebuilt by each setter, the session is set before requests */
+static void aead_build_tpl(struct wd_aead_sess *sess)
+{
+	struct wd_aead_sess_obj *obj = (struct wd_aead_sess_obj *)sess;
+	struct wd_aead_driver *drv = wd_aead_setting.driver;
+	struct wd_aead_msg msg;
+
+	obj->tpl_build = NULL;
+	if (!drv || !drv->aead_build_tpl)
+		return;
+
+	memset(&msg, 0, sizeof(struct wd_aead_msg));
+	msg.alg_type = WD_AEAD;
+	msg.calg = sess->calg;
+	msg.cmode = sess->cmode;
+	msg.dalg = sess->dalg;
+	msg.dmode = sess->dmode;
+	msg.ckey = sess->ckey;
+	msg.ckey_bytes = sess->ckey_bytes;
+	msg.akey = sess->akey;
+	msg.akey_bytes = sess->akey_bytes;
+	msg.auth_bytes = sess->auth_bytes;
+	/* requests are checked and filled fully by the driver without it */
+	if (!drv->aead_build_tpl(&msg, obj->bd_tpl))
+		obj->tpl_build = drv->aead_build_tpl;
+}
+
+static void *aead_sess_tpl(struct wd_aead_sess *sess)
+{
+	struct wd_aead_sess_obj *obj = (struct wd_aead_sess_obj *)sess;
+
+	if (obj->tpl_build && !obj->tpl_off &&
+	    obj->tpl_build == wd_aead_setting.driver->aead_build_tpl)
+		return obj->bd_tpl;
+
+	return NULL;
+}
+
 int wd_aead_set_ckey(handle_t h_sess, const __u8 *key, __u16 key_len)
 {
 	struct wd_aead_sess *sess = (struct wd_aead_sess *)h_sess;
@@ -156,6 +219,7 @@ int wd_aead_set_ckey(handle_t h_sess, const __u8 *key, __u16 key_len)
 
 	sess->ckey_bytes = key_len;
 	memcpy(sess->ckey, key, key_len);
+	aead_build_tpl(sess);
 
 	return 0;
 }
@@ -178,6 +242,7 @@ int wd_aead_set_akey(handle_t h_sess, const __u8 *key, __u16 key_len)
 
 	sess->akey_bytes = key_len;
 	memcpy(sess->akey, key, key_len);
+	aead_build_tpl(sess);
 
 	return 0;
 }
@@ -214,6 +279,7 @@ int wd_aead_set_authsize(handle_t h_sess, __u16 authsize)
 	}
 
 	sess->auth_bytes = authsize;
+	aead_build_tpl(sess);
 
 	return 0;
 }
@@ -247,63 +313,43 @@ int wd_aead_get_maxauthsize(handle_t h_sess)
 
 handle_t wd_aead_alloc_sess(struct wd_aead_sess_setup *setup)
 {
-	struct wd_aead_sess *sess = NULL;
+	struct wd_aead_sess_obj *obj;
+	struct wd_aead_sess *sess;
 
 	if (!setup) {
 		WD_ERR("failed to check session input parameter!\n");
 		return (handle_t)0;
 	}
 
-	sess = malloc(sizeof(struct wd_aead_sess));
-	if (!sess) {
+	obj = wd_sess_obj_alloc(WD_SESS_AEAD, sizeof(struct wd_aead_sess_obj));
+	if (!obj) {
 		WD_ERR("failed to alloc session memory!\n");
 		return (handle_t)0;
 	}
-	memset(sess, 0, sizeof(struct wd_aead_sess));
 
+	sess = &obj->sess;
 	sess->calg = setup->calg;
 	sess->cmode = setup->cmode;
-	sess->ckey = malloc(MAX_CIPHER_KEY_SIZE);
-	if (!sess->ckey) {
-		WD_ERR("failed to alloc cipher key memory!\n");
-		free(sess);
-		return (handle_t)0;
-	}
-	memset(sess->ckey, 0, MAX_CIPHER_KEY_SIZE);
-
+	sess->ckey = obj->ckey;
 	sess->dalg = setup->dalg;
 	sess->dmode = setup->dmode;
-	sess->akey = malloc(MAX_HMAC_KEY_SIZE);
-	if (!sess->akey) {
-		WD_ERR("failed to alloc digest key memory!\n");
-		free(sess->ckey);
-		free(sess);
-		return (handle_t)0;
-	}
-	memset(sess->akey, 0, MAX_HMAC_KEY_SIZE);
+	sess->akey = obj->akey;
 
 	return (handle_t)sess;
 }
 
 void wd_aead_free_sess(handle_t h_sess)
 {
-	struct wd_aead_sess *sess = (struct wd_aead_sess *)h_sess;
+	struct wd_aead_sess_obj *obj = (struct wd_aead_sess_obj *)h_sess;
 
-	if (!sess) {
+	if (!obj) {
 		WD_ERR("failed to check session parameter!\n");
 		return;
 	}
 
-	if (sess->ckey) {
-		wd_memset_zero(sess->ckey, MAX_CIPHER_KEY_SIZE);
-		free(sess->ckey);
-	}
-
-	if (sess->akey) {
-		wd_memset_zero(sess->akey, MAX_HMAC_KEY_SIZE);
-		free(sess->akey);
-	}
-	free(sess);
+	wd_memset_zero(obj->ckey, MAX_CIPHER_KEY_SIZE);
+	wd_memset_zero(obj->akey, MAX_HMAC_KEY_SIZE);
+	wd_sess_obj_free(WD_SESS_AEAD, obj);
 }
 
 static int aead_param_ckeck(struct wd_aead_sess *sess,
@@ -425,6 +471,66 @@ void wd_aead_uninit(void)
 	wd_clear_ctx_config(&wd_aead_setting.config);
 }
 
+int wd_aead_init_shared(struct wd_ctx_config_internal *config,
+			struct wd_sched *sched)
+{
+	int ret;
+
+	if (wd_aead_setting.config.ctx_num) {
+		WD_ERR("aead is initialized already!\n");
+		return -WD_EBUSY;
+	}
+
+	ret = wd_init_sched(&wd_aead_setting.sched, sched);
+	if (ret < 0) {
+		WD_ERR("failed to set sched, ret = %d!\n", ret);
+		return ret;
+	}
+
+#ifdef WD_STATIC_DRV
+	wd_aead_set_static_drv();
+#endif
+
+	ret = wd_init_async_request_pool(&wd_aead_setting.pool,
+					 config->ctx_num, WD_POOL_MAX_ENTRIES,
+					 sizeof(struct wd_aead_msg));
+	if (ret < 0) {
+		WD_ERR("failed to init req pool, ret = %d!\n", ret);
+		wd_clear_sched(&wd_aead_setting.sched);
+		return ret;
+	}
+
+	/* the driver is inited by wd_crypto_init(), priv is kept NULL */
+	wd_aead_setting.config = *config;
+	wd_aead_setting.shared = true;
+
+	return 0;
+}
+
+void wd_aead_uninit_shared(void)
+{
+	if (!wd_aead_setting.shared)
+		return;
+
+	wd_uninit_async_request_pool(&wd_aead_setting.pool);
+	wd_clear_sched(&wd_aead_setting.sched);
+	/* ctxs are released by wd_crypto_uninit() */
+	memset(&wd_aead_setting.config, 0, sizeof(wd_aead_setting.config));
+	wd_aead_setting.shared = false;
+}
+
+static __u32 aead_pick_ctx(const struct wd_aead_req *req, __u8 mode)
+{
+	struct sched_key key;
+
+	key.mode = mode;
+	key.type = 0;
+	key.numa_id = wd_sess_numa();
+
+	return wd_aead_setting.sched.pick_next_ctx(
+		wd_aead_setting.sched.h_sched_ctx, req, &key);
+}
+
 static void fill_request_msg(struct wd_aead_msg *msg, struct wd_aead_req *req,
 			    struct wd_aead_sess *sess)
 {
@@ -449,6 +555,7 @@ static void fill_request_msg(struct wd_aead_msg *msg, struct wd_aead_req *req,
 	msg->assoc_bytes = req->assoc_bytes;
 	msg->auth_bytes = sess->auth_bytes;
 	msg->data_fmt = req->data_fmt;
+	msg->bd_tpl = aead_sess_tpl(sess);
 }
 
 int wd_do_aead_sync(handle_t h_sess, struct wd_aead_req *req)
@@ -470,7 +577,10 @@ int wd_do_aead_sync(handle_t h_sess, struct wd_aead_req *req)
 	if (ret)
 		return -WD_EINVAL;
 
-	index = wd_aead_setting.sched.pick_next_ctx(0, req, NULL);
+	if (req->in_bytes < sess->sw_thresh && wd_aead_sw_support(sess, req))
+		return wd_aead_sw_do(sess, req);
+
+	index = aead_pick_ctx(req, CTX_MODE_SYNC);
 	if (unlikely(index >= config->ctx_num)) {
 		WD_ERR("failed to pick a proper ctx!\n");
 		return -WD_EINVAL;
@@ -526,6 +636,337 @@ recv_err:
 	return ret;
 }
 
+int wd_aead_set_sw_thresh(handle_t h_sess, __u32 thresh)
+{
+	struct wd_aead_sess *sess = (struct wd_aead_sess *)h_sess;
+
+	if (!sess) {
+		WD_ERR("failed to check session parameter!\n");
+		return -WD_EINVAL;
+	}
+
+	if (thresh && !wd_crypto_sw_supported()) {
+		WD_ERR("invalid: sw engine isn't built in!\n");
+		return -WD_EINVAL;
+	}
+
+	sess->sw_thresh = thresh;
+
+	return 0;
+}
+
+static int aead_calib_run(handle_t h_sess, struct wd_aead_req *req,
+			  bool sw, __u64 *ns)
+{
+	struct wd_aead_sess *sess = (struct wd_aead_sess *)h_sess;
+	struct timespec start, end;
+	int i, ret;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < SW_CALIB_LOOPS; i++) {
+		ret = sw ? wd_aead_sw_do(sess, req) :
+			   wd_do_aead_sync(h_sess, req);
+		if (ret || req->state) {
+			WD_ERR("failed to calibrate aead, ret = %d!\n", ret);
+			return ret ? ret : -WD_EIO;
+		}
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	*ns = (end.tv_sec - start.tv_sec) * 1000000000ULL +
+	      end.tv_nsec - start.tv_nsec;
+
+	return 0;
+}
+
+int wd_aead_sw_calibrate(handle_t h_sess, __u32 *thresh)
+{
+	struct wd_aead_sess *sess = (struct wd_aead_sess *)h_sess;
+	__u32 size = SW_CALIB_ASSOC + SW_CALIB_MAX + WD_AEAD_CCM_GCM_MAX;
+	__u8 iv[GCM_BLOCK_SIZE] = {0};
+	struct wd_aead_req req;
+	__u64 hw_ns, sw_ns;
+	__u32 old, len;
+	int ret = 0;
+	void *buf;
+
+	if (!sess || !thresh) {
+		WD_ERR("failed to check session or thresh parameter!\n");
+		return -WD_EINVAL;
+	}
+
+	buf = calloc(1, size);
+	if (!buf)
+		return -WD_ENOMEM;
+
+	memset(&req, 0, sizeof(struct wd_aead_req));
+	req.op_type = WD_CIPHER_ENCRYPTION_DIGEST;
+	req.src = buf;
+	req.dst = buf;
+	req.iv = iv;
+	req.iv_bytes = GCM_BLOCK_SIZE;
+	req.assoc_bytes = SW_CALIB_ASSOC;
+	req.data_fmt = WD_FLAT_BUF;
+	if (!wd_aead_sw_support(sess, &req) || !sess->auth_bytes) {
+		WD_ERR("invalid: session isn't supported by sw engine!\n");
+		free(buf);
+		return -WD_EINVAL;
+	}
+
+	old = sess->sw_thresh;
+	sess->sw_thresh = 0;
+	for (len = SW_CALIB_MIN; len <= SW_CALIB_MAX; len <<= 1) {
+		req.in_bytes = len;
+		req.out_bytes = SW_CALIB_ASSOC + len + sess->auth_bytes;
+		req.out_buf_bytes = req.out_bytes + sess->auth_bytes;
+		ret = aead_calib_run(h_sess, &req, false, &hw_ns);
+		if (!ret)
+			ret = aead_calib_run(h_sess, &req, true, &sw_ns);
+		if (ret || hw_ns < sw_ns)
+			break;
+	}
+	free(buf);
+
+	if (ret) {
+		sess->sw_thresh = old;
+		return ret;
+	}
+
+	sess->sw_thresh = len;
+	*thresh = len;
+
+	return 0;
+}
+
+int wd_aead_set_bd_tpl(handle_t h_sess, bool enable)
+{
+	struct wd_aead_sess_obj *obj = (struct wd_aead_sess_obj *)h_sess;
+
+	if (!obj) {
+		WD_ERR("aead input sess is NULL!\n");
+		return -WD_EINVAL;
+	}
+
+	obj->tpl_off = !enable;
+
+	return 0;
+}
+
+static int aead_batch_send(struct wd_ctx_internal *ctx,
+			   struct wd_aead_msg *msgs, __u32 num)
+{
+	struct wd_aead_driver *drv = wd_aead_setting.driver;
+	__u32 i;
+	int ret;
+
+	if (drv->aead_send_batch)
+		return drv->aead_send_batch(ctx->ctx, msgs, num);
+
+	for (i = 0; i < num; i++) {
+		ret = drv->aead_send(ctx->ctx, msgs + i);
+		if (ret < 0)
+			return i ? i : ret;
+	}
+
+	return num;
+}
+
+static int aead_batch_recv(struct wd_ctx_internal *ctx,
+			   struct wd_aead_msg *msgs, __u32 num)
+{
+	struct wd_aead_driver *drv = wd_aead_setting.driver;
+	__u32 i;
+	int ret;
+
+	if (drv->aead_recv_batch)
+		return drv->aead_recv_batch(ctx->ctx, msgs, num);
+
+	for (i = 0; i < num; i++) {
+		ret = drv->aead_recv(ctx->ctx, msgs + i);
+		if (ret == -WD_EAGAIN)
+			break;
+		if (ret < 0)
+			return ret;
+	}
+
+	return i;
+}
+
+/* the nonce of a record is the base nonce XOR its big endian sequence */
+static void aead_rec_nonce(__u8 *iv, const __u8 *nonce, __u16 bytes,
+			   __u64 seq)
+{
+	__u16 i;
+
+	memcpy(iv, nonce, bytes);
+	for (i = 0; i < sizeof(__u64); i++)
+		iv[bytes - 1 - i] ^= (__u8)(seq >> (i * BYTE_BITS));
+}
+
+static int aead_rec_burst(struct wd_ctx_internal *ctx,
+			  struct wd_aead_sess *sess,
+			  struct wd_aead_rec_batch *batch,
+			  struct wd_aead_rec *recs, __u32 num)
+{
+	struct wd_aead_msg msgs[WD_AEAD_BATCH_MAX];
+	struct wd_aead_msg resps[WD_AEAD_BATCH_MAX];
+	__u8 ivs[WD_AEAD_BATCH_MAX][AES_BLOCK_SIZE];
+	__u8 aivs[WD_AEAD_BATCH_MAX][AES_BLOCK_SIZE];
+	__u32 mac = batch->op_type == WD_CIPHER_ENCRYPTION_DIGEST ?
+		    sess->auth_bytes : 0;
+	__u32 sent = 0, recv = 0, i;
+	struct wd_aead_msg tmpl;
+	__u64 recv_cnt = 0;
+	int ret, err = 0;
+
+	memset(resps, 0, sizeof(resps));
+	memset(aivs, 0, sizeof(aivs));
+	/* fields of the session are filled once for all records */
+	memset(&tmpl, 0, sizeof(struct wd_aead_msg));
+	tmpl.alg_type = WD_AEAD;
+	tmpl.calg = sess->calg;
+	tmpl.cmode = sess->cmode;
+	tmpl.dalg = sess->dalg;
+	tmpl.dmode = sess->dmode;
+	tmpl.op_type = batch->op_type;
+	tmpl.ckey = sess->ckey;
+	tmpl.ckey_bytes = sess->ckey_bytes;
+	tmpl.akey = sess->akey;
+	tmpl.akey_bytes = sess->akey_bytes;
+	tmpl.iv_bytes = batch->nonce_bytes;
+	tmpl.auth_bytes = sess->auth_bytes;
+	tmpl.data_fmt = WD_FLAT_BUF;
+	tmpl.bd_tpl = aead_sess_tpl(sess);
+
+	for (i = 0; i < num; i++) {
+		msgs[i] = tmpl;
+		msgs[i].in = recs[i].data;
+		msgs[i].out = recs[i].data;
+		msgs[i].in_bytes = recs[i].in_bytes;
+		msgs[i].assoc_bytes = recs[i].assoc_bytes;
+		msgs[i].out_bytes = recs[i].assoc_bytes + recs[i].in_bytes + mac;
+		msgs[i].iv = ivs[i];
+		msgs[i].aiv = aivs[i];
+		aead_rec_nonce(ivs[i], batch->nonce, batch->nonce_bytes,
+			       recs[i].seq);
+		/* it's the index to find record of response */
+		msgs[i].tag = i;
+		recs[i].state = 0;
+	}
+
+	pthread_spin_lock(&ctx->lock);
+	while (recv < num) {
+		if (sent < num && !err) {
+			ret = aead_batch_send(ctx, msgs + sent, num - sent);
+			if (ret > 0) {
+				sent += ret;
+			} else if (ret != -WD_EBUSY) {
+				WD_ERR("failed to send aead batch!\n");
+				/* BDs sent should still be received */
+				err = ret;
+				num = sent;
+			}
+		}
+
+		ret = aead_batch_recv(ctx, resps, sent - recv);
+		if (ret < 0) {
+			WD_ERR("failed to recv aead batch!\n");
+			err = ret;
+			break;
+		}
+
+		for (i = 0; i < (__u32)ret; i++)
+			recs[resps[i].tag].state = resps[i].result;
+		recv += ret;
+		if (!ret && ++recv_cnt > MAX_RETRY_COUNTS) {
+			WD_ERR("failed to recv aead batch and timeout!\n");
+			err = -WD_ETIMEDOUT;
+			break;
+		}
+	}
+	pthread_spin_unlock(&ctx->lock);
+
+	return err;
+}
+
+static int aead_rec_batch_check(struct wd_aead_sess *sess,
+				struct wd_aead_rec_batch *batch)
+{
+	__u32 i;
+
+	if (sess->cmode != WD_CIPHER_GCM || !sess->auth_bytes) {
+		WD_ERR("invalid: aead record batch needs GCM and authsize!\n");
+		return -WD_EINVAL;
+	}
+
+	if (!batch->nonce || batch->nonce_bytes != GCM_BLOCK_SIZE ||
+	    !batch->recs || !batch->num) {
+		WD_ERR("invalid: aead record batch nonce or records!\n");
+		return -WD_EINVAL;
+	}
+
+	if (batch->op_type != WD_CIPHER_ENCRYPTION_DIGEST &&
+	    batch->op_type != WD_CIPHER_DECRYPTION_DIGEST) {
+		WD_ERR("invalid: aead record batch op type!\n");
+		return -WD_EINVAL;
+	}
+
+	for (i = 0; i < batch->num; i++) {
+		if (!batch->recs[i].data || !batch->recs[i].in_bytes) {
+			WD_ERR("invalid: aead record %u is empty!\n", i);
+			return -WD_EINVAL;
+		}
+	}
+
+	return 0;
+}
+
+int wd_do_aead_rec_batch(handle_t h_sess, struct wd_aead_rec_batch *batch)
+{
+	struct wd_ctx_config_internal *config = &wd_aead_setting.config;
+	struct wd_aead_sess *sess = (struct wd_aead_sess *)h_sess;
+	struct wd_ctx_internal *ctx;
+	struct wd_aead_req req;
+	__u32 i, n;
+	int index, ret;
+
+	if (unlikely(!sess || !batch)) {
+		WD_ERR("aead input sess or batch is NULL.\n");
+		return -WD_EINVAL;
+	}
+
+	ret = aead_rec_batch_check(sess, batch);
+	if (ret)
+		return ret;
+
+	/* the scheduler sees the first record as a request */
+	memset(&req, 0, sizeof(struct wd_aead_req));
+	req.op_type = batch->op_type;
+	req.src = batch->recs[0].data;
+	req.dst = batch->recs[0].data;
+	req.in_bytes = batch->recs[0].in_bytes;
+	req.assoc_bytes = batch->recs[0].assoc_bytes;
+	index = aead_pick_ctx(&req, CTX_MODE_SYNC);
+	if (unlikely(index >= config->ctx_num)) {
+		WD_ERR("failed to pick a proper ctx!\n");
+		return -WD_EINVAL;
+	}
+	ctx = config->ctxs + index;
+	if (ctx->ctx_mode != CTX_MODE_SYNC) {
+		WD_ERR("failed to check ctx mode!\n");
+		return -WD_EINVAL;
+	}
+
+	for (i = 0; i < batch->num; i += n) {
+		n = batch->num - i > WD_AEAD_BATCH_MAX ?
+		    WD_AEAD_BATCH_MAX : batch->num - i;
+		ret = aead_rec_burst(ctx, sess, batch, batch->recs + i, n);
+		if (ret)
+			return ret;
+	}
+
+	return 0;
+}
+
 int wd_do_aead_async(handle_t h_sess, struct wd_aead_req *req)
 {
 	struct wd_ctx_config_internal *config = &wd_aead_setting.config;
@@ -545,7 +986,7 @@ int wd_do_aead_async(handle_t h_sess, struct wd_aead_req *req)
 	if (ret)
 		return -WD_EINVAL;
 
-	index = wd_aead_setting.sched.pick_next_ctx(0, req, NULL);
+	index = aead_pick_ctx(req, CTX_MODE_ASYNC);
 	if (unlikely(index >= config->ctx_num)) {
 		WD_ERR("failed to pick a proper ctx!\n");
 		return -WD_EINVAL;
@@ -572,28 +1013,52 @@ int wd_do_aead_async(handle_t h_sess, struct wd_aead_req *req)
 		}
 	}
 	memset(msg->aiv, 0, req->iv_bytes);
-	msg->tag = idx;
+	msg->tag = wd_crypto_tag(WD_AEAD, idx);
 
 	ret = wd_aead_setting.driver->aead_send(ctx->ctx, msg);
 	if (ret < 0) {
 		if (ret != -WD_EBUSY)
 			WD_ERR("failed to send BD, hw is err!\n");
-		wd_put_msg_to_pool(&wd_aead_setting.pool, index, msg->tag);
+		wd_put_msg_to_pool(&wd_aead_setting.pool, index, idx);
 		free(msg->aiv);
 	}
 
 	return ret;
 }
 
+int wd_aead_msg_done(__u32 index, struct wd_aead_msg *resp)
+{
+	__u32 tag = wd_crypto_tag_idx(resp->tag);
+	struct wd_aead_msg *msg;
+	struct wd_aead_req *req;
+
+	msg = wd_find_msg_in_pool(&wd_aead_setting.pool, index, tag);
+	if (!msg) {
+		WD_ERR("failed to get msg from pool!\n");
+		return -WD_EINVAL;
+	}
+
+	msg->tag = resp->tag;
+	msg->req.state = resp->result;
+	req = &msg->req;
+	req->cb(req, req->cb_param);
+	free(msg->aiv);
+	wd_put_msg_to_pool(&wd_aead_setting.pool, index, tag);
+
+	return 0;
+}
+
 int wd_aead_poll_ctx(__u32 index, __u32 expt, __u32 *count)
 {
 	struct wd_ctx_config_internal *config = &wd_aead_setting.config;
 	struct wd_ctx_internal *ctx = config->ctxs + index;
-	struct wd_aead_msg resp_msg, *msg;
-	struct wd_aead_req *req;
+	struct wd_aead_msg resp_msg;
 	__u64 recv_count = 0;
 	int ret;
 
+	if (wd_aead_setting.shared)
+		return wd_crypto_poll_ctx(index, expt, count);
+
 	if (unlikely(index >= config->ctx_num || !count)) {
 		WD_ERR("aead poll ctx input param is NULL!\n");
 		return -WD_EINVAL;
@@ -610,20 +1075,8 @@ int wd_aead_poll_ctx(__u32 index, __u32 expt, __u32 *count)
 
 		expt--;
 		recv_count++;
-		msg = wd_find_msg_in_pool(&wd_aead_setting.pool,
-					    index, resp_msg.tag);
-		if (!msg) {
-			WD_ERR("failed to get msg from pool!\n");
+		if (wd_aead_msg_done(index, &resp_msg))
 			break;
-		}
-
-		msg->tag = resp_msg.tag;
-		msg->req.state = resp_msg.result;
-		req = &msg->req;
-		req->cb(req, req->cb_param);
-		wd_put_msg_to_pool(&wd_aead_setting.pool,
-				     index, resp_msg.tag);
-		free(msg->aiv);
 	} while (expt > 0);
 	*count = recv_count;
 
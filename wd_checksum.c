@@ -0,0 +1,431 @@
+// SPDX-License-Identifier: Apache-2.0
+#include <stdint.h>
+#include <string.h>
+
+#include "config.h"
+#include "wd_comp.h"
+
+#if defined(__aarch64__)
+#include <arm_acle.h>
+#include <sys/auxv.h>
+#ifndef HWCAP_CRC32
+#define HWCAP_CRC32		(1 << 7)
+#endif
+#elif defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+#define CRC32_POLY		0xedb88320
+#define CRC32_X0		0x80000000	/* x^0 in reflected order */
+#define CRC32_X1		0x40000000	/* x^1 in reflected order */
+#define CRC32_SLICE		8
+#define ADLER_BASE		65521
+/* max n that 255n(n+1)/2 + (n+1)(BASE-1) fits in 32 bits */
+#define ADLER_NMAX		5552
+#define ADLER_UNROLL		16
+
+typedef __u32 (*crc32_fn)(__u32 crc, const __u8 *buf, __u64 len);
+typedef __u32 (*adler32_fn)(__u32 adler, const __u8 *buf, __u64 len);
+
+static __u32 crc32_table[CRC32_SLICE][256];
+/* x^(2^n) mod p(x) */
+static __u32 crc32_x2n_table[32];
+static crc32_fn crc32_update;
+static adler32_fn adler32_update;
+
+static inline __u32 load_le32(const __u8 *p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((__u32)p[3] << 24);
+}
+
+/* slicing-by-8, crc is the inverted state */
+static __u32 crc32_generic(__u32 crc, const __u8 *buf, __u64 len)
+{
+	__u32 lo, hi;
+
+	while (len && ((uintptr_t)buf & (CRC32_SLICE - 1))) {
+		crc = crc32_table[0][(crc ^ *buf++) & 0xff] ^ (crc >> 8);
+		len--;
+	}
+
+	while (len >= CRC32_SLICE) {
+		lo = crc ^ load_le32(buf);
+		hi = load_le32(buf + 4);
+		crc = crc32_table[7][lo & 0xff] ^
+		      crc32_table[6][(lo >> 8) & 0xff] ^
+		      crc32_table[5][(lo >> 16) & 0xff] ^
+		      crc32_table[4][lo >> 24] ^
+		      crc32_table[3][hi & 0xff] ^
+		      crc32_table[2][(hi >> 8) & 0xff] ^
+		      crc32_table[1][(hi >> 16) & 0xff] ^
+		      crc32_table[0][hi >> 24];
+		buf += CRC32_SLICE;
+		len -= CRC32_SLICE;
+	}
+
+	while (len--)
+		crc = crc32_table[0][(crc ^ *buf++) & 0xff] ^ (crc >> 8);
+
+	return crc;
+}
+
+#define ADLER_DO1(p, i)		do { a += (p)[i]; b += a; } while (0)
+#define ADLER_DO2(p, i)		do { ADLER_DO1(p, i); ADLER_DO1(p, i + 1); } while (0)
+#define ADLER_DO4(p, i)		do { ADLER_DO2(p, i); ADLER_DO2(p, i + 2); } while (0)
+#define ADLER_DO8(p, i)		do { ADLER_DO4(p, i); ADLER_DO4(p, i + 4); } while (0)
+#define ADLER_DO16(p)		do { ADLER_DO8(p, 0); ADLER_DO8(p, 8); } while (0)
+
+/* the modulo is deferred to the end of every NMAX bytes, as zlib does */
+static __u32 adler32_generic(__u32 adler, const __u8 *p, __u64 len)
+{
+	__u32 a = adler & 0xffff;
+	__u32 b = adler >> 16;
+	__u32 n;
+
+	while (len) {
+		n = len > ADLER_NMAX ? ADLER_NMAX : len;
+		len -= n;
+		while (n >= ADLER_UNROLL) {
+			ADLER_DO16(p);
+			p += ADLER_UNROLL;
+			n -= ADLER_UNROLL;
+		}
+		while (n--) {
+			a += *p++;
+			b += a;
+		}
+		a %= ADLER_BASE;
+		b %= ADLER_BASE;
+	}
+
+	return (b << 16) | a;
+}
+
+#if defined(__aarch64__)
+__attribute__((target("+crc")))
+static __u32 crc32_armv8(__u32 crc, const __u8 *buf, __u64 len)
+{
+	__u64 v;
+
+	while (len && ((uintptr_t)buf & (sizeof(__u64) - 1))) {
+		crc = __crc32b(crc, *buf++);
+		len--;
+	}
+
+	while (len >= sizeof(__u64)) {
+		memcpy(&v, buf, sizeof(__u64));
+		crc = __crc32d(crc, v);
+		buf += sizeof(__u64);
+		len -= sizeof(__u64);
+	}
+
+	while (len--)
+		crc = __crc32b(crc, *buf++);
+
+	return crc;
+}
+
+static crc32_fn crc32_select(void)
+{
+	if (getauxval(AT_HWCAP) & HWCAP_CRC32)
+		return crc32_armv8;
+
+	return crc32_generic;
+}
+
+static adler32_fn adler32_select(void)
+{
+	return adler32_generic;
+}
+#elif defined(__x86_64__)
+#define CRC32_FOLD_MIN		64
+
+/*
+ * Fold 64 bytes a time with carry-less multiply, then reduce the 128 bits
+ * left by Barrett reduction. See "Fast CRC Computation for Generic
+ * Polynomials Using PCLMULQDQ Instruction", Intel, 2009. len must be a
+ * multiple of 16 and no less than 64.
+ */
+__attribute__((target("sse4.1,pclmul")))
+static __u32 crc32_fold(__u32 crc, const __u8 *buf, __u64 len)
+{
+	const __m128i k1k2 = _mm_set_epi64x(0x01c6e41596, 0x0154442bd4);
+	const __m128i k3k4 = _mm_set_epi64x(0x00ccaa009e, 0x01751997d0);
+	const __m128i k5k0 = _mm_set_epi64x(0, 0x0163cd6124);
+	const __m128i poly = _mm_set_epi64x(0x01f7011641, 0x01db710641);
+	const __m128i mask = _mm_setr_epi32(~0, 0, ~0, 0);
+	__m128i x1, x2, x3, x4, x5, x6, x7, x8;
+
+	x1 = _mm_loadu_si128((const __m128i *)buf);
+	x2 = _mm_loadu_si128((const __m128i *)(buf + 16));
+	x3 = _mm_loadu_si128((const __m128i *)(buf + 32));
+	x4 = _mm_loadu_si128((const __m128i *)(buf + 48));
+	x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128(crc));
+	buf += CRC32_FOLD_MIN;
+	len -= CRC32_FOLD_MIN;
+
+	while (len >= CRC32_FOLD_MIN) {
+		x5 = _mm_clmulepi64_si128(x1, k1k2, 0x00);
+		x6 = _mm_clmulepi64_si128(x2, k1k2, 0x00);
+		x7 = _mm_clmulepi64_si128(x3, k1k2, 0x00);
+		x8 = _mm_clmulepi64_si128(x4, k1k2, 0x00);
+		x1 = _mm_clmulepi64_si128(x1, k1k2, 0x11);
+		x2 = _mm_clmulepi64_si128(x2, k1k2, 0x11);
+		x3 = _mm_clmulepi64_si128(x3, k1k2, 0x11);
+		x4 = _mm_clmulepi64_si128(x4, k1k2, 0x11);
+		x1 = _mm_xor_si128(_mm_xor_si128(x1, x5),
+				   _mm_loadu_si128((const __m128i *)buf));
+		x2 = _mm_xor_si128(_mm_xor_si128(x2, x6),
+				   _mm_loadu_si128((const __m128i *)(buf + 16)));
+		x3 = _mm_xor_si128(_mm_xor_si128(x3, x7),
+				   _mm_loadu_si128((const __m128i *)(buf + 32)));
+		x4 = _mm_xor_si128(_mm_xor_si128(x4, x8),
+				   _mm_loadu_si128((const __m128i *)(buf + 48)));
+		buf += CRC32_FOLD_MIN;
+		len -= CRC32_FOLD_MIN;
+	}
+
+	/* fold 4 x 128 bits into 128 bits */
+	x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+	x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+	x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+	x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+	x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+	x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+	x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+	x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+	x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+
+	while (len >= 16) {
+		x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+		x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+		x1 = _mm_xor_si128(_mm_xor_si128(x1, x5),
+				   _mm_loadu_si128((const __m128i *)buf));
+		buf += 16;
+		len -= 16;
+	}
+
+	/* fold 128 bits into 64 bits */
+	x2 = _mm_clmulepi64_si128(x1, k3k4, 0x10);
+	x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x2);
+	x2 = _mm_srli_si128(x1, 4);
+	x1 = _mm_and_si128(x1, mask);
+	x1 = _mm_clmulepi64_si128(x1, k5k0, 0x00);
+	x1 = _mm_xor_si128(x1, x2);
+
+	/* Barrett reduction into 32 bits */
+	x2 = _mm_and_si128(x1, mask);
+	x2 = _mm_clmulepi64_si128(x2, poly, 0x10);
+	x2 = _mm_and_si128(x2, mask);
+	x2 = _mm_clmulepi64_si128(x2, poly, 0x00);
+	x1 = _mm_xor_si128(x1, x2);
+
+	return _mm_extract_epi32(x1, 1);
+}
+
+static __u32 crc32_pclmul(__u32 crc, const __u8 *buf, __u64 len)
+{
+	__u64 fold_len;
+
+	if (len >= CRC32_FOLD_MIN) {
+		fold_len = len & ~15ULL;
+		crc = crc32_fold(crc, buf, fold_len);
+		buf += fold_len;
+		len -= fold_len;
+	}
+
+	return crc32_generic(crc, buf, len);
+}
+
+static crc32_fn crc32_select(void)
+{
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("pclmul") &&
+	    __builtin_cpu_supports("sse4.1"))
+		return crc32_pclmul;
+
+	return crc32_generic;
+}
+
+#define ADLER_BLOCK		32
+
+__attribute__((target("ssse3")))
+static __u32 adler32_hsum(__m128i v)
+{
+	v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1)));
+	v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2)));
+
+	return _mm_cvtsi128_si32(v);
+}
+
+/*
+ * 32 bytes a time. a is the plain sum of bytes, b adds the bytes weighted
+ * by their distance to the end of the block, and 32 times the a of every
+ * block before. Both are reduced once per NMAX bytes, like the generic one.
+ */
+__attribute__((target("ssse3")))
+static __u32 adler32_ssse3(__u32 adler, const __u8 *buf, __u64 len)
+{
+	const __m128i tap1 = _mm_setr_epi8(32, 31, 30, 29, 28, 27, 26, 25,
+					   24, 23, 22, 21, 20, 19, 18, 17);
+	const __m128i tap2 = _mm_setr_epi8(16, 15, 14, 13, 12, 11, 10, 9,
+					   8, 7, 6, 5, 4, 3, 2, 1);
+	const __m128i ones = _mm_set1_epi16(1);
+	const __m128i zero = _mm_setzero_si128();
+	__u64 blocks = len / ADLER_BLOCK;
+	__u32 a = adler & 0xffff;
+	__u32 b = adler >> 16;
+	__m128i v_a, v_b, v_pa, lo, hi;
+	__u32 n;
+
+	while (blocks) {
+		n = ADLER_NMAX / ADLER_BLOCK;
+		if (n > blocks)
+			n = blocks;
+		blocks -= n;
+
+		/* the a of the last chunk is added to b once per block */
+		v_pa = _mm_cvtsi32_si128(a * n);
+		v_b = _mm_cvtsi32_si128(b);
+		v_a = zero;
+		do {
+			lo = _mm_loadu_si128((const __m128i *)buf);
+			hi = _mm_loadu_si128((const __m128i *)(buf + 16));
+			v_pa = _mm_add_epi32(v_pa, v_a);
+			v_a = _mm_add_epi32(v_a, _mm_sad_epu8(lo, zero));
+			v_a = _mm_add_epi32(v_a, _mm_sad_epu8(hi, zero));
+			v_b = _mm_add_epi32(v_b, _mm_madd_epi16(
+					    _mm_maddubs_epi16(lo, tap1), ones));
+			v_b = _mm_add_epi32(v_b, _mm_madd_epi16(
+					    _mm_maddubs_epi16(hi, tap2), ones));
+			buf += ADLER_BLOCK;
+		} while (--n);
+
+		v_b = _mm_add_epi32(v_b, _mm_slli_epi32(v_pa, 5));
+		a = (a + adler32_hsum(v_a)) % ADLER_BASE;
+		b = adler32_hsum(v_b) % ADLER_BASE;
+	}
+
+	return adler32_generic((b << 16) | a, buf, len % ADLER_BLOCK);
+}
+
+static adler32_fn adler32_select(void)
+{
+	if (__builtin_cpu_supports("ssse3"))
+		return adler32_ssse3;
+
+	return adler32_generic;
+}
+#else
+static crc32_fn crc32_select(void)
+{
+	return crc32_generic;
+}
+
+static adler32_fn adler32_select(void)
+{
+	return adler32_generic;
+}
+#endif
+
+/* a * b mod p(x), in reflected order */
+static __u32 crc32_multmodp(__u32 a, __u32 b)
+{
+	__u32 m = CRC32_X0;
+	__u32 p = 0;
+
+	while (1) {
+		if (a & m) {
+			p ^= b;
+			if (!(a & (m - 1)))
+				break;
+		}
+		m >>= 1;
+		b = b & 1 ? (b >> 1) ^ CRC32_POLY : b >> 1;
+	}
+
+	return p;
+}
+
+/* x^(n * 2^k) mod p(x) */
+static __u32 crc32_x2nmodp(__u64 n, __u32 k)
+{
+	__u32 p = CRC32_X0;
+
+	while (n) {
+		if (n & 1)
+			p = crc32_multmodp(crc32_x2n_table[k & 31], p);
+		n >>= 1;
+		k++;
+	}
+
+	return p;
+}
+
+static void __attribute__((constructor)) wd_checksum_init(void)
+{
+	__u32 c, i, j;
+
+	for (i = 0; i < 256; i++) {
+		c = i;
+		for (j = 0; j < 8; j++)
+			c = c & 1 ? (c >> 1) ^ CRC32_POLY : c >> 1;
+		crc32_table[0][i] = c;
+	}
+
+	for (i = 0; i < 256; i++)
+		for (j = 1; j < CRC32_SLICE; j++)
+			crc32_table[j][i] = (crc32_table[j - 1][i] >> 8) ^
+				crc32_table[0][crc32_table[j - 1][i] & 0xff];
+
+	c = CRC32_X1;
+	crc32_x2n_table[0] = c;
+	for (i = 1; i < 32; i++)
+		crc32_x2n_table[i] = c = crc32_multmodp(c, c);
+
+	crc32_update = crc32_select();
+	adler32_update = adler32_select();
+}
+
+__u32 wd_crc32(__u32 crc, const void *buf, __u64 len)
+{
+	if (!buf || !len)
+		return crc;
+
+	return ~crc32_update(~crc, buf, len);
+}
+
+__u32 wd_crc32_combine(__u32 crc1, __u32 crc2, __u64 len2)
+{
+	/* shift crc1 over len2 bytes, that's 8 * len2 bits */
+	return crc32_multmodp(crc32_x2nmodp(len2, 3), crc1) ^ crc2;
+}
+
+__u32 wd_adler32(__u32 adler, const void *buf, __u64 len)
+{
+	if (!buf || !len)
+		return adler;
+
+	return adler32_update(adler, buf, len);
+}
+
+__u32 wd_adler32_combine(__u32 adler1, __u32 adler2, __u64 len2)
+{
+	__u32 rem = len2 % ADLER_BASE;
+	__u32 sum1, sum2;
+
+	sum1 = adler1 & 0xffff;
+	sum2 = (rem * sum1) % ADLER_BASE;
+	sum1 += (adler2 & 0xffff) + ADLER_BASE - 1;
+	sum2 += (adler1 >> 16) + (adler2 >> 16) + ADLER_BASE - rem;
+	if (sum1 >= ADLER_BASE)
+		sum1 -= ADLER_BASE;
+	if (sum1 >= ADLER_BASE)
+		sum1 -= ADLER_BASE;
+	if (sum2 >= (ADLER_BASE << 1))
+		sum2 -= ADLER_BASE << 1;
+	if (sum2 >= ADLER_BASE)
+		sum2 -= ADLER_BASE;
+
+	return sum1 | (sum2 << 16);
+}
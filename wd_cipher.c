@@ -2,10 +2,12 @@
 #define _GNU_SOURCE
 #include <stdlib.h>
 #include <pthread.h>
-#include <sched.h>
-#include <numa.h>
+#include <stdbool.h>
+#include <time.h>
 #include "wd_cipher.h"
 #include "include/drv/wd_cipher_drv.h"
+#include "wd_crypto_share.h"
+#include "wd_crypto_sw.h"
 #include "wd_util.h"
 
 #define XTS_MODE_KEY_DIVISOR	2
@@ -14,11 +16,42 @@
 #define DES3_2KEY_SIZE		(2 * DES_KEY_SIZE)
 #define DES3_3KEY_SIZE		(3 * DES_KEY_SIZE)
 #define MAX_CIPHER_KEY_SIZE	64
+#define SESS_KEY_ALIGN		64
 
 #define WD_POOL_MAX_ENTRIES	1024
 #define DES_WEAK_KEY_NUM	4
 #define MAX_RETRY_COUNTS	200000000
 
+/* large flat requests of parallel modes are split to segments */
+#define CIPHER_SEG_MIN		(1024 * 1024)
+#define CIPHER_SEG_MAX		(8 * 1024 * 1024)
+#define CIPHER_SPLIT_CTX_MAX	16
+/* segments in flight on one ctx */
+#define CIPHER_SEG_DEPTH	4
+#define CTR_128BIT_COUNTER	16
+#define BYTE_BITS		8
+
+/* lengths and loops to compare CPU and hardware */
+#define SW_CALIB_MIN		16
+#define SW_CALIB_MAX		4096
+#define SW_CALIB_LOOPS		64
+
+struct cipher_seg {
+	struct wd_cipher_msg msg;
+	__u8 iv[AES_BLOCK_SIZE];
+};
+
+/* session, its key and BD template in one object, recycled by the thread */
+struct wd_cipher_sess_obj {
+	struct wd_cipher_sess sess;
+	__u8 key[MAX_CIPHER_KEY_SIZE] __attribute__((aligned(SESS_KEY_ALIGN)));
+	__u8 bd_tpl[WD_CIPHER_TPL_SIZE] __attribute__((aligned(SESS_KEY_ALIGN)));
+	/* the template is valid for the driver which built it */
+	int (*tpl_build)(struct wd_cipher_msg *msg, void *tpl);
+	/* BDs are filled in full if set */
+	bool tpl_off;
+};
+
 
 static __u64 des_weak_key[DES_WEAK_KEY_NUM] = {
 	0x0101010101010101, 0xFEFEFEFEFEFEFEFE,
@@ -32,6 +65,8 @@ struct wd_cipher_setting {
 	struct wd_cipher_driver *driver;
 	void *priv;
 	struct wd_async_msg_pool pool;
+	/* ctxs are shared with digest and aead by wd_crypto_init() */
+	bool shared;
 }wd_cipher_setting;
 
 #ifdef WD_STATIC_DRV
@@ -113,6 +148,38 @@ static int cipher_key_len_check(enum wd_cipher_alg alg, __u16 length)
 	return ret;
 }
 
+static void cipher_build_tpl(struct wd_cipher_sess *sess)
+{
+	struct wd_cipher_sess_obj *obj = (struct wd_cipher_sess_obj *)sess;
+	struct wd_cipher_driver *drv = wd_cipher_setting.driver;
+	struct wd_cipher_msg msg;
+
+	obj->tpl_build = NULL;
+	if (!drv || !drv->cipher_build_tpl)
+		return;
+
+	memset(&msg, 0, sizeof(struct wd_cipher_msg));
+	msg.alg_type = WD_CIPHER;
+	msg.alg = sess->alg;
+	msg.mode = sess->mode;
+	msg.key = sess->key;
+	msg.key_bytes = sess->key_bytes;
+	/* requests are checked and filled fully by the driver without it */
+	if (!drv->cipher_build_tpl(&msg, obj->bd_tpl))
+		obj->tpl_build = drv->cipher_build_tpl;
+}
+
+static void *cipher_sess_tpl(struct wd_cipher_sess *sess)
+{
+	struct wd_cipher_sess_obj *obj = (struct wd_cipher_sess_obj *)sess;
+
+	if (obj->tpl_build && !obj->tpl_off &&
+	    obj->tpl_build == wd_cipher_setting.driver->cipher_build_tpl)
+		return obj->bd_tpl;
+
+	return NULL;
+}
+
 int wd_cipher_set_key(handle_t h_sess, const __u8 *key, __u32 key_len)
 {
 	struct wd_cipher_sess *sess = (struct wd_cipher_sess *)h_sess;
@@ -139,59 +206,48 @@ int wd_cipher_set_key(handle_t h_sess, const __u8 *key, __u32 key_len)
 
 	sess->key_bytes = key_len;
 	memcpy(sess->key, key, key_len);
+	cipher_build_tpl(sess);
 
 	return 0;
 }
 
 handle_t wd_cipher_alloc_sess(struct wd_cipher_sess_setup *setup)
 {
-	struct wd_cipher_sess *sess = NULL;
-	int cpu;
-	int node;
+	struct wd_cipher_sess_obj *obj;
+	struct wd_cipher_sess *sess;
 
 	if (!setup) {
 		WD_ERR("cipher input setup is NULL!\n");
 		return (handle_t)0;
 	}
 
-	sess = malloc(sizeof(struct wd_cipher_sess));
-	if (!sess) {
+	obj = wd_sess_obj_alloc(WD_SESS_CIPHER,
+				sizeof(struct wd_cipher_sess_obj));
+	if (!obj) {
 		WD_ERR("fail to alloc session memory!\n");
 		return (handle_t)0;
 	}
-	memset(sess, 0, sizeof(struct wd_cipher_sess));
+
+	sess = &obj->sess;
 	sess->alg = setup->alg;
 	sess->mode = setup->mode;
-	sess->key = malloc(MAX_CIPHER_KEY_SIZE);
-	if (!sess->key) {
-		WD_ERR("fail to alloc key memory!\n");
-		free(sess);
-		return (handle_t)0;
-	}
-
-	memset(sess->key, 0, MAX_CIPHER_KEY_SIZE);
-
-	cpu = sched_getcpu();
-	node = numa_node_of_cpu(cpu);
-
-	sess->numa = node;
+	sess->key = obj->key;
+	sess->numa = wd_sess_numa();
 
 	return (handle_t)sess;
 }
 
 void wd_cipher_free_sess(handle_t h_sess)
 {
-	if (!h_sess) {
+	struct wd_cipher_sess_obj *obj = (struct wd_cipher_sess_obj *)h_sess;
+
+	if (!obj) {
 		WD_ERR("cipher input h_sess is NULL!\n");
 		return;
 	}
-	struct wd_cipher_sess *sess = (struct wd_cipher_sess *)h_sess;
 
-	if (sess->key) {
-		wd_memset_zero(sess->key, MAX_CIPHER_KEY_SIZE);
-		free(sess->key);
-	}
-	free(sess);
+	wd_memset_zero(obj->key, MAX_CIPHER_KEY_SIZE);
+	wd_sess_obj_free(WD_SESS_CIPHER, obj);
 }
 
 int wd_cipher_init(struct wd_ctx_config *config, struct wd_sched *sched)
@@ -282,6 +338,54 @@ void wd_cipher_uninit(void)
 	wd_clear_ctx_config(&wd_cipher_setting.config);
 }
 
+int wd_cipher_init_shared(struct wd_ctx_config_internal *config,
+			  struct wd_sched *sched)
+{
+	int ret;
+
+	if (wd_cipher_setting.config.ctx_num) {
+		WD_ERR("cipher is initialized already!\n");
+		return -WD_EBUSY;
+	}
+
+	ret = wd_init_sched(&wd_cipher_setting.sched, sched);
+	if (ret < 0) {
+		WD_ERR("failed to set sched, ret = %d!\n", ret);
+		return ret;
+	}
+
+#ifdef WD_STATIC_DRV
+	wd_cipher_set_static_drv();
+#endif
+
+	ret = wd_init_async_request_pool(&wd_cipher_setting.pool,
+					 config->ctx_num, WD_POOL_MAX_ENTRIES,
+					 sizeof(struct wd_cipher_msg));
+	if (ret < 0) {
+		WD_ERR("failed to init req pool, ret = %d!\n", ret);
+		wd_clear_sched(&wd_cipher_setting.sched);
+		return ret;
+	}
+
+	/* the driver is inited by wd_crypto_init(), priv is kept NULL */
+	wd_cipher_setting.config = *config;
+	wd_cipher_setting.shared = true;
+
+	return 0;
+}
+
+void wd_cipher_uninit_shared(void)
+{
+	if (!wd_cipher_setting.shared)
+		return;
+
+	wd_uninit_async_request_pool(&wd_cipher_setting.pool);
+	wd_clear_sched(&wd_cipher_setting.sched);
+	/* ctxs are released by wd_crypto_uninit() */
+	memset(&wd_cipher_setting.config, 0, sizeof(wd_cipher_setting.config));
+	wd_cipher_setting.shared = false;
+}
+
 static void fill_request_msg(struct wd_cipher_msg *msg,
 			     struct wd_cipher_req *req,
 			     struct wd_cipher_sess *sess)
@@ -301,6 +405,261 @@ static void fill_request_msg(struct wd_cipher_msg *msg,
 	msg->iv = req->iv;
 	msg->iv_bytes = req->iv_bytes;
 	msg->data_fmt = req->data_fmt;
+	msg->bd_tpl = cipher_sess_tpl(sess);
+}
+
+/* add blocks to the 128 bits big endian counter */
+static void cipher_ctr_add(__u8 *counter, __u32 c)
+{
+	__u32 n = CTR_128BIT_COUNTER;
+
+	do {
+		--n;
+		c += counter[n];
+		counter[n] = (__u8)c;
+		c >>= BYTE_BITS;
+	} while (n);
+}
+
+static __u32 cipher_blk_size(struct wd_cipher_sess *sess)
+{
+	if (sess->alg == WD_CIPHER_DES || sess->alg == WD_CIPHER_3DES)
+		return DES3_BLOCK_SIZE;
+
+	return AES_BLOCK_SIZE;
+}
+
+/*
+ * Segments of ECB, CTR and CBC decryption don't depend on the output of
+ * each other. XTS isn't split, the tweak of a later segment needs the IV
+ * encrypted by the second key.
+ */
+static bool cipher_can_split(struct wd_cipher_sess *sess,
+			     struct wd_cipher_req *req)
+{
+	if (req->data_fmt != WD_FLAT_BUF || req->in_bytes <= CIPHER_SEG_MIN)
+		return false;
+
+	switch (sess->mode) {
+	case WD_CIPHER_ECB:
+		return true;
+	case WD_CIPHER_CTR:
+		if (cipher_blk_size(sess) != AES_BLOCK_SIZE)
+			return false;
+		break;
+	case WD_CIPHER_CBC:
+		if (req->op_type != WD_CIPHER_DECRYPTION)
+			return false;
+		break;
+	default:
+		return false;
+	}
+
+	return req->iv && req->iv_bytes >= cipher_blk_size(sess);
+}
+
+/* Lock sync ctxs picked by the scheduler, only the first one is waited. */
+static __u32 cipher_lock_ctxs(struct wd_cipher_sess *sess,
+			      struct wd_cipher_req *req,
+			      struct wd_ctx_internal **ctxs)
+{
+	struct wd_ctx_config_internal *config = &wd_cipher_setting.config;
+	struct wd_ctx_internal *ctx;
+	struct sched_key key;
+	__u32 tries = config->ctx_num;
+	__u32 num = 0;
+	__u32 i, j, index;
+
+	if (tries > CIPHER_SPLIT_CTX_MAX)
+		tries = CIPHER_SPLIT_CTX_MAX;
+
+	key.mode = CTX_MODE_SYNC;
+	key.type = 0;
+	key.numa_id = sess->numa;
+	for (i = 0; i < tries; i++) {
+		index = wd_cipher_setting.sched.pick_next_ctx(
+			wd_cipher_setting.sched.h_sched_ctx, req, &key);
+		if (index >= config->ctx_num)
+			continue;
+		ctx = config->ctxs + index;
+		if (ctx->ctx_mode != CTX_MODE_SYNC)
+			continue;
+		for (j = 0; j < num; j++)
+			if (ctxs[j] == ctx)
+				break;
+		if (j < num)
+			continue;
+
+		if (!num)
+			pthread_spin_lock(&ctx->lock);
+		else if (pthread_spin_trylock(&ctx->lock))
+			continue;
+		ctxs[num++] = ctx;
+	}
+
+	return num;
+}
+
+static void cipher_fill_segs(struct wd_cipher_sess *sess,
+			     struct wd_cipher_req *req,
+			     struct cipher_seg *segs, __u32 num, __u32 seg_size)
+{
+	__u32 blk = cipher_blk_size(sess);
+	struct wd_cipher_msg *msg;
+	__u32 i, off;
+
+	for (i = 0; i < num; i++) {
+		msg = &segs[i].msg;
+		off = i * seg_size;
+		fill_request_msg(msg, req, sess);
+		msg->in = (__u8 *)req->src + off;
+		msg->out = (__u8 *)req->dst + off;
+		msg->in_bytes = req->in_bytes - off;
+		if (msg->in_bytes > seg_size)
+			msg->in_bytes = seg_size;
+		msg->out_bytes = msg->in_bytes;
+		msg->tag = i;
+		if (sess->mode == WD_CIPHER_ECB)
+			continue;
+
+		/* driver updates IV of every segment, keep the input one */
+		msg->iv = segs[i].iv;
+		msg->iv_bytes = blk;
+		if (sess->mode == WD_CIPHER_CTR) {
+			memcpy(msg->iv, req->iv, blk);
+			cipher_ctr_add(msg->iv, off / AES_BLOCK_SIZE);
+		} else if (!i) {
+			memcpy(msg->iv, req->iv, blk);
+		} else {
+			/* CBC decryption chains the previous cipher block */
+			memcpy(msg->iv, (__u8 *)req->src + off - blk, blk);
+		}
+	}
+}
+
+static int cipher_run_segs(struct wd_ctx_internal **ctxs, __u32 ctx_num,
+			   struct wd_cipher_req *req,
+			   struct cipher_seg *segs, __u32 num)
+{
+	__u32 infl[CIPHER_SPLIT_CTX_MAX] = {0};
+	struct wd_cipher_msg resp;
+	__u32 sent = 0, done = 0;
+	__u64 recv_cnt = 0;
+	int send_ret = 0;
+	bool progress;
+	__u32 i;
+	int ret;
+
+	while (done < num) {
+		/* one segment to every ctx by turns, spread them evenly */
+		while (sent < num && !send_ret) {
+			progress = false;
+			for (i = 0; i < ctx_num && sent < num; i++) {
+				if (infl[i] >= CIPHER_SEG_DEPTH)
+					continue;
+				ret = wd_cipher_setting.driver->cipher_send(
+					ctxs[i]->ctx, &segs[sent].msg);
+				if (ret == -WD_EBUSY)
+					continue;
+				if (ret < 0) {
+					WD_ERR("wd cipher send segment err!\n");
+					send_ret = ret;
+					break;
+				}
+				infl[i]++;
+				sent++;
+				progress = true;
+			}
+			if (!progress)
+				break;
+		}
+		/* segments in flight must be received before ctx is unlocked */
+		if (send_ret && done == sent)
+			return send_ret;
+
+		progress = false;
+		for (i = 0; i < ctx_num; i++) {
+			if (!infl[i])
+				continue;
+			memset(&resp, 0, sizeof(struct wd_cipher_msg));
+			resp.alg_type = WD_CIPHER;
+			resp.data_fmt = WD_FLAT_BUF;
+			ret = wd_cipher_setting.driver->cipher_recv(ctxs[i]->ctx,
+								    &resp);
+			if (ret == -WD_EAGAIN) {
+				continue;
+			} else if (ret < 0) {
+				WD_ERR("wd cipher recv segment err!\n");
+				return ret;
+			}
+			if (resp.result && !req->state)
+				req->state = resp.result;
+			infl[i]--;
+			done++;
+			progress = true;
+		}
+
+		if (progress) {
+			recv_cnt = 0;
+		} else if (++recv_cnt > MAX_RETRY_COUNTS) {
+			WD_ERR("wd cipher recv segment timeout fail!\n");
+			return -WD_ETIMEDOUT;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * Split the request to segments, which are done on several sync ctxs at the
+ * same time. It's also the way to do a request longer than one BD.
+ */
+static int cipher_do_split_sync(struct wd_cipher_sess *sess,
+				struct wd_cipher_req *req)
+{
+	struct wd_ctx_internal *ctxs[CIPHER_SPLIT_CTX_MAX];
+	__u32 blk = cipher_blk_size(sess);
+	struct cipher_seg *segs;
+	__u32 ctx_num, seg_size, num, i;
+	int ret;
+
+	ctx_num = cipher_lock_ctxs(sess, req, ctxs);
+	if (!ctx_num) {
+		WD_ERR("fail to pick a proper ctx!\n");
+		return -WD_EINVAL;
+	}
+
+	seg_size = (req->in_bytes - 1) / ctx_num + 1;
+	seg_size = (seg_size + AES_BLOCK_SIZE - 1) & ~(AES_BLOCK_SIZE - 1);
+	if (seg_size < CIPHER_SEG_MIN)
+		seg_size = CIPHER_SEG_MIN;
+	else if (seg_size > CIPHER_SEG_MAX)
+		seg_size = CIPHER_SEG_MAX;
+	num = (req->in_bytes - 1) / seg_size + 1;
+
+	segs = calloc(num, sizeof(struct cipher_seg));
+	if (!segs) {
+		ret = -WD_ENOMEM;
+		goto unlock;
+	}
+
+	cipher_fill_segs(sess, req, segs, num, seg_size);
+	req->state = 0;
+	ret = cipher_run_segs(ctxs, ctx_num, req, segs, num);
+	if (!ret && !req->state) {
+		/* keep the IV update of one BD, CTR from head, CBC from tail */
+		if (sess->mode == WD_CIPHER_CTR)
+			memcpy(req->iv, segs[0].iv, blk);
+		else if (sess->mode == WD_CIPHER_CBC)
+			memcpy(req->iv, segs[num - 1].iv, blk);
+	}
+
+	free(segs);
+unlock:
+	for (i = 0; i < ctx_num; i++)
+		pthread_spin_unlock(&ctxs[i]->lock);
+
+	return ret;
 }
 
 int wd_do_cipher_sync(handle_t h_sess, struct wd_cipher_req *req)
@@ -323,6 +682,12 @@ int wd_do_cipher_sync(handle_t h_sess, struct wd_cipher_req *req)
 		return -WD_EINVAL;
 	}
 
+	if (req->in_bytes < sess->sw_thresh && wd_cipher_sw_support(sess, req))
+		return wd_cipher_sw_do(sess, req);
+
+	if (cipher_can_split(sess, req))
+		return cipher_do_split_sync(sess, req);
+
 	key.mode = CTX_MODE_SYNC;
 	key.type = 0;
 	key.numa_id = sess->numa;
@@ -372,6 +737,119 @@ recv_err:
 	return ret;
 }
 
+int wd_cipher_set_sw_thresh(handle_t h_sess, __u32 thresh)
+{
+	struct wd_cipher_sess *sess = (struct wd_cipher_sess *)h_sess;
+
+	if (!sess) {
+		WD_ERR("cipher input sess is NULL!\n");
+		return -WD_EINVAL;
+	}
+
+	if (thresh && !wd_crypto_sw_supported()) {
+		WD_ERR("invalid: sw engine isn't built in!\n");
+		return -WD_EINVAL;
+	}
+
+	sess->sw_thresh = thresh;
+
+	return 0;
+}
+
+static int cipher_calib_run(handle_t h_sess, struct wd_cipher_req *req,
+			    bool sw, __u64 *ns)
+{
+	struct wd_cipher_sess *sess = (struct wd_cipher_sess *)h_sess;
+	struct timespec start, end;
+	int i, ret;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < SW_CALIB_LOOPS; i++) {
+		ret = sw ? wd_cipher_sw_do(sess, req) :
+			   wd_do_cipher_sync(h_sess, req);
+		if (ret || req->state) {
+			WD_ERR("failed to calibrate cipher, ret = %d!\n", ret);
+			return ret ? ret : -WD_EIO;
+		}
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	*ns = (end.tv_sec - start.tv_sec) * 1000000000ULL +
+	      end.tv_nsec - start.tv_nsec;
+
+	return 0;
+}
+
+int wd_cipher_sw_calibrate(handle_t h_sess, __u32 *thresh)
+{
+	struct wd_cipher_sess *sess = (struct wd_cipher_sess *)h_sess;
+	__u8 iv[AES_BLOCK_SIZE] = {0};
+	struct wd_cipher_req req;
+	__u64 hw_ns, sw_ns;
+	__u32 old, len;
+	int ret = 0;
+	void *buf;
+
+	if (!sess || !thresh) {
+		WD_ERR("cipher input sess or thresh is NULL!\n");
+		return -WD_EINVAL;
+	}
+
+	buf = calloc(1, SW_CALIB_MAX);
+	if (!buf)
+		return -WD_ENOMEM;
+
+	memset(&req, 0, sizeof(struct wd_cipher_req));
+	req.op_type = WD_CIPHER_ENCRYPTION;
+	req.src = buf;
+	req.dst = buf;
+	req.iv = iv;
+	req.iv_bytes = AES_BLOCK_SIZE;
+	req.out_buf_bytes = SW_CALIB_MAX;
+	req.data_fmt = WD_FLAT_BUF;
+	if (!wd_cipher_sw_support(sess, &req)) {
+		WD_ERR("invalid: session isn't supported by sw engine!\n");
+		free(buf);
+		return -WD_EINVAL;
+	}
+
+	old = sess->sw_thresh;
+	sess->sw_thresh = 0;
+	for (len = SW_CALIB_MIN; len <= SW_CALIB_MAX; len <<= 1) {
+		req.in_bytes = len;
+		req.out_bytes = len;
+		ret = cipher_calib_run(h_sess, &req, false, &hw_ns);
+		if (!ret)
+			ret = cipher_calib_run(h_sess, &req, true, &sw_ns);
+		if (ret || hw_ns < sw_ns)
+			break;
+	}
+	free(buf);
+
+	if (ret) {
+		sess->sw_thresh = old;
+		return ret;
+	}
+
+	sess->sw_thresh = len;
+	*thresh = len;
+
+	return 0;
+}
+
+int wd_cipher_set_bd_tpl(handle_t h_sess, bool enable)
+{
+	struct wd_cipher_sess_obj *obj = (struct wd_cipher_sess_obj *)h_sess;
+
+	if (!obj) {
+		WD_ERR("cipher input sess is NULL!\n");
+		return -WD_EINVAL;
+	}
+
+	obj->tpl_off = !enable;
+
+	return 0;
+}
+
 int wd_do_cipher_async(handle_t h_sess, struct wd_cipher_req *req)
 {
 	struct wd_ctx_config_internal *config = &wd_cipher_setting.config;
@@ -413,27 +891,52 @@ int wd_do_cipher_async(handle_t h_sess, struct wd_cipher_req *req)
 		return -WD_EBUSY;
 
 	fill_request_msg(msg, req, sess);
-	msg->tag = idx;
+	msg->tag = wd_crypto_tag(WD_CIPHER, idx);
 
 	ret = wd_cipher_setting.driver->cipher_send(ctx->ctx, msg);
 	if (ret < 0) {
 		if (ret != -WD_EBUSY)
 			WD_ERR("wd cipher async send err!\n");
-		wd_put_msg_to_pool(&wd_cipher_setting.pool, index, msg->tag);
+		wd_put_msg_to_pool(&wd_cipher_setting.pool, index, idx);
 	}
 
 	return ret;
 }
 
+int wd_cipher_msg_done(__u32 index, struct wd_cipher_msg *resp)
+{
+	__u32 tag = wd_crypto_tag_idx(resp->tag);
+	struct wd_cipher_msg *msg;
+	struct wd_cipher_req *req;
+
+	msg = wd_find_msg_in_pool(&wd_cipher_setting.pool, index, tag);
+	if (!msg) {
+		WD_ERR("failed to get msg from pool!\n");
+		return -WD_EINVAL;
+	}
+
+	msg->tag = resp->tag;
+	msg->req.state = resp->result;
+	req = &msg->req;
+
+	req->cb(req, req->cb_param);
+	/* free msg cache to msg_pool */
+	wd_put_msg_to_pool(&wd_cipher_setting.pool, index, tag);
+
+	return 0;
+}
+
 int wd_cipher_poll_ctx(__u32 index, __u32 expt, __u32* count)
 {
 	struct wd_ctx_config_internal *config = &wd_cipher_setting.config;
 	struct wd_ctx_internal *ctx = config->ctxs + index;
-	struct wd_cipher_msg resp_msg, *msg;
-	struct wd_cipher_req *req;
+	struct wd_cipher_msg resp_msg;
 	__u64 recv_count = 0;
 	int ret;
 
+	if (wd_cipher_setting.shared)
+		return wd_crypto_poll_ctx(index, expt, count);
+
 	if (unlikely(index >= config->ctx_num || !count)) {
 		WD_ERR("wd cipher poll ctx input param is NULL!\n");
 		return -WD_EINVAL;
@@ -448,21 +951,9 @@ int wd_cipher_poll_ctx(__u32 index, __u32 expt, __u32* count)
 			return ret;
 		}
 		recv_count++;
-		msg = wd_find_msg_in_pool(&wd_cipher_setting.pool, index,
-					  resp_msg.tag);
-		if (!msg) {
-			WD_ERR("failed to get msg from pool!\n");
-			return -WD_EINVAL;
-		}
-
-		msg->tag = resp_msg.tag;
-		msg->req.state = resp_msg.result;
-		req = &msg->req;
-
-		req->cb(req, req->cb_param);
-		/* free msg cache to msg_pool */
-		wd_put_msg_to_pool(&wd_cipher_setting.pool, index,
-				   resp_msg.tag);
+		ret = wd_cipher_msg_done(index, &resp_msg);
+		if (ret)
+			return ret;
 		*count = recv_count;
 	} while (expt > *count);
 
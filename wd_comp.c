@@ -6,16 +6,43 @@
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
 
 #include "config.h"
 #include "drv/wd_comp_drv.h"
 #include "wd_comp.h"
+#include "wd_comp_sw.h"
 #include "wd_util.h"
 
 #define WD_POOL_MAX_ENTRIES		1024
 #define MAX_RETRY_COUNTS		200000000
 #define HW_CTX_SIZE			(64 * 1024)
+#define HW_CTX_SLAB_NUM			16
+#define HW_CTX_NODE_MAX			16
 #define STREAM_CHUNK			(128 * 1024)
+#define WD_COMP_PAR_MAX			64
+#define WD_FRAME_MAGIC			0x4b535744	/* "WDSK" */
+#define WD_FRAME_BLOCK_MAX		(4 * 1024 * 1024)
+#define WD_FRAME_EXPANSION		2
+#define WD_SEQ_WINDOW_DEF		64
+#define WD_SEQ_WINDOW_MAX		4096
+
+#define GZIP_ID1			0x1f
+#define GZIP_ID2			0x8b
+#define GZIP_CM_DEFLATE			0x08
+#define GZIP_FHCRC			0x02
+#define GZIP_FEXTRA			0x04
+#define GZIP_FNAME			0x08
+#define GZIP_FCOMMENT			0x10
+#define GZIP_FIXED_HEAD_SZ		10
+#define GZIP_TAIL_SZ			8
+#define GZIP_FRESERVED			0xe0
+/* the shortest deflate stream is an empty fixed huffman block */
+#define GZIP_DEFLATE_MIN		2
+/* a stateless request of the hardware takes at most 8MB */
+#define GZIP_PAR_MEMBER_MAX		(8 * 1024 * 1024)
 
 #define swap_byte(x) \
 	((((x) & 0x000000ff) << 24) | \
@@ -27,11 +54,59 @@
 
 struct wd_comp_sess {
 	int	alg_type;
+	int	comp_lv;
+	int	win_sz;
 	struct sched_key	key;
+	/* only taken when the session is in a stream */
 	__u8	*ctx_buf;
+	__u8	ctx_buf_node;
 	__u8	stream_pos;
 	__u32	isize;
 	__u32	checksum;
+	/* preset dictionary, requests of the session are done by CPU */
+	void	*dict;
+	__u32	dict_len;
+};
+
+/* a ctx bound to one thread for fixed-size page requests */
+struct wd_comp_page_ctx {
+	struct wd_comp_sess *sess;
+	struct wd_ctx_internal *ctx;
+	__u32 page_size;
+	/* constant fields are filled once, only buffers change per page */
+	struct wd_comp_msg msg;
+};
+
+enum wd_seq_slot_state {
+	WD_SEQ_SLOT_FREE,
+	WD_SEQ_SLOT_INFLIGHT,
+	WD_SEQ_SLOT_DONE,
+	/* submission failed, the id is skipped without calling the sink */
+	WD_SEQ_SLOT_FAILED,
+};
+
+struct wd_comp_seq_slot {
+	struct wd_comp_seq *seq;
+	/* copy of user request, results are stored back by the callback */
+	struct wd_comp_req req;
+	void *cb_param;
+	__u64 id;
+	__u8 state;
+};
+
+/* a ring of in flight requests of one logical stream, released in order */
+struct wd_comp_seq {
+	handle_t h_sess;
+	wd_comp_seq_sink_t *sink;
+	void *sink_param;
+	__u32 mask;
+	/* next id to submit, reserved under the lock */
+	__u64 tail;
+	/* next id to release */
+	__u64 head;
+	bool releasing;
+	pthread_mutex_t lock;
+	struct wd_comp_seq_slot *slots;
 };
 
 struct wd_comp_setting {
@@ -40,8 +115,130 @@ struct wd_comp_setting {
 	struct wd_comp_driver *driver;
 	void *priv;
 	struct wd_async_msg_pool pool;
+	struct wd_comp_sw_policy sw_policy;
+	struct wd_comp_engine_stat stat;
 } wd_comp_setting;
 
+struct wd_ctx_buf_slab {
+	void *base;
+	struct wd_ctx_buf_slab *next;
+};
+
+/*
+ * Free hardware stream ctx buffers of one NUMA node. Buffers are carved from
+ * slabs which are touched first on the node, and linked by their first word
+ * when they are free.
+ */
+struct wd_ctx_buf_pool {
+	pthread_mutex_t lock;
+	void *free_list;
+	struct wd_ctx_buf_slab *slabs;
+};
+
+static struct wd_ctx_buf_pool wd_ctx_buf_pools[HW_CTX_NODE_MAX] = {
+	[0 ... HW_CTX_NODE_MAX - 1] = { .lock = PTHREAD_MUTEX_INITIALIZER },
+};
+
+static __u8 wd_ctx_buf_node(void)
+{
+	unsigned int cpu, node;
+
+	if (syscall(SYS_getcpu, &cpu, &node, NULL))
+		return 0;
+
+	return node % HW_CTX_NODE_MAX;
+}
+
+static int wd_ctx_buf_add_slab(struct wd_ctx_buf_pool *pool)
+{
+	struct wd_ctx_buf_slab *node;
+	__u8 *slab;
+	int i;
+
+	node = malloc(sizeof(struct wd_ctx_buf_slab));
+	if (!node)
+		return -WD_ENOMEM;
+
+	slab = mmap(NULL, HW_CTX_SIZE * HW_CTX_SLAB_NUM, PROT_READ | PROT_WRITE,
+		    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (slab == MAP_FAILED) {
+		WD_ERR("failed to map ctx buffer slab!\n");
+		free(node);
+		return -WD_ENOMEM;
+	}
+
+	node->base = slab;
+	node->next = pool->slabs;
+	pool->slabs = node;
+	for (i = 0; i < HW_CTX_SLAB_NUM; i++) {
+		*(void **)(slab + i * HW_CTX_SIZE) = pool->free_list;
+		pool->free_list = slab + i * HW_CTX_SIZE;
+	}
+
+	return 0;
+}
+
+static void *wd_ctx_buf_get(__u8 *node)
+{
+	struct wd_ctx_buf_pool *pool;
+	void *buf = NULL;
+
+	*node = wd_ctx_buf_node();
+	pool = &wd_ctx_buf_pools[*node];
+
+	pthread_mutex_lock(&pool->lock);
+	if (pool->free_list || !wd_ctx_buf_add_slab(pool)) {
+		buf = pool->free_list;
+		pool->free_list = *(void **)buf;
+	}
+	pthread_mutex_unlock(&pool->lock);
+
+	/* a new stream needs a clean ctx, it's touched on local node here */
+	if (buf)
+		memset(buf, 0, HW_CTX_SIZE);
+
+	return buf;
+}
+
+static void wd_ctx_buf_put(void *buf, __u8 node)
+{
+	struct wd_ctx_buf_pool *pool = &wd_ctx_buf_pools[node];
+
+	pthread_mutex_lock(&pool->lock);
+	*(void **)buf = pool->free_list;
+	pool->free_list = buf;
+	pthread_mutex_unlock(&pool->lock);
+}
+
+static void __attribute__((destructor)) wd_ctx_buf_release(void)
+{
+	struct wd_ctx_buf_slab *slab, *next;
+	int i;
+
+	for (i = 0; i < HW_CTX_NODE_MAX; i++) {
+		for (slab = wd_ctx_buf_pools[i].slabs; slab; slab = next) {
+			next = slab->next;
+			munmap(slab->base, HW_CTX_SIZE * HW_CTX_SLAB_NUM);
+			free(slab);
+		}
+		wd_ctx_buf_pools[i].slabs = NULL;
+		wd_ctx_buf_pools[i].free_list = NULL;
+	}
+}
+
+/* release the ctx buffer, and the next request starts a new stream */
+static void wd_comp_end_stream(struct wd_comp_sess *sess)
+{
+	if (sess->ctx_buf) {
+		wd_ctx_buf_put(sess->ctx_buf, sess->ctx_buf_node);
+		sess->ctx_buf = NULL;
+	}
+
+	sess->stream_pos = WD_COMP_STREAM_NEW;
+	sess->isize = 0;
+	sess->checksum = 0;
+}
+
 #ifdef WD_STATIC_DRV
 extern struct wd_comp_driver wd_comp_hisi_zip;
 static void wd_comp_set_static_drv(void)
@@ -63,6 +260,8 @@ static void __attribute__((constructor)) wd_comp_open_driver(void)
 }
 #endif
 
+static void wd_comp_par_pool_stop(void);
+
 void wd_comp_set_driver(struct wd_comp_driver *drv)
 {
 	wd_comp_setting.driver = drv;
@@ -133,6 +332,7 @@ int wd_comp_init(struct wd_ctx_config *config, struct wd_sched *sched)
 		WD_ERR("failed to do driver init, ret = %d!\n", ret);
 		goto out_init;
 	}
+
 	return 0;
 
 out_init:
@@ -153,6 +353,7 @@ void wd_comp_uninit(void)
 	if (!priv)
 		return;
 
+	wd_comp_par_pool_stop();
 	wd_comp_setting.driver->exit(priv);
 	free(priv);
 	wd_comp_setting.priv = NULL;
@@ -223,19 +424,21 @@ handle_t wd_comp_alloc_sess(struct wd_comp_sess_setup *setup)
 	if (!setup)
 		return (handle_t)0;
 
+	if ((int)setup->comp_lv < 0 || setup->comp_lv > WD_COMP_L9 ||
+	    (int)setup->win_sz < 0 || setup->win_sz > WD_COMP_WS_32K) {
+		WD_ERR("invalid: comp_lv(%d) or win_sz(%d)!\n",
+		       setup->comp_lv, setup->win_sz);
+		return (handle_t)0;
+	}
+
 	sess = calloc(1, sizeof(struct wd_comp_sess));
 	if (!sess)
 		return (handle_t)0;
 
-	if (setup->mode == CTX_MODE_SYNC) {
-		sess->ctx_buf = calloc(1, HW_CTX_SIZE);
-		if (!sess->ctx_buf) {
-			free(sess);
-			return (handle_t)0;
-		}
-	}
-
 	sess->alg_type = setup->alg_type;
+	sess->comp_lv = setup->comp_lv;
+	sess->win_sz = setup->win_sz == WD_COMP_WS_DEF ?
+		       WD_COMP_WS_32K : setup->win_sz;
 	sess->stream_pos = WD_COMP_STREAM_NEW;
 
 	sess->key.mode = setup->mode;
@@ -252,12 +455,50 @@ void wd_comp_free_sess(handle_t h_sess)
 	if (!sess)
 		return;
 
-	if (sess->ctx_buf)
-		free(sess->ctx_buf);
-
+	wd_comp_end_stream(sess);
+	free(sess->dict);
 	free(sess);
 }
 
+int wd_comp_set_dict(handle_t h_sess, const void *dict, __u32 dict_len)
+{
+	struct wd_comp_sess *sess = (struct wd_comp_sess *)h_sess;
+	void *copy = NULL;
+
+	if (!sess || (dict_len && !dict)) {
+		WD_ERR("invalid: sess or dict is NULL!\n");
+		return -WD_EINVAL;
+	}
+
+	if (sess->alg_type == WD_GZIP) {
+		WD_ERR("invalid: gzip doesn't support preset dictionary!\n");
+		return -WD_EINVAL;
+	}
+
+	if (dict_len && !wd_comp_sw_supported()) {
+		WD_ERR("preset dictionary needs the software engine!\n");
+		return -WD_EINVAL;
+	}
+
+	if (sess->stream_pos != WD_COMP_STREAM_NEW) {
+		WD_ERR("invalid: dictionary is set in a stream!\n");
+		return -WD_EINVAL;
+	}
+
+	if (dict_len) {
+		copy = malloc(dict_len);
+		if (!copy)
+			return -WD_ENOMEM;
+		memcpy(copy, dict, dict_len);
+	}
+
+	free(sess->dict);
+	sess->dict = copy;
+	sess->dict_len = dict_len;
+
+	return 0;
+}
+
 static unsigned int bit_reverse(register unsigned int x)
 {
 	x = (((x & 0xaaaaaaaa) >> 1) | ((x & 0x55555555) << 1));
@@ -298,15 +539,181 @@ static int append_store_block(handle_t h_sess, struct wd_comp_req *req)
 	return 0;
 }
 
-static void fill_comp_msg(struct wd_comp_msg *msg, struct wd_comp_req *req)
+static void fill_comp_msg(struct wd_comp_sess *sess, struct wd_comp_msg *msg,
+			  struct wd_comp_req *req)
 {
 	memcpy(&msg->req, req, sizeof(struct wd_comp_req));
+	msg->alg_type = sess->alg_type;
+	msg->comp_lv = sess->comp_lv;
+	msg->win_sz = sess->win_sz;
 	msg->avail_out = req->dst_len;
+	msg->data_fmt = req->data_fmt;
 
 	/* if is last 1: flush end; other: sync flush */
 	msg->req.last = 1;
 }
 
+int wd_comp_set_sw_policy(struct wd_comp_sw_policy *policy)
+{
+	if (!policy) {
+		memset(&wd_comp_setting.sw_policy, 0,
+		       sizeof(struct wd_comp_sw_policy));
+		return 0;
+	}
+
+	/* stored blocks are framed without zlib */
+	if ((policy->small_thresh || policy->large_thresh ||
+	     policy->busy_fallback || policy->err_fallback) &&
+	    !wd_comp_sw_supported()) {
+		WD_ERR("invalid: sw engine isn't built in!\n");
+		return -WD_EINVAL;
+	}
+
+	if (policy->large_thresh && policy->small_thresh > policy->large_thresh) {
+		WD_ERR("invalid: small_thresh(%u) > large_thresh(%u)!\n",
+		       policy->small_thresh, policy->large_thresh);
+		return -WD_EINVAL;
+	}
+
+	memcpy(&wd_comp_setting.sw_policy, policy,
+	       sizeof(struct wd_comp_sw_policy));
+
+	return 0;
+}
+
+void wd_comp_get_engine_stat(struct wd_comp_engine_stat *stat)
+{
+	struct wd_comp_engine_stat *s = &wd_comp_setting.stat;
+
+	if (!stat)
+		return;
+
+	stat->hw_reqs = __atomic_load_n(&s->hw_reqs, __ATOMIC_RELAXED);
+	stat->sw_reqs = __atomic_load_n(&s->sw_reqs, __ATOMIC_RELAXED);
+	stat->sw_small = __atomic_load_n(&s->sw_small, __ATOMIC_RELAXED);
+	stat->sw_large = __atomic_load_n(&s->sw_large, __ATOMIC_RELAXED);
+	stat->sw_busy = __atomic_load_n(&s->sw_busy, __ATOMIC_RELAXED);
+	stat->sw_hw_err = __atomic_load_n(&s->sw_hw_err, __ATOMIC_RELAXED);
+	stat->precheck_reqs = __atomic_load_n(&s->precheck_reqs,
+					      __ATOMIC_RELAXED);
+	stat->stored_reqs = __atomic_load_n(&s->stored_reqs, __ATOMIC_RELAXED);
+}
+
+static inline void wd_comp_stat_inc(__u64 *cnt)
+{
+	__atomic_add_fetch(cnt, 1, __ATOMIC_RELAXED);
+}
+
+/* check whether a stateless request should go to CPU by its size */
+static bool wd_comp_sw_by_size(struct wd_comp_req *req)
+{
+	struct wd_comp_sw_policy *policy = &wd_comp_setting.sw_policy;
+
+	/* software engine only handles flat buffers */
+	if (req->data_fmt == WD_SGL_BUF)
+		return false;
+
+	if (req->src_len < policy->small_thresh) {
+		wd_comp_stat_inc(&wd_comp_setting.stat.sw_small);
+		return true;
+	}
+
+	if (policy->large_thresh && req->src_len > policy->large_thresh) {
+		wd_comp_stat_inc(&wd_comp_setting.stat.sw_large);
+		return true;
+	}
+
+	return false;
+}
+
+/* check whether a stateless request should go to CPU by hardware error */
+static bool wd_comp_sw_by_err(struct wd_comp_req *req, int err)
+{
+	struct wd_comp_sw_policy *policy = &wd_comp_setting.sw_policy;
+
+	if (req->data_fmt == WD_SGL_BUF)
+		return false;
+
+	if (err == -WD_EBUSY && policy->busy_fallback) {
+		wd_comp_stat_inc(&wd_comp_setting.stat.sw_busy);
+		return true;
+	}
+
+	if (err == -WD_HW_EACCESS && policy->err_fallback) {
+		wd_comp_stat_inc(&wd_comp_setting.stat.sw_hw_err);
+		return true;
+	}
+
+	return false;
+}
+
+/*
+ * Emit stored blocks for a stateless compression request if its input
+ * looks incompressible, return true if the request is done.
+ */
+static bool wd_comp_try_store(struct wd_comp_sess *sess,
+			      struct wd_comp_req *req)
+{
+	if (!wd_comp_setting.sw_policy.store_precheck ||
+	    req->op_type != WD_DIR_COMPRESS || req->data_fmt == WD_SGL_BUF)
+		return false;
+
+	/* leave it to the engine if dst couldn't hold the stored blocks */
+	if (req->dst_len < wd_comp_sw_store_bound(sess->alg_type, req->src_len))
+		return false;
+
+	wd_comp_stat_inc(&wd_comp_setting.stat.precheck_reqs);
+	if (!wd_comp_sw_incompressible(req->src, req->src_len))
+		return false;
+
+	if (wd_comp_sw_store(sess->alg_type, req))
+		return false;
+
+	wd_comp_stat_inc(&wd_comp_setting.stat.stored_reqs);
+
+	return true;
+}
+
+static int wd_comp_do_sw(struct wd_comp_sess *sess, struct wd_comp_req *req)
+{
+	int ret;
+
+	ret = wd_comp_sw_do(sess->alg_type, sess->comp_lv, sess->win_sz,
+			    sess->dict, sess->dict_len, req);
+	if (ret < 0)
+		return ret;
+
+	wd_comp_stat_inc(&wd_comp_setting.stat.sw_reqs);
+
+	return 0;
+}
+
+static int wd_comp_do_sw_async(struct wd_comp_sess *sess,
+			       struct wd_comp_req *req)
+{
+	int ret;
+
+	ret = wd_comp_do_sw(sess, req);
+	if (ret < 0)
+		return ret;
+
+	/* async request done by CPU, report it at once */
+	req->cb(req, req->cb_param);
+
+	return 0;
+}
+
+/* the hardware has no input of preset dictionary, zlib handles it */
+static int wd_comp_do_dict(struct wd_comp_sess *sess, struct wd_comp_req *req)
+{
+	if (req->data_fmt == WD_SGL_BUF) {
+		WD_ERR("invalid: dictionary doesn't support sgl!\n");
+		return -WD_EINVAL;
+	}
+
+	return wd_comp_do_sw(sess, req);
+}
+
 int wd_do_comp_sync(handle_t h_sess, struct wd_comp_req *req)
 {
 	struct wd_ctx_config_internal *config = &wd_comp_setting.config;
@@ -329,6 +736,15 @@ int wd_do_comp_sync(handle_t h_sess, struct wd_comp_req *req)
 		return -WD_EINVAL;
 	}
 
+	if (sess->dict)
+		return wd_comp_do_dict(sess, req);
+
+	if (wd_comp_try_store(sess, req))
+		return 0;
+
+	if (wd_comp_sw_by_size(req))
+		return wd_comp_do_sw(sess, req);
+
 	memset(&msg, 0, sizeof(struct wd_comp_msg));
 	memset(&resp_msg, 0, sizeof(struct wd_comp_msg));
 
@@ -344,9 +760,7 @@ int wd_do_comp_sync(handle_t h_sess, struct wd_comp_req *req)
 		WD_ERR("ctx %u mode = %hhu error!\n", index, ctx->ctx_mode);
 		return -WD_EINVAL;
 	}
-	fill_comp_msg(&msg, req);
-	msg.ctx_buf = sess->ctx_buf;
-	msg.alg_type = sess->alg_type;
+	fill_comp_msg(sess, &msg, req);
 	msg.stream_mode = WD_COMP_STATELESS;
 
 	pthread_spin_lock(&ctx->lock);
@@ -354,15 +768,18 @@ int wd_do_comp_sync(handle_t h_sess, struct wd_comp_req *req)
 	ret = wd_comp_setting.driver->comp_send(ctx->ctx, &msg, priv);
 	if (ret < 0) {
 		pthread_spin_unlock(&ctx->lock);
+		if (wd_comp_sw_by_err(req, ret))
+			return wd_comp_do_sw(sess, req);
 		WD_ERR("wd comp send err(%d)!\n", ret);
 		return ret;
 	}
-	resp_msg.ctx_buf = sess->ctx_buf;
 	do {
 		ret = wd_comp_setting.driver->comp_recv(ctx->ctx, &resp_msg,
 							priv);
 		if (ret == -WD_HW_EACCESS) {
 			pthread_spin_unlock(&ctx->lock);
+			if (wd_comp_sw_by_err(req, ret))
+				return wd_comp_do_sw(sess, req);
 			WD_ERR("wd comp recv hw err!\n");
 			return ret;
 		} else if (ret == -WD_EAGAIN) {
@@ -379,12 +796,153 @@ int wd_do_comp_sync(handle_t h_sess, struct wd_comp_req *req)
 	req->src_len = resp_msg.in_cons;
 	req->dst_len = resp_msg.produced;
 	req->status = resp_msg.req.status;
+	wd_comp_stat_inc(&wd_comp_setting.stat.hw_reqs);
 
 	return 0;
 }
 
+handle_t wd_comp_page_alloc(handle_t h_sess, __u32 page_size)
+{
+	struct wd_ctx_config_internal *config = &wd_comp_setting.config;
+	struct wd_comp_sess *sess = (struct wd_comp_sess *)h_sess;
+	handle_t h_sched_ctx = wd_comp_setting.sched.h_sched_ctx;
+	struct wd_comp_page_ctx *pctx;
+	struct wd_ctx_internal *ctx;
+	struct wd_comp_req req;
+	__u32 index;
+
+	if (!sess || !page_size) {
+		WD_ERR("invalid: sess is NULL or page_size is 0!\n");
+		return (handle_t)0;
+	}
+
+	if (sess->key.mode != CTX_MODE_SYNC) {
+		WD_ERR("invalid: page requests need a sync session!\n");
+		return (handle_t)0;
+	}
+
+	if (sess->dict) {
+		WD_ERR("invalid: page requests don't support dictionary!\n");
+		return (handle_t)0;
+	}
+
+	memset(&req, 0, sizeof(struct wd_comp_req));
+	req.op_type = sess->key.type;
+	index = wd_comp_setting.sched.pick_next_ctx(h_sched_ctx, &req,
+						    &sess->key);
+	if (index >= config->ctx_num) {
+		WD_ERR("fail to pick a proper ctx!\n");
+		return (handle_t)0;
+	}
+	ctx = config->ctxs + index;
+	if (ctx->ctx_mode != CTX_MODE_SYNC) {
+		WD_ERR("ctx %u mode = %hhu error!\n", index, ctx->ctx_mode);
+		return (handle_t)0;
+	}
+
+	pctx = calloc(1, sizeof(struct wd_comp_page_ctx));
+	if (!pctx)
+		return (handle_t)0;
+
+	pctx->sess = sess;
+	pctx->ctx = ctx;
+	pctx->page_size = page_size;
+	pctx->msg.req.op_type = sess->key.type;
+	pctx->msg.req.data_fmt = WD_FLAT_BUF;
+	pctx->msg.req.last = 1;
+	pctx->msg.alg_type = sess->alg_type;
+	pctx->msg.comp_lv = sess->comp_lv;
+	pctx->msg.win_sz = sess->win_sz;
+	pctx->msg.data_fmt = WD_FLAT_BUF;
+	pctx->msg.stream_mode = WD_COMP_STATELESS;
+
+	return (handle_t)pctx;
+}
+
+void wd_comp_page_free(handle_t h_page)
+{
+	free((struct wd_comp_page_ctx *)h_page);
+}
+
+int wd_do_comp_page_batch(handle_t h_page, struct wd_comp_page *pages,
+			  __u32 num)
+{
+	struct wd_comp_page_ctx *pctx = (struct wd_comp_page_ctx *)h_page;
+	struct wd_comp_driver *driver = wd_comp_setting.driver;
+	void *priv = wd_comp_setting.priv;
+	struct wd_comp_msg *msg, resp_msg;
+	struct wd_ctx_internal *ctx;
+	__u32 sent = 0, done = 0;
+	__u64 recv_count = 0;
+	int ret = 0, err;
+
+	if (unlikely(!pctx || !pages || !num)) {
+		WD_ERR("invalid: page handle or pages is NULL, or num is 0!\n");
+		return -WD_EINVAL;
+	}
+
+	ctx = pctx->ctx;
+	msg = &pctx->msg;
+	pthread_spin_lock(&ctx->lock);
+
+	/*
+	 * Keep the queue full, and reap pages in any order by their tag. If
+	 * a page fails to be sent, pages in flight are still reaped, so the
+	 * ctx is left clean for the next caller.
+	 */
+	while (done < num) {
+		while (!ret && sent < num) {
+			msg->req.src = pages[sent].src;
+			msg->req.src_len = msg->req.op_type == WD_DIR_COMPRESS ?
+					   pctx->page_size : pages[sent].src_len;
+			msg->req.dst = pages[sent].dst;
+			msg->avail_out = pages[sent].dst_len;
+			msg->tag = sent;
+			ret = driver->comp_send(ctx->ctx, msg, priv);
+			if (ret == -WD_EBUSY && sent > done) {
+				ret = 0;
+				break;
+			}
+			if (ret < 0)
+				break;
+			sent++;
+		}
+
+		if (done == sent)
+			break;
+
+		memset(&resp_msg, 0, sizeof(struct wd_comp_msg));
+		err = driver->comp_recv(ctx->ctx, &resp_msg, priv);
+		if (err == -WD_EAGAIN) {
+			if (++recv_count > MAX_RETRY_COUNTS) {
+				ret = -WD_ETIMEDOUT;
+				break;
+			}
+			continue;
+		} else if (err < 0 || unlikely(resp_msg.tag >= sent)) {
+			ret = err < 0 ? err : -WD_EINVAL;
+			break;
+		}
+
+		recv_count = 0;
+		pages[resp_msg.tag].dst_len = resp_msg.produced;
+		pages[resp_msg.tag].status = resp_msg.req.status;
+		done++;
+	}
+
+	pthread_spin_unlock(&ctx->lock);
+	__atomic_add_fetch(&wd_comp_setting.stat.hw_reqs, done,
+			   __ATOMIC_RELAXED);
+	if (ret < 0)
+		WD_ERR("failed to do page batch, %u of %u done(%d)!\n",
+		       done, num, ret);
+
+	return ret;
+}
+
 int wd_do_comp_sync2(handle_t h_sess, struct wd_comp_req *req)
 {
+	struct wd_comp_sess *sess = (struct wd_comp_sess *)h_sess;
 	struct wd_comp_req strm_req;
 	__u32 total_avail_out = req->dst_len;
 	__u32 chunk = STREAM_CHUNK;
@@ -407,6 +965,11 @@ int wd_do_comp_sync2(handle_t h_sess, struct wd_comp_req *req)
 		return -WD_EINVAL;
 	}
 
+	if (req->data_fmt == WD_SGL_BUF) {
+		WD_ERR("invalid: sync2 only supports flat buffer!\n");
+		return -WD_EINVAL;
+	}
+
 	dbg("do, op_type = %hhu, in =%u, out_len =%u\n",
 	    req->op_type, req->src_len, req->dst_len);
 
@@ -435,21 +998,25 @@ int wd_do_comp_sync2(handle_t h_sess, struct wd_comp_req *req)
 				dbg("append_store, src_len=%u, dst_len=%u\n",
 				    req->src_len, req->dst_len);
 				ret = append_store_block(h_sess, &strm_req);
+				if (ret)
+					goto out_end;
 				req->dst_len += strm_req.dst_len;
 				req->status = 0;
-				return 0;
+				goto out_end;
 			}
 			dbg("do, strm start, in =%u, out_len =%u\n",
 			    strm_req.src_len, strm_req.dst_len);
-			if (req->dst_len + strm_req.src_len > total_avail_out)
-				return -WD_ENOMEM;
+			if (req->dst_len + strm_req.src_len > total_avail_out) {
+				ret = -WD_ENOMEM;
+				goto out_end;
+			}
 			strm_req.dst_len = avail_out > chunk ? chunk : avail_out;
 			ret = wd_do_comp_strm(h_sess, &strm_req);
 			if (ret < 0 || strm_req.status == WD_IN_EPARA) {
 				WD_ERR("wd comp, invalid or incomplete data! "
 				       "ret(%d), req.status(%u)\n",
 				       ret, strm_req.status);
-				return ret;
+				goto out_end;
 			}
 			req->dst_len += strm_req.dst_len;
 			strm_req.dst += strm_req.dst_len;
@@ -472,8 +1039,15 @@ int wd_do_comp_sync2(handle_t h_sess, struct wd_comp_req *req)
 	dbg("end, in =%u, out_len =%u\n", req->src_len, req->dst_len);
 
 	req->status = 0;
+	ret = 0;
 
-	return 0;
+out_end:
+	/*
+	 * The whole input is taken by one call, so the stream is over however
+	 * it returns, and the next call starts a new one.
+	 */
+	wd_comp_end_stream(sess);
+	return ret;
 }
 
 
@@ -494,6 +1068,11 @@ int wd_do_comp_strm(handle_t h_sess, struct wd_comp_req *req)
 		return -WD_EINVAL;
 	}
 
+	if (sess->dict) {
+		WD_ERR("invalid: stream doesn't support preset dictionary!\n");
+		return -WD_EINVAL;
+	}
+
 	index = wd_comp_setting.sched.pick_next_ctx(h_sched_ctx,
 						    req,
 						    &sess->key);
@@ -507,10 +1086,15 @@ int wd_do_comp_strm(handle_t h_sess, struct wd_comp_req *req)
 		return -WD_EINVAL;
 	}
 
-	fill_comp_msg(&msg, req);
+	if (!sess->ctx_buf) {
+		sess->ctx_buf = wd_ctx_buf_get(&sess->ctx_buf_node);
+		if (!sess->ctx_buf)
+			return -WD_ENOMEM;
+	}
+
+	fill_comp_msg(sess, &msg, req);
 	msg.stream_pos = sess->stream_pos;
 	msg.ctx_buf = sess->ctx_buf;
-	msg.alg_type = sess->alg_type;
 	msg.isize = sess->isize;
 	msg.checksum = sess->checksum;
 	/* fill true flag */
@@ -552,21 +1136,1211 @@ int wd_do_comp_strm(handle_t h_sess, struct wd_comp_req *req)
 
 	sess->stream_pos = WD_COMP_STREAM_OLD;
 
+	/*
+	 * Compression ends when the last input is consumed with room left in
+	 * dst, otherwise some output may be still pending in the hardware.
+	 */
+	if ((req->op_type == WD_DIR_DECOMPRESS &&
+	     req->status == WD_STREAM_END) ||
+	    (req->op_type == WD_DIR_COMPRESS && req->last && !req->status &&
+	     resp_msg.in_cons == msg.req.src_len &&
+	     resp_msg.produced < msg.avail_out))
+		wd_comp_end_stream(sess);
+
 	return 0;
 }
 
-int wd_do_comp_async(handle_t h_sess, struct wd_comp_req *req)
+struct wd_comp_out {
+	wd_comp_sink_t *sink;
+	wd_comp_alloc_t *alloc;
+	void *param;
+	/* staging buffer of sink mode */
+	void *buf;
+	__u32 buf_size;
+	/* current node and tail link of chain mode */
+	struct wd_datalist *cur;
+	struct wd_datalist **tail;
+};
+
+static int wd_comp_out_get(struct wd_comp_out *out, void **buf, __u32 *size)
 {
-	struct wd_ctx_config_internal *config = &wd_comp_setting.config;
-	struct wd_comp_sess *sess = (struct wd_comp_sess *)h_sess;
-	handle_t h_sched_ctx = wd_comp_setting.sched.h_sched_ctx;
-	void *priv = wd_comp_setting.priv;
-	struct wd_ctx_internal *ctx;
-	struct wd_comp_msg *msg;
-	__u32 index;
-	int idx, ret;
+	struct wd_datalist *node;
 
-	if (!sess || !req) {
+	if (out->sink) {
+		*buf = out->buf;
+		*size = out->buf_size;
+		return 0;
+	}
+
+	node = out->alloc(out->param);
+	if (!node || !node->data || !node->len) {
+		WD_ERR("failed to alloc output buffer!\n");
+		return -WD_ENOMEM;
+	}
+
+	node->next = NULL;
+	*out->tail = node;
+	out->tail = &node->next;
+	out->cur = node;
+	*buf = node->data;
+	*size = node->len;
+
+	return 0;
+}
+
+static int wd_comp_out_put(struct wd_comp_out *out, void *buf, __u32 used)
+{
+	int ret;
+
+	if (!out->sink) {
+		out->cur->len = used;
+		return 0;
+	}
+
+	if (!used)
+		return 0;
+
+	ret = out->sink(buf, used, out->param);
+	if (ret < 0) {
+		WD_ERR("output sink is aborted(%d)!\n", ret);
+		return ret;
+	}
+
+	return 0;
+}
+
+/* decompress in stream mode, hand over output buffer as soon as it's full */
+static int wd_comp_strm_out(handle_t h_sess, struct wd_comp_req *req,
+			    struct wd_comp_out *out)
+{
+	struct wd_comp_req strm_req;
+	__u32 avail_in = req->src_len;
+	__u32 consumed = 0;
+	__u32 size = 0;
+	__u32 used = 0;
+	void *buf = NULL;
+	int ret;
+
+	memcpy(&strm_req, req, sizeof(struct wd_comp_req));
+	strm_req.last = 0;
+
+	while (1) {
+		if (!buf) {
+			ret = wd_comp_out_get(out, &buf, &size);
+			if (ret)
+				return ret;
+			used = 0;
+		}
+
+		strm_req.src = req->src + consumed;
+		strm_req.src_len = avail_in > STREAM_CHUNK ?
+				   STREAM_CHUNK : avail_in;
+		strm_req.dst = buf + used;
+		strm_req.dst_len = size - used > STREAM_CHUNK ?
+				   STREAM_CHUNK : size - used;
+		ret = wd_do_comp_strm(h_sess, &strm_req);
+		if (ret < 0 || strm_req.status == WD_IN_EPARA) {
+			WD_ERR("wd comp, invalid or incomplete data! "
+			       "ret(%d), req.status(%u)\n",
+			       ret, strm_req.status);
+			return ret < 0 ? ret : -WD_EINVAL;
+		}
+
+		consumed += strm_req.src_len;
+		avail_in -= strm_req.src_len;
+		used += strm_req.dst_len;
+
+		if (strm_req.status == WD_STREAM_END)
+			break;
+
+		if (used == size ||
+		    (!strm_req.src_len && !strm_req.dst_len)) {
+			/* no progress with empty buffer, avoid endless loop */
+			if (!used) {
+				WD_ERR("wd comp, no progress in stream!\n");
+				return -WD_EIO;
+			}
+			ret = wd_comp_out_put(out, buf, used);
+			if (ret)
+				return ret;
+			buf = NULL;
+			continue;
+		}
+
+		/* all input is consumed, and no more data is in hardware */
+		if (!avail_in && strm_req.status != WD_EAGAIN)
+			break;
+	}
+
+	ret = wd_comp_out_put(out, buf, used);
+	if (ret)
+		return ret;
+
+	req->src_len = consumed;
+	req->status = strm_req.status;
+
+	return 0;
+}
+
+static int wd_comp_check_out_req(handle_t h_sess, struct wd_comp_req *req)
+{
+	if (!h_sess || !req) {
+		WD_ERR("invalid: sess or req is NULL!\n");
+		return -WD_EINVAL;
+	}
+
+	if (req->op_type != WD_DIR_DECOMPRESS) {
+		WD_ERR("invalid: only decompression is supported!\n");
+		return -WD_EINVAL;
+	}
+
+	if (!req->src_len || req->data_fmt == WD_SGL_BUF) {
+		WD_ERR("invalid: req src_len is 0 or src is sgl!\n");
+		return -WD_EINVAL;
+	}
+
+	return 0;
+}
+
+int wd_do_comp_sync_sink(handle_t h_sess, struct wd_comp_req *req,
+			 wd_comp_sink_t *sink, void *param)
+{
+	struct wd_comp_out out = {0};
+	int ret;
+
+	ret = wd_comp_check_out_req(h_sess, req);
+	if (ret)
+		return ret;
+
+	if (!sink) {
+		WD_ERR("invalid: sink is NULL!\n");
+		return -WD_EINVAL;
+	}
+
+	out.sink = sink;
+	out.param = param;
+	if (req->dst && req->dst_len) {
+		out.buf = req->dst;
+		out.buf_size = req->dst_len;
+	} else {
+		out.buf = malloc(STREAM_CHUNK);
+		if (!out.buf)
+			return -WD_ENOMEM;
+		out.buf_size = STREAM_CHUNK;
+	}
+
+	ret = wd_comp_strm_out(h_sess, req, &out);
+
+	if (out.buf != req->dst)
+		free(out.buf);
+
+	return ret;
+}
+
+int wd_do_comp_sync_chain(handle_t h_sess, struct wd_comp_req *req,
+			  wd_comp_alloc_t *alloc, void *param,
+			  struct wd_datalist **list)
+{
+	struct wd_comp_out out = {0};
+	int ret;
+
+	ret = wd_comp_check_out_req(h_sess, req);
+	if (ret)
+		return ret;
+
+	if (!alloc || !list) {
+		WD_ERR("invalid: alloc or list is NULL!\n");
+		return -WD_EINVAL;
+	}
+
+	*list = NULL;
+	out.alloc = alloc;
+	out.param = param;
+	out.tail = list;
+
+	return wd_comp_strm_out(h_sess, req, &out);
+}
+
+/* run stateless sync requests on all sync ctxs of the session's op type */
+struct wd_comp_par {
+	struct wd_comp_sess *sess;
+	struct wd_comp_req *reqs;
+	__u32 num;
+	__u32 next;
+	int ret;
+	/* take the result of request i, and return the one to keep */
+	int (*check)(struct wd_comp_par *par, __u32 i, int ret);
+	void *param;
+	/* pool workers on the job, at most max of them, under the pool lock */
+	__u32 busy;
+	__u32 max;
+	struct wd_comp_par *next_job;
+};
+
+/*
+ * Workers of parallel requests, one less than the sync ctxs of an op type,
+ * created by the first parallel request and kept until wd_comp_uninit(). A
+ * caller queues its job and works on it too, and idle workers join the
+ * queued jobs.
+ */
+struct wd_comp_par_pool {
+	pthread_mutex_t lock;
+	pthread_cond_t work;
+	pthread_cond_t idle;
+	struct wd_comp_par *jobs;
+	pthread_t threads[WD_COMP_PAR_MAX];
+	__u32 thread_num;
+	bool started;
+	bool stop;
+};
+
+static struct wd_comp_par_pool wd_comp_par_pool = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.work = PTHREAD_COND_INITIALIZER,
+	.idle = PTHREAD_COND_INITIALIZER,
+};
+
+static __u32 wd_comp_par_ctx_num(struct wd_comp_sess *sess)
+{
+	struct wd_ctx_config_internal *config = &wd_comp_setting.config;
+	__u32 num = 0;
+	__u32 i;
+
+	for (i = 0; i < config->ctx_num; i++)
+		if (config->ctxs[i].ctx_mode == CTX_MODE_SYNC &&
+		    config->ctxs[i].op_type == sess->key.type)
+			num++;
+
+	return num;
+}
+
+static int wd_comp_par_do(handle_t h_sess, struct wd_comp_req *req)
+{
+	int ret;
+
+	ret = wd_do_comp_sync(h_sess, req);
+	if (ret < 0)
+		return ret;
+
+	if (req->status == WD_IN_EPARA || req->status == WD_EAGAIN) {
+		WD_ERR("wd comp, invalid data or no space! status(%u)\n",
+		       req->status);
+		return -WD_EINVAL;
+	}
+
+	return 0;
+}
+
+static int wd_comp_par_one(struct wd_comp_par *par, __u32 i)
+{
+	/* stateless requests don't touch the session, so it's shared */
+	int ret = wd_comp_par_do((handle_t)par->sess, par->reqs + i);
+
+	if (par->check)
+		ret = par->check(par, i, ret);
+
+	return ret;
+}
+
+static void *wd_comp_par_worker(void *arg)
+{
+	struct wd_comp_par *par = arg;
+	__u32 i;
+	int ret;
+
+	while (!__atomic_load_n(&par->ret, __ATOMIC_RELAXED)) {
+		i = __atomic_fetch_add(&par->next, 1, __ATOMIC_RELAXED);
+		if (i >= par->num)
+			break;
+
+		ret = wd_comp_par_one(par, i);
+		if (ret)
+			__atomic_store_n(&par->ret, ret, __ATOMIC_RELAXED);
+	}
+
+	return NULL;
+}
+
+/* the caller holds the pool lock */
+static struct wd_comp_par *wd_comp_par_pick(struct wd_comp_par_pool *pool)
+{
+	struct wd_comp_par *par;
+
+	for (par = pool->jobs; par; par = par->next_job)
+		if (par->busy < par->max && !par->ret &&
+		    __atomic_load_n(&par->next, __ATOMIC_RELAXED) < par->num)
+			return par;
+
+	return NULL;
+}
+
+static void *wd_comp_par_thread(void *arg)
+{
+	struct wd_comp_par_pool *pool = arg;
+	struct wd_comp_par *par;
+
+	pthread_mutex_lock(&pool->lock);
+	while (!pool->stop) {
+		par = wd_comp_par_pick(pool);
+		if (!par) {
+			pthread_cond_wait(&pool->work, &pool->lock);
+			continue;
+		}
+
+		par->busy++;
+		pthread_mutex_unlock(&pool->lock);
+		wd_comp_par_worker(par);
+		pthread_mutex_lock(&pool->lock);
+		if (!--par->busy)
+			pthread_cond_broadcast(&pool->idle);
+	}
+	pthread_mutex_unlock(&pool->lock);
+
+	return NULL;
+}
+
+/* the caller holds the pool lock */
+static void wd_comp_par_pool_start(void)
+{
+	struct wd_ctx_config_internal *config = &wd_comp_setting.config;
+	struct wd_comp_par_pool *pool = &wd_comp_par_pool;
+	__u32 sync_num[WD_DIR_DECOMPRESS + 1] = {0};
+	__u32 num, i;
+	int ret;
+
+	for (i = 0; i < config->ctx_num; i++)
+		if (config->ctxs[i].ctx_mode == CTX_MODE_SYNC &&
+		    config->ctxs[i].op_type <= WD_DIR_DECOMPRESS)
+			sync_num[config->ctxs[i].op_type]++;
+
+	num = sync_num[WD_DIR_COMPRESS] > sync_num[WD_DIR_DECOMPRESS] ?
+	      sync_num[WD_DIR_COMPRESS] : sync_num[WD_DIR_DECOMPRESS];
+	if (num > WD_COMP_PAR_MAX)
+		num = WD_COMP_PAR_MAX;
+
+	/* the caller is a worker of its own job */
+	for (i = 0; i + 1 < num; i++) {
+		ret = pthread_create(&pool->threads[i], NULL,
+				     wd_comp_par_thread, pool);
+		if (ret) {
+			/* fewer workers only lower the parallelism */
+			WD_ERR("failed to create comp worker(%d)!\n", ret);
+			break;
+		}
+	}
+	pool->thread_num = i;
+	pool->started = true;
+}
+
+static void wd_comp_par_pool_stop(void)
+{
+	struct wd_comp_par_pool *pool = &wd_comp_par_pool;
+	__u32 i;
+
+	pthread_mutex_lock(&pool->lock);
+	if (!pool->started) {
+		pthread_mutex_unlock(&pool->lock);
+		return;
+	}
+	pool->stop = true;
+	pthread_cond_broadcast(&pool->work);
+	pthread_mutex_unlock(&pool->lock);
+
+	for (i = 0; i < pool->thread_num; i++)
+		pthread_join(pool->threads[i], NULL);
+
+	pool->thread_num = 0;
+	pool->started = false;
+	pool->stop = false;
+}
+
+static int wd_comp_par_run_check(struct wd_comp_sess *sess,
+				 struct wd_comp_req *reqs, __u32 num,
+				 int (*check)(struct wd_comp_par *par,
+					      __u32 i, int ret),
+				 void *param)
+{
+	struct wd_comp_par_pool *pool = &wd_comp_par_pool;
+	struct wd_comp_par par = {0};
+	struct wd_comp_par **link;
+	__u32 thread_num, i;
+	int ret;
+
+	par.sess = sess;
+	par.reqs = reqs;
+	par.num = num;
+	par.check = check;
+	par.param = param;
+
+	thread_num = wd_comp_par_ctx_num(sess);
+	if (thread_num > num)
+		thread_num = num;
+	if (thread_num > WD_COMP_PAR_MAX)
+		thread_num = WD_COMP_PAR_MAX;
+
+	if (thread_num <= 1) {
+		for (i = 0; i < num; i++) {
+			ret = wd_comp_par_one(&par, i);
+			if (ret)
+				return ret;
+		}
+		return 0;
+	}
+
+	par.max = thread_num - 1;
+
+	pthread_mutex_lock(&pool->lock);
+	if (!pool->started)
+		wd_comp_par_pool_start();
+	for (link = &pool->jobs; *link; link = &(*link)->next_job)
+		;
+	*link = &par;
+	pthread_cond_broadcast(&pool->work);
+	pthread_mutex_unlock(&pool->lock);
+
+	wd_comp_par_worker(&par);
+
+	/* no worker joins after the job is unlinked */
+	pthread_mutex_lock(&pool->lock);
+	for (link = &pool->jobs; *link != &par; link = &(*link)->next_job)
+		;
+	*link = par.next_job;
+	while (par.busy)
+		pthread_cond_wait(&pool->idle, &pool->lock);
+	pthread_mutex_unlock(&pool->lock);
+
+	return par.ret;
+}
+
+static int wd_comp_par_run(struct wd_comp_sess *sess, struct wd_comp_req *reqs,
+			   __u32 num)
+{
+	return wd_comp_par_run_check(sess, reqs, num, NULL, NULL);
+}
+
+struct wd_frame_index {
+	__u32 comp_len;
+	__u32 orig_len;
+};
+
+struct wd_frame_trailer {
+	__u32 magic;
+	__u32 alg_type;
+	__u32 block_size;
+	__u32 block_num;
+};
+
+#define WD_FRAME_TAIL_SIZE(num) \
+	((__u64)(num) * sizeof(struct wd_frame_index) + \
+	 sizeof(struct wd_frame_trailer))
+
+static __u32 wd_frame_block_len(__u32 total, __u32 block_size, __u32 i,
+				__u32 block_num)
+{
+	return i == block_num - 1 ? total - i * block_size : block_size;
+}
+
+int wd_comp_frame_compress(handle_t h_sess, struct wd_comp_req *req,
+			   __u32 block_size)
+{
+	struct wd_comp_sess *sess = (struct wd_comp_sess *)h_sess;
+	struct wd_frame_trailer *trailer;
+	struct wd_frame_index *index;
+	struct wd_comp_req *reqs;
+	__u32 block_num, wave, out_size;
+	__u32 produced = 0;
+	__u32 i, j, n;
+	void *tmp;
+	int ret;
+
+	if (!sess || !req || !req->src_len || req->data_fmt == WD_SGL_BUF) {
+		WD_ERR("invalid: sess, req or src is NULL!\n");
+		return -WD_EINVAL;
+	}
+
+	if (sess->key.type != WD_DIR_COMPRESS) {
+		WD_ERR("invalid: frame needs a compression session!\n");
+		return -WD_EINVAL;
+	}
+
+	if (!block_size)
+		block_size = STREAM_CHUNK;
+	if (block_size > WD_FRAME_BLOCK_MAX) {
+		WD_ERR("invalid: block_size(%u) is too large!\n", block_size);
+		return -WD_EINVAL;
+	}
+
+	block_num = (req->src_len - 1) / block_size + 1;
+	if (req->dst_len < WD_FRAME_TAIL_SIZE(block_num)) {
+		WD_ERR("invalid: dst_len(%u) is too small!\n", req->dst_len);
+		return -WD_ENOMEM;
+	}
+
+	index = malloc(WD_FRAME_TAIL_SIZE(block_num));
+	if (!index)
+		return -WD_ENOMEM;
+
+	/* compress a wave of blocks in parallel, then append them in order */
+	wave = wd_comp_par_ctx_num(sess);
+	if (!wave)
+		wave = 1;
+	if (wave > WD_COMP_PAR_MAX)
+		wave = WD_COMP_PAR_MAX;
+	if (wave > block_num)
+		wave = block_num;
+
+	out_size = block_size * WD_FRAME_EXPANSION;
+	reqs = calloc(wave, sizeof(struct wd_comp_req));
+	tmp = malloc((size_t)wave * out_size);
+	if (!reqs || !tmp) {
+		ret = -WD_ENOMEM;
+		goto out;
+	}
+
+	for (i = 0; i < block_num; i += n) {
+		n = block_num - i > wave ? wave : block_num - i;
+		for (j = 0; j < n; j++) {
+			reqs[j].src = req->src + (size_t)(i + j) * block_size;
+			reqs[j].src_len = wd_frame_block_len(req->src_len,
+						block_size, i + j, block_num);
+			reqs[j].dst = tmp + (size_t)j * out_size;
+			reqs[j].dst_len = out_size;
+			reqs[j].op_type = WD_DIR_COMPRESS;
+			reqs[j].data_fmt = WD_FLAT_BUF;
+		}
+
+		ret = wd_comp_par_run(sess, reqs, n);
+		if (ret)
+			goto out;
+
+		for (j = 0; j < n; j++) {
+			if (reqs[j].src_len != wd_frame_block_len(req->src_len,
+						block_size, i + j, block_num)) {
+				WD_ERR("wd comp, block %u isn't fully consumed!\n",
+				       i + j);
+				ret = -WD_EIO;
+				goto out;
+			}
+			if (reqs[j].dst_len >
+			    req->dst_len - produced - WD_FRAME_TAIL_SIZE(block_num)) {
+				WD_ERR("invalid: dst_len(%u) is too small!\n",
+				       req->dst_len);
+				ret = -WD_ENOMEM;
+				goto out;
+			}
+			memcpy(req->dst + produced, reqs[j].dst,
+			       reqs[j].dst_len);
+			produced += reqs[j].dst_len;
+			index[i + j].comp_len = reqs[j].dst_len;
+			index[i + j].orig_len = reqs[j].src_len;
+		}
+	}
+
+	trailer = (struct wd_frame_trailer *)(index + block_num);
+	trailer->magic = WD_FRAME_MAGIC;
+	trailer->alg_type = sess->alg_type;
+	trailer->block_size = block_size;
+	trailer->block_num = block_num;
+	memcpy(req->dst + produced, index, WD_FRAME_TAIL_SIZE(block_num));
+	req->dst_len = produced + WD_FRAME_TAIL_SIZE(block_num);
+	req->status = 0;
+	ret = 0;
+out:
+	free(tmp);
+	free(reqs);
+	free(index);
+	return ret;
+}
+
+static struct wd_frame_trailer *wd_frame_get_trailer(void *frame,
+						     __u32 frame_len)
+{
+	struct wd_frame_trailer *trailer;
+	struct wd_frame_index *index;
+	__u64 comp_len = 0;
+	__u32 i;
+
+	if (!frame || frame_len < sizeof(struct wd_frame_trailer)) {
+		WD_ERR("invalid: frame is NULL or too short!\n");
+		return NULL;
+	}
+
+	trailer = frame + frame_len - sizeof(struct wd_frame_trailer);
+	if (trailer->magic != WD_FRAME_MAGIC || !trailer->block_num ||
+	    !trailer->block_size ||
+	    WD_FRAME_TAIL_SIZE(trailer->block_num) > frame_len) {
+		WD_ERR("invalid: bad frame trailer!\n");
+		return NULL;
+	}
+
+	index = (struct wd_frame_index *)trailer - trailer->block_num;
+	for (i = 0; i < trailer->block_num; i++) {
+		if (index[i].orig_len > trailer->block_size ||
+		    (i < trailer->block_num - 1 &&
+		     index[i].orig_len != trailer->block_size)) {
+			WD_ERR("invalid: bad frame index %u!\n", i);
+			return NULL;
+		}
+		comp_len += index[i].comp_len;
+	}
+
+	if (comp_len + WD_FRAME_TAIL_SIZE(trailer->block_num) != frame_len) {
+		WD_ERR("invalid: frame length mismatch!\n");
+		return NULL;
+	}
+
+	return trailer;
+}
+
+int wd_comp_frame_info(void *frame, __u32 frame_len, __u64 *orig_len,
+		       __u32 *block_num)
+{
+	struct wd_frame_trailer *trailer;
+	struct wd_frame_index *index;
+
+	trailer = wd_frame_get_trailer(frame, frame_len);
+	if (!trailer)
+		return -WD_EINVAL;
+
+	index = (struct wd_frame_index *)trailer - trailer->block_num;
+	if (orig_len)
+		*orig_len = (__u64)(trailer->block_num - 1) *
+			    trailer->block_size +
+			    index[trailer->block_num - 1].orig_len;
+	if (block_num)
+		*block_num = trailer->block_num;
+
+	return 0;
+}
+
+int wd_comp_read_range(handle_t h_sess, void *frame, __u32 frame_len,
+		       __u64 offset, void *dst, __u32 *len)
+{
+	struct wd_comp_sess *sess = (struct wd_comp_sess *)h_sess;
+	__u32 first, last, num, i, bsz, skip, copy;
+	struct wd_frame_trailer *trailer;
+	struct wd_frame_index *index;
+	struct wd_comp_req *reqs;
+	void *head_buf = NULL;
+	void *tail_buf = NULL;
+	__u64 comp_off = 0;
+	__u64 orig_len, end;
+	__u32 done = 0;
+	int ret;
+
+	if (!sess || !dst || !len || !*len) {
+		WD_ERR("invalid: sess, dst or len is NULL!\n");
+		return -WD_EINVAL;
+	}
+
+	if (sess->key.type != WD_DIR_DECOMPRESS) {
+		WD_ERR("invalid: read range needs a decompression session!\n");
+		return -WD_EINVAL;
+	}
+
+	trailer = wd_frame_get_trailer(frame, frame_len);
+	if (!trailer)
+		return -WD_EINVAL;
+
+	if (trailer->alg_type != sess->alg_type) {
+		WD_ERR("invalid: frame alg(%u) mismatches session!\n",
+		       trailer->alg_type);
+		return -WD_EINVAL;
+	}
+
+	index = (struct wd_frame_index *)trailer - trailer->block_num;
+	bsz = trailer->block_size;
+	(void)wd_comp_frame_info(frame, frame_len, &orig_len, NULL);
+	if (offset >= orig_len) {
+		*len = 0;
+		return 0;
+	}
+
+	end = offset + *len > orig_len ? orig_len : offset + *len;
+	first = offset / bsz;
+	last = (end - 1) / bsz;
+	num = last - first + 1;
+
+	reqs = calloc(num, sizeof(struct wd_comp_req));
+	if (!reqs)
+		return -WD_ENOMEM;
+
+	for (i = 0; i < first; i++)
+		comp_off += index[i].comp_len;
+
+	/* blocks fully in range are decompressed into dst directly */
+	for (i = 0; i < num; i++) {
+		reqs[i].src = frame + comp_off;
+		reqs[i].src_len = index[first + i].comp_len;
+		reqs[i].dst_len = index[first + i].orig_len;
+		reqs[i].op_type = WD_DIR_DECOMPRESS;
+		reqs[i].data_fmt = WD_FLAT_BUF;
+		comp_off += reqs[i].src_len;
+
+		if (i == 0 && offset % bsz) {
+			head_buf = malloc(bsz);
+			reqs[i].dst = head_buf;
+		} else if (i == num - 1 &&
+			   end < (__u64)(last + 1) * bsz &&
+			   end < orig_len) {
+			tail_buf = malloc(bsz);
+			reqs[i].dst = tail_buf;
+		} else {
+			reqs[i].dst = dst + ((__u64)(first + i) * bsz - offset);
+		}
+
+		if (!reqs[i].dst) {
+			ret = -WD_ENOMEM;
+			goto out;
+		}
+	}
+
+	ret = wd_comp_par_run(sess, reqs, num);
+	if (ret)
+		goto out;
+
+	for (i = 0; i < num; i++) {
+		if (reqs[i].dst_len != index[first + i].orig_len) {
+			WD_ERR("invalid: block %u is corrupted!\n", first + i);
+			ret = -WD_EINVAL;
+			goto out;
+		}
+	}
+
+	/* copy out the partial head and tail blocks */
+	for (i = 0; i < num; i++) {
+		if (reqs[i].dst != head_buf && reqs[i].dst != tail_buf) {
+			done += reqs[i].dst_len;
+			continue;
+		}
+		skip = i == 0 ? offset % bsz : 0;
+		copy = reqs[i].dst_len - skip;
+		if (done + copy > end - offset)
+			copy = end - offset - done;
+		memcpy(dst + done, reqs[i].dst + skip, copy);
+		done += copy;
+	}
+
+	*len = done;
+out:
+	free(tail_buf);
+	free(head_buf);
+	free(reqs);
+	return ret;
+}
+
+/*
+ * Parse a gzip member head, member_len is set if a BGZF size is found. It's
+ * quiet, since it also tells if a guessed member end is followed by a head.
+ */
+static int wd_gzip_parse_head(__u8 *p, __u32 len, __u32 *head_len,
+			      __u32 *member_len)
+{
+	__u32 pos = GZIP_FIXED_HEAD_SZ;
+	__u32 xlen, xend, slen;
+	__u8 flg;
+
+	*member_len = 0;
+	if (len < GZIP_FIXED_HEAD_SZ || p[0] != GZIP_ID1 || p[1] != GZIP_ID2 ||
+	    p[2] != GZIP_CM_DEFLATE || (p[3] & GZIP_FRESERVED))
+		return -WD_EINVAL;
+
+	flg = p[3];
+	if (flg & GZIP_FEXTRA) {
+		if (pos + 2 > len)
+			return -WD_EINVAL;
+		xlen = p[pos] | (p[pos + 1] << 8);
+		pos += 2;
+		xend = pos + xlen;
+		if (xend > len)
+			return -WD_EINVAL;
+		while (pos + 4 <= xend) {
+			slen = p[pos + 2] | (p[pos + 3] << 8);
+			if (p[pos] == 'B' && p[pos + 1] == 'C' && slen == 2 &&
+			    pos + 6 <= xend)
+				*member_len = (p[pos + 4] | (p[pos + 5] << 8)) + 1;
+			pos += 4 + slen;
+		}
+		pos = xend;
+	}
+
+	if (flg & GZIP_FNAME) {
+		while (pos < len && p[pos])
+			pos++;
+		pos++;
+	}
+
+	if (flg & GZIP_FCOMMENT) {
+		while (pos < len && p[pos])
+			pos++;
+		pos++;
+	}
+
+	if (flg & GZIP_FHCRC)
+		pos += 2;
+
+	if (pos > len)
+		return -WD_EINVAL;
+
+	if (*member_len &&
+	    (*member_len > len || *member_len < pos + GZIP_TAIL_SZ))
+		return -WD_EINVAL;
+
+	*head_len = pos;
+
+	return 0;
+}
+
+static __u32 wd_gzip_get_crc(__u8 *tail)
+{
+	return tail[0] | (tail[1] << 8) | (tail[2] << 16) | ((__u32)tail[3] << 24);
+}
+
+static __u32 wd_gzip_get_isize(__u8 *tail)
+{
+	return tail[4] | (tail[5] << 8) | (tail[6] << 16) | ((__u32)tail[7] << 24);
+}
+
+/*
+ * Guess the length of a member without BGZF size: it ends at the first
+ * following gzip head, or at the end of src, whose previous 8 bytes look like
+ * a tail the output fits. A wrong guess is caught by the CRC or ISIZE check.
+ */
+static __u32 wd_gzip_guess_len(__u8 *src, __u32 src_len, __u32 in,
+			       __u32 head_len, __u32 avail_out)
+{
+	__u32 start = in + head_len + GZIP_DEFLATE_MIN + GZIP_TAIL_SZ;
+	__u32 end, pos, isize, h_len, m_len;
+	__u8 *p;
+
+	end = src_len - in > GZIP_PAR_MEMBER_MAX ?
+	      in + GZIP_PAR_MEMBER_MAX : src_len;
+	if (avail_out > GZIP_PAR_MEMBER_MAX)
+		avail_out = GZIP_PAR_MEMBER_MAX;
+
+	for (pos = start; pos <= end; pos++) {
+		if (pos < end) {
+			p = memchr(src + pos, GZIP_ID1, end - pos);
+			pos = p ? p - src : end;
+		}
+		/* only the end of src ends a member without a head after */
+		if (pos == end && end != src_len)
+			break;
+		if (pos < src_len &&
+		    wd_gzip_parse_head(src + pos, src_len - pos,
+				       &h_len, &m_len))
+			continue;
+
+		isize = wd_gzip_get_isize(src + pos - GZIP_TAIL_SZ);
+		/* an empty member is left to stream mode, it's cheap there */
+		if (isize && isize <= avail_out)
+			return pos - in;
+	}
+
+	return 0;
+}
+
+/* decompress one raw deflate stream whose length isn't known */
+static int wd_comp_strm_member(struct wd_comp_sess *sess, void *src,
+			       __u32 src_len, void *dst, __u32 dst_len,
+			       __u32 *consumed, __u32 *produced)
+{
+	struct wd_comp_req strm_req = {0};
+	int ret;
+
+	/* drop what is left by a broken member */
+	wd_comp_end_stream(sess);
+	*consumed = 0;
+	*produced = 0;
+
+	strm_req.op_type = WD_DIR_DECOMPRESS;
+	strm_req.data_fmt = WD_FLAT_BUF;
+	while (1) {
+		strm_req.src = src + *consumed;
+		strm_req.src_len = src_len - *consumed > STREAM_CHUNK ?
+				   STREAM_CHUNK : src_len - *consumed;
+		strm_req.dst = dst + *produced;
+		strm_req.dst_len = dst_len - *produced > STREAM_CHUNK ?
+				   STREAM_CHUNK : dst_len - *produced;
+		if (!strm_req.dst_len) {
+			WD_ERR("invalid: dst_len(%u) is too small!\n", dst_len);
+			return -WD_ENOMEM;
+		}
+
+		ret = wd_do_comp_strm((handle_t)sess, &strm_req);
+		if (ret < 0 || strm_req.status == WD_IN_EPARA) {
+			WD_ERR("wd comp, invalid or incomplete data! "
+			       "ret(%d), req.status(%u)\n",
+			       ret, strm_req.status);
+			return ret < 0 ? ret : -WD_EINVAL;
+		}
+
+		*consumed += strm_req.src_len;
+		*produced += strm_req.dst_len;
+		if (strm_req.status == WD_STREAM_END)
+			return 0;
+
+		if (*consumed == src_len && strm_req.status != WD_EAGAIN) {
+			WD_ERR("invalid: gzip member is truncated!\n");
+			return -WD_EINVAL;
+		}
+	}
+}
+
+struct wd_gzip_member {
+	__u32 in;	/* offset of the member in src */
+	__u32 out;	/* offset of its output in dst */
+	__u32 isize;
+	__u32 crc;
+	/* the member end is guessed, since it has no BGZF size */
+	bool guess;
+	int ret;
+};
+
+struct wd_gzip_batch {
+	struct wd_comp_req *reqs;
+	struct wd_gzip_member *members;
+	__u32 num;
+	__u32 max;
+};
+
+/* the CRC is done by the worker, so it's in parallel too */
+static int wd_gzip_member_check(struct wd_comp_par *par, __u32 i, int ret)
+{
+	struct wd_gzip_member *member = (struct wd_gzip_member *)par->param + i;
+	struct wd_comp_req *req = par->reqs + i;
+
+	if (!ret && (req->dst_len != member->isize ||
+		     wd_crc32(0, req->dst, req->dst_len) != member->crc))
+		ret = -WD_EINVAL;
+
+	member->ret = ret;
+
+	/* a wrong guess is redone in stream mode, it doesn't stop others */
+	return member->guess ? 0 : ret;
+}
+
+/*
+ * Inflate the batched members. If a guessed member is wrong, in and out are
+ * moved back to it, and redo is set to inflate it in stream mode.
+ */
+static int wd_gzip_batch_flush(struct wd_comp_sess *sess,
+			       struct wd_gzip_batch *batch, __u32 *in,
+			       __u32 *out, bool *redo)
+{
+	struct wd_gzip_member *member;
+	__u32 i, num = batch->num;
+	int ret;
+
+	if (!num)
+		return 0;
+
+	batch->num = 0;
+	ret = wd_comp_par_run_check(sess, batch->reqs, num,
+				    wd_gzip_member_check, batch->members);
+
+	/* members are taken in order, so all before a failure are done */
+	for (i = 0; i < num; i++) {
+		member = batch->members + i;
+		if (!member->ret)
+			continue;
+		if (!member->guess) {
+			WD_ERR("invalid: gzip member at %u is corrupted!\n",
+			       member->in);
+			return member->ret;
+		}
+		*in = member->in;
+		*out = member->out;
+		*redo = true;
+		return 0;
+	}
+
+	return ret;
+}
+
+static int wd_gzip_batch_add(struct wd_gzip_batch *batch, __u8 *src,
+			     __u32 in, __u32 head_len, __u32 member_len,
+			     __u8 *dst, __u32 out, bool guess)
+{
+	__u8 *tail = src + in + member_len - GZIP_TAIL_SZ;
+	struct wd_gzip_member *member;
+	struct wd_comp_req *req;
+	void *tmp;
+
+	if (batch->num == batch->max) {
+		batch->max = batch->max ? batch->max * 2 : WD_COMP_PAR_MAX;
+		tmp = realloc(batch->reqs,
+			      batch->max * sizeof(struct wd_comp_req));
+		if (!tmp)
+			return -WD_ENOMEM;
+		batch->reqs = tmp;
+		tmp = realloc(batch->members,
+			      batch->max * sizeof(struct wd_gzip_member));
+		if (!tmp)
+			return -WD_ENOMEM;
+		batch->members = tmp;
+	}
+
+	member = batch->members + batch->num;
+	member->in = in;
+	member->out = out;
+	member->isize = wd_gzip_get_isize(tail);
+	member->crc = wd_gzip_get_crc(tail);
+	member->guess = guess;
+	member->ret = 0;
+
+	req = batch->reqs + batch->num++;
+	memset(req, 0, sizeof(struct wd_comp_req));
+	req->src = src + in + head_len;
+	req->src_len = member_len - head_len - GZIP_TAIL_SZ;
+	req->dst = dst + out;
+	req->dst_len = member->isize;
+	req->op_type = WD_DIR_DECOMPRESS;
+	req->data_fmt = WD_FLAT_BUF;
+
+	return 0;
+}
+
+int wd_do_comp_gzip_multi(handle_t h_sess, struct wd_comp_req *req)
+{
+	struct wd_comp_sess *sess = (struct wd_comp_sess *)h_sess;
+	struct wd_comp_sess_setup setup = {0};
+	struct wd_gzip_batch batch = {0};
+	__u32 head_len, member_len, isize;
+	__u32 in = 0, out = 0, at;
+	__u32 consumed, produced;
+	struct wd_comp_sess *raw;
+	bool redo = false;
+	__u8 *src;
+	int ret;
+
+	if (!sess || !req || !req->src_len || req->data_fmt == WD_SGL_BUF) {
+		WD_ERR("invalid: sess, req or src is NULL!\n");
+		return -WD_EINVAL;
+	}
+
+	if (sess->alg_type != WD_GZIP ||
+	    sess->key.type != WD_DIR_DECOMPRESS) {
+		WD_ERR("invalid: need a gzip decompression session!\n");
+		return -WD_EINVAL;
+	}
+
+	/* heads are parsed here, members are inflated as raw deflate */
+	setup.alg_type = WD_DEFLATE;
+	setup.op_type = WD_DIR_DECOMPRESS;
+	setup.mode = CTX_MODE_SYNC;
+	raw = (struct wd_comp_sess *)wd_comp_alloc_sess(&setup);
+	if (!raw)
+		return -WD_ENOMEM;
+
+	src = req->src;
+	while (1) {
+		if (in == req->src_len) {
+			ret = wd_gzip_batch_flush(raw, &batch, &in, &out,
+						  &redo);
+			if (ret)
+				goto out;
+			if (in == req->src_len)
+				break;
+		}
+
+		ret = wd_gzip_parse_head(src + in, req->src_len - in,
+					 &head_len, &member_len);
+		if (ret) {
+			WD_ERR("invalid: bad gzip member head at %u!\n", in);
+			goto out;
+		}
+
+		if (member_len) {
+			/* member size is known, inflate it in parallel */
+			isize = wd_gzip_get_isize(src + in + member_len -
+						  GZIP_TAIL_SZ);
+			if (isize > req->dst_len - out) {
+				WD_ERR("invalid: dst_len(%u) is too small!\n",
+				       req->dst_len);
+				ret = -WD_ENOMEM;
+				goto out;
+			}
+			/* empty member, such as the EOF block of BGZF */
+			if (isize) {
+				ret = wd_gzip_batch_add(&batch, src, in,
+							head_len, member_len,
+							req->dst, out, false);
+				if (ret)
+					goto out;
+			}
+			in += member_len;
+			out += isize;
+			continue;
+		}
+
+		/* the end of a plain member is guessed to inflate it in parallel */
+		if (!redo)
+			member_len = wd_gzip_guess_len(src, req->src_len, in,
+						       head_len,
+						       req->dst_len - out);
+		if (member_len) {
+			ret = wd_gzip_batch_add(&batch, src, in, head_len,
+						member_len, req->dst, out, true);
+			if (ret)
+				goto out;
+			in += member_len;
+			out += batch.reqs[batch.num - 1].dst_len;
+			continue;
+		}
+
+		/* output offset of the following members depends on it */
+		at = in;
+		ret = wd_gzip_batch_flush(raw, &batch, &in, &out, &redo);
+		if (ret)
+			goto out;
+		/* go back to the wrong guess */
+		if (in != at)
+			continue;
+		redo = false;
+
+		ret = wd_comp_strm_member(raw, src + in + head_len,
+					  req->src_len - in - head_len,
+					  req->dst + out, req->dst_len - out,
+					  &consumed, &produced);
+		if (ret)
+			goto out;
+
+		in += head_len + consumed;
+		if (req->src_len - in < GZIP_TAIL_SZ ||
+		    wd_gzip_get_isize(src + in) != produced ||
+		    wd_gzip_get_crc(src + in) !=
+		    wd_crc32(0, req->dst + out, produced)) {
+			WD_ERR("invalid: bad gzip member tail!\n");
+			ret = -WD_EINVAL;
+			goto out;
+		}
+		in += GZIP_TAIL_SZ;
+		out += produced;
+	}
+
+	req->src_len = in;
+	req->dst_len = out;
+	req->status = WD_STREAM_END;
+out:
+	free(batch.members);
+	free(batch.reqs);
+	wd_comp_free_sess((handle_t)raw);
+	return ret;
+}
+
+int wd_do_comp_async(handle_t h_sess, struct wd_comp_req *req)
+{
+	struct wd_ctx_config_internal *config = &wd_comp_setting.config;
+	struct wd_comp_sess *sess = (struct wd_comp_sess *)h_sess;
+	handle_t h_sched_ctx = wd_comp_setting.sched.h_sched_ctx;
+	void *priv = wd_comp_setting.priv;
+	struct wd_ctx_internal *ctx;
+	struct wd_comp_msg *msg;
+	__u32 index;
+	int idx, ret;
+
+	if (!sess || !req) {
 		WD_ERR("sess or req is NULL!\n");
 		return -WD_EINVAL;
 	}
@@ -581,6 +2355,22 @@ int wd_do_comp_async(handle_t h_sess, struct wd_comp_req *req)
 		return -WD_EINVAL;
 	}
 
+	if (sess->dict) {
+		ret = wd_comp_do_dict(sess, req);
+		if (ret < 0)
+			return ret;
+		req->cb(req, req->cb_param);
+		return 0;
+	}
+
+	if (wd_comp_try_store(sess, req)) {
+		req->cb(req, req->cb_param);
+		return 0;
+	}
+
+	if (wd_comp_sw_by_size(req))
+		return wd_comp_do_sw_async(sess, req);
+
 	index = wd_comp_setting.sched.pick_next_ctx(h_sched_ctx,
 						    req,
 						    &sess->key);
@@ -596,25 +2386,176 @@ int wd_do_comp_async(handle_t h_sess, struct wd_comp_req *req)
 
 	idx = wd_get_msg_from_pool(&wd_comp_setting.pool, index, (void **)&msg);
 	if (idx < 0) {
+		if (wd_comp_sw_by_err(req, -WD_EBUSY))
+			return wd_comp_do_sw_async(sess, req);
 		WD_ERR("busy, failed to get msg from pool!\n");
 		return -WD_EBUSY;
 	}
-	fill_comp_msg(msg, req);
+	fill_comp_msg(sess, msg, req);
 	msg->tag = idx;
-	msg->alg_type = sess->alg_type;
 	msg->stream_mode = WD_COMP_STATELESS;
 
 	pthread_spin_lock(&ctx->lock);
 
 	ret = wd_comp_setting.driver->comp_send(ctx->ctx, msg, priv);
 	if (ret < 0) {
-		WD_ERR("wd comp send err(%d)!\n", ret);
 		wd_put_msg_to_pool(&wd_comp_setting.pool, index, msg->tag);
+		pthread_spin_unlock(&ctx->lock);
+		if (wd_comp_sw_by_err(req, ret))
+			return wd_comp_do_sw_async(sess, req);
+		WD_ERR("wd comp send err(%d)!\n", ret);
+		return ret;
 	}
 
 	pthread_spin_unlock(&ctx->lock);
+	wd_comp_stat_inc(&wd_comp_setting.stat.hw_reqs);
 
-	return ret;
+	return 0;
+}
+
+handle_t wd_comp_seq_alloc(handle_t h_sess, struct wd_comp_seq_setup *setup)
+{
+	struct wd_comp_seq *seq;
+	__u32 window, i;
+
+	if (!h_sess || !setup || !setup->sink) {
+		WD_ERR("invalid: sess, seq setup or sink is NULL!\n");
+		return (handle_t)0;
+	}
+
+	window = setup->window ? setup->window : WD_SEQ_WINDOW_DEF;
+	if (window > WD_SEQ_WINDOW_MAX || (window & (window - 1))) {
+		WD_ERR("invalid: seq window %u isn't a power of 2 up to %d!\n",
+		       window, WD_SEQ_WINDOW_MAX);
+		return (handle_t)0;
+	}
+
+	seq = calloc(1, sizeof(struct wd_comp_seq));
+	if (!seq)
+		return (handle_t)0;
+
+	seq->slots = calloc(window, sizeof(struct wd_comp_seq_slot));
+	if (!seq->slots) {
+		free(seq);
+		return (handle_t)0;
+	}
+
+	for (i = 0; i < window; i++)
+		seq->slots[i].seq = seq;
+	seq->h_sess = h_sess;
+	seq->sink = setup->sink;
+	seq->sink_param = setup->sink_param;
+	seq->mask = window - 1;
+	pthread_mutex_init(&seq->lock, NULL);
+
+	return (handle_t)seq;
+}
+
+void wd_comp_seq_free(handle_t h_seq)
+{
+	struct wd_comp_seq *seq = (struct wd_comp_seq *)h_seq;
+
+	if (!seq)
+		return;
+
+	if (seq->head != seq->tail)
+		WD_ERR("seq is freed with %llu requests in flight!\n",
+		       (unsigned long long)(seq->tail - seq->head));
+
+	pthread_mutex_destroy(&seq->lock);
+	free(seq->slots);
+	free(seq);
+}
+
+/*
+ * Completions come from any polling thread in any order. The first thread
+ * that finds the head done releases it and every done one behind it, others
+ * just mark their slots, so the sink is never called concurrently.
+ * Called with the lock held.
+ */
+static void wd_comp_seq_release(struct wd_comp_seq *seq)
+{
+	struct wd_comp_seq_slot *slot;
+
+	if (seq->releasing)
+		return;
+
+	seq->releasing = true;
+	while (seq->head != seq->tail) {
+		slot = &seq->slots[seq->head & seq->mask];
+		if (slot->state == WD_SEQ_SLOT_DONE) {
+			pthread_mutex_unlock(&seq->lock);
+
+			slot->req.cb_param = slot->cb_param;
+			seq->sink(&slot->req, slot->id, seq->sink_param);
+
+			pthread_mutex_lock(&seq->lock);
+		} else if (slot->state != WD_SEQ_SLOT_FAILED) {
+			break;
+		}
+		slot->state = WD_SEQ_SLOT_FREE;
+		seq->head++;
+	}
+	seq->releasing = false;
+}
+
+static void *wd_comp_seq_cb(struct wd_comp_req *req, void *cb_param)
+{
+	struct wd_comp_seq_slot *slot = cb_param;
+	struct wd_comp_seq *seq = slot->seq;
+
+	pthread_mutex_lock(&seq->lock);
+	slot->req.src_len = req->src_len;
+	slot->req.dst_len = req->dst_len;
+	slot->req.status = req->status;
+	slot->state = WD_SEQ_SLOT_DONE;
+	wd_comp_seq_release(seq);
+	pthread_mutex_unlock(&seq->lock);
+
+	return NULL;
+}
+
+int wd_do_comp_seq_async(handle_t h_seq, struct wd_comp_req *req, __u64 *id)
+{
+	struct wd_comp_seq *seq = (struct wd_comp_seq *)h_seq;
+	struct wd_comp_seq_slot *slot;
+	int ret;
+
+	if (!seq || !req) {
+		WD_ERR("invalid: seq or req is NULL!\n");
+		return -WD_EINVAL;
+	}
+
+	/* window is full until the oldest one is released */
+	pthread_mutex_lock(&seq->lock);
+	if (seq->tail - seq->head > seq->mask) {
+		pthread_mutex_unlock(&seq->lock);
+		return -WD_EBUSY;
+	}
+
+	slot = &seq->slots[seq->tail & seq->mask];
+	slot->req = *req;
+	slot->req.cb = wd_comp_seq_cb;
+	slot->req.cb_param = slot;
+	slot->cb_param = req->cb_param;
+	slot->id = seq->tail++;
+	slot->state = WD_SEQ_SLOT_INFLIGHT;
+	if (id)
+		*id = slot->id;
+	pthread_mutex_unlock(&seq->lock);
+
+	/* it may complete and be released before return */
+	ret = wd_do_comp_async(seq->h_sess, &slot->req);
+	if (ret < 0) {
+		/* the id is taken, so let the release step over it */
+		pthread_mutex_lock(&seq->lock);
+		slot->state = WD_SEQ_SLOT_FAILED;
+		wd_comp_seq_release(seq);
+		pthread_mutex_unlock(&seq->lock);
+		return ret;
+	}
+
+	return 0;
 }
 
 int wd_comp_poll(__u32 expt, __u32 *count)
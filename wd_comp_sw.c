@@ -0,0 +1,302 @@
+// SPDX-License-Identifier: Apache-2.0
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "config.h"
+#include "wd_comp_sw.h"
+
+#define STORE_BLOCK_MAX		0xffff
+#define STORE_BLOCK_HEAD_SZ	5
+#define STORE_ZLIB_HEAD		"\x78\x9c"
+#define STORE_ZLIB_HEAD_SZ	2
+#define STORE_ZLIB_TAIL_SZ	4
+#define STORE_GZIP_HEAD		"\x1f\x8b\x08\x00\x00\x00\x00\x00\x00\x03"
+#define STORE_GZIP_HEAD_SZ	10
+#define STORE_GZIP_TAIL_SZ	8
+
+#define SAMPLE_RUN		32
+#define SAMPLE_MAX		4096
+#define HIST_NUM		4
+/*
+ * Data is taken as incompressible if sum(p^2) * 256 is below it (in 1/16),
+ * about 7.4 bits of collision entropy per byte. Uniform random data is
+ * close to 16/16, text is usually over 10 times of it.
+ */
+#define INCOMP_THRESH		24
+
+bool wd_comp_sw_incompressible(const void *src, __u32 len)
+{
+	/* several histograms break the store to load dependency */
+	__u32 hist[HIST_NUM][256] = {0};
+	const __u8 *p = src;
+	__u64 sum = 0, n = 0;
+	__u32 step, off, i, c;
+
+	if (len <= SAMPLE_MAX) {
+		step = SAMPLE_RUN;
+	} else {
+		step = len / (SAMPLE_MAX / SAMPLE_RUN);
+		step -= step % SAMPLE_RUN;
+	}
+
+	for (off = 0; off + SAMPLE_RUN <= len; off += step) {
+		for (i = 0; i < SAMPLE_RUN; i += HIST_NUM) {
+			hist[0][p[off + i]]++;
+			hist[1][p[off + i + 1]]++;
+			hist[2][p[off + i + 2]]++;
+			hist[3][p[off + i + 3]]++;
+		}
+		n += SAMPLE_RUN;
+	}
+
+	/* too few samples to tell */
+	if (n < SAMPLE_RUN * 8)
+		return false;
+
+	for (i = 0; i < 256; i++) {
+		c = hist[0][i] + hist[1][i] + hist[2][i] + hist[3][i];
+		sum += (__u64)c * c;
+	}
+
+	return sum * 256 * 16 < n * n * INCOMP_THRESH;
+}
+
+__u32 wd_comp_sw_store_bound(int alg_type, __u32 len)
+{
+	__u32 blocks = len / STORE_BLOCK_MAX + 1;
+	__u64 bound = (__u64)blocks * STORE_BLOCK_HEAD_SZ + len;
+
+	if (alg_type == WD_ZLIB)
+		bound += STORE_ZLIB_HEAD_SZ + STORE_ZLIB_TAIL_SZ;
+	else if (alg_type == WD_GZIP)
+		bound += STORE_GZIP_HEAD_SZ + STORE_GZIP_TAIL_SZ;
+
+	return bound > UINT32_MAX ? UINT32_MAX : bound;
+}
+
+static void put_le32(__u8 *p, __u32 v)
+{
+	p[0] = v;
+	p[1] = v >> 8;
+	p[2] = v >> 16;
+	p[3] = v >> 24;
+}
+
+int wd_comp_sw_store(int alg_type, struct wd_comp_req *req)
+{
+	__u32 left = req->src_len;
+	const __u8 *src = req->src;
+	__u8 *dst = req->dst;
+	__u32 len, sum;
+
+	if (alg_type >= WD_COMP_ALG_MAX ||
+	    req->dst_len < wd_comp_sw_store_bound(alg_type, req->src_len)) {
+		WD_ERR("invalid: alg(%d) or dst_len(%u) for store blocks!\n",
+		       alg_type, req->dst_len);
+		return -WD_EINVAL;
+	}
+
+	if (alg_type == WD_ZLIB) {
+		memcpy(dst, STORE_ZLIB_HEAD, STORE_ZLIB_HEAD_SZ);
+		dst += STORE_ZLIB_HEAD_SZ;
+	} else if (alg_type == WD_GZIP) {
+		memcpy(dst, STORE_GZIP_HEAD, STORE_GZIP_HEAD_SZ);
+		dst += STORE_GZIP_HEAD_SZ;
+	}
+
+	/* BFINAL is set on the last block, BTYPE is 00 */
+	do {
+		len = left > STORE_BLOCK_MAX ? STORE_BLOCK_MAX : left;
+		left -= len;
+		dst[0] = left ? 0 : 1;
+		dst[1] = len & 0xff;
+		dst[2] = len >> 8;
+		dst[3] = ~len & 0xff;
+		dst[4] = (~len >> 8) & 0xff;
+		memcpy(dst + STORE_BLOCK_HEAD_SZ, src, len);
+		dst += STORE_BLOCK_HEAD_SZ + len;
+		src += len;
+	} while (left);
+
+	if (alg_type == WD_ZLIB) {
+		sum = wd_adler32(1, req->src, req->src_len);
+		dst[0] = sum >> 24;
+		dst[1] = sum >> 16;
+		dst[2] = sum >> 8;
+		dst[3] = sum;
+		dst += STORE_ZLIB_TAIL_SZ;
+	} else if (alg_type == WD_GZIP) {
+		sum = wd_crc32(0, req->src, req->src_len);
+		put_le32(dst, sum);
+		put_le32(dst + 4, req->src_len);
+		dst += STORE_GZIP_TAIL_SZ;
+	}
+
+	req->dst_len = dst - (__u8 *)req->dst;
+	req->status = 0;
+
+	return 0;
+}
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+
+#define SW_DEF_LEVEL		6
+#define SW_MEM_LEVEL		8
+#define SW_WBITS		15
+#define SW_MIN_WBITS		12
+#define SW_GZIP_WBITS		16
+
+static int sw_window_bits(int alg_type, int win_sz)
+{
+	/* 4KB to 32KB window */
+	int wbits = SW_MIN_WBITS + win_sz - WD_COMP_WS_4K;
+
+	if (win_sz < WD_COMP_WS_4K || win_sz > WD_COMP_WS_32K)
+		wbits = SW_WBITS;
+
+	switch (alg_type) {
+	case WD_DEFLATE:
+		return -wbits;
+	case WD_ZLIB:
+		return wbits;
+	case WD_GZIP:
+		return wbits + SW_GZIP_WBITS;
+	default:
+		return 0;
+	}
+}
+
+static int sw_deflate(int wbits, int comp_lv, const void *dict,
+		      __u32 dict_len, struct wd_comp_req *req)
+{
+	z_stream strm;
+	int ret;
+
+	memset(&strm, 0, sizeof(z_stream));
+	/*
+	 * Hardware always emits the zlib header of level 6, keep the same
+	 * header if user doesn't ask for a level.
+	 */
+	if (comp_lv < WD_COMP_L1 || comp_lv > WD_COMP_L9)
+		comp_lv = SW_DEF_LEVEL;
+
+	ret = deflateInit2(&strm, comp_lv, Z_DEFLATED, wbits, SW_MEM_LEVEL,
+			   Z_DEFAULT_STRATEGY);
+	if (ret != Z_OK) {
+		WD_ERR("failed to init sw deflate, ret = %d!\n", ret);
+		return -WD_ENOMEM;
+	}
+
+	/* zlib format gets FDICT and DICTID in its header */
+	if (dict_len) {
+		ret = deflateSetDictionary(&strm, dict, dict_len);
+		if (ret != Z_OK) {
+			WD_ERR("failed to set sw deflate dict, ret = %d!\n",
+			       ret);
+			(void)deflateEnd(&strm);
+			return -WD_EINVAL;
+		}
+	}
+
+	strm.next_in = req->src;
+	strm.avail_in = req->src_len;
+	strm.next_out = req->dst;
+	strm.avail_out = req->dst_len;
+	ret = deflate(&strm, Z_FINISH);
+	if (ret == Z_STREAM_END)
+		req->status = 0;
+	else if (ret == Z_OK || ret == Z_BUF_ERROR)
+		/* no space left in dst */
+		req->status = WD_EAGAIN;
+	else
+		req->status = WD_IN_EPARA;
+
+	req->src_len = strm.total_in;
+	req->dst_len = strm.total_out;
+	(void)deflateEnd(&strm);
+
+	return 0;
+}
+
+static int sw_inflate(int wbits, const void *dict, __u32 dict_len,
+		      struct wd_comp_req *req)
+{
+	z_stream strm;
+	int ret;
+
+	memset(&strm, 0, sizeof(z_stream));
+	ret = inflateInit2(&strm, wbits);
+	if (ret != Z_OK) {
+		WD_ERR("failed to init sw inflate, ret = %d!\n", ret);
+		return -WD_ENOMEM;
+	}
+
+	/* raw deflate takes the dictionary at once */
+	if (dict_len && wbits < 0)
+		(void)inflateSetDictionary(&strm, dict, dict_len);
+
+	strm.next_in = req->src;
+	strm.avail_in = req->src_len;
+	strm.next_out = req->dst;
+	strm.avail_out = req->dst_len;
+	ret = inflate(&strm, Z_FINISH);
+	/* zlib asks for it after the header, DICTID is checked by zlib */
+	if (ret == Z_NEED_DICT && dict_len &&
+	    inflateSetDictionary(&strm, dict, dict_len) == Z_OK)
+		ret = inflate(&strm, Z_FINISH);
+	if (ret == Z_STREAM_END)
+		req->status = WD_STREAM_END;
+	else if (ret == Z_BUF_ERROR && !strm.avail_out)
+		req->status = WD_EAGAIN;
+	else if (ret == Z_OK || ret == Z_BUF_ERROR)
+		req->status = 0;
+	else
+		req->status = WD_IN_EPARA;
+
+	req->src_len = strm.total_in;
+	req->dst_len = strm.total_out;
+	(void)inflateEnd(&strm);
+
+	return 0;
+}
+
+bool wd_comp_sw_supported(void)
+{
+	return true;
+}
+
+int wd_comp_sw_do(int alg_type, int comp_lv, int win_sz, const void *dict,
+		  __u32 dict_len, struct wd_comp_req *req)
+{
+	int wbits = sw_window_bits(alg_type, win_sz);
+
+	if (!wbits) {
+		WD_ERR("invalid: sw engine alg type %d!\n", alg_type);
+		return -WD_EINVAL;
+	}
+
+	if (req->op_type == WD_DIR_COMPRESS)
+		return sw_deflate(wbits, comp_lv, dict, dict_len, req);
+	else if (req->op_type == WD_DIR_DECOMPRESS)
+		/* inflate with the largest window, it accepts any stream */
+		return sw_inflate(sw_window_bits(alg_type, WD_COMP_WS_32K),
+				  dict, dict_len, req);
+
+	WD_ERR("invalid: sw engine op type %hhu!\n", req->op_type);
+	return -WD_EINVAL;
+}
+#else
+bool wd_comp_sw_supported(void)
+{
+	return false;
+}
+
+int wd_comp_sw_do(int alg_type, int comp_lv, int win_sz, const void *dict,
+		  __u32 dict_len, struct wd_comp_req *req)
+{
+	WD_ERR("sw engine isn't supported without zlib!\n");
+	return -WD_EINVAL;
+}
+#endif
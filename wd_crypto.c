@@ -0,0 +1,292 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+#include <stdlib.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include "wd_crypto.h"
+#include "wd_crypto_share.h"
+#include "wd_util.h"
+
+struct wd_crypto_setting {
+	struct wd_ctx_config_internal config;
+	struct wd_sched sched;
+	struct wd_crypto_driver *driver;
+	void *priv;
+	/* start position of the built-in schedule */
+	__u32 sched_pos;
+} wd_crypto_setting;
+
+#ifdef WD_STATIC_DRV
+extern struct wd_crypto_driver wd_crypto_hisi_crypto_driver;
+static void wd_crypto_set_static_drv(void)
+{
+	wd_crypto_setting.driver = &wd_crypto_hisi_crypto_driver;
+}
+#endif
+
+/*
+ * The driver is set when libhisi_sec.so is opened by the constructors of
+ * cipher, digest and aead.
+ */
+void wd_crypto_set_driver(struct wd_crypto_driver *drv)
+{
+	wd_crypto_setting.driver = drv;
+}
+
+/*
+ * Requests of all families take turns on the ctxs of the wanted mode. A sync
+ * ctx held by another thread is skipped if an idle one is found, as the
+ * caller would spin on its lock until the held request is done.
+ */
+static __u32 crypto_sched_pick_next_ctx(handle_t h_sched_ctx, const void *req,
+					const struct sched_key *key)
+{
+	struct wd_ctx_config_internal *config = &wd_crypto_setting.config;
+	__u8 mode = key ? key->mode : CTX_MODE_SYNC;
+	__u32 num = config->ctx_num;
+	__u32 busy = num;
+	struct wd_ctx_internal *ctx;
+	__u32 start, pos, i;
+
+	start = __atomic_fetch_add(&wd_crypto_setting.sched_pos, 1,
+				   __ATOMIC_RELAXED);
+	for (i = 0; i < num; i++) {
+		pos = (start + i) % num;
+		ctx = config->ctxs + pos;
+		if (ctx->ctx_mode != mode)
+			continue;
+
+		if (mode == CTX_MODE_ASYNC)
+			return pos;
+
+		if (!pthread_spin_trylock(&ctx->lock)) {
+			pthread_spin_unlock(&ctx->lock);
+			return pos;
+		}
+
+		if (busy == num)
+			busy = pos;
+	}
+
+	/* num means no ctx of the mode, it's rejected by the callers */
+	return busy;
+}
+
+static int crypto_sched_poll_policy(handle_t h_sched_ctx, __u32 expect,
+				    __u32 *count)
+{
+	struct wd_ctx_config_internal *config = &wd_crypto_setting.config;
+	__u32 poll_num;
+	__u32 i;
+	int ret;
+
+	*count = 0;
+	for (i = 0; i < config->ctx_num && *count < expect; i++) {
+		if (config->ctxs[i].ctx_mode != CTX_MODE_ASYNC)
+			continue;
+
+		poll_num = 0;
+		ret = wd_crypto_poll_ctx(i, expect - *count, &poll_num);
+		if (ret < 0 && ret != -WD_EAGAIN)
+			return ret;
+		*count += poll_num;
+	}
+
+	return 0;
+}
+
+static struct wd_sched wd_crypto_sched = {
+	.name		= "crypto_balance",
+	.pick_next_ctx	= crypto_sched_pick_next_ctx,
+	.poll_policy	= crypto_sched_poll_policy,
+};
+
+static int crypto_init_families(void)
+{
+	struct wd_ctx_config_internal *config = &wd_crypto_setting.config;
+	struct wd_sched *sched = &wd_crypto_setting.sched;
+	int ret;
+
+	ret = wd_cipher_init_shared(config, sched);
+	if (ret < 0)
+		return ret;
+
+	ret = wd_digest_init_shared(config, sched);
+	if (ret < 0)
+		goto out_cipher;
+
+	ret = wd_aead_init_shared(config, sched);
+	if (ret < 0)
+		goto out_digest;
+
+	return 0;
+
+out_digest:
+	wd_digest_uninit_shared();
+out_cipher:
+	wd_cipher_uninit_shared();
+	return ret;
+}
+
+int wd_crypto_init(struct wd_ctx_config *config, struct wd_sched *sched)
+{
+	void *priv;
+	int ret;
+
+	if (wd_crypto_setting.config.ctx_num) {
+		WD_ERR("crypto have initialized.\n");
+		return 0;
+	}
+
+	if (!config || !config->ctxs || !config->ctx_num) {
+		WD_ERR("wd crypto config is NULL!\n");
+		return -WD_EINVAL;
+	}
+
+	if (!wd_is_sva(config->ctxs[0].ctx)) {
+		WD_ERR("err, non sva, please check system!\n");
+		return -WD_EINVAL;
+	}
+
+#ifdef WD_STATIC_DRV
+	wd_crypto_set_static_drv();
+#endif
+	if (!wd_crypto_setting.driver) {
+		WD_ERR("failed to find crypto driver!\n");
+		return -WD_ENODEV;
+	}
+
+	ret = wd_init_ctx_config(&wd_crypto_setting.config, config);
+	if (ret < 0) {
+		WD_ERR("failed to set config, ret = %d!\n", ret);
+		return ret;
+	}
+
+	ret = wd_init_sched(&wd_crypto_setting.sched,
+			    sched ? sched : &wd_crypto_sched);
+	if (ret < 0) {
+		WD_ERR("failed to set sched, ret = %d!\n", ret);
+		goto out;
+	}
+
+	/* init ctx related resources in specific driver, once for all */
+	priv = calloc(1, wd_crypto_setting.driver->drv_ctx_size);
+	if (!priv) {
+		ret = -WD_ENOMEM;
+		goto out_sched;
+	}
+
+	ret = wd_crypto_setting.driver->init(&wd_crypto_setting.config, priv);
+	if (ret < 0) {
+		WD_ERR("failed to init crypto driver, ret = %d!\n", ret);
+		goto out_priv;
+	}
+
+	ret = crypto_init_families();
+	if (ret < 0) {
+		WD_ERR("failed to share ctxs, ret = %d!\n", ret);
+		goto out_init;
+	}
+	wd_crypto_setting.priv = priv;
+
+	return 0;
+
+out_init:
+	wd_crypto_setting.driver->exit(priv);
+out_priv:
+	free(priv);
+out_sched:
+	wd_clear_sched(&wd_crypto_setting.sched);
+out:
+	wd_clear_ctx_config(&wd_crypto_setting.config);
+	return ret;
+}
+
+void wd_crypto_uninit(void)
+{
+	void *priv = wd_crypto_setting.priv;
+
+	if (!priv)
+		return;
+
+	wd_aead_uninit_shared();
+	wd_digest_uninit_shared();
+	wd_cipher_uninit_shared();
+
+	wd_crypto_setting.driver->exit(priv);
+	wd_crypto_setting.priv = NULL;
+	free(priv);
+
+	wd_clear_sched(&wd_crypto_setting.sched);
+	wd_clear_ctx_config(&wd_crypto_setting.config);
+}
+
+static int crypto_msg_done(__u32 index, struct wd_crypto_msg *resp)
+{
+	switch (resp->alg_type) {
+	case WD_CIPHER:
+		return wd_cipher_msg_done(index, &resp->cipher);
+	case WD_DIGEST:
+		return wd_digest_msg_done(index, &resp->digest);
+	case WD_AEAD:
+		return wd_aead_msg_done(index, &resp->aead);
+	default:
+		WD_ERR("invalid: crypto msg type %u!\n", resp->alg_type);
+		return -WD_EINVAL;
+	}
+}
+
+int wd_crypto_poll_ctx(__u32 index, __u32 expt, __u32 *count)
+{
+	struct wd_ctx_config_internal *config = &wd_crypto_setting.config;
+	struct wd_crypto_msg resp_msg;
+	struct wd_ctx_internal *ctx;
+	bool digest = false;
+	__u32 recv_cnt = 0;
+	int ret;
+
+	if (unlikely(index >= config->ctx_num || !count)) {
+		WD_ERR("crypto poll ctx input param is NULL!\n");
+		return -WD_EINVAL;
+	}
+
+	ctx = config->ctxs + index;
+	do {
+		ret = wd_crypto_setting.driver->crypto_recv(ctx->ctx, &resp_msg);
+		if (ret == -WD_EAGAIN) {
+			break;
+		} else if (ret < 0) {
+			WD_ERR("wd crypto recv hw err!\n");
+			break;
+		}
+
+		recv_cnt++;
+		if (resp_msg.alg_type == WD_DIGEST)
+			digest = true;
+		ret = crypto_msg_done(index, &resp_msg);
+		if (ret < 0)
+			break;
+	} while (recv_cnt < expt);
+	*count = recv_cnt;
+
+	if (digest)
+		wd_digest_poll_end();
+
+	/* the received ones are counted, no more isn't an error then */
+	if (ret == -WD_EAGAIN && recv_cnt)
+		return 0;
+
+	return ret;
+}
+
+int wd_crypto_poll(__u32 expt, __u32 *count)
+{
+	handle_t h_ctx = wd_crypto_setting.sched.h_sched_ctx;
+	struct wd_sched *sched = &wd_crypto_setting.sched;
+
+	if (unlikely(!sched->poll_policy)) {
+		WD_ERR("failed to check crypto poll_policy!\n");
+		return -WD_EINVAL;
+	}
+
+	return sched->poll_policy(h_ctx, expt, count);
+}
@@ -0,0 +1,335 @@
+// SPDX-License-Identifier: Apache-2.0
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "config.h"
+#include "wd_crypto_sw.h"
+
+#ifdef HAVE_LIBCRYPTO
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+
+#define CTR_128BIT_COUNTER	16
+#define BYTE_BITS		8
+
+/* the same as the driver, IV of CTR is increased by one block */
+static void sw_ctr_iv_inc(__u8 *counter, __u32 c)
+{
+	__u32 n = CTR_128BIT_COUNTER;
+
+	do {
+		--n;
+		c += counter[n];
+		counter[n] = (__u8)c;
+		c >>= BYTE_BITS;
+	} while (n);
+}
+
+static const EVP_CIPHER *sw_aes_evp(enum wd_cipher_mode mode, __u32 key_bytes)
+{
+	switch (mode) {
+	case WD_CIPHER_ECB:
+		return key_bytes == AES_KEYSIZE_128 ? EVP_aes_128_ecb() :
+		       key_bytes == AES_KEYSIZE_192 ? EVP_aes_192_ecb() :
+		       key_bytes == AES_KEYSIZE_256 ? EVP_aes_256_ecb() : NULL;
+	case WD_CIPHER_CBC:
+		return key_bytes == AES_KEYSIZE_128 ? EVP_aes_128_cbc() :
+		       key_bytes == AES_KEYSIZE_192 ? EVP_aes_192_cbc() :
+		       key_bytes == AES_KEYSIZE_256 ? EVP_aes_256_cbc() : NULL;
+	case WD_CIPHER_CTR:
+		return key_bytes == AES_KEYSIZE_128 ? EVP_aes_128_ctr() :
+		       key_bytes == AES_KEYSIZE_192 ? EVP_aes_192_ctr() :
+		       key_bytes == AES_KEYSIZE_256 ? EVP_aes_256_ctr() : NULL;
+	case WD_CIPHER_GCM:
+		return key_bytes == AES_KEYSIZE_128 ? EVP_aes_128_gcm() :
+		       key_bytes == AES_KEYSIZE_192 ? EVP_aes_192_gcm() :
+		       key_bytes == AES_KEYSIZE_256 ? EVP_aes_256_gcm() : NULL;
+	default:
+		return NULL;
+	}
+}
+
+static const EVP_CIPHER *sw_sm4_evp(enum wd_cipher_mode mode, __u32 key_bytes)
+{
+#ifndef OPENSSL_NO_SM4
+	if (key_bytes != AES_KEYSIZE_128)
+		return NULL;
+
+	switch (mode) {
+	case WD_CIPHER_ECB:
+		return EVP_sm4_ecb();
+	case WD_CIPHER_CBC:
+		return EVP_sm4_cbc();
+	case WD_CIPHER_CTR:
+		return EVP_sm4_ctr();
+	default:
+		break;
+	}
+#endif
+	return NULL;
+}
+
+static const EVP_CIPHER *sw_cipher_evp(enum wd_cipher_alg alg,
+				       enum wd_cipher_mode mode,
+				       __u32 key_bytes)
+{
+	if (alg == WD_CIPHER_AES)
+		return sw_aes_evp(mode, key_bytes);
+	if (alg == WD_CIPHER_SM4)
+		return sw_sm4_evp(mode, key_bytes);
+
+	return NULL;
+}
+
+bool wd_crypto_sw_supported(void)
+{
+	return true;
+}
+
+bool wd_cipher_sw_support(struct wd_cipher_sess *sess,
+			  struct wd_cipher_req *req)
+{
+	return req->data_fmt == WD_FLAT_BUF && req->in_bytes <= INT_MAX &&
+	       sw_cipher_evp(sess->alg, sess->mode, sess->key_bytes);
+}
+
+int wd_cipher_sw_do(struct wd_cipher_sess *sess, struct wd_cipher_req *req)
+{
+	const EVP_CIPHER *evp = sw_cipher_evp(sess->alg, sess->mode,
+					      sess->key_bytes);
+	int enc = req->op_type == WD_CIPHER_ENCRYPTION;
+	__u8 last[AES_BLOCK_SIZE] = {0};
+	EVP_CIPHER_CTX *ctx;
+	int len, ret;
+
+	if (!evp || !req->in_bytes ||
+	    (sess->mode != WD_CIPHER_CTR && req->in_bytes % AES_BLOCK_SIZE)) {
+		WD_ERR("invalid: sw cipher mode or length %u!\n", req->in_bytes);
+		return -WD_EINVAL;
+	}
+
+	if (sess->mode != WD_CIPHER_ECB &&
+	    (!req->iv || req->iv_bytes < AES_BLOCK_SIZE)) {
+		WD_ERR("invalid: sw cipher iv bytes %u!\n", req->iv_bytes);
+		return -WD_EINVAL;
+	}
+
+	/* the input may be overwritten in place */
+	if (sess->mode == WD_CIPHER_CBC && !enc)
+		memcpy(last, (__u8 *)req->src + req->in_bytes - AES_BLOCK_SIZE,
+		       AES_BLOCK_SIZE);
+
+	ctx = EVP_CIPHER_CTX_new();
+	if (!ctx)
+		return -WD_ENOMEM;
+
+	ret = EVP_CipherInit_ex(ctx, evp, NULL, sess->key, req->iv, enc);
+	if (ret == 1) {
+		EVP_CIPHER_CTX_set_padding(ctx, 0);
+		ret = EVP_CipherUpdate(ctx, req->dst, &len, req->src,
+				       req->in_bytes);
+	}
+	EVP_CIPHER_CTX_free(ctx);
+	if (ret != 1) {
+		WD_ERR("failed to do sw cipher!\n");
+		return -WD_EINVAL;
+	}
+
+	if (sess->mode == WD_CIPHER_CBC && enc)
+		memcpy(req->iv, (__u8 *)req->dst + req->in_bytes -
+		       AES_BLOCK_SIZE, AES_BLOCK_SIZE);
+	else if (sess->mode == WD_CIPHER_CBC)
+		memcpy(req->iv, last, AES_BLOCK_SIZE);
+	else if (sess->mode == WD_CIPHER_CTR)
+		sw_ctr_iv_inc(req->iv, req->iv_bytes / AES_BLOCK_SIZE);
+
+	req->state = WD_SUCCESS;
+
+	return 0;
+}
+
+bool wd_aead_sw_support(struct wd_aead_sess *sess, struct wd_aead_req *req)
+{
+	return req->data_fmt == WD_FLAT_BUF && req->in_bytes <= INT_MAX &&
+	       sess->calg == WD_CIPHER_AES && sess->cmode == WD_CIPHER_GCM &&
+	       sw_aes_evp(sess->cmode, sess->ckey_bytes);
+}
+
+static int sw_gcm_run(EVP_CIPHER_CTX *ctx, struct wd_aead_sess *sess,
+		      struct wd_aead_req *req)
+{
+	int enc = req->op_type == WD_CIPHER_ENCRYPTION_DIGEST;
+	__u8 *in = (__u8 *)req->src + req->assoc_bytes;
+	__u8 *out = (__u8 *)req->dst + req->assoc_bytes;
+	int len;
+
+	if (EVP_CipherInit_ex(ctx, sw_aes_evp(sess->cmode, sess->ckey_bytes),
+			      NULL, NULL, NULL, enc) != 1 ||
+	    EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_IVLEN, req->iv_bytes,
+				NULL) != 1 ||
+	    EVP_CipherInit_ex(ctx, NULL, NULL, sess->ckey, req->iv, enc) != 1)
+		return -WD_EINVAL;
+
+	if (req->assoc_bytes &&
+	    EVP_CipherUpdate(ctx, NULL, &len, req->src, req->assoc_bytes) != 1)
+		return -WD_EINVAL;
+
+	if (EVP_CipherUpdate(ctx, out, &len, in, req->in_bytes) != 1)
+		return -WD_EINVAL;
+
+	/* MAC follows the text in src for decryption, like the driver */
+	if (!enc && EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_TAG,
+					sess->auth_bytes,
+					in + req->in_bytes) != 1)
+		return -WD_EINVAL;
+
+	if (EVP_CipherFinal_ex(ctx, out + req->in_bytes, &len) != 1) {
+		req->state = WD_IN_EPARA;
+		return 0;
+	}
+
+	if (enc && EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_GET_TAG,
+				       sess->auth_bytes,
+				       (__u8 *)req->dst + req->out_bytes -
+				       sess->auth_bytes) != 1)
+		return -WD_EINVAL;
+
+	req->state = WD_SUCCESS;
+
+	return 0;
+}
+
+int wd_aead_sw_do(struct wd_aead_sess *sess, struct wd_aead_req *req)
+{
+	EVP_CIPHER_CTX *ctx;
+	int ret;
+
+	if (!wd_aead_sw_support(sess, req) || !req->in_bytes ||
+	    !sess->auth_bytes || req->out_bytes < sess->auth_bytes) {
+		WD_ERR("invalid: sw aead mode, length or auth bytes!\n");
+		return -WD_EINVAL;
+	}
+
+	ctx = EVP_CIPHER_CTX_new();
+	if (!ctx)
+		return -WD_ENOMEM;
+
+	ret = sw_gcm_run(ctx, sess, req);
+	EVP_CIPHER_CTX_free(ctx);
+	if (ret) {
+		WD_ERR("failed to do sw aead!\n");
+		return ret;
+	}
+
+	if (req->assoc_bytes && req->dst != req->src)
+		memcpy(req->dst, req->src, req->assoc_bytes);
+
+	return 0;
+}
+
+static const EVP_MD *sw_digest_evp(enum wd_digest_type alg)
+{
+	switch (alg) {
+#ifndef OPENSSL_NO_SM3
+	case WD_DIGEST_SM3:
+		return EVP_sm3();
+#endif
+	case WD_DIGEST_MD5:
+		return EVP_md5();
+	case WD_DIGEST_SHA1:
+		return EVP_sha1();
+	case WD_DIGEST_SHA256:
+		return EVP_sha256();
+	case WD_DIGEST_SHA224:
+		return EVP_sha224();
+	case WD_DIGEST_SHA384:
+		return EVP_sha384();
+	case WD_DIGEST_SHA512:
+		return EVP_sha512();
+	case WD_DIGEST_SHA512_224:
+		return EVP_sha512_224();
+	case WD_DIGEST_SHA512_256:
+		return EVP_sha512_256();
+	default:
+		return NULL;
+	}
+}
+
+bool wd_digest_sw_support(struct wd_digest_sess *sess,
+			  struct wd_digest_req *req)
+{
+	return req->data_fmt == WD_FLAT_BUF && !req->has_next &&
+	       req->in_bytes <= INT_MAX && sw_digest_evp(sess->alg) &&
+	       (sess->mode == WD_DIGEST_NORMAL ||
+		(sess->mode == WD_DIGEST_HMAC && sess->key_bytes));
+}
+
+int wd_digest_sw_do(struct wd_digest_sess *sess, struct wd_digest_req *req)
+{
+	const EVP_MD *evp = sw_digest_evp(sess->alg);
+	__u8 md[EVP_MAX_MD_SIZE];
+	unsigned int len = 0;
+	int ret;
+
+	if (!wd_digest_sw_support(sess, req)) {
+		WD_ERR("invalid: sw digest type, mode or key!\n");
+		return -WD_EINVAL;
+	}
+
+	if (sess->mode == WD_DIGEST_HMAC)
+		ret = HMAC(evp, sess->key, sess->key_bytes, req->in,
+			   req->in_bytes, md, &len) ? 1 : 0;
+	else
+		ret = EVP_Digest(req->in, req->in_bytes, md, &len, evp, NULL);
+	if (ret != 1 || req->out_bytes > len) {
+		WD_ERR("failed to do sw digest!\n");
+		return -WD_EINVAL;
+	}
+
+	memcpy(req->out, md, req->out_bytes);
+	req->state = WD_SUCCESS;
+
+	return 0;
+}
+#else
+bool wd_crypto_sw_supported(void)
+{
+	return false;
+}
+
+bool wd_cipher_sw_support(struct wd_cipher_sess *sess,
+			  struct wd_cipher_req *req)
+{
+	return false;
+}
+
+int wd_cipher_sw_do(struct wd_cipher_sess *sess, struct wd_cipher_req *req)
+{
+	WD_ERR("sw engine isn't supported without libcrypto!\n");
+	return -WD_EINVAL;
+}
+
+bool wd_aead_sw_support(struct wd_aead_sess *sess, struct wd_aead_req *req)
+{
+	return false;
+}
+
+int wd_aead_sw_do(struct wd_aead_sess *sess, struct wd_aead_req *req)
+{
+	WD_ERR("sw engine isn't supported without libcrypto!\n");
+	return -WD_EINVAL;
+}
+
+bool wd_digest_sw_support(struct wd_digest_sess *sess,
+			  struct wd_digest_req *req)
+{
+	return false;
+}
+
+int wd_digest_sw_do(struct wd_digest_sess *sess, struct wd_digest_req *req)
+{
+	WD_ERR("sw engine isn't supported without libcrypto!\n");
+	return -WD_EINVAL;
+}
+#endif
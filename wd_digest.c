@@ -1,8 +1,11 @@
 /* SPDX-License-Identifier: Apache-2.0 */
 #include <stdlib.h>
 #include <pthread.h>
+#include <stdbool.h>
 #include "wd_digest.h"
 #include "include/drv/wd_digest_drv.h"
+#include "wd_crypto_share.h"
+#include "wd_crypto_sw.h"
 #include "wd_util.h"
 
 #define XTS_MODE_KEY_DIVISOR	2
@@ -15,6 +18,13 @@
 #define WD_POOL_MAX_ENTRIES	1024
 #define DES_WEAK_KEY_NUM	4
 #define MAX_RETRY_COUNTS	200000000
+#define SESS_KEY_ALIGN		64
+
+#define WD_DIGEST_BLOCK_SIZE		64
+#define WD_DIGEST_LONG_BLOCK_SIZE	128
+/* whole blocks, less than the max input of a BD */
+#define WD_DIGEST_STRM_SEG_MAX		(8 * 1024 * 1024)
+#define WD_DIGEST_STRM_DEPTH		64
 
 static int g_digest_mac_len[WD_DIGEST_TYPE_MAX] = {
 	WD_DIGEST_SM3_LEN, WD_DIGEST_MD5_LEN, WD_DIGEST_SHA1_LEN,
@@ -22,6 +32,74 @@ static int g_digest_mac_len[WD_DIGEST_TYPE_MAX] = {
 	WD_DIGEST_SHA384_LEN, WD_DIGEST_SHA512_LEN,
 	WD_DIGEST_SHA512_224_LEN, WD_DIGEST_SHA512_256_LEN
 };
+
+/* the whole state chained between long BDs, MACs of truncated ones are less */
+static int g_digest_state_len[WD_DIGEST_TYPE_MAX] = {
+	WD_DIGEST_SM3_LEN, WD_DIGEST_MD5_LEN, WD_DIGEST_SHA1_LEN,
+	WD_DIGEST_SHA256_LEN, WD_DIGEST_SHA256_LEN,
+	WD_DIGEST_SHA512_LEN, WD_DIGEST_SHA512_LEN,
+	WD_DIGEST_SHA512_LEN, WD_DIGEST_SHA512_LEN
+};
+/* session and its key in one object, recycled by the calling thread */
+struct wd_digest_sess_obj {
+	struct wd_digest_sess sess;
+	__u8 key[MAX_HMAC_KEY_SIZE] __attribute__((aligned(SESS_KEY_ALIGN)));
+};
+
+struct wd_digest_strm_job {
+	struct wd_digest_req	*req;
+	bool			final;
+};
+
+/* a part of stream which is hashed by one BD */
+struct wd_digest_strm_seg {
+	void			*in;
+	__u32			in_bytes;
+	__u16			has_next;
+};
+
+struct wd_digest_strm {
+	struct wd_digest_sess	*sess;
+	pthread_mutex_t		lock;
+	__u32			block_size;
+	__u32			state_bytes;
+	/* the first BD is done, later BDs take the MAC as iv */
+	bool			started;
+	/* hashed bytes, the end BD pads by the total length */
+	__u64			long_data_len;
+	/* tail shorter than a block, at least 1 byte is kept for the end BD */
+	__u32			partial_len;
+	__u8			partial[WD_DIGEST_LONG_BLOCK_SIZE];
+	/* intermediate MAC, both iv and output of long BDs */
+	__u8			mac[WD_DIGEST_SHA512_LEN];
+	/* consumed bytes of the head job */
+	__u32			in_off;
+	struct wd_digest_strm_seg seg;
+	/* seg is got but not sent for busy queue */
+	bool			seg_ready;
+	/* status of a failed BD, jobs fail until the stream is inited */
+	__u16			err;
+	/* asynchronous jobs in order, only one BD in flight */
+	struct wd_digest_strm_job jobs[WD_DIGEST_STRM_DEPTH];
+	__u32			job_head;
+	__u32			job_num;
+	bool			in_flight;
+	/* the session is freed by the completion of the last job */
+	bool			freeing;
+	struct wd_digest_req	hw_req;
+	/* link in pending list */
+	struct wd_digest_strm	*next;
+};
+
+/* streams which met busy queue, the BD is sent again by polling */
+static struct wd_digest_strm_pending {
+	pthread_mutex_t		lock;
+	struct wd_digest_strm	*head;
+	struct wd_digest_strm	*tail;
+} wd_digest_strm_pending = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
 struct wd_digest_setting {
 	struct wd_ctx_config_internal config;
 	struct wd_sched	sched;
@@ -29,6 +107,8 @@ struct wd_digest_setting {
 	struct wd_async_msg_pool pool;
 	void *sched_ctx;
 	void *priv;
+	/* ctxs are shared with cipher and aead by wd_crypto_init() */
+	bool shared;
 }wd_digest_setting;
 
 #ifdef WD_STATIC_DRV
@@ -82,45 +162,65 @@ int wd_digest_set_key(handle_t h_sess, const __u8 *key, __u32 key_len)
 
 handle_t wd_digest_alloc_sess(struct wd_digest_sess_setup *setup)
 {
-	struct wd_digest_sess *sess = NULL;
+	struct wd_digest_sess_obj *obj;
+	struct wd_digest_sess *sess;
 
 	if (!setup) {
 		WD_ERR("failed to check alloc sess param!\n");
 		return (handle_t)0;
 	}
 
-	sess = malloc(sizeof(struct wd_digest_sess));
-	if (!sess)
+	obj = wd_sess_obj_alloc(WD_SESS_DIGEST,
+				sizeof(struct wd_digest_sess_obj));
+	if (!obj)
 		return (handle_t)0;
-	memset(sess, 0, sizeof(struct wd_digest_sess));
 
+	sess = &obj->sess;
 	sess->alg = setup->alg;
 	sess->mode = setup->mode;
-	sess->key = malloc(MAX_HMAC_KEY_SIZE);
-	if (!sess->key) {
-		free(sess);
-		WD_ERR("failed to alloc sess key!\n");
-		return (handle_t)0;
-	}
-	memset(sess->key, 0, MAX_HMAC_KEY_SIZE);
+	sess->key = obj->key;
 
 	return (handle_t)sess;
 }
 
+static void digest_sess_release(struct wd_digest_sess *sess)
+{
+	struct wd_digest_sess_obj *obj = (struct wd_digest_sess_obj *)sess;
+	struct wd_digest_strm *strm = sess->strm;
+
+	if (strm) {
+		pthread_mutex_destroy(&strm->lock);
+		wd_memset_zero(strm, sizeof(struct wd_digest_strm));
+		free(strm);
+	}
+
+	wd_memset_zero(obj->key, MAX_HMAC_KEY_SIZE);
+	wd_sess_obj_free(WD_SESS_DIGEST, obj);
+}
+
 void wd_digest_free_sess(handle_t h_sess)
 {
 	struct wd_digest_sess *sess = (struct wd_digest_sess *)h_sess;
+	struct wd_digest_strm *strm;
 
 	if (!sess) {
 		WD_ERR("failed to check free sess param!\n");
 		return;
 	}
 
-	if (sess->key) {
-		wd_memset_zero(sess->key, MAX_HMAC_KEY_SIZE);
-		free(sess->key);
+	strm = sess->strm;
+	if (strm) {
+		/* queued jobs may be in flight or on the pending list */
+		pthread_mutex_lock(&strm->lock);
+		if (strm->job_num) {
+			strm->freeing = true;
+			pthread_mutex_unlock(&strm->lock);
+			return;
+		}
+		pthread_mutex_unlock(&strm->lock);
 	}
-	free(sess);
+
+	digest_sess_release(sess);
 }
 
 int wd_digest_init(struct wd_ctx_config *config, struct wd_sched *sched)
@@ -215,16 +315,78 @@ void wd_digest_uninit(void)
 	wd_clear_ctx_config(&wd_digest_setting.config);
 }
 
+int wd_digest_init_shared(struct wd_ctx_config_internal *config,
+			  struct wd_sched *sched)
+{
+	int ret;
+
+	if (wd_digest_setting.config.ctx_num) {
+		WD_ERR("digest is initialized already!\n");
+		return -WD_EBUSY;
+	}
+
+	ret = wd_init_sched(&wd_digest_setting.sched, sched);
+	if (ret < 0) {
+		WD_ERR("failed to set sched, ret = %d!\n", ret);
+		return ret;
+	}
+
+#ifdef WD_STATIC_DRV
+	wd_digest_set_static_drv();
+#endif
+
+	ret = wd_init_async_request_pool(&wd_digest_setting.pool,
+					 config->ctx_num, WD_POOL_MAX_ENTRIES,
+					 sizeof(struct wd_digest_msg));
+	if (ret < 0) {
+		WD_ERR("failed to init req pool, ret = %d!\n", ret);
+		wd_clear_sched(&wd_digest_setting.sched);
+		return ret;
+	}
+
+	/* the driver is inited by wd_crypto_init(), priv is kept NULL */
+	wd_digest_setting.config = *config;
+	wd_digest_setting.shared = true;
+
+	return 0;
+}
+
+void wd_digest_uninit_shared(void)
+{
+	if (!wd_digest_setting.shared)
+		return;
+
+	wd_uninit_async_request_pool(&wd_digest_setting.pool);
+	wd_clear_sched(&wd_digest_setting.sched);
+	/* ctxs are released by wd_crypto_uninit() */
+	memset(&wd_digest_setting.config, 0, sizeof(wd_digest_setting.config));
+	wd_digest_setting.shared = false;
+}
+
+static __u32 digest_pick_ctx(const struct wd_digest_req *req, __u8 mode)
+{
+	struct sched_key key;
+
+	key.mode = mode;
+	key.type = 0;
+	key.numa_id = wd_sess_numa();
+
+	return wd_digest_setting.sched.pick_next_ctx(
+		wd_digest_setting.sched.h_sched_ctx, req, &key);
+}
+
 static int digest_param_ckeck(struct wd_digest_sess *sess,
-	struct wd_digest_req *req)
+	struct wd_digest_req *req, struct wd_digest_strm *strm)
 {
 	if (req->out_buf_bytes < req->out_bytes) {
 		WD_ERR("failed to check digest out buffer length!\n");
 		return -WD_EINVAL;
 	}
 
+	/* BDs of a stream output the whole state */
 	if (sess->alg >= WD_DIGEST_TYPE_MAX || req->out_bytes == 0 ||
-	    req->out_bytes > g_digest_mac_len[sess->alg]) {
+	    req->out_bytes > (strm ? g_digest_state_len[sess->alg] :
+				     g_digest_mac_len[sess->alg])) {
 		WD_ERR("failed to check digest type or mac length!\n");
 		return -WD_EINVAL;
 	}
@@ -251,26 +413,29 @@ static void fill_request_msg(struct wd_digest_msg *msg,
 	msg->data_fmt = req->data_fmt;
 }
 
-int wd_do_digest_sync(handle_t h_sess, struct wd_digest_req *req)
+static void fill_strm_msg(struct wd_digest_msg *msg,
+			  struct wd_digest_strm *strm)
+{
+	msg->iv = strm->mac;
+	msg->iv_bytes = strm->started ? strm->state_bytes : 0;
+	msg->long_data_len = strm->long_data_len + msg->in_bytes;
+}
+
+static int digest_do_sync(struct wd_digest_sess *dsess,
+			  struct wd_digest_req *req,
+			  struct wd_digest_strm *strm)
 {
 	struct wd_ctx_config_internal *config = &wd_digest_setting.config;
-	struct wd_digest_sess *dsess = (struct wd_digest_sess *)h_sess;
 	struct wd_ctx_internal *ctx;
 	struct wd_digest_msg msg;
 	__u64 recv_cnt = 0;
 	int index, ret;
 
-	if (unlikely(!dsess || !req)) {
-		WD_ERR("digest input sess or req is NULL.\n");
-		return -WD_EINVAL;
-	}
-
-	ret = digest_param_ckeck(dsess, req);
+	ret = digest_param_ckeck(dsess, req, strm);
 	if (ret)
 		return -WD_EINVAL;
 
-	/* fix me: maybe wrong */
-	index = wd_digest_setting.sched.pick_next_ctx(0, req, NULL);
+	index = digest_pick_ctx(req, CTX_MODE_SYNC);
 	if (unlikely(index >= config->ctx_num)) {
 		WD_ERR("fail to pick next ctx!\n");
 		return -WD_EINVAL;
@@ -283,6 +448,8 @@ int wd_do_digest_sync(handle_t h_sess, struct wd_digest_req *req)
 
 	memset(&msg, 0, sizeof(struct wd_digest_msg));
 	fill_request_msg(&msg, req, dsess);
+	if (strm)
+		fill_strm_msg(&msg, strm);
 	req->state = 0;
 
 	pthread_spin_lock(&ctx->lock);
@@ -317,24 +484,208 @@ recv_err:
 	return ret;
 }
 
-int wd_do_digest_async(handle_t h_sess, struct wd_digest_req *req)
+int wd_do_digest_sync(handle_t h_sess, struct wd_digest_req *req)
+{
+	struct wd_digest_sess *dsess = (struct wd_digest_sess *)h_sess;
+
+	if (unlikely(!dsess || !req)) {
+		WD_ERR("digest input sess or req is NULL.\n");
+		return -WD_EINVAL;
+	}
+
+	return digest_do_sync(dsess, req, NULL);
+}
+
+static int digest_batch_send(struct wd_ctx_internal *ctx,
+			     struct wd_digest_msg *msgs, __u32 num)
+{
+	struct wd_digest_driver *drv = wd_digest_setting.driver;
+	__u32 i;
+	int ret;
+
+	if (drv->digest_send_batch)
+		return drv->digest_send_batch(ctx->ctx, msgs, num);
+
+	for (i = 0; i < num; i++) {
+		ret = drv->digest_send(ctx->ctx, msgs + i);
+		if (ret < 0)
+			return i ? i : ret;
+	}
+
+	return num;
+}
+
+static int digest_batch_recv(struct wd_ctx_internal *ctx,
+			     struct wd_digest_msg *msgs, __u32 num)
+{
+	struct wd_digest_driver *drv = wd_digest_setting.driver;
+	__u32 i;
+	int ret;
+
+	if (drv->digest_recv_batch)
+		return drv->digest_recv_batch(ctx->ctx, msgs, num);
+
+	for (i = 0; i < num; i++) {
+		ret = drv->digest_recv(ctx->ctx, msgs + i);
+		if (ret == -WD_EAGAIN)
+			break;
+		if (ret < 0)
+			return ret;
+	}
+
+	return i;
+}
+
+static int digest_batch_burst(struct wd_ctx_internal *ctx,
+			      struct wd_digest_sess *dsess,
+			      struct wd_digest_req **reqs, __u32 num)
+{
+	struct wd_digest_msg msgs[WD_DIGEST_BATCH_MAX];
+	struct wd_digest_msg resps[WD_DIGEST_BATCH_MAX];
+	__u32 sent = 0, recv = 0, i;
+	__u64 recv_cnt = 0;
+	int ret, err = 0;
+
+	memset(resps, 0, sizeof(resps));
+	for (i = 0; i < num; i++) {
+		memset(&msgs[i], 0, sizeof(struct wd_digest_msg));
+		fill_request_msg(&msgs[i], reqs[i], dsess);
+		/* it's the index to find request of response */
+		msgs[i].tag = i;
+		reqs[i]->state = 0;
+	}
+
+	pthread_spin_lock(&ctx->lock);
+	while (recv < num) {
+		if (sent < num && !err) {
+			ret = digest_batch_send(ctx, msgs + sent, num - sent);
+			if (ret > 0) {
+				sent += ret;
+			} else if (ret != -WD_EBUSY) {
+				WD_ERR("failed to send digest batch!\n");
+				/* BDs sent should still be received */
+				err = ret;
+				num = sent;
+			}
+		}
+
+		ret = digest_batch_recv(ctx, resps, sent - recv);
+		if (ret < 0) {
+			WD_ERR("failed to recv digest batch!\n");
+			err = ret;
+			break;
+		}
+
+		for (i = 0; i < (__u32)ret; i++)
+			reqs[resps[i].tag]->state = resps[i].result;
+		recv += ret;
+		if (!ret && ++recv_cnt > MAX_RETRY_COUNTS) {
+			WD_ERR("failed to recv digest batch and timeout!\n");
+			err = -WD_ETIMEDOUT;
+			break;
+		}
+	}
+	pthread_spin_unlock(&ctx->lock);
+
+	return err;
+}
+
+int wd_do_digest_batch(handle_t h_sess, struct wd_digest_req **reqs,
+		       __u32 num)
 {
 	struct wd_ctx_config_internal *config = &wd_digest_setting.config;
 	struct wd_digest_sess *dsess = (struct wd_digest_sess *)h_sess;
+	struct wd_digest_req *hw[WD_DIGEST_BATCH_MAX];
 	struct wd_ctx_internal *ctx;
-        struct wd_digest_msg *msg;
-	int index, idx, ret;
+	__u32 i, n;
+	int index, ret;
 
-	if (unlikely(!dsess || !req || !req->cb)) {
-		WD_ERR("digest input sess or req is NULL.\n");
+	if (unlikely(!dsess || !reqs || !num)) {
+		WD_ERR("digest input sess or reqs is NULL.\n");
+		return -WD_EINVAL;
+	}
+
+	for (i = 0; i < num; i++) {
+		if (unlikely(!reqs[i] || reqs[i]->has_next ||
+			     reqs[i]->data_fmt != WD_FLAT_BUF)) {
+			WD_ERR("invalid: digest batch req %u!\n", i);
+			return -WD_EINVAL;
+		}
+
+		ret = digest_param_ckeck(dsess, reqs[i], NULL);
+		if (ret)
+			return -WD_EINVAL;
+	}
+
+	index = digest_pick_ctx(reqs[0], CTX_MODE_SYNC);
+	if (unlikely(index >= config->ctx_num)) {
+		WD_ERR("fail to pick next ctx!\n");
+		return -WD_EINVAL;
+	}
+	ctx = config->ctxs + index;
+	if (ctx->ctx_mode != CTX_MODE_SYNC) {
+		WD_ERR("failed to check ctx mode!\n");
+		return -WD_EINVAL;
+	}
+
+	/* short ones are done by CPU, the others are sent in bursts */
+	for (i = 0, n = 0; i < num; i++) {
+		if (reqs[i]->in_bytes < dsess->sw_thresh &&
+		    wd_digest_sw_support(dsess, reqs[i])) {
+			ret = wd_digest_sw_do(dsess, reqs[i]);
+			if (ret)
+				return ret;
+			continue;
+		}
+
+		hw[n++] = reqs[i];
+		if (n == WD_DIGEST_BATCH_MAX) {
+			ret = digest_batch_burst(ctx, dsess, hw, n);
+			if (ret)
+				return ret;
+			n = 0;
+		}
+	}
+
+	if (n)
+		return digest_batch_burst(ctx, dsess, hw, n);
+
+	return 0;
+}
+
+int wd_digest_set_sw_thresh(handle_t h_sess, __u32 thresh)
+{
+	struct wd_digest_sess *dsess = (struct wd_digest_sess *)h_sess;
+
+	if (!dsess) {
+		WD_ERR("digest input sess is NULL!\n");
+		return -WD_EINVAL;
+	}
+
+	if (thresh && !wd_crypto_sw_supported()) {
+		WD_ERR("invalid: sw engine isn't built in!\n");
 		return -WD_EINVAL;
 	}
 
-	ret = digest_param_ckeck(dsess, req);
+	dsess->sw_thresh = thresh;
+
+	return 0;
+}
+
+static int digest_do_async(struct wd_digest_sess *dsess,
+			   struct wd_digest_req *req,
+			   struct wd_digest_strm *strm)
+{
+	struct wd_ctx_config_internal *config = &wd_digest_setting.config;
+	struct wd_ctx_internal *ctx;
+	struct wd_digest_msg *msg;
+	int index, idx, ret;
+
+	ret = digest_param_ckeck(dsess, req, strm);
 	if (ret)
 		return -WD_EINVAL;
 
-	index = wd_digest_setting.sched.pick_next_ctx(0, req, NULL);
+	index = digest_pick_ctx(req, CTX_MODE_ASYNC);
 	if (unlikely(index >= config->ctx_num)) {
 		WD_ERR("fail to pick next ctx!\n");
 		return -WD_EINVAL;
@@ -353,27 +704,520 @@ int wd_do_digest_async(handle_t h_sess, struct wd_digest_req *req)
 	}
 
 	fill_request_msg(msg, req, dsess);
-	msg->tag = idx;
+	if (strm)
+		fill_strm_msg(msg, strm);
+	msg->tag = wd_crypto_tag(WD_DIGEST, idx);
 
 	ret = wd_digest_setting.driver->digest_send(ctx->ctx, msg);
 	if (ret < 0) {
 		WD_ERR("failed to send BD, hw is err!\n");
-		wd_put_msg_to_pool(&wd_digest_setting.pool, index, msg->tag);
+		wd_put_msg_to_pool(&wd_digest_setting.pool, index, idx);
+		return ret;
+	}
+
+	return 0;
+}
+
+int wd_do_digest_async(handle_t h_sess, struct wd_digest_req *req)
+{
+	struct wd_digest_sess *dsess = (struct wd_digest_sess *)h_sess;
+
+	if (unlikely(!dsess || !req || !req->cb)) {
+		WD_ERR("digest input sess or req is NULL.\n");
+		return -WD_EINVAL;
+	}
+
+	return digest_do_async(dsess, req, NULL);
+}
+static struct wd_digest_strm *digest_strm_get(struct wd_digest_sess *sess)
+{
+	struct wd_digest_strm *strm = sess->strm;
+
+	if (strm)
+		return strm;
+
+	if (sess->alg >= WD_DIGEST_TYPE_MAX) {
+		WD_ERR("failed to check digest type!\n");
+		return NULL;
+	}
+
+	strm = calloc(1, sizeof(struct wd_digest_strm));
+	if (!strm) {
+		WD_ERR("failed to alloc digest stream!\n");
+		return NULL;
+	}
+
+	strm->sess = sess;
+	strm->state_bytes = g_digest_state_len[sess->alg];
+	if (sess->alg >= WD_DIGEST_SHA384)
+		strm->block_size = WD_DIGEST_LONG_BLOCK_SIZE;
+	else
+		strm->block_size = WD_DIGEST_BLOCK_SIZE;
+	pthread_mutex_init(&strm->lock, NULL);
+	sess->strm = strm;
+
+	return strm;
+}
+
+static void digest_strm_reset(struct wd_digest_strm *strm)
+{
+	strm->started = false;
+	strm->long_data_len = 0;
+	strm->partial_len = 0;
+	strm->in_off = 0;
+	strm->seg_ready = false;
+}
+
+int wd_digest_strm_init(handle_t h_sess)
+{
+	struct wd_digest_sess *sess = (struct wd_digest_sess *)h_sess;
+	struct wd_digest_strm *strm;
+	int ret = 0;
+
+	if (unlikely(!sess)) {
+		WD_ERR("digest input sess is NULL.\n");
+		return -WD_EINVAL;
+	}
+
+	strm = digest_strm_get(sess);
+	if (!strm)
+		return -WD_ENOMEM;
+
+	pthread_mutex_lock(&strm->lock);
+	if (strm->job_num) {
+		ret = -WD_EBUSY;
+	} else {
+		digest_strm_reset(strm);
+		strm->err = 0;
+	}
+	pthread_mutex_unlock(&strm->lock);
+
+	return ret;
+}
+
+/*
+ * Get the next segment of job to hash. Return 1 if the segment is got, 0 if
+ * the job is consumed, or a negative error. Bytes not enough for a block are
+ * copied into partial.
+ */
+static int digest_strm_next(struct wd_digest_strm *strm,
+			    struct wd_digest_strm_job *job)
+{
+	struct wd_digest_strm_seg *seg = &strm->seg;
+	struct wd_digest_req *req = job->req;
+	__u32 left = req->in_bytes - strm->in_off;
+	__u8 *in = (__u8 *)req->in + strm->in_off;
+	__u32 bs = strm->block_size;
+	__u64 total;
+	__u32 fill;
+
+	total = (__u64)strm->partial_len + left;
+	if (total > bs) {
+		if (strm->partial_len) {
+			fill = bs - strm->partial_len;
+			memcpy(strm->partial + strm->partial_len, in, fill);
+			strm->partial_len = bs;
+			strm->in_off += fill;
+			seg->in = strm->partial;
+			seg->in_bytes = bs;
+		} else {
+			/* keep the last block at least for the end BD */
+			seg->in = in;
+			seg->in_bytes = (total - 1) / bs * bs;
+			if (seg->in_bytes > WD_DIGEST_STRM_SEG_MAX)
+				seg->in_bytes = WD_DIGEST_STRM_SEG_MAX;
+			strm->in_off += seg->in_bytes;
+		}
+		seg->has_next = 1;
+		return 1;
+	}
+
+	memcpy(strm->partial + strm->partial_len, in, left);
+	strm->partial_len += left;
+	strm->in_off += left;
+	if (!job->final)
+		return 0;
+
+	if (!strm->partial_len) {
+		WD_ERR("invalid: digest stream is empty!\n");
+		return -WD_EINVAL;
+	}
+
+	seg->in = strm->partial;
+	seg->in_bytes = strm->partial_len;
+	seg->has_next = 0;
+
+	return 1;
+}
+
+/* the segment is hashed, the MAC is output if it's the end */
+static void digest_strm_done(struct wd_digest_strm *strm,
+			     struct wd_digest_req *req)
+{
+	strm->long_data_len += strm->seg.in_bytes;
+	strm->started = true;
+	if (strm->seg.in == strm->partial)
+		strm->partial_len = 0;
+
+	if (!strm->seg.has_next) {
+		memcpy(req->out, strm->mac, req->out_bytes);
+		digest_strm_reset(strm);
+	}
+}
+
+static void digest_strm_fill_req(struct wd_digest_strm *strm,
+				 struct wd_digest_req *hw_req)
+{
+	memset(hw_req, 0, sizeof(struct wd_digest_req));
+	hw_req->in = strm->seg.in;
+	hw_req->in_bytes = strm->seg.in_bytes;
+	hw_req->out = strm->mac;
+	hw_req->out_bytes = strm->state_bytes;
+	hw_req->out_buf_bytes = strm->state_bytes;
+	hw_req->has_next = strm->seg.has_next;
+	hw_req->data_fmt = WD_FLAT_BUF;
+}
+
+static int digest_strm_check(struct wd_digest_sess *sess,
+			     struct wd_digest_req *req, bool final)
+{
+	if (unlikely(!sess || !req)) {
+		WD_ERR("digest input sess or req is NULL.\n");
+		return -WD_EINVAL;
+	}
+
+	if (req->data_fmt != WD_FLAT_BUF || (req->in_bytes && !req->in)) {
+		WD_ERR("invalid: digest stream needs flat in buffer!\n");
+		return -WD_EINVAL;
+	}
+
+	if (final && (!req->out || req->out_bytes > req->out_buf_bytes ||
+	    sess->alg >= WD_DIGEST_TYPE_MAX || !req->out_bytes ||
+	    req->out_bytes > g_digest_mac_len[sess->alg])) {
+		WD_ERR("invalid: digest stream out or mac length!\n");
+		return -WD_EINVAL;
+	}
+
+	return 0;
+}
+
+static int digest_strm_sync(handle_t h_sess, struct wd_digest_req *req,
+			    bool final)
+{
+	struct wd_digest_sess *sess = (struct wd_digest_sess *)h_sess;
+	struct wd_digest_strm_job job;
+	struct wd_digest_strm *strm;
+	struct wd_digest_req hw_req;
+	int ret;
+
+	ret = digest_strm_check(sess, req, final);
+	if (ret)
 		return ret;
+
+	strm = digest_strm_get(sess);
+	if (!strm)
+		return -WD_ENOMEM;
+
+	if (strm->job_num) {
+		WD_ERR("digest stream has asynchronous requests!\n");
+		return -WD_EBUSY;
 	}
 
+	job.req = req;
+	job.final = final;
+	req->state = 0;
+	strm->in_off = 0;
+	while ((ret = digest_strm_next(strm, &job)) > 0) {
+		digest_strm_fill_req(strm, &hw_req);
+		ret = digest_do_sync(sess, &hw_req, strm);
+		if (ret || hw_req.state) {
+			req->state = hw_req.state;
+			digest_strm_reset(strm);
+			return ret;
+		}
+
+		digest_strm_done(strm, req);
+		if (!hw_req.has_next)
+			break;
+	}
+
+	return ret < 0 ? ret : 0;
+}
+
+int wd_do_digest_strm_update(handle_t h_sess, struct wd_digest_req *req)
+{
+	return digest_strm_sync(h_sess, req, false);
+}
+
+int wd_do_digest_strm_final(handle_t h_sess, struct wd_digest_req *req)
+{
+	return digest_strm_sync(h_sess, req, true);
+}
+
+static void digest_strm_add_pending(struct wd_digest_strm *strm)
+{
+	struct wd_digest_strm_pending *pending = &wd_digest_strm_pending;
+
+	pthread_mutex_lock(&pending->lock);
+	strm->next = NULL;
+	if (pending->tail)
+		pending->tail->next = strm;
+	else
+		pending->head = strm;
+	pending->tail = strm;
+	pthread_mutex_unlock(&pending->lock);
+}
+
+static struct wd_digest_strm *digest_strm_get_pending(void)
+{
+	struct wd_digest_strm_pending *pending = &wd_digest_strm_pending;
+	struct wd_digest_strm *strm;
+
+	pthread_mutex_lock(&pending->lock);
+	strm = pending->head;
+	if (strm) {
+		pending->head = strm->next;
+		if (!pending->head)
+			pending->tail = NULL;
+	}
+	pthread_mutex_unlock(&pending->lock);
+
+	return strm;
+}
+
+static void *digest_strm_cb(void *data);
+
+/*
+ * Send the next BD of the head job, and pop the jobs which are done into
+ * done[]. The caller holds the lock, and calls callbacks of done[] after
+ * unlock. Return the number of done jobs.
+ */
+static __u32 digest_strm_kick(struct wd_digest_strm *strm,
+			      struct wd_digest_req **done)
+{
+	struct wd_digest_strm_job *job;
+	__u32 num = 0;
+	int ret;
+
+	while (strm->job_num && !strm->in_flight) {
+		job = &strm->jobs[strm->job_head];
+		if (strm->err) {
+			job->req->state = strm->err;
+			goto pop_job;
+		}
+
+		if (!strm->seg_ready) {
+			ret = digest_strm_next(strm, job);
+			if (!ret)
+				goto pop_job;
+			if (ret < 0) {
+				job->req->state = WD_IN_EPARA;
+				goto pop_job;
+			}
+			strm->seg_ready = true;
+		}
+
+		digest_strm_fill_req(strm, &strm->hw_req);
+		strm->hw_req.cb = digest_strm_cb;
+		strm->hw_req.cb_param = strm;
+		strm->in_flight = true;
+		ret = digest_do_async(strm->sess, &strm->hw_req, strm);
+		if (!ret) {
+			strm->seg_ready = false;
+			break;
+		}
+
+		strm->in_flight = false;
+		if (ret == -WD_EBUSY) {
+			/* it can't wait here, leave it to polling */
+			digest_strm_add_pending(strm);
+			break;
+		}
+
+		WD_ERR("failed to send digest stream BD, ret = %d!\n", ret);
+		strm->err = WD_IN_EPARA;
+		job->req->state = strm->err;
+		digest_strm_reset(strm);
+pop_job:
+		done[num++] = job->req;
+		strm->in_off = 0;
+		strm->job_head = (strm->job_head + 1) % WD_DIGEST_STRM_DEPTH;
+		strm->job_num--;
+	}
+
+	return num;
+}
+
+/* the caller holds the lock, only the one which sees it true frees */
+static bool digest_strm_release(struct wd_digest_strm *strm)
+{
+	if (!strm->freeing || strm->job_num)
+		return false;
+
+	strm->freeing = false;
+
+	return true;
+}
+
+static void digest_strm_complete(struct wd_digest_strm *strm,
+				 struct wd_digest_req **done, __u32 num,
+				 bool release)
+{
+	__u32 i;
+
+	for (i = 0; i < num; i++)
+		done[i]->cb(done[i]);
+
+	if (release)
+		digest_sess_release(strm->sess);
+}
+
+static void *digest_strm_cb(void *data)
+{
+	struct wd_digest_req *done[WD_DIGEST_STRM_DEPTH];
+	struct wd_digest_req *hw_req = data;
+	struct wd_digest_strm *strm = hw_req->cb_param;
+	struct wd_digest_strm_job *job;
+	__u32 num = 0;
+	bool release;
+
+	pthread_mutex_lock(&strm->lock);
+	strm->in_flight = false;
+	job = &strm->jobs[strm->job_head];
+	if (hw_req->state) {
+		strm->err = hw_req->state;
+		digest_strm_reset(strm);
+	} else {
+		digest_strm_done(strm, job->req);
+		if (!hw_req->has_next) {
+			done[num++] = job->req;
+			strm->in_off = 0;
+			strm->job_head = (strm->job_head + 1) %
+					 WD_DIGEST_STRM_DEPTH;
+			strm->job_num--;
+		}
+	}
+	num += digest_strm_kick(strm, done + num);
+	release = digest_strm_release(strm);
+	pthread_mutex_unlock(&strm->lock);
+
+	digest_strm_complete(strm, done, num, release);
+
+	return NULL;
+}
+
+static int digest_strm_async(handle_t h_sess, struct wd_digest_req *req,
+			     bool final)
+{
+	struct wd_digest_sess *sess = (struct wd_digest_sess *)h_sess;
+	struct wd_digest_req *done[WD_DIGEST_STRM_DEPTH];
+	struct wd_digest_strm *strm;
+	__u32 num = 0, tail;
+	int ret;
+
+	ret = digest_strm_check(sess, req, final);
+	if (ret)
+		return ret;
+
+	if (unlikely(!req->cb)) {
+		WD_ERR("digest input req cb is NULL.\n");
+		return -WD_EINVAL;
+	}
+
+	strm = digest_strm_get(sess);
+	if (!strm)
+		return -WD_ENOMEM;
+
+	pthread_mutex_lock(&strm->lock);
+	if (strm->job_num == WD_DIGEST_STRM_DEPTH) {
+		pthread_mutex_unlock(&strm->lock);
+		return -WD_EBUSY;
+	}
+
+	req->state = 0;
+	tail = (strm->job_head + strm->job_num) % WD_DIGEST_STRM_DEPTH;
+	strm->jobs[tail].req = req;
+	strm->jobs[tail].final = final;
+	strm->job_num++;
+	/* a pending stream is sent by polling */
+	if (!strm->seg_ready)
+		num = digest_strm_kick(strm, done);
+	pthread_mutex_unlock(&strm->lock);
+
+	digest_strm_complete(strm, done, num, false);
+
+	return 0;
+}
+
+int wd_do_digest_strm_update_async(handle_t h_sess, struct wd_digest_req *req)
+{
+	return digest_strm_async(h_sess, req, false);
+}
+
+int wd_do_digest_strm_final_async(handle_t h_sess, struct wd_digest_req *req)
+{
+	return digest_strm_async(h_sess, req, true);
+}
+
+static void digest_strm_resend(void)
+{
+	struct wd_digest_req *done[WD_DIGEST_STRM_DEPTH];
+	struct wd_digest_strm *strm;
+	bool busy, release;
+	__u32 num;
+
+	while ((strm = digest_strm_get_pending())) {
+		pthread_mutex_lock(&strm->lock);
+		num = digest_strm_kick(strm, done);
+		/* it's added to the tail again */
+		busy = strm->seg_ready && !strm->in_flight;
+		release = digest_strm_release(strm);
+		pthread_mutex_unlock(&strm->lock);
+		digest_strm_complete(strm, done, num, release);
+		if (busy)
+			break;
+	}
+}
+
+int wd_digest_msg_done(__u32 index, struct wd_digest_msg *resp)
+{
+	__u32 tag = wd_crypto_tag_idx(resp->tag);
+	struct wd_digest_msg *msg;
+	struct wd_digest_req *req;
+
+	msg = wd_find_msg_in_pool(&wd_digest_setting.pool, index, tag);
+	if (!msg) {
+		WD_ERR("failed to get msg from pool!\n");
+		return -WD_EINVAL;
+	}
+
+	msg->req.state = resp->result;
+	req = &msg->req;
+	if (likely(req))
+		req->cb(req);
+
+	wd_put_msg_to_pool(&wd_digest_setting.pool, index, tag);
+
 	return 0;
 }
 
+void wd_digest_poll_end(void)
+{
+	/* BDs are received, streams waiting for the queue could go on */
+	digest_strm_resend();
+}
+
 int wd_digest_poll_ctx(__u32 index, __u32 expt, __u32 *count)
 {
 	struct wd_ctx_config_internal *config = &wd_digest_setting.config;
 	struct wd_ctx_internal *ctx = config->ctxs + index;
-	struct wd_digest_msg recv_msg, *msg;
-	struct wd_digest_req *req;
+	struct wd_digest_msg recv_msg;
 	__u32 recv_cnt = 0;
 	int ret;
 
+	if (wd_digest_setting.shared)
+		return wd_crypto_poll_ctx(index, expt, count);
+
 	if (unlikely(index >= config->ctx_num || !count)) {
 		WD_ERR("digest input poll ctx or count is NULL.\n");
 		return -WD_EINVAL;
@@ -392,23 +1236,13 @@ int wd_digest_poll_ctx(__u32 index, __u32 expt, __u32 *count)
 		expt--;
 		recv_cnt++;
 
-		msg = wd_find_msg_in_pool(&wd_digest_setting.pool, index,
-					  recv_msg.tag);
-		if (!msg) {
-			WD_ERR("failed to get msg from pool!\n");
+		if (wd_digest_msg_done(index, &recv_msg))
 			break;
-		}
-
-		msg->req.state = recv_msg.result;
-		req = &msg->req;
-		if (likely(req))
-			req->cb(req);
-
-		wd_put_msg_to_pool(&wd_digest_setting.pool, index,
-				   recv_msg.tag);
 	} while (expt > 0);
 	*count = recv_cnt;
 
+	wd_digest_poll_end();
+
 	return ret;
 }
 
@@ -0,0 +1,667 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/*
+ * Block pipeline of file compression. Input blocks are read ahead while
+ * earlier blocks are compressed by async ctxs and later ones written, instead
+ * of reading the whole file first.
+ *
+ * Reads are issued by the caller thread and writes by a writer thread, each
+ * on its own io_uring, so several blocks are on the disk at the same time.
+ * Without liburing, or if the kernel refuses a ring, a block is read or
+ * written by pread or pwrite when it is issued, and completes at once.
+ */
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "config.h"
+#include "wd_file_pipe.h"
+
+#ifdef HAVE_LIBURING
+#include <liburing.h>
+#endif
+
+/* output of a block may be larger than input */
+#define FP_EXPANSION		2
+
+struct fp_block {
+	void *src;
+	void *dst;
+	__u32 out_len;
+	__u32 status;
+	/* I/O of the block, it's issued again until done or failed */
+	void *io_buf;
+	__u32 io_len;
+	__u32 io_done;
+	__u64 io_off;
+	int io_ret;
+	bool io_write;
+	bool io_complete;
+	struct fp_block *next;
+};
+
+struct fp_queue {
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	struct fp_block *head;
+	struct fp_block *tail;
+};
+
+/* I/O of one thread, a ring isn't shared by threads */
+struct fp_io {
+#ifdef HAVE_LIBURING
+	struct io_uring ring;
+#endif
+	bool uring;
+	int fd;
+	__u32 inflight;
+	/* blocks done by pread or pwrite, or failed to be issued */
+	struct fp_block *done_head;
+	struct fp_block *done_tail;
+};
+
+struct file_pipe {
+	/* a copy with the defaults filled */
+	struct wd_file_pipe_setup setup;
+	struct fp_block *blocks;
+	/* blocks being read, in the order of the file */
+	struct fp_block **order;
+	void *bufs;
+	struct fp_queue free_q;
+	struct fp_queue write_q;
+	struct fp_io rd;
+	struct fp_io wr;
+	/* set by reader when no more block is submitted */
+	bool eof;
+	__u64 submitted;
+	__u64 out_bytes;
+	volatile int err;
+	volatile bool stop_poll;
+	/* blocks in flight are lost if polling fails */
+	volatile bool poll_failed;
+};
+
+static void fp_queue_init(struct fp_queue *q)
+{
+	pthread_mutex_init(&q->lock, NULL);
+	pthread_cond_init(&q->cond, NULL);
+	q->head = NULL;
+	q->tail = NULL;
+}
+
+static void fp_queue_destroy(struct fp_queue *q)
+{
+	pthread_cond_destroy(&q->cond);
+	pthread_mutex_destroy(&q->lock);
+}
+
+static void fp_queue_push(struct fp_queue *q, struct fp_block *blk)
+{
+	pthread_mutex_lock(&q->lock);
+	blk->next = NULL;
+	if (q->tail)
+		q->tail->next = blk;
+	else
+		q->head = blk;
+	q->tail = blk;
+	pthread_cond_signal(&q->cond);
+	pthread_mutex_unlock(&q->lock);
+}
+
+/* the caller holds the lock */
+static struct fp_block *fp_queue_pop_locked(struct fp_queue *q)
+{
+	struct fp_block *blk = q->head;
+
+	if (blk) {
+		q->head = blk->next;
+		if (!q->head)
+			q->tail = NULL;
+	}
+
+	return blk;
+}
+
+/* return NULL if the pipe fails while waiting, or if wait is false */
+static struct fp_block *fp_queue_pop(struct fp_queue *q, volatile int *err,
+				     bool wait)
+{
+	struct fp_block *blk;
+
+	pthread_mutex_lock(&q->lock);
+	while (wait && !q->head && !*err)
+		pthread_cond_wait(&q->cond, &q->lock);
+	blk = fp_queue_pop_locked(q);
+	pthread_mutex_unlock(&q->lock);
+
+	return blk;
+}
+
+static void fp_queue_wake(struct fp_queue *q)
+{
+	pthread_mutex_lock(&q->lock);
+	pthread_cond_broadcast(&q->cond);
+	pthread_mutex_unlock(&q->lock);
+}
+
+static void fp_io_done(struct fp_io *io, struct fp_block *blk)
+{
+	blk->next = NULL;
+	if (io->done_tail)
+		io->done_tail->next = blk;
+	else
+		io->done_head = blk;
+	io->done_tail = blk;
+}
+
+/* read until len or the end of file, or write all of len */
+static void fp_io_sync(struct fp_io *io, struct fp_block *blk)
+{
+	char *buf = blk->io_buf;
+	ssize_t n;
+
+	while (blk->io_done < blk->io_len) {
+		if (blk->io_write)
+			n = pwrite(io->fd, buf + blk->io_done,
+				   blk->io_len - blk->io_done,
+				   blk->io_off + blk->io_done);
+		else
+			n = pread(io->fd, buf + blk->io_done,
+				  blk->io_len - blk->io_done,
+				  blk->io_off + blk->io_done);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n < 0) {
+			blk->io_ret = -errno;
+			break;
+		}
+		if (!n) {
+			if (blk->io_write)
+				blk->io_ret = -WD_EIO;
+			break;
+		}
+		blk->io_done += n;
+	}
+
+	fp_io_done(io, blk);
+}
+
+#ifdef HAVE_LIBURING
+static void fp_io_uring_issue(struct fp_io *io, struct fp_block *blk)
+{
+	char *buf = (char *)blk->io_buf + blk->io_done;
+	__u32 len = blk->io_len - blk->io_done;
+	__u64 off = blk->io_off + blk->io_done;
+	struct io_uring_sqe *sqe;
+	int ret;
+
+	/* no more than the ring entries are in flight */
+	sqe = io_uring_get_sqe(&io->ring);
+	if (!sqe) {
+		blk->io_ret = -WD_EBUSY;
+		fp_io_done(io, blk);
+		return;
+	}
+
+	if (blk->io_write)
+		io_uring_prep_write(sqe, io->fd, buf, len, off);
+	else
+		io_uring_prep_read(sqe, io->fd, buf, len, off);
+	io_uring_sqe_set_data(sqe, blk);
+
+	ret = io_uring_submit(&io->ring);
+	if (ret < 0) {
+		blk->io_ret = ret;
+		fp_io_done(io, blk);
+	}
+}
+
+/* return a block whose I/O is done or failed, short ones are issued again */
+static struct fp_block *fp_io_uring_wait(struct fp_io *io)
+{
+	struct io_uring_cqe *cqe;
+	struct fp_block *blk;
+	int ret;
+
+	while (1) {
+		ret = io_uring_wait_cqe(&io->ring, &cqe);
+		if (ret == -EINTR)
+			continue;
+		if (ret < 0) {
+			/* the blocks in flight are kept by the ring */
+			WD_ERR("failed to wait io_uring, ret = %d!\n", ret);
+			return NULL;
+		}
+
+		blk = io_uring_cqe_get_data(cqe);
+		ret = cqe->res;
+		io_uring_cqe_seen(&io->ring, cqe);
+		if (ret == -EINTR || ret == -EAGAIN) {
+			fp_io_uring_issue(io, blk);
+		} else if (ret < 0) {
+			blk->io_ret = ret;
+			return blk;
+		} else if (!ret) {
+			if (blk->io_write)
+				blk->io_ret = -WD_EIO;
+			return blk;
+		} else {
+			blk->io_done += ret;
+			if (blk->io_done == blk->io_len)
+				return blk;
+			fp_io_uring_issue(io, blk);
+		}
+
+		if (io->done_head)
+			return NULL;
+	}
+}
+#endif
+
+static void fp_io_init(struct fp_io *io, int fd, __u32 depth, bool sync_io)
+{
+	memset(io, 0, sizeof(struct fp_io));
+	io->fd = fd;
+
+#ifdef HAVE_LIBURING
+	/* the kernel may not support it, or it may be disabled */
+	if (!sync_io && !io_uring_queue_init(depth, &io->ring, 0))
+		io->uring = true;
+#endif
+}
+
+static void fp_io_exit(struct fp_io *io)
+{
+#ifdef HAVE_LIBURING
+	if (io->uring)
+		io_uring_queue_exit(&io->ring);
+#endif
+}
+
+static void fp_io_start(struct fp_io *io, struct fp_block *blk, bool write,
+			void *buf, __u32 len, __u64 off)
+{
+	blk->io_buf = buf;
+	blk->io_len = len;
+	blk->io_done = 0;
+	blk->io_off = off;
+	blk->io_ret = 0;
+	blk->io_write = write;
+	blk->io_complete = false;
+	io->inflight++;
+
+#ifdef HAVE_LIBURING
+	if (io->uring) {
+		fp_io_uring_issue(io, blk);
+		return;
+	}
+#endif
+	fp_io_sync(io, blk);
+}
+
+/* wait for any block in flight, return NULL if the ring fails */
+static struct fp_block *fp_io_wait(struct fp_io *io)
+{
+	struct fp_block *blk = io->done_head;
+
+	if (blk) {
+		io->done_head = blk->next;
+		if (!io->done_head)
+			io->done_tail = NULL;
+	}
+
+#ifdef HAVE_LIBURING
+	if (!blk && io->uring)
+		blk = fp_io_uring_wait(io);
+	if (!blk && io->done_head)
+		return fp_io_wait(io);
+#endif
+	if (!blk)
+		return NULL;
+
+	blk->io_complete = true;
+	io->inflight--;
+
+	return blk;
+}
+
+/* called by the sequence strictly in the order of blocks */
+static void fp_sink(struct wd_comp_req *req, __u64 id, void *sink_param)
+{
+	struct file_pipe *fp = sink_param;
+	struct fp_block *blk = req->cb_param;
+
+	blk->out_len = req->dst_len;
+	blk->status = req->status;
+	fp_queue_push(&fp->write_q, blk);
+}
+
+static void fp_set_err(struct file_pipe *fp, int err)
+{
+	pthread_mutex_lock(&fp->write_q.lock);
+	if (!fp->err)
+		fp->err = err;
+	pthread_mutex_unlock(&fp->write_q.lock);
+	/* the reader may wait for a free block which never comes */
+	fp_queue_wake(&fp->free_q);
+}
+
+static void *fp_write_thread(void *arg)
+{
+	struct file_pipe *fp = arg;
+	struct fp_queue *q = &fp->write_q;
+	struct fp_io *io = &fp->wr;
+	struct fp_block *blk;
+	__u64 written = 0;
+	__u64 off = 0;
+
+	while (1) {
+		pthread_mutex_lock(&q->lock);
+		while (!q->head && !io->inflight && !fp->poll_failed &&
+		       !(fp->eof && written == fp->submitted))
+			pthread_cond_wait(&q->cond, &q->lock);
+		blk = fp_queue_pop_locked(q);
+		pthread_mutex_unlock(&q->lock);
+
+		/* blocks are issued in order, so their offsets are known */
+		if (blk) {
+			if (blk->status) {
+				WD_ERR("block %llu is failed, status = %u!\n",
+				       (unsigned long long)written,
+				       blk->status);
+				fp_set_err(fp, -WD_EIO);
+			}
+			if (fp->err) {
+				written++;
+				fp_queue_push(&fp->free_q, blk);
+			} else {
+				fp_io_start(io, blk, true, blk->dst,
+					    blk->out_len, off);
+				off += blk->out_len;
+			}
+			continue;
+		}
+
+		if (!io->inflight)
+			break;
+
+		blk = fp_io_wait(io);
+		if (!blk) {
+			fp_set_err(fp, -WD_EIO);
+			break;
+		}
+		if (blk->io_ret) {
+			WD_ERR("failed to write output, ret = %d!\n",
+			       blk->io_ret);
+			fp_set_err(fp, blk->io_ret);
+		}
+		written++;
+		fp_queue_push(&fp->free_q, blk);
+	}
+
+	fp->out_bytes = off;
+
+	return NULL;
+}
+
+static void *fp_poll_thread(void *arg)
+{
+	struct file_pipe *fp = arg;
+	__u32 count;
+	int ret;
+
+	while (!fp->stop_poll) {
+		count = 0;
+		ret = wd_comp_poll(1, &count);
+		if (ret < 0 && ret != -WD_EAGAIN) {
+			WD_ERR("failed to poll, ret = %d!\n", ret);
+			pthread_mutex_lock(&fp->write_q.lock);
+			fp->err = ret;
+			fp->poll_failed = true;
+			pthread_cond_signal(&fp->write_q.cond);
+			pthread_mutex_unlock(&fp->write_q.lock);
+			/*
+			 * Blocks in flight never come back to the free queue,
+			 * so the reader waiting for one has to bail out.
+			 */
+			fp_queue_wake(&fp->free_q);
+			break;
+		}
+	}
+
+	return NULL;
+}
+
+static int fp_alloc_blocks(struct file_pipe *fp)
+{
+	struct wd_file_pipe_setup *setup = &fp->setup;
+	size_t dst_size = (size_t)setup->block_size * FP_EXPANSION;
+	size_t blk_size = setup->block_size + dst_size;
+	__u32 i;
+
+	fp->blocks = calloc(setup->depth, sizeof(struct fp_block));
+	fp->order = calloc(setup->depth, sizeof(struct fp_block *));
+	fp->bufs = malloc(blk_size * setup->depth);
+	if (!fp->blocks || !fp->order || !fp->bufs) {
+		free(fp->bufs);
+		free(fp->order);
+		free(fp->blocks);
+		return -WD_ENOMEM;
+	}
+
+	for (i = 0; i < setup->depth; i++) {
+		fp->blocks[i].src = (char *)fp->bufs + blk_size * i;
+		fp->blocks[i].dst = (char *)fp->blocks[i].src +
+				    setup->block_size;
+		fp_queue_push(&fp->free_q, &fp->blocks[i]);
+	}
+
+	return 0;
+}
+
+static void fp_free_blocks(struct file_pipe *fp)
+{
+	free(fp->bufs);
+	free(fp->order);
+	free(fp->blocks);
+}
+
+static int fp_send_block(struct file_pipe *fp, handle_t h_seq,
+			 struct fp_block *blk)
+{
+	struct wd_comp_req req;
+	int ret;
+
+	memset(&req, 0, sizeof(struct wd_comp_req));
+	req.src = blk->src;
+	req.src_len = blk->io_done;
+	req.dst = blk->dst;
+	req.dst_len = fp->setup.block_size * FP_EXPANSION;
+	req.op_type = WD_DIR_COMPRESS;
+	req.data_fmt = WD_FLAT_BUF;
+	req.cb_param = blk;
+	/* a busy queue, or ids of busy sends hold the window for a while */
+	do {
+		ret = wd_do_comp_seq_async(h_seq, &req, NULL);
+		if (ret == -WD_EBUSY)
+			sched_yield();
+	} while (ret == -WD_EBUSY && !fp->err);
+	if (ret) {
+		WD_ERR("failed to send block, ret = %d!\n", ret);
+		return ret;
+	}
+
+	pthread_mutex_lock(&fp->write_q.lock);
+	fp->submitted++;
+	pthread_mutex_unlock(&fp->write_q.lock);
+
+	return 0;
+}
+
+/* wait until the block is read, others may complete meanwhile */
+static int fp_wait_read(struct file_pipe *fp, struct fp_block *blk)
+{
+	while (!blk->io_complete)
+		if (!fp_io_wait(&fp->rd))
+			return -WD_EIO;
+
+	return 0;
+}
+
+static int fp_read_blocks(struct file_pipe *fp, handle_t h_seq,
+			  struct wd_file_pipe_stat *stat)
+{
+	struct wd_file_pipe_setup *setup = &fp->setup;
+	__u32 mask = setup->depth - 1;
+	__u32 head = 0, tail = 0;
+	struct fp_block *blk;
+	bool eof = false;
+	__u64 off = 0;
+	int ret = 0;
+	__u32 len;
+
+	while (!fp->err && !ret) {
+		/* read ahead into every free block, wait only if none is read */
+		while (!eof && tail - head <= mask) {
+			blk = fp_queue_pop(&fp->free_q, &fp->err, head == tail);
+			if (!blk)
+				break;
+			fp_io_start(&fp->rd, blk, false, blk->src,
+				    setup->block_size, off);
+			off += setup->block_size;
+			fp->order[tail++ & mask] = blk;
+		}
+		if (head == tail)
+			break;
+
+		blk = fp->order[head++ & mask];
+		ret = fp_wait_read(fp, blk);
+		if (ret)
+			break;
+
+		/* a short read is the end of file, later ones get nothing */
+		if (blk->io_ret || blk->io_done < setup->block_size)
+			eof = true;
+		if (blk->io_ret) {
+			WD_ERR("failed to read input, ret = %d!\n",
+			       blk->io_ret);
+			ret = blk->io_ret;
+		}
+		if (ret || !blk->io_done) {
+			fp_queue_push(&fp->free_q, blk);
+			continue;
+		}
+
+		/* the writer takes the block once it is sent */
+		len = blk->io_done;
+		ret = fp_send_block(fp, h_seq, blk);
+		if (ret) {
+			fp_queue_push(&fp->free_q, blk);
+			break;
+		}
+		stat->in_bytes += len;
+	}
+
+	/* reads in flight use the buffers, and the ring is freed after */
+	while (head != tail) {
+		blk = fp->order[head++ & mask];
+		if (fp_wait_read(fp, blk))
+			return -WD_EIO;
+		fp_queue_push(&fp->free_q, blk);
+	}
+
+	return ret ? ret : fp->err;
+}
+
+int wd_file_pipe_compress(struct wd_file_pipe_setup *setup,
+			  struct wd_file_pipe_stat *stat)
+{
+	struct wd_comp_seq_setup seq_setup = {0};
+	struct file_pipe fp = {0};
+	pthread_t writer, poller;
+	bool poll = false;
+	handle_t h_seq;
+	int ret;
+
+	if (!setup || !stat || !setup->h_sess) {
+		WD_ERR("invalid: file pipe setup, stat or sess is NULL!\n");
+		return -WD_EINVAL;
+	}
+
+	memset(stat, 0, sizeof(struct wd_file_pipe_stat));
+	fp.setup = *setup;
+	if (!fp.setup.block_size)
+		fp.setup.block_size = WD_FILE_PIPE_BLOCK_SIZE;
+	if (!fp.setup.depth)
+		fp.setup.depth = WD_FILE_PIPE_DEPTH;
+	if (fp.setup.block_size > UINT32_MAX / FP_EXPANSION ||
+	    (fp.setup.depth & (fp.setup.depth - 1))) {
+		WD_ERR("invalid: block size or depth of file pipe!\n");
+		return -WD_EINVAL;
+	}
+
+	fp_queue_init(&fp.free_q);
+	fp_queue_init(&fp.write_q);
+	ret = fp_alloc_blocks(&fp);
+	if (ret)
+		goto out_queue;
+
+	seq_setup.window = fp.setup.depth;
+	seq_setup.sink = fp_sink;
+	seq_setup.sink_param = &fp;
+	h_seq = wd_comp_seq_alloc(fp.setup.h_sess, &seq_setup);
+	if (!h_seq) {
+		ret = -WD_EINVAL;
+		goto out_blocks;
+	}
+
+	fp_io_init(&fp.rd, fp.setup.in_fd, fp.setup.depth, fp.setup.sync_io);
+	fp_io_init(&fp.wr, fp.setup.out_fd, fp.setup.depth, fp.setup.sync_io);
+	stat->uring = fp.rd.uring && fp.wr.uring;
+
+	ret = pthread_create(&writer, NULL, fp_write_thread, &fp);
+	if (ret) {
+		ret = -ret;
+		goto out_io;
+	}
+	if (fp.setup.poll) {
+		ret = pthread_create(&poller, NULL, fp_poll_thread, &fp);
+		if (ret)
+			fp_set_err(&fp, -ret);
+		else
+			poll = true;
+	}
+
+	ret = fp.err ? fp.err : fp_read_blocks(&fp, h_seq, stat);
+
+	/* writer leaves once every submitted block is written */
+	pthread_mutex_lock(&fp.write_q.lock);
+	fp.eof = true;
+	pthread_cond_signal(&fp.write_q.cond);
+	pthread_mutex_unlock(&fp.write_q.lock);
+	pthread_join(writer, NULL);
+
+	if (poll) {
+		fp.stop_poll = true;
+		pthread_join(poller, NULL);
+	}
+
+	stat->out_bytes = fp.out_bytes;
+	stat->blocks = fp.submitted;
+	if (!ret)
+		ret = fp.err;
+
+out_io:
+	fp_io_exit(&fp.wr);
+	fp_io_exit(&fp.rd);
+	wd_comp_seq_free(h_seq);
+out_blocks:
+	fp_free_blocks(&fp);
+out_queue:
+	fp_queue_destroy(&fp.write_q);
+	fp_queue_destroy(&fp.free_q);
+	return ret;
+}
@@ -0,0 +1,370 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "wd_pipe.h"
+
+struct wd_pipe_sess;
+
+/* one request in flight, owns an intermediate buffer */
+struct wd_pipe_job {
+	struct wd_pipe_sess	*sess;
+	struct wd_pipe_req	*req;
+	struct wd_comp_req	comp_req;
+	struct wd_aead_req	aead_req;
+	void			*buf;
+	/* link in free list of session or in pending list */
+	struct wd_pipe_job	*next;
+};
+
+struct wd_pipe_sess {
+	handle_t		h_comp;
+	handle_t		h_aead;
+	__u32			buf_size;
+	__u32			buf_num;
+	void			*bufs;
+	struct wd_pipe_job	*jobs;
+	struct wd_pipe_job	*free_list;
+	/* jobs in flight or pending, they aren't in free list */
+	__u32			busy_num;
+	pthread_spinlock_t	lock;
+};
+
+/* AEAD requests that met a busy queue, submitted again by wd_pipe_poll() */
+static struct wd_pipe_pending {
+	pthread_mutex_t		lock;
+	struct wd_pipe_job	*head;
+	struct wd_pipe_job	*tail;
+} wd_pipe_pending = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+/* callbacks run in the polling thread, count what they complete there */
+static __thread __u32 wd_pipe_done;
+
+handle_t wd_pipe_alloc_sess(struct wd_pipe_sess_setup *setup)
+{
+	struct wd_aead_sess *aead;
+	struct wd_pipe_sess *sess;
+	__u32 i;
+
+	if (!setup || !setup->h_comp || !setup->h_aead) {
+		WD_ERR("invalid: pipe setup or sessions are NULL!\n");
+		return (handle_t)0;
+	}
+
+	aead = (struct wd_aead_sess *)setup->h_aead;
+	if (aead->cmode == WD_CIPHER_CBC) {
+		WD_ERR("invalid: pipe doesn't support aead cbc mode!\n");
+		return (handle_t)0;
+	}
+
+	sess = calloc(1, sizeof(struct wd_pipe_sess));
+	if (!sess)
+		return (handle_t)0;
+
+	sess->h_comp = setup->h_comp;
+	sess->h_aead = setup->h_aead;
+	sess->buf_size = setup->buf_size ? setup->buf_size : WD_PIPE_BUF_SIZE;
+	sess->buf_num = setup->buf_num ? setup->buf_num : WD_PIPE_BUF_NUM;
+
+	sess->jobs = calloc(sess->buf_num, sizeof(struct wd_pipe_job));
+	if (!sess->jobs)
+		goto free_sess;
+
+	sess->bufs = mmap(NULL, (size_t)sess->buf_size * sess->buf_num,
+			  PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS,
+			  -1, 0);
+	if (sess->bufs == MAP_FAILED) {
+		WD_ERR("failed to alloc %u pipe buffers!\n", sess->buf_num);
+		goto free_jobs;
+	}
+
+	for (i = 0; i < sess->buf_num; i++) {
+		sess->jobs[i].sess = sess;
+		sess->jobs[i].buf = (__u8 *)sess->bufs +
+				    (size_t)sess->buf_size * i;
+		sess->jobs[i].next = sess->free_list;
+		sess->free_list = &sess->jobs[i];
+	}
+	pthread_spin_init(&sess->lock, PTHREAD_PROCESS_PRIVATE);
+
+	return (handle_t)sess;
+
+free_jobs:
+	free(sess->jobs);
+free_sess:
+	free(sess);
+	return (handle_t)0;
+}
+
+int wd_pipe_free_sess(handle_t h_sess)
+{
+	struct wd_pipe_sess *sess = (struct wd_pipe_sess *)h_sess;
+	__u32 busy_num;
+
+	if (!sess)
+		return -WD_EINVAL;
+
+	pthread_spin_lock(&sess->lock);
+	busy_num = sess->busy_num;
+	pthread_spin_unlock(&sess->lock);
+	if (busy_num) {
+		WD_ERR("pipe sess has %u requests, it isn't freed!\n",
+		       busy_num);
+		return -WD_EBUSY;
+	}
+
+	pthread_spin_destroy(&sess->lock);
+	munmap(sess->bufs, (size_t)sess->buf_size * sess->buf_num);
+	free(sess->jobs);
+	free(sess);
+
+	return 0;
+}
+
+static struct wd_pipe_job *wd_pipe_get_job(struct wd_pipe_sess *sess)
+{
+	struct wd_pipe_job *job;
+
+	pthread_spin_lock(&sess->lock);
+	job = sess->free_list;
+	if (job) {
+		sess->free_list = job->next;
+		sess->busy_num++;
+	}
+	pthread_spin_unlock(&sess->lock);
+
+	return job;
+}
+
+static void wd_pipe_put_job(struct wd_pipe_job *job)
+{
+	struct wd_pipe_sess *sess = job->sess;
+
+	pthread_spin_lock(&sess->lock);
+	job->next = sess->free_list;
+	sess->free_list = job;
+	sess->busy_num--;
+	pthread_spin_unlock(&sess->lock);
+}
+
+static void wd_pipe_complete(struct wd_pipe_job *job, int status)
+{
+	struct wd_pipe_req *req = job->req;
+
+	req->status = status;
+	/* the buffer is free before callback, so it could submit again */
+	wd_pipe_put_job(job);
+	wd_pipe_done++;
+	req->cb(req, req->cb_param);
+}
+
+static void wd_pipe_add_pending(struct wd_pipe_job *job, bool head)
+{
+	struct wd_pipe_pending *pending = &wd_pipe_pending;
+
+	pthread_mutex_lock(&pending->lock);
+	if (head) {
+		job->next = pending->head;
+		pending->head = job;
+		if (!pending->tail)
+			pending->tail = job;
+	} else {
+		job->next = NULL;
+		if (pending->tail)
+			pending->tail->next = job;
+		else
+			pending->head = job;
+		pending->tail = job;
+	}
+	pthread_mutex_unlock(&pending->lock);
+}
+
+static struct wd_pipe_job *wd_pipe_get_pending(void)
+{
+	struct wd_pipe_pending *pending = &wd_pipe_pending;
+	struct wd_pipe_job *job;
+
+	pthread_mutex_lock(&pending->lock);
+	job = pending->head;
+	if (job) {
+		pending->head = job->next;
+		if (!pending->head)
+			pending->tail = NULL;
+	}
+	pthread_mutex_unlock(&pending->lock);
+
+	return job;
+}
+
+/* Return -WD_EBUSY if the job should be tried again later. */
+static int wd_pipe_send_aead(struct wd_pipe_job *job)
+{
+	int ret;
+
+	ret = wd_do_aead_async(job->sess->h_aead, &job->aead_req);
+	if (ret == -WD_EBUSY)
+		return ret;
+
+	if (ret < 0) {
+		WD_ERR("failed to send pipe aead request, ret = %d!\n", ret);
+		wd_pipe_complete(job, ret);
+	}
+
+	return 0;
+}
+
+static void *wd_pipe_aead_cb(struct wd_aead_req *aead_req, void *cb_param)
+{
+	struct wd_pipe_job *job = cb_param;
+
+	if (!aead_req->state)
+		job->req->dst_len = aead_req->out_bytes;
+	wd_pipe_complete(job, aead_req->state);
+
+	return NULL;
+}
+
+static void *wd_pipe_comp_cb(struct wd_comp_req *comp_req, void *cb_param)
+{
+	struct wd_pipe_job *job = cb_param;
+	struct wd_aead_req *aead_req = &job->aead_req;
+	struct wd_pipe_req *req = job->req;
+	int auth_bytes;
+
+	if (comp_req->status) {
+		wd_pipe_complete(job, comp_req->status);
+		return NULL;
+	}
+
+	auth_bytes = wd_aead_get_authsize(job->sess->h_aead);
+	if (auth_bytes < 0) {
+		wd_pipe_complete(job, auth_bytes);
+		return NULL;
+	}
+
+	/* associated data is already in front of compressed data */
+	req->comp_len = comp_req->dst_len;
+	memset(aead_req, 0, sizeof(struct wd_aead_req));
+	aead_req->op_type = WD_CIPHER_ENCRYPTION_DIGEST;
+	aead_req->src = job->buf;
+	aead_req->dst = req->dst;
+	aead_req->iv = req->iv;
+	aead_req->iv_bytes = req->iv_bytes;
+	aead_req->assoc_bytes = req->assoc_bytes;
+	aead_req->in_bytes = req->comp_len;
+	aead_req->out_bytes = req->assoc_bytes + req->comp_len + auth_bytes;
+	aead_req->out_buf_bytes = req->dst_len;
+	aead_req->data_fmt = WD_FLAT_BUF;
+	aead_req->cb = wd_pipe_aead_cb;
+	aead_req->cb_param = job;
+
+	if (aead_req->out_bytes > aead_req->out_buf_bytes) {
+		WD_ERR("invalid: pipe dst_len %u is less than %u!\n",
+		       req->dst_len, aead_req->out_bytes);
+		wd_pipe_complete(job, -WD_EINVAL);
+		return NULL;
+	}
+
+	/* it can't wait in the callback, leave it to wd_pipe_poll() */
+	if (wd_pipe_send_aead(job) == -WD_EBUSY)
+		wd_pipe_add_pending(job, false);
+
+	return NULL;
+}
+
+int wd_do_pipe_async(handle_t h_sess, struct wd_pipe_req *req)
+{
+	struct wd_pipe_sess *sess = (struct wd_pipe_sess *)h_sess;
+	struct wd_comp_req *comp_req;
+	struct wd_pipe_job *job;
+	int ret;
+
+	if (!sess || !req || !req->cb) {
+		WD_ERR("invalid: pipe sess, req or callback is NULL!\n");
+		return -WD_EINVAL;
+	}
+
+	if (!req->src || !req->src_len || !req->dst ||
+	    (req->assoc_bytes && !req->assoc)) {
+		WD_ERR("invalid: pipe req buffers are NULL or empty!\n");
+		return -WD_EINVAL;
+	}
+
+	if (req->assoc_bytes >= sess->buf_size) {
+		WD_ERR("invalid: pipe assoc_bytes %u is too long!\n",
+		       req->assoc_bytes);
+		return -WD_EINVAL;
+	}
+
+	job = wd_pipe_get_job(sess);
+	if (!job)
+		return -WD_EBUSY;
+
+	job->req = req;
+	if (req->assoc_bytes)
+		memcpy(job->buf, req->assoc, req->assoc_bytes);
+
+	comp_req = &job->comp_req;
+	memset(comp_req, 0, sizeof(struct wd_comp_req));
+	comp_req->src = req->src;
+	comp_req->src_len = req->src_len;
+	comp_req->dst = (__u8 *)job->buf + req->assoc_bytes;
+	comp_req->dst_len = sess->buf_size - req->assoc_bytes;
+	comp_req->op_type = WD_DIR_COMPRESS;
+	comp_req->data_fmt = WD_FLAT_BUF;
+	comp_req->cb = wd_pipe_comp_cb;
+	comp_req->cb_param = job;
+
+	ret = wd_do_comp_async(sess->h_comp, comp_req);
+	if (ret < 0)
+		wd_pipe_put_job(job);
+
+	return ret;
+}
+
+static void wd_pipe_resend(void)
+{
+	struct wd_pipe_job *job;
+
+	while ((job = wd_pipe_get_pending())) {
+		if (wd_pipe_send_aead(job) == -WD_EBUSY) {
+			/* keep the order, it's the oldest one */
+			wd_pipe_add_pending(job, true);
+			break;
+		}
+	}
+}
+
+int wd_pipe_poll(__u32 expt, __u32 *count)
+{
+	__u32 start = wd_pipe_done;
+	__u32 recv = 0;
+	int ret;
+
+	if (!count) {
+		WD_ERR("invalid: pipe poll count is NULL!\n");
+		return -WD_EINVAL;
+	}
+
+	wd_pipe_resend();
+
+	ret = wd_comp_poll(expt, &recv);
+	if (ret < 0 && ret != -WD_EAGAIN)
+		return ret;
+
+	/* compression just done may have met a busy aead queue */
+	wd_pipe_resend();
+
+	recv = 0;
+	ret = wd_aead_poll(expt, &recv);
+	if (ret < 0 && ret != -WD_EAGAIN)
+		return ret;
+
+	*count = wd_pipe_done - start;
+
+	return 0;
+}
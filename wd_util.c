@@ -1,9 +1,17 @@
 // SPDX-License-Identifier: Apache-2.0
-#include <stdlib.h>
+#define _GNU_SOURCE
+#include <numa.h>
 #include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
 #include "wd_alg_common.h"
 #include "wd_util.h"
 
+#define WD_SESS_CACHE_MAX	64
+#define WD_CACHE_LINE		64
+
 struct msg_pool {
 	/* message array allocated dynamically */
 	void *msgs;
@@ -14,6 +22,19 @@ struct msg_pool {
 	int tail;
 };
 
+/* freed session objects of one thread, linked by their first bytes */
+struct wd_sess_cache {
+	void *head[WD_SESS_TYPE_MAX];
+	__u32 num[WD_SESS_TYPE_MAX];
+	int numa;
+};
+
+static __thread struct wd_sess_cache *sess_cache;
+/* set once the cache is released on thread exit, it isn't built again */
+static __thread bool sess_cache_dead;
+static pthread_key_t sess_cache_key;
+static pthread_once_t sess_cache_once = PTHREAD_ONCE_INIT;
+
 static void clone_ctx_to_internal(struct wd_ctx *ctx,
 				  struct wd_ctx_internal *ctx_in)
 {
@@ -222,3 +243,108 @@ void wd_put_msg_to_pool(struct wd_async_msg_pool *pool, int index, __u32 tag)
 
 	__atomic_clear(&p->used[tag - 1], __ATOMIC_RELEASE);
 }
+
+static void sess_cache_release(void *data)
+{
+	struct wd_sess_cache *cache = data;
+	void *obj;
+	int i;
+
+	for (i = 0; i < WD_SESS_TYPE_MAX; i++) {
+		while (cache->head[i]) {
+			obj = cache->head[i];
+			cache->head[i] = *(void **)obj;
+			free(obj);
+		}
+	}
+	free(cache);
+
+	/* later TLS destructors may still free sessions, they bypass the cache */
+	sess_cache = NULL;
+	sess_cache_dead = true;
+}
+
+static void sess_cache_key_init(void)
+{
+	(void)pthread_key_create(&sess_cache_key, sess_cache_release);
+}
+
+static void sess_cache_update_numa(struct wd_sess_cache *cache)
+{
+	int cpu = sched_getcpu();
+
+	cache->numa = cpu < 0 ? 0 : numa_node_of_cpu(cpu);
+	if (cache->numa < 0)
+		cache->numa = 0;
+}
+
+static struct wd_sess_cache *sess_cache_get(void)
+{
+	struct wd_sess_cache *cache = sess_cache;
+
+	if (likely(cache))
+		return cache;
+
+	if (sess_cache_dead)
+		return NULL;
+
+	pthread_once(&sess_cache_once, sess_cache_key_init);
+	cache = calloc(1, sizeof(struct wd_sess_cache));
+	if (!cache)
+		return NULL;
+
+	sess_cache_update_numa(cache);
+
+	/* without the destructor, cached objects would leak on thread exit */
+	if (pthread_setspecific(sess_cache_key, cache)) {
+		free(cache);
+		return NULL;
+	}
+	sess_cache = cache;
+
+	return cache;
+}
+
+void *wd_sess_obj_alloc(enum wd_sess_type type, __u32 size)
+{
+	struct wd_sess_cache *cache = sess_cache_get();
+	__u32 len = (size + WD_CACHE_LINE - 1) & ~(WD_CACHE_LINE - 1);
+	void *obj;
+
+	if (cache && cache->head[type]) {
+		obj = cache->head[type];
+		cache->head[type] = *(void **)obj;
+		cache->num[type]--;
+	} else {
+		/* a miss is slow anyway, follow the thread if it has migrated */
+		if (cache)
+			sess_cache_update_numa(cache);
+		if (posix_memalign(&obj, WD_CACHE_LINE, len))
+			return NULL;
+	}
+
+	memset(obj, 0, size);
+
+	return obj;
+}
+
+void wd_sess_obj_free(enum wd_sess_type type, void *obj)
+{
+	struct wd_sess_cache *cache = sess_cache_get();
+
+	if (!cache || cache->num[type] >= WD_SESS_CACHE_MAX) {
+		free(obj);
+		return;
+	}
+
+	*(void **)obj = cache->head[type];
+	cache->head[type] = obj;
+	cache->num[type]++;
+}
+
+int wd_sess_numa(void)
+{
+	struct wd_sess_cache *cache = sess_cache_get();
+
+	return cache ? cache->numa : 0;
+}